@@ -1,15 +1,182 @@
 #include "OBJLoader.h"
+#include "TangentSpace.hpp"
+#include "Trace.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <unordered_map>
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
 
-Mesh OBJLoader::LoadOBJ(const std::string& filepath) {
+bool Material::SameAppearance(const Material& other) const {
+    return ambient == other.ambient && diffuse == other.diffuse && specular == other.specular &&
+           emissive == other.emissive && shininess == other.shininess && opacity == other.opacity &&
+           indexOfRefraction == other.indexOfRefraction && roughness == other.roughness &&
+           metallic == other.metallic && illuminationModel == other.illuminationModel &&
+           diffuseMap == other.diffuseMap && specularMap == other.specularMap &&
+           normalMap == other.normalMap && opacityMap == other.opacityMap;
+}
+
+// Directory part of a path, including the trailing separator.
+static std::string DirectoryOf(const std::string& path) {
+    size_t slash = path.find_last_of("/\\");
+    return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+}
+
+// Reorders the triangles (and, since LoadOBJ gives every corner its own
+// vertex, the vertices with them) so each material's triangles are
+// contiguous, keeping their original order, and records one submesh each.
+static void SortTrianglesByMaterial(Mesh& mesh, const std::vector<unsigned int>& triangleMaterials) {
+    size_t triangleCount = triangleMaterials.size();
+    std::vector<unsigned int> start(mesh.materials.size() + 1, 0);
+    for (unsigned int material : triangleMaterials) {
+        start[material + 1]++;
+    }
+    for (size_t m = 0; m < mesh.materials.size(); m++) {
+        start[m + 1] += start[m];
+    }
+    std::vector<unsigned int> order(triangleCount);
+    std::vector<unsigned int> cursor(start.begin(), start.end() - 1);
+    for (size_t t = 0; t < triangleCount; t++) {
+        order[cursor[triangleMaterials[t]]++] = (unsigned int)t;
+    }
+    std::vector<Vertex> vertices(triangleCount * 3);
+    std::vector<unsigned int> positionIds(triangleCount * 3);
+    std::vector<unsigned int> smoothingGroups(triangleCount);
+    for (size_t i = 0; i < triangleCount; i++) {
+        size_t t = order[i];
+        for (int corner = 0; corner < 3; corner++) {
+            vertices[i * 3 + corner] = mesh.vertices[t * 3 + corner];
+            positionIds[i * 3 + corner] = mesh.positionIds[t * 3 + corner];
+            mesh.indices[i * 3 + corner] = (unsigned int)(i * 3 + corner);
+        }
+        smoothingGroups[i] = mesh.smoothingGroups[t];
+    }
+    mesh.vertices = std::move(vertices);
+    mesh.positionIds = std::move(positionIds);
+    mesh.smoothingGroups = std::move(smoothingGroups);
+    mesh.submeshes.clear();
+    for (size_t m = 0; m < mesh.materials.size(); m++) {
+        Submesh submesh;
+        submesh.indexOffset = start[m] * 3;
+        submesh.indexCount = (start[m + 1] - start[m]) * 3;
+        submesh.material = (unsigned int)m;
+        mesh.submeshes.push_back(submesh);
+    }
+}
+
+bool OBJLoader::LoadMTL(const std::string& filepath, std::vector<Material>& materials) {
+    std::ifstream file(filepath);
+    if (!file.is_open()) {
+        return false;
+    }
+    std::string directory = DirectoryOf(filepath);
+    Material* material = nullptr;
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream iss(line);
+        std::string prefix;
+        iss >> prefix;
+        if (prefix == "newmtl") {
+            materials.emplace_back();
+            material = &materials.back();
+            iss >> material->name;
+            continue;
+        }
+        if (material == nullptr) {
+            continue;
+        }
+        if (prefix == "Ka") {
+            iss >> material->ambient.x >> material->ambient.y >> material->ambient.z;
+        }
+        else if (prefix == "Kd") {
+            iss >> material->diffuse.x >> material->diffuse.y >> material->diffuse.z;
+        }
+        else if (prefix == "Ks") {
+            iss >> material->specular.x >> material->specular.y >> material->specular.z;
+        }
+        else if (prefix == "Ke") {
+            iss >> material->emissive.x >> material->emissive.y >> material->emissive.z;
+        }
+        else if (prefix == "Ns") {
+            iss >> material->shininess;
+        }
+        else if (prefix == "d") {
+            iss >> material->opacity;
+        }
+        else if (prefix == "Tr") {
+            // Transparency, the inverse of d
+            float transparency = 0.0f;
+            iss >> transparency;
+            material->opacity = 1.0f - transparency;
+        }
+        else if (prefix == "Ni") {
+            iss >> material->indexOfRefraction;
+        }
+        else if (prefix == "Pr") {
+            iss >> material->roughness;
+        }
+        else if (prefix == "Pm") {
+            iss >> material->metallic;
+        }
+        else if (prefix == "illum") {
+            iss >> material->illuminationModel;
+        }
+        else if (prefix == "map_Kd" || prefix == "map_Ks" || prefix == "map_Bump" || prefix == "map_bump" ||
+                 prefix == "bump" || prefix == "norm" || prefix == "map_d") {
+            // Options such as -bm 1.0 come first; the file name is the last token.
+            std::string token;
+            std::string texture;
+            while (iss >> token) {
+                texture = token;
+            }
+            if (texture.empty()) {
+                continue;
+            }
+            texture = directory + texture;
+            if (prefix == "map_Kd") {
+                material->diffuseMap = texture;
+            }
+            else if (prefix == "map_Ks") {
+                material->specularMap = texture;
+            }
+            else if (prefix == "map_d") {
+                material->opacityMap = texture;
+            }
+            else {
+                material->normalMap = texture;
+            }
+        }
+    }
+    return true;
+}
+
+Mesh OBJLoader::LoadOBJ(const std::string& filepath, const OBJLoadOptions& options) {
+    TRACE_SCOPE("LoadOBJ");
     std::vector<glm::vec3> positions;
     std::vector<glm::vec2> texCoords;
     std::vector<glm::vec3> normals;
     std::vector<Vertex> vertices;
     std::vector<unsigned int> indices;
+    std::vector<unsigned int> smoothingGroups;
+    std::vector<unsigned int> positionIds;
+    // Faces before the first `s` statement smooth together.
+    unsigned int smoothingGroup = 1;
+    // usemtl names in order of first use (slot 0: faces before any usemtl),
+    // the slot of every triangle, and the materials of every mtllib.
+    std::vector<std::string> materialNames(1);
+    std::unordered_map<std::string, unsigned int> materialSlots;
+    materialSlots[""] = 0;
+    unsigned int materialSlot = 0;
+    std::vector<unsigned int> triangleSlots;
+    std::vector<Material> libraryMaterials;
     
     std::ifstream file(filepath);
     if (!file.is_open()) {
@@ -41,6 +208,30 @@ Mesh OBJLoader::LoadOBJ(const std::string& filepath) {
             iss >> normal.x >> normal.y >> normal.z;
             normals.push_back(normal);
         }
+        else if (prefix == "s") {
+            // Smoothing group: a number, or 0/off for flat faces
+            std::string group;
+            iss >> group;
+            smoothingGroup = (group == "off") ? 0 : (unsigned int)std::strtoul(group.c_str(), nullptr, 10);
+        }
+        else if (prefix == "mtllib") {
+            // One or more material libraries, relative to the OBJ file
+            std::string library;
+            while (iss >> library) {
+                if (!LoadMTL(DirectoryOf(filepath) + library, libraryMaterials)) {
+                    std::cerr << "Failed to open material library: " << DirectoryOf(filepath) + library << std::endl;
+                }
+            }
+        }
+        else if (prefix == "usemtl") {
+            std::string name;
+            iss >> name;
+            auto inserted = materialSlots.emplace(name, (unsigned int)materialNames.size());
+            if (inserted.second) {
+                materialNames.push_back(name);
+            }
+            materialSlot = inserted.first->second;
+        }
         else if (prefix == "f") {
             // Face - can be triangles or quads
             std::vector<std::string> faceTokens;
@@ -82,11 +273,15 @@ Mesh OBJLoader::LoadOBJ(const std::string& filepath) {
                     
                     vertices.push_back(vertex);
                     indices.push_back(vertices.size() - 1);
+                    positionIds.push_back(vertexIndex);
                 }
+                smoothingGroups.push_back(smoothingGroup);
+                triangleSlots.push_back(materialSlot);
             }
             else if (faceTokens.size() == 4) {
                 // Quad - split into two triangles
                 std::vector<Vertex> quadVertices;
+                std::vector<unsigned int> quadPositionIds;
                 
                 for (int i = 0; i < 4; i++) {
                     std::string faceToken = faceTokens[i];
@@ -117,6 +312,7 @@ Mesh OBJLoader::LoadOBJ(const std::string& filepath) {
                     }
                     
                     quadVertices.push_back(vertex);
+                    quadPositionIds.push_back(vertexIndex);
                 }
                 
                 // First triangle: 0, 1, 2
@@ -134,6 +330,12 @@ Mesh OBJLoader::LoadOBJ(const std::string& filepath) {
                 indices.push_back(vertices.size() - 1);
                 vertices.push_back(quadVertices[3]);
                 indices.push_back(vertices.size() - 1);
+                positionIds.insert(positionIds.end(), { quadPositionIds[0], quadPositionIds[1], quadPositionIds[2],
+                                                        quadPositionIds[0], quadPositionIds[2], quadPositionIds[3] });
+                smoothingGroups.push_back(smoothingGroup);
+                smoothingGroups.push_back(smoothingGroup);
+                triangleSlots.push_back(materialSlot);
+                triangleSlots.push_back(materialSlot);
             }
         }
     }
@@ -146,7 +348,386 @@ Mesh OBJLoader::LoadOBJ(const std::string& filepath) {
     std::cout << "Triangles: " << indices.size() / 3 << std::endl;
     
     Mesh mesh;
-    mesh.vertices = vertices;
-    mesh.indices = indices;
+    mesh.vertices = std::move(vertices);
+    mesh.indices = std::move(indices);
+    mesh.smoothingGroups = std::move(smoothingGroups);
+    mesh.positionIds = std::move(positionIds);
+
+    // Resolve the used material names and merge materials that look the same,
+    // then group the triangles by material.
+    std::vector<unsigned int> slotMaterials(materialNames.size(), ~0u);
+    for (unsigned int& slot : triangleSlots) {
+        unsigned int& material = slotMaterials[slot];
+        if (material == ~0u) {
+            Material resolved;
+            resolved.name = materialNames[slot];
+            bool found = resolved.name.empty();
+            for (const Material& candidate : libraryMaterials) {
+                if (candidate.name == resolved.name) {
+                    resolved = candidate;
+                    found = true;
+                    break;
+                }
+            }
+            if (!found) {
+                std::cerr << "Material not found, using defaults: " << resolved.name << std::endl;
+            }
+            material = (unsigned int)mesh.materials.size();
+            for (size_t i = 0; i < mesh.materials.size(); i++) {
+                if (mesh.materials[i].SameAppearance(resolved)) {
+                    material = (unsigned int)i;
+                    break;
+                }
+            }
+            if (material == mesh.materials.size()) {
+                mesh.materials.push_back(resolved);
+            }
+        }
+        slot = material;
+    }
+    SortTrianglesByMaterial(mesh, triangleSlots);
+    std::cout << "Materials: " << mesh.materials.size() << " (" << materialNames.size() - 1 << " referenced)" << std::endl;
+
+    if (options.generateNormals && normals.empty() && !mesh.indices.empty()) {
+        TangentSpace::GenerateNormals(mesh, options.smoothingAngle);
+    }
+    if (options.generateTangents && !mesh.indices.empty()) {
+        TangentSpace::GenerateTangents(mesh);
+    }
     return mesh;
 }
+
+
+std::vector<float> OBJLoader::BuildVertexStream(const Mesh& mesh) {
+    std::vector<float> stream;
+    stream.reserve(mesh.vertices.size() * kVertexStreamFloats);
+    for (const Vertex& vertex : mesh.vertices) {
+        glm::vec3 color = vertex.normal * 0.5f + glm::vec3(0.5f);
+        stream.push_back(vertex.position.x);
+        stream.push_back(vertex.position.y);
+        stream.push_back(vertex.position.z);
+        stream.push_back(color.r);
+        stream.push_back(color.g);
+        stream.push_back(color.b);
+        stream.push_back(vertex.texCoord.x);
+        stream.push_back(vertex.texCoord.y);
+    }
+    return stream;
+}
+
+// Append-only table of fixed-size float records (v, vt or vn) with bounded
+// memory: full blocks go to a temporary file and come back through a small
+// direct-mapped cache, while the block being filled stays in memory. OBJ faces
+// mostly reference recent records, so few lookups reach the file.
+class AttributeSpill {
+public:
+    explicit AttributeSpill(size_t recordFloats)
+        : mRecordFloats(recordFloats), mFile(std::tmpfile()), mCount(0), mCache(kCachedBlocks) {
+        mTail.reserve(kBlockRecords * recordFloats);
+        if (mFile == nullptr) {
+            std::cerr << "No temporary file for OBJ streaming; attributes stay in memory" << std::endl;
+        }
+    }
+    ~AttributeSpill() {
+        if (mFile != nullptr) {
+            std::fclose(mFile);
+        }
+    }
+    AttributeSpill(const AttributeSpill&) = delete;
+    AttributeSpill& operator=(const AttributeSpill&) = delete;
+
+    void Append(const float* record) {
+        mTail.insert(mTail.end(), record, record + mRecordFloats);
+        mCount++;
+        if (mCount % kBlockRecords != 0) {
+            return;
+        }
+        if (mFile != nullptr) {
+            std::fseek(mFile, 0, SEEK_END);
+            std::fwrite(mTail.data(), sizeof(float), mTail.size(), mFile);
+        } else {
+            mInMemory.insert(mInMemory.end(), mTail.begin(), mTail.end());
+        }
+        mTail.clear();
+    }
+    size_t Size() const { return mCount; }
+    // Copies record index into out; false when it does not exist.
+    bool Fetch(size_t index, float* out) {
+        if (index >= mCount) {
+            return false;
+        }
+        size_t block = index / kBlockRecords;
+        size_t offset = (index % kBlockRecords) * mRecordFloats;
+        const float* source = nullptr;
+        if (block == mCount / kBlockRecords) {
+            source = mTail.data() + offset;
+        } else if (mFile == nullptr) {
+            source = mInMemory.data() + index * mRecordFloats;
+        } else {
+            CachedBlock& cached = mCache[block % kCachedBlocks];
+            if (cached.block != block) {
+                cached.data.resize(kBlockRecords * mRecordFloats);
+                std::fseek(mFile, (long)(block * kBlockRecords * mRecordFloats * sizeof(float)), SEEK_SET);
+                if (std::fread(cached.data.data(), sizeof(float), cached.data.size(), mFile) != cached.data.size()) {
+                    return false;
+                }
+                cached.block = block;
+            }
+            source = cached.data.data() + offset;
+        }
+        std::copy(source, source + mRecordFloats, out);
+        return true;
+    }
+
+private:
+    static const size_t kBlockRecords = 4096;
+    static const size_t kCachedBlocks = 64;
+    struct CachedBlock {
+        size_t block = ~(size_t)0;
+        std::vector<float> data;
+    };
+    size_t mRecordFloats;
+    std::FILE* mFile;
+    size_t mCount;
+    std::vector<float> mTail;
+    std::vector<float> mInMemory;
+    std::vector<CachedBlock> mCache;
+};
+
+// Resolves a 1-based (or negative, relative) OBJ index against count records.
+static bool ResolveIndex(long index, size_t count, size_t& out) {
+    if (index > 0 && (size_t)index <= count) {
+        out = (size_t)index - 1;
+        return true;
+    }
+    if (index < 0 && (size_t)(-index) <= count) {
+        out = count - (size_t)(-index);
+        return true;
+    }
+    return false;
+}
+
+bool OBJLoader::StreamOBJ(const std::string& filepath, const OBJBatchSink& sink, size_t batchVertices) {
+    TRACE_SCOPE("StreamOBJ");
+    static const size_t kWindowBytes = 1 << 20;
+    std::FILE* file = std::fopen(filepath.c_str(), "rb");
+    if (file == nullptr) {
+        std::cerr << "Failed to open OBJ file: " << filepath << std::endl;
+        return false;
+    }
+    batchVertices = std::max<size_t>(batchVertices, 3);
+    AttributeSpill positions(3);
+    AttributeSpill texCoords(2);
+    AttributeSpill normals(3);
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    vertices.reserve(batchVertices);
+    indices.reserve(batchVertices);
+    std::vector<Vertex> polygon;
+    std::string material;
+    size_t firstVertex = 0;
+    size_t firstIndex = 0;
+    auto flush = [&]() {
+        if (vertices.empty()) {
+            return;
+        }
+        OBJBatch batch;
+        batch.vertices = vertices.data();
+        batch.vertexCount = vertices.size();
+        batch.indices = indices.data();
+        batch.indexCount = indices.size();
+        batch.firstVertex = firstVertex;
+        batch.firstIndex = firstIndex;
+        batch.material = &material;
+        sink(batch);
+        firstVertex += vertices.size();
+        firstIndex += indices.size();
+        vertices.clear();
+        indices.clear();
+    };
+    auto parseLine = [&](char* line) {
+        char* cursor = line;
+        while (*cursor == ' ' || *cursor == '\t') {
+            cursor++;
+        }
+        if (cursor[0] == 'v' && (cursor[1] == ' ' || cursor[1] == '\t')) {
+            float record[3];
+            cursor++;
+            for (float& value : record) {
+                value = std::strtof(cursor, &cursor);
+            }
+            positions.Append(record);
+        } else if (cursor[0] == 'v' && cursor[1] == 't') {
+            float record[2];
+            cursor += 2;
+            record[0] = std::strtof(cursor, &cursor);
+            record[1] = std::strtof(cursor, &cursor);
+            texCoords.Append(record);
+        } else if (cursor[0] == 'v' && cursor[1] == 'n') {
+            float record[3];
+            cursor += 2;
+            for (float& value : record) {
+                value = std::strtof(cursor, &cursor);
+            }
+            normals.Append(record);
+        } else if (cursor[0] == 'f' && (cursor[1] == ' ' || cursor[1] == '\t')) {
+            // v, v/vt, v//vn or v/vt/vn corners; polygons are fanned into triangles.
+            polygon.clear();
+            cursor++;
+            while (true) {
+                long references[3] = { 0, 0, 0 };
+                char* end = nullptr;
+                references[0] = std::strtol(cursor, &end, 10);
+                if (end == cursor) {
+                    break;
+                }
+                cursor = end;
+                for (int slot = 1; slot < 3 && *cursor == '/'; slot++) {
+                    cursor++;
+                    references[slot] = std::strtol(cursor, &end, 10);
+                    cursor = end;
+                }
+                Vertex vertex;
+                size_t index = 0;
+                if (!ResolveIndex(references[0], positions.Size(), index)) {
+                    return;
+                }
+                positions.Fetch(index, &vertex.position.x);
+                if (ResolveIndex(references[1], texCoords.Size(), index)) {
+                    texCoords.Fetch(index, &vertex.texCoord.x);
+                }
+                if (ResolveIndex(references[2], normals.Size(), index)) {
+                    normals.Fetch(index, &vertex.normal.x);
+                }
+                polygon.push_back(vertex);
+            }
+            if (polygon.size() < 3) {
+                return;
+            }
+            size_t corners = (polygon.size() - 2) * 3;
+            if (vertices.size() + corners > batchVertices) {
+                flush();
+            }
+            for (size_t i = 1; i + 1 < polygon.size(); i++) {
+                const Vertex* triangle[3] = { &polygon[0], &polygon[i], &polygon[i + 1] };
+                for (const Vertex* corner : triangle) {
+                    indices.push_back((unsigned int)(firstVertex + vertices.size()));
+                    vertices.push_back(*corner);
+                }
+            }
+        } else if (std::strncmp(cursor, "usemtl", 6) == 0) {
+            std::istringstream iss(cursor + 6);
+            std::string name;
+            iss >> name;
+            if (name != material) {
+                flush();
+                material = name;
+            }
+        }
+    };
+
+    // Lines are parsed in place out of the window; a partial last line moves
+    // to the front before the next read.
+    std::vector<char> window(kWindowBytes + 1);
+    size_t filled = 0;
+    bool endOfFile = false;
+    while (!endOfFile || filled > 0) {
+        if (!endOfFile) {
+            if (filled == window.size() - 1) {
+                // A single line longer than the window.
+                window.resize(window.size() * 2);
+            }
+            size_t read = std::fread(window.data() + filled, 1, window.size() - 1 - filled, file);
+            endOfFile = read == 0;
+            filled += read;
+        }
+        size_t lineStart = 0;
+        for (size_t i = 0; i < filled; i++) {
+            if (window[i] == '\n' || window[i] == '\r') {
+                window[i] = '\0';
+                parseLine(&window[lineStart]);
+                lineStart = i + 1;
+            }
+        }
+        if (endOfFile && lineStart < filled) {
+            window[filled] = '\0';
+            parseLine(&window[lineStart]);
+            lineStart = filled;
+        }
+        std::memmove(window.data(), window.data() + lineStart, filled - lineStart);
+        filled -= lineStart;
+    }
+    flush();
+    std::fclose(file);
+    return true;
+}
+
+// Peak resident set size of the process so far, in bytes (0 where unknown).
+static size_t PeakResidentBytes() {
+#if defined(__APPLE__)
+    struct rusage usage;
+    return getrusage(RUSAGE_SELF, &usage) == 0 ? (size_t)usage.ru_maxrss : 0;
+#elif defined(__unix__)
+    struct rusage usage;
+    return getrusage(RUSAGE_SELF, &usage) == 0 ? (size_t)usage.ru_maxrss * 1024 : 0;
+#else
+    return 0;
+#endif
+}
+
+// Writes a size x size grid of quads with positions, texture coordinates and
+// normals; returns the file size in bytes.
+static size_t WriteGridOBJ(const std::string& path, int size) {
+    std::FILE* file = std::fopen(path.c_str(), "w");
+    if (file == nullptr) {
+        return 0;
+    }
+    for (int y = 0; y <= size; y++) {
+        for (int x = 0; x <= size; x++) {
+            float u = (float)x / size;
+            float v = (float)y / size;
+            std::fprintf(file, "v %f %f %f\nvt %f %f\nvn 0 1 0\n", u, 0.0f, v, u, v);
+        }
+    }
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            int a = y * (size + 1) + x + 1;
+            int b = a + size + 1;
+            std::fprintf(file, "f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d\n", a, a, a, a + 1, a + 1, a + 1, b + 1, b + 1, b + 1, b, b, b);
+        }
+    }
+    size_t bytes = (size_t)std::ftell(file);
+    std::fclose(file);
+    return bytes;
+}
+
+void OBJLoader::RunMicrobenchmark(int maxTriangles) {
+    const std::string path = "objstream_bench.obj";
+    const double kMegabyte = 1024.0 * 1024.0;
+    std::cout << "Streaming OBJ loader, peak RSS before: " << PeakResidentBytes() / kMegabyte << " MB" << std::endl;
+    size_t largestBytes = 0;
+    for (int divisor = 16; divisor >= 1; divisor /= 4) {
+        int size = std::max(1, (int)std::sqrt(maxTriangles / divisor / 2.0));
+        size_t bytes = WriteGridOBJ(path, size);
+        if (bytes == 0) {
+            std::cerr << "Could not write " << path << std::endl;
+            return;
+        }
+        largestBytes = bytes;
+        size_t triangles = 0;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        StreamOBJ(path, [&](const OBJBatch& batch) {
+            triangles += batch.indexCount / 3;
+        });
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "\t" << bytes / kMegabyte << " MB file, " << triangles << " triangles: streamed in "
+                  << seconds * 1000.0 << " ms (" << bytes / kMegabyte / seconds << " MB/s), peak RSS "
+                  << PeakResidentBytes() / kMegabyte << " MB" << std::endl;
+    }
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    Mesh mesh = LoadOBJ(path);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "\tLoadOBJ on the " << largestBytes / kMegabyte << " MB file: " << seconds * 1000.0 << " ms, peak RSS "
+              << PeakResidentBytes() / kMegabyte << " MB" << std::endl;
+    std::remove(path.c_str());
+}
@@ -1,20 +1,99 @@
 #pragma once
+#include <cstddef>
+#include <functional>
 #include <vector>
 #include <string>
 #include <glm/glm.hpp>
 
 struct Vertex {
-    glm::vec3 position;
-    glm::vec2 texCoord;
-    glm::vec3 normal;
+    glm::vec3 position{0.0f};
+    glm::vec2 texCoord{0.0f};
+    glm::vec3 normal{0.0f};
+    // xyz along +u in the normal's plane, w = +-1 bitangent sign (MikkTSpace convention)
+    glm::vec4 tangent{0.0f};
+};
+
+// Wavefront .mtl material. Texture paths are resolved relative to the .mtl file.
+struct Material {
+    std::string name;
+    glm::vec3 ambient{0.0f};
+    glm::vec3 diffuse{0.8f};
+    glm::vec3 specular{0.0f};
+    glm::vec3 emissive{0.0f};
+    float shininess = 0.0f;
+    float opacity = 1.0f;
+    float indexOfRefraction = 1.0f;
+    // PBR extension (Pr/Pm); negative when the file does not set them.
+    float roughness = -1.0f;
+    float metallic = -1.0f;
+    int illuminationModel = 2;
+    std::string diffuseMap;
+    std::string specularMap;
+    std::string normalMap;
+    std::string opacityMap;
+    // Equal in everything but the name.
+    bool SameAppearance(const Material& other) const;
+};
+
+// A run of mesh.indices drawn with one material.
+struct Submesh {
+    unsigned int indexOffset = 0;
+    unsigned int indexCount = 0;
+    unsigned int material = 0;
 };
 
 struct Mesh {
     std::vector<Vertex> vertices;
     std::vector<unsigned int> indices;
+    // Materials with duplicates merged, and one submesh per material in
+    // material order; LoadOBJ sorts the triangles so each is contiguous.
+    std::vector<Material> materials;
+    std::vector<Submesh> submeshes;
+    // Filled by LoadOBJ for the normal generator: the smoothing group of every
+    // triangle (0 = `s off`) and the `v` record every vertex came from.
+    std::vector<unsigned int> smoothingGroups;
+    std::vector<unsigned int> positionIds;
+};
+
+struct OBJLoadOptions {
+    // Generate normals when the file has no vn records.
+    bool generateNormals = true;
+    // Faces meeting at more than this many degrees keep separate normals.
+    float smoothingAngle = 60.0f;
+    bool generateTangents = false;
+};
+
+// A run of vertices and triangles handed to a streaming sink. The arrays are
+// only valid during the call; indices already include firstVertex.
+struct OBJBatch {
+    const Vertex* vertices = nullptr;
+    size_t vertexCount = 0;
+    const unsigned int* indices = nullptr;
+    size_t indexCount = 0;
+    size_t firstVertex = 0;
+    size_t firstIndex = 0;
+    // usemtl name in effect; a batch never spans two materials.
+    const std::string* material = nullptr;
 };
+typedef std::function<void(const OBJBatch& batch)> OBJBatchSink;
 
 class OBJLoader {
 public:
-    static Mesh LoadOBJ(const std::string& filepath);
+    static Mesh LoadOBJ(const std::string& filepath, const OBJLoadOptions& options = OBJLoadOptions());
+    // Reads filepath through a fixed-size window and hands every batchVertices
+    // vertices to sink, so memory use does not grow with the file: the v/vt/vn
+    // tables faces index into spill to a temporary file behind a small block
+    // cache. Triangles arrive in file order with attributes as written (no
+    // normal generation or material sorting, which need the whole mesh).
+    static bool StreamOBJ(const std::string& filepath, const OBJBatchSink& sink, size_t batchVertices = 65535);
+    // Generates OBJ files of growing size and reports peak RSS for StreamOBJ
+    // against LoadOBJ.
+    static void RunMicrobenchmark(int maxTriangles);
+    // Appends the materials of an .mtl file; false when it cannot be opened.
+    static bool LoadMTL(const std::string& filepath, std::vector<Material>& materials);
+    // Floats per vertex in the draw stream.
+    static const int kVertexStreamFloats = 8;
+    // Interleaved x,y,z,r,g,b,u,v stream in the layout vert.glsl expects, with
+    // the normal remapped to [0,1] as the vertex colour.
+    static std::vector<float> BuildVertexStream(const Mesh& mesh);
 };
@@ -0,0 +1,68 @@
+#ifndef ASSETLOADER_HPP
+#define ASSETLOADER_HPP
+#include <glad/glad.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Loads assets without stalling the render loop. Parsing runs on the shared
+// JobSystem's background queue, buffer uploads on a dedicated thread that owns a GL context
+// sharing objects with the render context, and the render thread publishes an
+// asset only once the fence behind its upload has signalled, drawing whatever
+// placeholder it had until then.
+class AssetLoader{
+    public:
+    struct Job{
+        // Worker thread: file I/O and parsing. Returning false drops the asset.
+        std::function<bool()> mParse;
+        // Upload thread, shared context current: create and fill buffers.
+        // Vertex array objects are not shared between contexts, so those are
+        // left to mPublish.
+        std::function<void()> mUpload;
+        // Render thread, once the upload is complete on the GPU.
+        std::function<void()> mPublish;
+    };
+    AssetLoader();
+    ~AssetLoader();
+    AssetLoader(const AssetLoader&) = delete;
+    AssetLoader& operator=(const AssetLoader&) = delete;
+    // Starts the upload thread; makeCurrent/release bind and unbind the shared
+    // context on it. Without a started upload thread, uploads run on the
+    // render thread inside Poll().
+    void Start(std::function<bool()> makeCurrent, std::function<void()> release);
+    // Waits for parses in flight and joins the upload thread; unpublished
+    // assets are dropped.
+    void Stop();
+    void Load(Job job);
+    // Render thread, once a frame. Never blocks on the GPU.
+    void Poll();
+    size_t GetPendingCount() const { return mEntries.size(); }
+    private:
+        enum Stage{
+            kParsing,
+            kParsed,
+            kUploaded,
+            kFailed
+        };
+        struct Entry{
+            Job mJob;
+            std::atomic<int> mStage{kParsing};
+            GLsync mFence = nullptr;
+        };
+        void UploadLoop(std::function<bool()> makeCurrent, std::function<void()> release);
+        std::vector<std::shared_ptr<Entry>> mEntries;
+        std::atomic<int> mParsing;
+        std::thread mUploadThread;
+        // Read by parse jobs on worker threads.
+        std::atomic<bool> mUploadThreadRunning;
+        std::mutex mMutex;
+        std::condition_variable mWake;
+        std::deque<std::shared_ptr<Entry>> mUploads;
+        bool mStopping;
+};
+#endif
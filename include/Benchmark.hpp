@@ -0,0 +1,72 @@
+#ifndef BENCHMARK_HPP
+#define BENCHMARK_HPP
+#include <glad/glad.h>
+#include "glm/glm.hpp"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+class Camera;
+
+// A camera trajectory sampled by frame index, so a benchmark run visits exactly
+// the same views every time regardless of frame rate or input.
+class CameraPath{
+    public:
+    struct Key{
+        glm::vec3 mPosition;
+        glm::vec3 mViewDirection;
+    };
+    // Text file with one "px py pz dx dy dz" key per line; '#' starts a comment.
+    bool Load(const std::string& filepath);
+    bool Save(const std::string& filepath) const;
+    // Built-in path: one full orbit around target at the given radius and height.
+    void MakeOrbit(const glm::vec3& target, float radius, float height, int keyCount);
+    void Append(const Camera& camera);
+    // Places the camera at frame/(frameCount-1) of the way along the path,
+    // interpolating linearly between keys.
+    void Apply(Camera* camera, int frame, int frameCount) const;
+    bool Empty() const { return mKeys.empty(); }
+    private:
+        std::vector<Key> mKeys;
+};
+
+// GL_TIME_ELAPSED queries in a ring. A query is only read back when its slot
+// comes round again kLatency frames later, by which point the GPU has long
+// finished it, so measuring does not serialize the CPU and GPU.
+class GpuFrameTimer{
+    public:
+    static const int kLatency = 4;
+    GpuFrameTimer();
+    void Create();
+    void Destroy();
+    void Begin(int frame);
+    void End();
+    // Waits for the outstanding queries; call once after the last frame.
+    void Flush();
+    // Milliseconds per frame index, negative for frames never measured.
+    const std::vector<double>& GetResults() const { return mResults; }
+    private:
+        void Retire(int slot);
+        GLuint mQueries[kLatency];
+        int mFrames[kLatency];
+        int mCurrent;
+        std::vector<double> mResults;
+};
+
+struct FrameSample{
+    double mCpuMilliseconds = 0.0;
+    double mGpuMilliseconds = -1.0;  // negative when unavailable
+    int mDrawCalls = 0;
+    size_t mTriangles = 0;
+};
+
+class BenchmarkReport{
+    public:
+    void Resize(int frameCount);
+    FrameSample& operator[](int frame) { return mSamples[frame]; }
+    // Per-frame samples plus mean/min/max and p50/p95/p99 summaries as JSON.
+    bool WriteJson(const std::string& filepath, const std::string& renderer, int width, int height) const;
+    private:
+        std::vector<FrameSample> mSamples;
+};
+#endif
@@ -0,0 +1,38 @@
+#ifndef BLOCKCOMPRESSION_HPP
+#define BLOCKCOMPRESSION_HPP
+#include <glad/glad.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct Image;
+
+enum BlockFormat{
+    kUncompressed,
+    kBC1,   // RGB, 4 bits per texel
+    kBC3,   // BC1 colour plus interpolated alpha, 8 bits per texel
+    kBC7    // RGBA, 8 bits per texel; mode 6 only (one subset, 7.7.7.7+1 endpoints, 4-bit indices)
+};
+
+// Encodes images into 4x4 blocks GL can sample directly. Endpoints come from
+// the principal axis of each block's colours, refined once by least squares;
+// texels are matched to the palette four at a time with Float4. Blocks at the
+// right and top edges repeat their last texels.
+class BlockCompressor{
+    public:
+    static size_t GetEncodedSize(int width, int height, BlockFormat format);
+    // GL internal format, 0 for kUncompressed.
+    static GLenum GetGLFormat(BlockFormat format);
+    // Whether the current context can sample format.
+    static bool IsSupported(BlockFormat format);
+    static const char* GetName(BlockFormat format);
+    // Rows of blocks are spread across the JobSystem.
+    static void Encode(const Image& image, BlockFormat format, std::vector<uint8_t>& blocks);
+    // Returns false on BC7 blocks that are not mode 6.
+    static bool Decode(const uint8_t* blocks, int width, int height, BlockFormat format, Image& image);
+    // Peak signal-to-noise ratio in dB over RGB, and alpha when asked.
+    static double ComputePSNR(const Image& reference, const Image& image, bool alpha);
+    // Encode throughput and PSNR of every format on a generated image.
+    static void RunMicrobenchmark(int imageSize);
+};
+#endif
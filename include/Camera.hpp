@@ -1,25 +1,71 @@
-#ifndef CAMERA_HPP 
+#ifndef CAMERA_HPP
 #define CAMERA_HPP
 #include "glm/glm.hpp"
+#include "glm/gtc/quaternion.hpp"
+// Orientation is a unit quaternion built from yaw (about world up), pitch
+// (clamped short of straight up or down) and roll, so repeated turns never
+// accumulate error into the view basis. In fly mode the camera moves along its
+// own axes; in orbit mode it circles a target at a distance, the move calls
+// zooming and orbiting instead.
 class Camera{
-    public: 
-    
+    public:
+    enum Mode{
+        kFly,
+        kOrbit
+    };
     //Constructor
     Camera();
-    void SetProjectionMatrix(float fovy, float aspect, float near, float far);
+    // Reverse-Z with the far plane at infinity: clip z is 0 <= z <= w (glClipControl's
+    // GL_ZERO_TO_ONE) and z / w falls from 1 at near to 0 far away, so depth tests
+    // use GL_GREATER against a buffer cleared to 0. Float depth then keeps about
+    // constant relative precision at any distance.
+    void SetProjectionMatrix(float fovy, float aspect, float near);
     glm::mat4 GetProjectionMatrix() const;
+    // Rigid inverse of the camera's placement: transposed rotation, no lookAt.
     glm::mat4 GetViewMatrix() const;
+    // One degree of yaw and pitch per pixel the mouse moved since the last call.
     void MouseLook(int mouseX, int mouseY);
+    void Roll(float radians);
     void MoveForward(float speed);
     void MoveBackward(float speed);
     void MoveLeft(float speed);
     void MoveRight(float speed);
-    private: 
-        // glm::mat4 mViewMatrix;
+    // Switching to orbit mode orbits the point the camera looks at from where it is.
+    void SetMode(Mode mode);
+    Mode GetMode() const { return mMode; }
+    void SetOrbitTarget(const glm::vec3& target);
+    void SetOrbitDistance(float distance);
+    // Time constant (seconds) the orientation follows mouse look and roll with;
+    // 0 turns at once. Smoothed turns advance in Update.
+    void SetSmoothing(float seconds);
+    void Update(float seconds);
+    // Direct placement, used to replay scripted or recorded camera paths.
+    void SetPosition(const glm::vec3& eye);
+    void SetViewDirection(const glm::vec3& direction);
+    glm::vec3 GetPosition() const;
+    glm::vec3 GetViewDirection() const;
+    glm::quat GetOrientation() const { return mOrientation; }
+    // Orientation drift over many updates, against repeatedly rotating a direction.
+    static void RunMicrobenchmark(int updateCount);
+    // Smallest depth separation each depth setup resolves at a range of distances.
+    static void RunDepthMicrobenchmark();
+    private:
+        glm::quat GetTargetOrientation() const;
+        void SetOrientation(const glm::quat& orientation);
         glm::mat4 mProjectionMatrix;
+        Mode mMode;
         glm::vec3 mEye;
-        glm::vec3 mViewDirection;
-        glm::vec3 mUpVector;
-        glm::vec2 mOldMousePosition;
+        glm::quat mOrientation;
+        // Summed in double: float sums of millions of small turns wander by degrees.
+        double mYaw;
+        double mPitch;
+        double mRoll;
+        float mSmoothing;
+        glm::vec3 mOrbitTarget;
+        float mOrbitDistance;
+        bool mHasMouse;
+        // Integers: a float position loses whole pixels after a few hours of turning.
+        int mOldMouseX;
+        int mOldMouseY;
 };
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,75 @@
+#ifndef CASCADEDSHADOWS_HPP
+#define CASCADEDSHADOWS_HPP
+#include <glad/glad.h>
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+class Camera;
+
+// Directional light shadows from cascaded shadow maps. The camera's view range
+// up to mShadowDistance is split into kCascadeCount slices, each fitted with
+// a bounding sphere so its size never changes as the camera turns. All cascades
+// share one light rotation. Each cascade's origin is snapped to whole texels so
+// static shadows do not shimmer as the camera moves. Depth is reverse-Z like
+// the camera (1 nearest the light), in one layer of a 32-bit float depth array
+// per cascade, sampled with hardware comparison and 3x3 PCF in frag.glsl.
+class CascadedShadows{
+    public:
+    static const int kCascadeCount = 4;
+    CascadedShadows(int resolution = 1024, float shadowDistance = 20.0f);
+    // direction the light travels, world space.
+    void SetLightDirection(const glm::vec3& direction);
+    // Splits and fits the cascades to camera.
+    void Update(const Camera& camera);
+    // One pass over world-space bounding spheres (center, radius): masks[i] gets
+    // bit c set when sphere i may cast into cascade c.
+    void CullCasters(const glm::vec4* spheres, size_t count, uint8_t* masks) const;
+    // Light view and reverse-Z orthographic projection (clip z in 0..w) of a cascade.
+    const glm::mat4& GetLightView() const { return mLightView; }
+    const glm::mat4& GetProjection(int cascade) const { return mProjections[cascade]; }
+    int GetResolution() const { return mResolution; }
+    // GL side; the render context must be current.
+    bool Create();
+    void Destroy();
+    // Binds the cascade's layer for drawing and clears it; restore the frame's
+    // framebuffer and viewport afterwards.
+    void BeginCascade(int cascade);
+    // Locations of the uniforms Bind sets, looked up once when a program is linked.
+    struct Uniforms{
+        GLint mShadowMap;
+        GLint mShadowMatrices;
+        GLint mCascadeEnds;
+        GLint mCascadeTexels;
+        GLint mShadowTexel;
+        GLint mSunDirection;
+    };
+    static Uniforms FindUniforms(GLuint program);
+    // Binds the map to texture unit unit and sets the shadow uniforms of the
+    // program uniforms came from, which must be in use. cameraView maps world to
+    // the camera's view space.
+    void Bind(const Uniforms& uniforms, int unit, const glm::mat4& cameraView) const;
+    // Cost of fitting and of culling many casters, and how far the cascade
+    // origins move in texels while the camera pans.
+    static void RunMicrobenchmark(size_t casterCount);
+    private:
+        int mResolution;
+        float mShadowDistance;
+        glm::vec3 mLightDirection;
+        glm::mat4 mLightView;
+        glm::mat4 mProjections[kCascadeCount];
+        // Per cascade: snapped light-space center, half extent, the light-space z
+        // of its far and near ends (the near end reaching past the sphere toward
+        // the light for casters outside it), the view depth it ends at and the
+        // size of a texel.
+        float mCenterX[kCascadeCount];
+        float mCenterY[kCascadeCount];
+        float mHalfExtent[kCascadeCount];
+        float mFarZ[kCascadeCount];
+        float mNearZ[kCascadeCount];
+        float mSplitEnds[kCascadeCount];
+        float mTexelSizes[kCascadeCount];
+        GLuint mTexture;
+        GLuint mFramebuffer;
+};
+#endif
@@ -0,0 +1,91 @@
+#ifndef CLUSTEREDLIGHTING_HPP
+#define CLUSTEREDLIGHTING_HPP
+#include <glad/glad.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+class Camera;
+class JobSystem;
+
+struct PointLight{
+    glm::vec3 mPosition = glm::vec3(0.0f);
+    // Influence ends smoothly at mRadius.
+    float mRadius = 1.0f;
+    glm::vec3 mColor = glm::vec3(1.0f);
+};
+
+// Clustered forward lighting. The camera's frustum is split into a grid of
+// kClustersX x kClustersY screen tiles by kClustersZ depth slices, spaced
+// exponentially from the near plane to mSliceFar (the last slice runs to
+// infinity). Each frame the lights are moved to view space and given the range
+// of clusters their sphere may touch, four lights at a time against the tile
+// planes, then the per-cluster light lists are filled one depth slice per job.
+// The lights, the (offset, count) of every cluster and the concatenated lists
+// go to the GPU as texture buffers that frag.glsl walks for each fragment.
+class ClusteredLighting{
+    public:
+    static const int kClustersX = 16;
+    static const int kClustersY = 9;
+    static const int kClustersZ = 24;
+    static const int kClusterCount = kClustersX * kClustersY * kClustersZ;
+    explicit ClusteredLighting(JobSystem* jobs = nullptr, float sliceFar = 100.0f);
+    // lights are in world space; the frustum is taken from camera's projection.
+    void Build(const Camera& camera, const std::vector<PointLight>& lights);
+    // Lights inside the frustum and light references over all clusters after Build.
+    size_t GetVisibleLightCount() const { return mVisibleCount; }
+    size_t GetReferenceCount() const { return mIndices.size(); }
+    // GL side; the render context must be current.
+    void Create();
+    void Destroy();
+    void Upload();
+    // Locations of the uniforms Bind sets, looked up once when a program is linked.
+    struct Uniforms{
+        GLint mSamplers[3];
+        GLint mClusterCount;
+        GLint mClusterScale;
+    };
+    static Uniforms FindUniforms(GLuint program);
+    // Binds the three buffers to texture units firstUnit.. and sets the cluster
+    // uniforms of the program uniforms came from, which must be in use.
+    void Bind(const Uniforms& uniforms, int firstUnit, int screenWidth, int screenHeight) const;
+    // Binning time for 1k to 64k lights scattered through a large scene.
+    static void RunMicrobenchmark(int iterations);
+    private:
+        // Inclusive cluster ranges of one visible light.
+        struct LightBounds{
+            uint32_t mLight;
+            uint8_t mX0, mX1, mY0, mY1, mZ0, mZ1;
+        };
+        int GetSlice(float depth) const;
+        void BoundLights(const glm::mat4& view, size_t begin, size_t end);
+        void FillSlice(int slice);
+        JobSystem* mJobs;
+        float mSliceFar;
+        float mNear;
+        float mSliceScale;
+        // Tile planes through the eye: x + mTileX[i] * z = 0, with the factor
+        // that turns that into a distance.
+        float mTileX[kClustersX + 1];
+        float mTileXScale[kClustersX + 1];
+        float mTileY[kClustersY + 1];
+        float mTileYScale[kClustersY + 1];
+        const std::vector<PointLight>* mLights;
+        // Packed for upload: view-space position and radius, then colour.
+        std::vector<glm::vec4> mLightData;
+        // Written per light by BoundLights, compacted into mBounds.
+        std::vector<LightBounds> mLightBounds;
+        std::vector<uint8_t> mLightVisible;
+        std::vector<LightBounds> mBounds;
+        size_t mVisibleCount;
+        // Indices into mBounds of the lights in each slice, slice by slice.
+        std::vector<uint32_t> mSliceLights;
+        uint32_t mSliceLightStart[kClustersZ + 1];
+        std::vector<std::vector<uint32_t>> mSliceIndices;
+        std::vector<uint32_t> mClusters;    // offset, count per cluster
+        std::vector<uint32_t> mIndices;
+        GLuint mBuffers[3];
+        GLuint mTextures[3];
+};
+#endif
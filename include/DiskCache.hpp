@@ -0,0 +1,24 @@
+#ifndef DISKCACHE_HPP
+#define DISKCACHE_HPP
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <string>
+
+// Files of precomputed data named after a hash of everything they were computed
+// from: a change to any input, or to a cache's version word hashed in with
+// them, lands on a different file, so an entry is never invalidated in place.
+class DiskCache{
+    public:
+    static const uint64_t kHashSeed = 14695981039346656037ull;
+    // FNV-1a over size bytes, continuing from hash; chain calls to hash several inputs.
+    static uint64_t Hash(const void* data, size_t size, uint64_t hash = kHashSeed);
+    // directory/<hash as 16 hex digits>.<extension>
+    static std::string GetPath(const std::string& directory, uint64_t hash, const char* extension);
+    // Creates the directory if needed and writes the file through write. The
+    // file is written under a temporary name and renamed, so a concurrent reader
+    // never sees a partial file. Reports and returns false on failure.
+    static bool Write(const std::string& path, const std::function<void(std::ofstream&)>& write);
+};
+#endif
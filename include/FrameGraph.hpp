@@ -0,0 +1,138 @@
+#ifndef FRAMEGRAPH_HPP
+#define FRAMEGRAPH_HPP
+#include <glad/glad.h>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+// A texture (mWidth > 0: colour format, depth format or GL_NONE) or a buffer
+// of mByteSize bytes.
+struct FrameGraphResourceDesc{
+    int mWidth = 0;
+    int mHeight = 0;
+    GLenum mFormat = GL_NONE;
+    GLenum mDepthFormat = GL_NONE;
+    size_t mByteSize = 0;
+    // Imported resources: the backend's own handle, e.g. a framebuffer.
+    GLuint mExternal = 0;
+    bool mImported = false;
+};
+
+// What a FrameGraph runs on. Resources live in numbered slots; the graph gives
+// every transient resource a slot and hands one slot to several resources
+// whose lifetimes do not overlap, so the backend only keeps memory per slot.
+class FrameGraphBackend{
+    public:
+    enum Access{
+        kNone,     // contents undefined, e.g. just handed to another resource
+        kWrite,    // render target or storage
+        kRead      // sampled
+    };
+    virtual ~FrameGraphBackend(){}
+    // Before a slot's first use in the frame, and after its last.
+    virtual void AcquireSlot(int slot, const FrameGraphResourceDesc& desc) = 0;
+    virtual void ReleaseSlot(int slot) = 0;
+    virtual void Barrier(int slot, Access before, Access after) = 0;
+    // The pass about to run writes targets (slots; empty for none).
+    virtual void BeginPass(const std::string& name, const std::vector<int>& targets) = 0;
+};
+
+// Per-frame graph of render passes. Passes declare what they read and write,
+// in the order they would run; Compile then
+//  - culls passes whose results nothing reads, working back from imported
+//    resources (the frame's outputs) and passes with side effects,
+//  - orders the rest, respecting every read-after-write, write-after-write
+//    and write-after-read, keeping passes with the same targets together to
+//    save framebuffer switches,
+//  - places the transient resources in slots by lifetime in that order.
+// Execute runs the passes through a backend, with the barriers and the slot
+// acquires and releases between them.
+class FrameGraph{
+    public:
+    void Reset();
+    int CreateTexture(const std::string& name, int width, int height, GLenum format, GLenum depthFormat = GL_NONE);
+    int CreateBuffer(const std::string& name, size_t byteSize);
+    // Resources from outside the graph: never culled or shared.
+    int Import(const std::string& name, const FrameGraphResourceDesc& desc);
+    int AddPass(const std::string& name, std::function<void()> execute);
+    // A pass that writes and reads a resource (blending) keeps its old contents.
+    void Read(int pass, int resource);
+    void Write(int pass, int resource);
+    // Kept even though nothing reads what it writes.
+    void SetSideEffect(int pass);
+    void Compile();
+    void Execute(FrameGraphBackend& backend) const;
+    // Checks the compiled schedule: every pass runs after the passes it depends
+    // on and no two resources alive at the same time share a slot.
+    bool Validate(std::string* error) const;
+    // The compiled schedule.
+    const std::vector<int>& GetOrder() const { return mOrder; }
+    bool IsCulled(int pass) const { return mPasses[pass].mCulled; }
+    int GetSlot(int resource) const { return mResources[resource].mSlot; }
+    int GetSlotCount() const { return (int)mSlots.size(); }
+    const std::string& GetPassName(int pass) const { return mPasses[pass].mName; }
+    int GetPassCount() const { return (int)mPasses.size(); }
+    // Render target changes between consecutive passes, the first pass included;
+    // in the compiled order, and had the passes run in declaration order.
+    int GetTargetSwitches() const { return mTargetSwitches; }
+    int GetDeclaredTargetSwitches() const { return mDeclaredTargetSwitches; }
+    // Transient memory with every resource in its own slot, and as placed.
+    size_t GetUnaliasedBytes() const;
+    size_t GetAliasedBytes() const;
+    static size_t GetByteSize(const FrameGraphResourceDesc& desc);
+    // Builds frames against a recording backend, prints one schedule, checks
+    // every compiled schedule and times Compile on large graphs.
+    static void RunMicrobenchmark();
+    private:
+        struct Pass{
+            std::string mName;
+            std::function<void()> mExecute;
+            std::vector<int> mReads;
+            std::vector<int> mWrites;
+            bool mSideEffect = false;
+            bool mCulled = false;
+        };
+        struct Resource{
+            std::string mName;
+            FrameGraphResourceDesc mDesc;
+            int mSlot = -1;
+            // Positions in mOrder, -1 when unused.
+            int mFirstUse = -1;
+            int mLastUse = -1;
+        };
+        struct Slot{
+            FrameGraphResourceDesc mDesc;
+            int mFreeAfter;
+        };
+        int AddResource(const std::string& name, const FrameGraphResourceDesc& desc);
+        // Passes that must run after each pass, over the passes not culled.
+        void BuildDependencies(std::vector<std::vector<int>>& successors) const;
+        // The textures a pass writes, sorted: what it binds as render targets.
+        std::vector<int> GetTargets(int pass) const;
+        void Cull();
+        void Schedule();
+        void PlaceResources();
+        bool IsTexture(int resource) const { return mResources[resource].mDesc.mWidth > 0; }
+        std::vector<Pass> mPasses;
+        std::vector<Resource> mResources;
+        std::vector<int> mOrder;
+        std::vector<Slot> mSlots;
+        int mTargetSwitches = 0;
+        int mDeclaredTargetSwitches = 0;
+};
+
+// Backend that runs nothing and logs every call, for checking schedules
+// without a GPU.
+class RecordingFrameGraphBackend : public FrameGraphBackend{
+    public:
+    void AcquireSlot(int slot, const FrameGraphResourceDesc& desc) override;
+    void ReleaseSlot(int slot) override;
+    void Barrier(int slot, Access before, Access after) override;
+    void BeginPass(const std::string& name, const std::vector<int>& targets) override;
+    const std::vector<std::string>& GetLog() const { return mLog; }
+    void Clear() { mLog.clear(); }
+    private:
+        std::vector<std::string> mLog;
+};
+#endif
@@ -0,0 +1,48 @@
+#ifndef FRAMESCHEDULER_HPP
+#define FRAMESCHEDULER_HPP
+#include <chrono>
+
+// Paces the render loop and decouples simulation from it. Each frame the wall
+// time since the last one goes into an accumulator that is drained in fixed
+// steps, so the simulation advances the same way at any frame rate; what is
+// left over gives the alpha to blend the last two simulated states with.
+// An optional limiter holds frames to a target rate by sleeping, and only
+// spins for the last fraction of a millisecond the OS cannot sleep precisely.
+class FrameScheduler{
+    public:
+    typedef std::chrono::steady_clock Clock;
+    // Frames slower than maxStepsPerFrame steps drop the rest of their time
+    // rather than fall further behind.
+    FrameScheduler(double stepSeconds = 1.0 / 60.0, int maxStepsPerFrame = 8);
+    // 0 disables the limiter.
+    void SetFrameRateLimit(double framesPerSecond);
+    double GetStepSeconds() const { return mStepSeconds; }
+    // Call once a frame before simulating; returns the number of fixed steps
+    // to run.
+    int BeginFrame();
+    // Fraction of a step the rendered frame lies past the last simulated state.
+    float GetAlpha() const;
+    // Call once a frame after presenting; sleeps until the next frame is due
+    // when the limiter is on.
+    void EndFrame();
+    long long GetDroppedSteps() const { return mDroppedSteps; }
+    // Sleeps until deadline, learning how late the OS wakes up to know when to
+    // stop sleeping and spin.
+    void SleepUntil(Clock::time_point deadline);
+    // Frame time error and CPU use of the limiter at a target rate.
+    static void RunMicrobenchmark(double framesPerSecond, int frameCount);
+    private:
+        double mStepSeconds;
+        int mMaxStepsPerFrame;
+        double mAccumulator;
+        bool mStarted;
+        Clock::time_point mLastFrame;
+        long long mDroppedSteps;
+        Clock::duration mFramePeriod;
+        Clock::time_point mNextFrame;
+        // Running mean and variance (Welford) of how long a 1 ms sleep takes.
+        double mSleepMean;
+        double mSleepM2;
+        long long mSleepCount;
+};
+#endif
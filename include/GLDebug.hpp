@@ -0,0 +1,40 @@
+#ifndef GLDEBUG_HPP
+#define GLDEBUG_HPP
+#include <glad/glad.h>
+
+// OpenGL error reporting. Debug builds create a debug context and route driver
+// messages through a KHR_debug callback: messages are filtered by severity,
+// repeats are counted instead of printed, and anything raised inside a GLCheck
+// is attributed to that call's file and line. Without KHR_debug (macOS stops at
+// GL 4.1) GLCheck falls back to a single glGetError after the call.
+// GL_DEBUG defaults to on unless NDEBUG is defined; with GL_DEBUG=0 GLCheck
+// expands to the bare call and no debug context is requested.
+#ifndef GL_DEBUG
+#ifdef NDEBUG
+#define GL_DEBUG 0
+#else
+#define GL_DEBUG 1
+#endif
+#endif
+
+class GLDebug{
+    public:
+    // Call once the context is current and glad is loaded. Messages below
+    // minimumSeverity are dropped by the driver. Returns true when the
+    // callback is installed; always false when GL_DEBUG is 0.
+    static bool Install(GLenum minimumSeverity = GL_DEBUG_SEVERITY_LOW);
+    static bool IsCallbackInstalled();
+    // GLCheck bookkeeping: remembers the call being made on this thread so
+    // the synchronous callback can name it.
+    static void BeginCall(const char* call, const char* file, int line);
+    static void EndCall();
+    // Prints how often each deduplicated message was raised.
+    static void PrintSummary();
+};
+
+#if GL_DEBUG
+#define GLCheck(x) do { GLDebug::BeginCall(#x, __FILE__, __LINE__); x; GLDebug::EndCall(); } while (0)
+#else
+#define GLCheck(x) x
+#endif
+#endif
@@ -0,0 +1,82 @@
+#ifndef GPUPROFILER_HPP
+#define GPUPROFILER_HPP
+#include <glad/glad.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+// Frame profiler pairing GPU timestamps with CPU timers for nested scopes.
+// Each scope drops a GL_TIMESTAMP query at its start and end (timestamps nest,
+// GL_TIME_ELAPSED queries do not). Query sets for kFrameLatency frames are kept
+// in a ring and a frame's results are only read when its set is reused, so the
+// CPU never waits for the GPU to catch up. Collected scopes can be written as a
+// Chrome trace (chrome://tracing or ui.perfetto.dev) with one CPU and one GPU track.
+class GpuProfiler{
+    public:
+    static const int kFrameLatency = 4;
+    static const int kMaxScopesPerFrame = 128;
+    GpuProfiler();
+    bool Create();
+    void Destroy();
+    // BeginFrame opens a root "Frame" scope that EndFrame closes.
+    void BeginFrame();
+    void EndFrame();
+    // name must outlive the profiler (use string literals). Returns a handle for
+    // EndScope, or -1 when the frame's scope budget is exhausted.
+    int BeginScope(const char* name);
+    void EndScope(int scope);
+    // Reads back every outstanding frame; call before writing the trace.
+    void Flush();
+    bool WriteChromeTrace(const std::string& filepath) const;
+    private:
+        struct Scope{
+            const char* mName;
+            int mDepth;
+            long long mCpuBegin;
+            long long mCpuEnd;
+        };
+        struct FrameQueries{
+            std::vector<Scope> mScopes;
+            std::vector<GLuint> mQueries;   // begin/end timestamp per scope
+            int mFrameIndex = -1;
+            int mRootScope = -1;
+        };
+        struct Event{
+            const char* mName;
+            int mFrameIndex;
+            int mDepth;
+            long long mCpuBegin;
+            long long mCpuEnd;
+            long long mGpuBegin;
+            long long mGpuEnd;
+        };
+        void Collect(FrameQueries& frame);
+        long long CpuNow() const;
+        FrameQueries mFrames[kFrameLatency];
+        std::vector<Event> mEvents;
+        std::chrono::steady_clock::time_point mEpoch;
+        long long mGpuToCpuOffset;
+        int mFrameCounter;
+        int mDepth;
+        bool mCreated;
+};
+
+// RAII helper; a null profiler makes the scope free.
+class GpuProfileScope{
+    public:
+    GpuProfileScope(GpuProfiler* profiler, const char* name){
+        mProfiler = profiler;
+        mScope = profiler != nullptr ? profiler->BeginScope(name) : -1;
+    }
+    ~GpuProfileScope(){
+        if (mProfiler != nullptr){
+            mProfiler->EndScope(mScope);
+        }
+    }
+    GpuProfileScope(const GpuProfileScope&) = delete;
+    GpuProfileScope& operator=(const GpuProfileScope&) = delete;
+    private:
+        GpuProfiler* mProfiler;
+        int mScope;
+};
+#endif
@@ -0,0 +1,122 @@
+#ifndef HEADLESS_HPP
+#define HEADLESS_HPP
+#include <glad/glad.h>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Headless (window-less) rendering support: an OpenGL context that needs no
+// display server, an offscreen framebuffer to render into, and an
+// asynchronous PBO readback ring that streams finished frames to disk or a pipe.
+
+class HeadlessContext{
+    public:
+    HeadlessContext();
+    ~HeadlessContext();
+    // Creates an OpenGL 4.1 core context and makes it current. On Linux this
+    // uses EGL (surfaceless platform first, pbuffer as a fallback) so it works
+    // on Mesa llvmpipe without X11/Wayland; elsewhere a hidden SDL window is used.
+    bool Create(int width, int height);
+    void Destroy();
+    // A second context sharing buffers and textures with the main one, for an
+    // upload thread. Created (and left not current) on the thread that owns
+    // the main context; MakeSharedCurrent/ReleaseShared run on the upload thread.
+    bool CreateSharedContext();
+    bool MakeSharedCurrent();
+    void ReleaseShared();
+    // Loader to hand to gladLoadGLLoader once the context is current.
+    static void* GetProcAddress(const char* name);
+    private:
+        void* mDisplay;
+        void* mConfig;
+        void* mSurface;
+        void* mContext;
+        void* mSharedSurface;
+        void* mSharedContext;
+        void* mHiddenWindow;
+};
+
+class OffscreenTarget{
+    public:
+    OffscreenTarget();
+    bool Create(int width, int height);
+    void Destroy();
+    void Bind() const;
+    static void Unbind();
+    int GetWidth() const { return mWidth; }
+    int GetHeight() const { return mHeight; }
+    private:
+        GLuint mFramebuffer;
+        GLuint mColorBuffer;
+        GLuint mDepthBuffer;
+        int mWidth;
+        int mHeight;
+};
+
+// Writes RGB frames as binary PPM images. The output is either a filename
+// pattern containing a printf-style frame number (e.g. "frames/out_%04d.ppm"),
+// or "-" to stream concatenated PPMs to stdout (ffmpeg -f image2pipe).
+class FrameWriter{
+    public:
+    FrameWriter();
+    ~FrameWriter();
+    bool Open(const std::string& output);
+    void Close();
+    // pixels are tightly packed RGBA8 rows in OpenGL bottom-up order.
+    bool Write(int frameIndex, const unsigned char* pixels, int width, int height);
+    private:
+        std::string mPattern;
+        FILE* mPipe;
+        std::vector<unsigned char> mRow;
+};
+
+// Ring of pixel pack buffers. Each Queue() issues a glReadPixels into the next
+// PBO and drops a fence behind it; the mapping happens frames later, once the
+// fence has signalled, so the CPU never stalls waiting for the GPU to drain.
+class AsyncReadback{
+    public:
+    static const int kRingSize = 3;
+    AsyncReadback();
+    bool Create(int width, int height, FrameWriter* writer);
+    void Destroy();
+    // Reads the currently bound read framebuffer into the ring.
+    void Queue(int frameIndex);
+    // Hands every already-completed readback to the writer without blocking.
+    void Poll();
+    // Blocks until every queued readback has been written.
+    void Flush();
+    private:
+        struct Slot{
+            GLuint mBuffer = 0;
+            GLsync mFence = nullptr;
+            int mFrameIndex = -1;
+        };
+        bool Retire(Slot& slot, GLuint64 timeout);
+        Slot mSlots[kRingSize];
+        int mNext;
+        int mWidth;
+        int mHeight;
+        FrameWriter* mWriter;
+};
+
+// Overdraw measurement. Meshes are drawn with additive blending and a shader
+// that adds 1/255 to red, so the red channel of a finished frame counts the
+// fragments shaded at every pixel. Resolve reads that back synchronously, adds
+// it to the totals and writes the frame out as a heat map: black, then blue,
+// green, yellow, orange and red for one to five layers, white beyond.
+class OverdrawCounter{
+    public:
+    OverdrawCounter();
+    // Reads the currently bound read framebuffer; writer may be null.
+    void Resolve(int frameIndex, int width, int height, FrameWriter* writer);
+    // Fragments shaded per covered pixel, the deepest pixel and coverage so far.
+    void PrintReport() const;
+    private:
+        std::vector<unsigned char> mPixels;
+        uint64_t mFragments;
+        uint64_t mCoveredPixels;
+        uint64_t mPixelCount;
+        int mMaxLayers;
+};
+#endif
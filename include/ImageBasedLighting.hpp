@@ -0,0 +1,65 @@
+#ifndef IMAGEBASEDLIGHTING_HPP
+#define IMAGEBASEDLIGHTING_HPP
+#include <glad/glad.h>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+class JobSystem;
+
+// Split-sum image-based lighting for the metallic/roughness material in
+// frag.glsl. A sky (gradient plus sun disc) is convolved once on the CPU into
+// a diffuse irradiance cube, a specular cube whose mip levels are prefiltered
+// with the GGX lobe for increasing roughness, and a table of the specular
+// response's scale and bias to F0 by view angle and roughness. Every output
+// texel is a weighted sum over the source cube's texels, four at a time, one
+// row of texels per job. The results are cached on disk under a hash of all
+// their inputs and read back on later runs.
+class ImageBasedLighting{
+    public:
+    static const int kIrradianceSize = 16;
+    static const int kSpecularSize = 64;
+    // Level i is prefiltered for roughness i / (kSpecularLevels - 1).
+    static const int kSpecularLevels = 5;
+    static const int kLutSize = 128;
+    explicit ImageBasedLighting(JobSystem* jobs = nullptr);
+    // Direction the sunlight travels, world space; places the sun in the sky.
+    void SetSunDirection(const glm::vec3& direction);
+    // Reads the maps from cacheDirectory, or computes them and writes them
+    // there. An empty cacheDirectory always computes.
+    void Prepare(const std::string& cacheDirectory);
+    void Compute();
+    // GL side; the render context must be current.
+    void Create();
+    void Destroy();
+    // Locations of the uniforms Bind sets, looked up once when a program is linked.
+    struct Uniforms{
+        GLint mSamplers[3];
+        GLint mSpecularLevels;
+        GLint mViewToWorld;
+    };
+    static Uniforms FindUniforms(GLuint program);
+    // Binds irradiance, specular and table to texture units firstUnit.. and sets
+    // the uniforms of the program uniforms came from, which must be in use.
+    // cameraView maps world to the camera's view space, where frag.glsl shades.
+    void Bind(const Uniforms& uniforms, int firstUnit, const glm::mat4& cameraView) const;
+    // Cost of each precomputation step against a cache load, and a white
+    // furnace check of the convolutions.
+    static void RunMicrobenchmark(const std::string& cacheDirectory);
+    private:
+        glm::vec3 SampleSky(const glm::vec3& direction) const;
+        std::string GetCachePath(const std::string& cacheDirectory) const;
+        bool LoadCache(const std::string& path);
+        bool SaveCache(const std::string& path) const;
+        void ComputeLut();
+        JobSystem* mJobs;
+        glm::vec3 mSunDirection;
+        // RGB, faces in GL order (+X, -X, +Y, -Y, +Z, -Z), rows top down.
+        std::vector<float> mIrradiance;
+        std::vector<float> mSpecular[kSpecularLevels];
+        // Scale and bias, NdotV along rows and roughness down columns.
+        std::vector<float> mLut;
+        GLuint mTextures[3];
+};
+#endif
@@ -0,0 +1,59 @@
+#ifndef INPUTSYSTEM_HPP
+#define INPUTSYSTEM_HPP
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct InputEvent{
+    enum Type{
+        kQuit,
+        kMouseMotion
+    };
+    Type mType = kMouseMotion;
+    // When the event reached us; SDL's own timestamps only have millisecond resolution.
+    std::chrono::steady_clock::time_point mTime;
+    // Relative motion in pixels for kMouseMotion.
+    int mX = 0;
+    int mY = 0;
+};
+
+// Buffers input events with their arrival time so the render loop can consume
+// them as late as it likes: discrete events once a frame, mouse motion summed
+// right before the view matrix is needed. Events may be pushed from any thread.
+// Latency from arrival to the motion being latched, and to the frame showing
+// it being complete, is collected per event.
+class InputSystem{
+    public:
+    typedef std::chrono::steady_clock Clock;
+    InputSystem();
+    ~InputSystem();
+    InputSystem(const InputSystem&) = delete;
+    InputSystem& operator=(const InputSystem&) = delete;
+    void Push(const InputEvent& event);
+    // Moves the buffered events other than mouse motion to events, oldest first.
+    void TakeEvents(std::vector<InputEvent>& events);
+    // Sums the buffered mouse motion into dx/dy; returns false when there was none.
+    bool TakeMotion(int& dx, int& dy);
+    // Call once the frame that used the motion taken since the last call has
+    // finished on the GPU.
+    void FrameCompleted();
+    // Injects a mouse motion event of (dx, 0) eventsPerSecond times a second from
+    // a background thread, for measuring latency without a person at the mouse.
+    void StartSyntheticMotion(double eventsPerSecond, int dx);
+    void StopSyntheticMotion();
+    // Mean and 99th percentile latency of every event latched so far.
+    void PrintLatencyReport() const;
+    private:
+        std::mutex mMutex;
+        std::vector<InputEvent> mEvents;
+        // Arrival and latch time of the motion taken for the frame in flight.
+        std::vector<Clock::time_point> mLatchedArrivals;
+        std::vector<Clock::time_point> mLatchTimes;
+        std::vector<double> mLatchMilliseconds;
+        std::vector<double> mFrameMilliseconds;
+        std::thread mSyntheticThread;
+        std::atomic<bool> mSyntheticRunning;
+};
+#endif
@@ -0,0 +1,42 @@
+#ifndef JOBSYSTEM_HPP
+#define JOBSYSTEM_HPP
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed pool of worker threads fed from two FIFO queues. Threads that wait on a
+// ParallelFor help drain the first, so parallel loops may nest safely. Long
+// jobs (file loading, decoding) go to the second, which only idle workers
+// take from: a waiter picking one up would stall its caller, often the render
+// thread, for the whole job.
+class JobSystem{
+    public:
+    // threadCount == 0 uses one worker per hardware thread minus the caller.
+    explicit JobSystem(unsigned int threadCount = 0);
+    ~JobSystem();
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+    void Submit(std::function<void()> job);
+    void SubmitBackground(std::function<void()> job);
+    // Splits [0, count) into ranges of at most grainSize and runs body(begin, end)
+    // on the pool, returning once every range has finished.
+    void ParallelFor(size_t count, size_t grainSize, const std::function<void(size_t, size_t)>& body);
+    // Workers plus the calling thread.
+    unsigned int GetThreadCount() const;
+    // Process-wide pool sized to the machine.
+    static JobSystem& Shared();
+    private:
+        void WorkerLoop();
+        bool RunOne();
+        std::vector<std::thread> mThreads;
+        std::deque<std::function<void()>> mJobs;
+        std::deque<std::function<void()>> mBackgroundJobs;
+        std::mutex mMutex;
+        std::condition_variable mWake;
+        bool mStopping;
+};
+#endif
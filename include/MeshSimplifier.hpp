@@ -0,0 +1,49 @@
+#ifndef MESHSIMPLIFIER_HPP
+#define MESHSIMPLIFIER_HPP
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "../OBJLoader.h"
+
+class Camera;
+
+// One level of detail: a range of the chain's shared index buffer.
+struct LodLevel{
+    unsigned int mIndexOffset = 0;
+    unsigned int mIndexCount = 0;
+    // Object-space distance the level deviates from the source surface: the
+    // largest area-weighted RMS distance of a collapsed vertex from the source
+    // planes around it.
+    float mError = 0.0f;
+};
+
+// Every level indexes the same welded vertex array (collapses only ever move a
+// vertex onto an existing one), and all index ranges live back to back in
+// mMesh.indices, so a chain uploads as one VBO and one IBO.
+struct LodChain{
+    Mesh mMesh;
+    std::vector<LodLevel> mLevels;
+    glm::vec3 mCenter = glm::vec3(0.0f);
+    float mRadius = 0.0f;
+};
+
+// Quadric error metric edge-collapse simplifier (Garland & Heckbert), with the
+// quadrics extended over normals and texture coordinates so collapses across
+// shading and UV discontinuities are charged for the attribute error too.
+class MeshSimplifier{
+    public:
+    // Merges vertices whose position, normal and texture coordinate all match.
+    static Mesh WeldVertices(const Mesh& mesh);
+    // ratios are triangle fractions in descending order, e.g. {1, 0.5, 0.25};
+    // the levels are produced by one continuous collapse sequence.
+    static LodChain BuildLodChain(const Mesh& mesh, const std::vector<float>& ratios);
+    // Coarsest level whose error projects to at most maxPixelError pixels for a
+    // bounding sphere at worldCenter/worldRadius seen from camera.
+    static int SelectLod(const std::vector<LodLevel>& levels, const Camera& camera,
+                         const glm::vec3& worldCenter, float worldRadius,
+                         float viewportHeight, float maxPixelError);
+    // Simplifies modelPath (or a generated torus of about triangleCount
+    // triangles when empty) and prints per-level savings and throughput.
+    static void RunMicrobenchmark(const std::string& modelPath, int triangleCount);
+};
+#endif
@@ -0,0 +1,61 @@
+#ifndef MESHLET_HPP
+#define MESHLET_HPP
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "../OBJLoader.h"
+
+class Camera;
+
+// A small cluster of triangles (at most kMaxVertices unique vertices and
+// kMaxTriangles triangles) stored as a contiguous run of the mesh's index
+// buffer, with the bounds needed to cull it as a unit.
+struct Meshlet{
+    static const unsigned int kMaxVertices = 64;
+    static const unsigned int kMaxTriangles = 124;
+    unsigned int mIndexOffset = 0;
+    unsigned int mTriangleCount = 0;
+    unsigned int mVertexCount = 0;
+    glm::vec3 mCenter = glm::vec3(0.0f);
+    float mRadius = 0.0f;
+    // Normal cone: mConeCutoff is the sine of the angle between the axis and
+    // the widest face normal, or 1 when the cone is too wide to ever cull.
+    glm::vec3 mConeApex = glm::vec3(0.0f);
+    glm::vec3 mConeAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+    float mConeCutoff = 1.0f;
+};
+
+struct ClusterCullStats{
+    size_t mMeshlets = 0;
+    size_t mTriangles = 0;
+    size_t mFrustumCulledMeshlets = 0;
+    size_t mFrustumCulledTriangles = 0;
+    size_t mBackfaceCulledMeshlets = 0;
+    size_t mBackfaceCulledTriangles = 0;
+    void Add(const ClusterCullStats& other);
+};
+
+class MeshletBuilder{
+    public:
+    // Reorders indices[0, indexCount) so every meshlet is a contiguous run and
+    // appends the meshlets to out, their offsets relative to indexBase. Triangles
+    // are grown greedily across shared vertices so clusters stay compact.
+    static void Build(const std::vector<Vertex>& vertices, unsigned int* indices, size_t indexCount,
+                      unsigned int indexBase, std::vector<Meshlet>& out);
+};
+
+class ClusterCuller{
+    public:
+    // Tests meshlets against the frustum of modelViewProjection and against the
+    // camera at eye (model space), and writes the surviving index runs, merged
+    // where neighbouring meshlets both survive, as (first index, index count).
+    static void Cull(const Meshlet* meshlets, size_t meshletCount,
+                     const glm::mat4& modelViewProjection, const glm::vec3& eye,
+                     std::vector<unsigned int>& firstIndices, std::vector<unsigned int>& indexCounts,
+                     ClusterCullStats* stats);
+    // Orbits the camera around modelPath for frameCount frames and prints how
+    // many meshlets and triangles each test removes.
+    static void RunMicrobenchmark(const std::string& modelPath, int frameCount);
+};
+#endif
@@ -0,0 +1,56 @@
+#ifndef OCCLUSIONCULLER_HPP
+#define OCCLUSIONCULLER_HPP
+#include <cstddef>
+#include <vector>
+#include <glm/glm.hpp>
+
+// Hierarchical-Z occlusion culling on the CPU. A handful of occluder meshes are
+// rasterized depth-only into a small buffer, four pixels at a time, then
+// reduced into a pyramid whose texels hold the farthest depth below them. An
+// object's bounding box is occluded when its nearest depth lies behind every
+// texel of the pyramid level where its screen rectangle spans about 2x2 texels.
+// Depth is reverse-Z as Camera projects it, so farther means smaller.
+class OcclusionCuller{
+    public:
+    static const int kDefaultWidth = 256;
+    static const int kDefaultHeight = 128;
+    enum Result{
+        kVisible,
+        kOutsideFrustum,
+        kOccluded
+    };
+    // width must be a multiple of 4.
+    OcclusionCuller(int width = kDefaultWidth, int height = kDefaultHeight);
+    // Clears the depth buffer for a new view.
+    void Begin(const glm::mat4& viewProjection);
+    // positions: x,y,z at the start of every stride floats.
+    void RenderOccluder(const float* positions, size_t stride, const unsigned int* indices, size_t indexCount,
+                        const glm::mat4& model);
+    // Call once after the last occluder and before testing.
+    void BuildPyramid();
+    Result TestBox(const glm::vec3& boxMin, const glm::vec3& boxMax, const glm::mat4& model) const;
+    int GetWidth() const { return mWidth; }
+    int GetHeight() const { return mHeight; }
+    // Depth buffer (level 0) or a pyramid level, row-major, 1 at the near plane
+    // and 0 infinitely far.
+    const std::vector<float>& GetLevel(int level) const { return mLevels[level]; }
+    // Instanced city-block scene: walks a camera down a street and reports
+    // rasterization time and the share of objects culled.
+    static void RunMicrobenchmark(int frameCount);
+    private:
+        struct ScreenVertex{
+            float x;
+            float y;
+            float z;
+        };
+        void RasterTriangle(const ScreenVertex& v0, const ScreenVertex& v1, const ScreenVertex& v2);
+        void ClipAndRaster(const glm::vec4* clip);
+        ScreenVertex ToScreen(const glm::vec4& clip) const;
+        int mWidth;
+        int mHeight;
+        glm::mat4 mViewProjection;
+        std::vector<std::vector<float>> mLevels;
+        std::vector<int> mLevelWidths;
+        std::vector<int> mLevelHeights;
+};
+#endif
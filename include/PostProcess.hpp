@@ -0,0 +1,122 @@
+#ifndef POSTPROCESS_HPP
+#define POSTPROCESS_HPP
+#include <glad/glad.h>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "FrameGraph.hpp"
+
+// A colour texture, optionally with a depth buffer, and the framebuffer that
+// draws to them.
+struct RenderTarget{
+    int mWidth = 0;
+    int mHeight = 0;
+    GLenum mFormat = GL_NONE;
+    GLenum mDepthFormat = GL_NONE;
+    GLuint mTexture = 0;
+    GLuint mDepthBuffer = 0;
+    GLuint mFramebuffer = 0;
+    bool mInUse = false;
+    int mIdleFrames = 0;
+};
+
+// Transient render targets. A pass acquires a target when it first writes it
+// and releases it after its last reader; a later acquire of the same size and
+// formats, in the same frame or the next, gets the same memory back. Passes
+// whose targets are not alive at once so share memory and the pool only grows
+// to the most targets alive together. Targets left unused for a few frames
+// (after a resize) are freed.
+class RenderTargetPool{
+    public:
+    // depthFormat GL_NONE for a colour target only. Leaves the framebuffer
+    // binding as it was, even when the target has to be created.
+    RenderTarget* Acquire(int width, int height, GLenum format, GLenum depthFormat = GL_NONE);
+    void Release(RenderTarget* target);
+    void EndFrame();
+    void Destroy();
+    // The last frame's acquires, and what the pool holds.
+    size_t GetRequestedCount() const { return mLastRequestedCount; }
+    size_t GetRequestedBytes() const { return mLastRequestedBytes; }
+    size_t GetTargetCount() const { return mTargets.size(); }
+    size_t GetAllocatedBytes() const;
+    static size_t GetByteSize(const RenderTarget& target);
+    private:
+        std::vector<std::unique_ptr<RenderTarget>> mTargets;
+        size_t mRequestedCount = 0;
+        size_t mRequestedBytes = 0;
+        size_t mLastRequestedCount = 0;
+        size_t mLastRequestedBytes = 0;
+};
+
+struct PostProcessSettings{
+    bool mBloom = false;
+    bool mTonemap = false;
+    bool mFxaa = false;
+    float mExposure = 1.0f;
+    // Bloom takes what is brighter than mBloomThreshold through mBloomLevels
+    // halvings of the frame.
+    float mBloomThreshold = 1.0f;
+    float mBloomStrength = 0.3f;
+    int mBloomLevels = 5;
+};
+
+// Runs a FrameGraph on GL: texture slots take their targets from a
+// RenderTargetPool, imported ones wrap the framebuffer in mExternal.
+class RenderTargetGraphBackend : public FrameGraphBackend{
+    public:
+    explicit RenderTargetGraphBackend(RenderTargetPool* pool);
+    void AcquireSlot(int slot, const FrameGraphResourceDesc& desc) override;
+    void ReleaseSlot(int slot) override;
+    void Barrier(int slot, Access before, Access after) override;
+    void BeginPass(const std::string& name, const std::vector<int>& targets) override;
+    // Before every frame, with the framebuffer bound at the time.
+    void Reset(GLuint boundFramebuffer);
+    RenderTarget* GetTarget(int slot) const { return mSlots[slot]; }
+    int GetFramebufferBinds() const { return mFramebufferBinds; }
+    private:
+        RenderTargetPool* mPool;
+        std::vector<RenderTarget*> mSlots;
+        std::vector<std::unique_ptr<RenderTarget>> mImported;
+        GLuint mBoundFramebuffer = 0;
+        int mFramebufferBinds = 0;
+};
+
+// Programs of the chain, all drawn with post_vert.glsl.
+struct PostProcessPrograms{
+    GLuint mDownsample = 0;
+    GLuint mUpsample = 0;
+    GLuint mResolve = 0;
+    GLuint mFxaa = 0;
+};
+
+// The frame is drawn into a half-float HDR target instead of the output
+// framebuffer, then: bloom, by downsampling the bright parts into a chain of
+// ever smaller targets and adding them back up while upsampling; the resolve,
+// which applies exposure, adds the bloom, tonemaps with the ACES fit and
+// encodes sRGB; and FXAA on the result. The passes are a FrameGraph built
+// every frame, every intermediate a slot from a RenderTargetPool.
+class PostProcessChain{
+    public:
+    PostProcessChain(const PostProcessSettings& settings, const PostProcessPrograms& programs);
+    // GL side; the render context must be current.
+    void Create();
+    void Destroy();
+    // Calls drawScene with a new HDR target (with float depth) bound, runs the
+    // chain on it and draws the result to framebuffer output, leaving it bound.
+    void Render(GLuint output, int width, int height, const std::function<void()>& drawScene);
+    void PrintReport() const;
+    private:
+        void BuildGraph(GLuint output, int width, int height, const std::function<void()>& drawScene);
+        // The target a graph resource got this frame.
+        RenderTarget* GetTarget(int resource) const;
+        void DrawFullscreen();
+        PostProcessSettings mSettings;
+        PostProcessPrograms mPrograms;
+        RenderTargetPool mPool;
+        FrameGraph mGraph;
+        RenderTargetGraphBackend mBackend;
+        GLuint mVertexArray;
+};
+#endif
@@ -0,0 +1,114 @@
+#ifndef SIMD_HPP
+#define SIMD_HPP
+// Minimal 4-wide float vector used by the CPU-side renderers. Maps onto SSE2 on
+// x86-64, NEON on Apple Silicon / ARM64 and falls back to plain arrays elsewhere,
+// so callers write one code path.
+#if defined(__SSE2__) || defined(_M_X64)
+#define SIMD_SSE 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#define SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+struct Float4{
+#if SIMD_SSE
+    __m128 v;
+#elif SIMD_NEON
+    float32x4_t v;
+#else
+    float v[4];
+#endif
+};
+
+#if SIMD_SSE
+inline Float4 Float4Splat(float s){ return { _mm_set1_ps(s) }; }
+inline Float4 Float4Set(float a, float b, float c, float d){ return { _mm_setr_ps(a, b, c, d) }; }
+inline Float4 Float4Load(const float* p){ return { _mm_loadu_ps(p) }; }
+inline void Float4Store(float* p, Float4 a){ _mm_storeu_ps(p, a.v); }
+inline Float4 operator+(Float4 a, Float4 b){ return { _mm_add_ps(a.v, b.v) }; }
+inline Float4 operator-(Float4 a, Float4 b){ return { _mm_sub_ps(a.v, b.v) }; }
+inline Float4 operator*(Float4 a, Float4 b){ return { _mm_mul_ps(a.v, b.v) }; }
+inline Float4 operator/(Float4 a, Float4 b){ return { _mm_div_ps(a.v, b.v) }; }
+inline Float4 Float4Min(Float4 a, Float4 b){ return { _mm_min_ps(a.v, b.v) }; }
+inline Float4 Float4Max(Float4 a, Float4 b){ return { _mm_max_ps(a.v, b.v) }; }
+inline Float4 Float4Sqrt(Float4 a){ return { _mm_sqrt_ps(a.v) }; }
+inline Float4 Float4CmpGe(Float4 a, Float4 b){ return { _mm_cmpge_ps(a.v, b.v) }; }
+inline Float4 Float4CmpGt(Float4 a, Float4 b){ return { _mm_cmpgt_ps(a.v, b.v) }; }
+inline Float4 Float4CmpLt(Float4 a, Float4 b){ return { _mm_cmplt_ps(a.v, b.v) }; }
+inline Float4 Float4CmpLe(Float4 a, Float4 b){ return { _mm_cmple_ps(a.v, b.v) }; }
+inline Float4 Float4And(Float4 a, Float4 b){ return { _mm_and_ps(a.v, b.v) }; }
+inline Float4 Float4Or(Float4 a, Float4 b){ return { _mm_or_ps(a.v, b.v) }; }
+// Per lane: mask ? a : b
+inline Float4 Float4Select(Float4 mask, Float4 a, Float4 b){ return { _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)) }; }
+inline int Float4MoveMask(Float4 mask){ return _mm_movemask_ps(mask.v); }
+inline float Float4HorizontalMax(Float4 a){
+    __m128 m = _mm_max_ps(a.v, _mm_shuffle_ps(a.v, a.v, _MM_SHUFFLE(2, 3, 0, 1)));
+    m = _mm_max_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 0, 3, 2)));
+    return _mm_cvtss_f32(m);
+}
+inline float Float4HorizontalMin(Float4 a){
+    __m128 m = _mm_min_ps(a.v, _mm_shuffle_ps(a.v, a.v, _MM_SHUFFLE(2, 3, 0, 1)));
+    m = _mm_min_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 0, 3, 2)));
+    return _mm_cvtss_f32(m);
+}
+#elif SIMD_NEON
+inline Float4 Float4Splat(float s){ return { vdupq_n_f32(s) }; }
+inline Float4 Float4Set(float a, float b, float c, float d){ const float p[4] = { a, b, c, d }; return { vld1q_f32(p) }; }
+inline Float4 Float4Load(const float* p){ return { vld1q_f32(p) }; }
+inline void Float4Store(float* p, Float4 a){ vst1q_f32(p, a.v); }
+inline Float4 operator+(Float4 a, Float4 b){ return { vaddq_f32(a.v, b.v) }; }
+inline Float4 operator-(Float4 a, Float4 b){ return { vsubq_f32(a.v, b.v) }; }
+inline Float4 operator*(Float4 a, Float4 b){ return { vmulq_f32(a.v, b.v) }; }
+inline Float4 operator/(Float4 a, Float4 b){ return { vdivq_f32(a.v, b.v) }; }
+inline Float4 Float4Min(Float4 a, Float4 b){ return { vminq_f32(a.v, b.v) }; }
+inline Float4 Float4Max(Float4 a, Float4 b){ return { vmaxq_f32(a.v, b.v) }; }
+inline Float4 Float4Sqrt(Float4 a){ return { vsqrtq_f32(a.v) }; }
+inline Float4 Float4CmpGe(Float4 a, Float4 b){ return { vreinterpretq_f32_u32(vcgeq_f32(a.v, b.v)) }; }
+inline Float4 Float4CmpGt(Float4 a, Float4 b){ return { vreinterpretq_f32_u32(vcgtq_f32(a.v, b.v)) }; }
+inline Float4 Float4CmpLt(Float4 a, Float4 b){ return { vreinterpretq_f32_u32(vcltq_f32(a.v, b.v)) }; }
+inline Float4 Float4CmpLe(Float4 a, Float4 b){ return { vreinterpretq_f32_u32(vcleq_f32(a.v, b.v)) }; }
+inline Float4 Float4And(Float4 a, Float4 b){ return { vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(a.v), vreinterpretq_u32_f32(b.v))) }; }
+inline Float4 Float4Or(Float4 a, Float4 b){ return { vreinterpretq_f32_u32(vorrq_u32(vreinterpretq_u32_f32(a.v), vreinterpretq_u32_f32(b.v))) }; }
+inline Float4 Float4Select(Float4 mask, Float4 a, Float4 b){ return { vbslq_f32(vreinterpretq_u32_f32(mask.v), a.v, b.v) }; }
+inline int Float4MoveMask(Float4 mask){
+    uint32x4_t bits = vshrq_n_u32(vreinterpretq_u32_f32(mask.v), 31);
+    return (int)(vgetq_lane_u32(bits, 0) | (vgetq_lane_u32(bits, 1) << 1) | (vgetq_lane_u32(bits, 2) << 2) | (vgetq_lane_u32(bits, 3) << 3));
+}
+inline float Float4HorizontalMax(Float4 a){ return vmaxvq_f32(a.v); }
+inline float Float4HorizontalMin(Float4 a){ return vminvq_f32(a.v); }
+#else
+#include <cmath>
+#include <cstring>
+inline Float4 Float4Splat(float s){ return { { s, s, s, s } }; }
+inline Float4 Float4Set(float a, float b, float c, float d){ return { { a, b, c, d } }; }
+inline Float4 Float4Load(const float* p){ return { { p[0], p[1], p[2], p[3] } }; }
+inline void Float4Store(float* p, Float4 a){ for (int i = 0; i < 4; i++){ p[i] = a.v[i]; } }
+#define FLOAT4_LANEWISE(expr) Float4 r; for (int i = 0; i < 4; i++){ r.v[i] = (expr); } return r;
+inline float Float4MaskBits(bool b){ unsigned int u = b ? 0xFFFFFFFFu : 0u; float f; memcpy(&f, &u, 4); return f; }
+inline unsigned int Float4Bits(float f){ unsigned int u; memcpy(&u, &f, 4); return u; }
+inline float Float4FromBits(unsigned int u){ float f; memcpy(&f, &u, 4); return f; }
+inline Float4 operator+(Float4 a, Float4 b){ FLOAT4_LANEWISE(a.v[i] + b.v[i]) }
+inline Float4 operator-(Float4 a, Float4 b){ FLOAT4_LANEWISE(a.v[i] - b.v[i]) }
+inline Float4 operator*(Float4 a, Float4 b){ FLOAT4_LANEWISE(a.v[i] * b.v[i]) }
+inline Float4 operator/(Float4 a, Float4 b){ FLOAT4_LANEWISE(a.v[i] / b.v[i]) }
+inline Float4 Float4Min(Float4 a, Float4 b){ FLOAT4_LANEWISE(a.v[i] < b.v[i] ? a.v[i] : b.v[i]) }
+inline Float4 Float4Max(Float4 a, Float4 b){ FLOAT4_LANEWISE(a.v[i] > b.v[i] ? a.v[i] : b.v[i]) }
+inline Float4 Float4Sqrt(Float4 a){ FLOAT4_LANEWISE(std::sqrt(a.v[i])) }
+inline Float4 Float4CmpGe(Float4 a, Float4 b){ FLOAT4_LANEWISE(Float4MaskBits(a.v[i] >= b.v[i])) }
+inline Float4 Float4CmpGt(Float4 a, Float4 b){ FLOAT4_LANEWISE(Float4MaskBits(a.v[i] > b.v[i])) }
+inline Float4 Float4CmpLt(Float4 a, Float4 b){ FLOAT4_LANEWISE(Float4MaskBits(a.v[i] < b.v[i])) }
+inline Float4 Float4CmpLe(Float4 a, Float4 b){ FLOAT4_LANEWISE(Float4MaskBits(a.v[i] <= b.v[i])) }
+inline Float4 Float4And(Float4 a, Float4 b){ FLOAT4_LANEWISE(Float4FromBits(Float4Bits(a.v[i]) & Float4Bits(b.v[i]))) }
+inline Float4 Float4Or(Float4 a, Float4 b){ FLOAT4_LANEWISE(Float4FromBits(Float4Bits(a.v[i]) | Float4Bits(b.v[i]))) }
+inline Float4 Float4Select(Float4 mask, Float4 a, Float4 b){ FLOAT4_LANEWISE(Float4Bits(mask.v[i]) ? a.v[i] : b.v[i]) }
+inline int Float4MoveMask(Float4 mask){
+    int bits = 0;
+    for (int i = 0; i < 4; i++){ bits |= (Float4Bits(mask.v[i]) >> 31) << i; }
+    return bits;
+}
+inline float Float4HorizontalMax(Float4 a){ float m = a.v[0]; for (int i = 1; i < 4; i++){ m = a.v[i] > m ? a.v[i] : m; } return m; }
+inline float Float4HorizontalMin(Float4 a){ float m = a.v[0]; for (int i = 1; i < 4; i++){ m = a.v[i] < m ? a.v[i] : m; } return m; }
+#undef FLOAT4_LANEWISE
+#endif
+#endif
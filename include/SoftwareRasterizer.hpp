@@ -0,0 +1,81 @@
+#ifndef SOFTWARERASTERIZER_HPP
+#define SOFTWARERASTERIZER_HPP
+#include "glm/glm.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class JobSystem;
+
+// CPU implementation of the vert.glsl / frag.glsl pipeline for machines without
+// a GPU. Vertices are transformed with SIMD, triangles are set up as half-space
+// edge functions and binned into screen tiles, and tiles are rasterized in
+// parallel in 8x8 blocks. A per-block and per-tile farthest-depth hierarchy
+// rejects occluded blocks before any per-pixel work. Depth follows the camera's
+// reverse-Z convention: clip z in [0, w], 1 at the near plane. Output matches
+// glReadPixels: RGBA8 with the bottom row first.
+class SoftwareRasterizer{
+    public:
+    static const int kTileSize = 64;
+    static const int kBlockSize = 8;
+    explicit SoftwareRasterizer(JobSystem* jobs = nullptr);
+    void Resize(int width, int height);
+    // Mirrors glEnable/glDisable(GL_DEPTH_TEST) with glDepthFunc(GL_GREATER).
+    void SetDepthTest(bool enabled);
+    // Mirrors glEnable/glDisable(GL_CULL_FACE) with counter-clockwise front faces.
+    void SetCullBackFaces(bool enabled);
+    // depth 0 is infinitely far.
+    void Clear(const glm::vec4& color, float depth);
+    // vertexData starts every stride floats with x,y,z,r,g,b, the same stream
+    // the GL path binds to attributes 0 and 1. Textures are not sampled.
+    void DrawIndexed(const float* vertexData, size_t stride, size_t vertexCount,
+                     const unsigned int* indices, size_t indexCount,
+                     const glm::mat4& modelViewProjection);
+    // Tightly packed RGBA8 rows, bottom row first.
+    const unsigned char* GetColorBuffer();
+    int GetWidth() const { return mWidth; }
+    int GetHeight() const { return mHeight; }
+    private:
+        struct ClipVertex{
+            glm::vec4 position;
+            glm::vec3 color;
+        };
+        struct RasterTriangle{
+            // Edge functions E_i(x,y) = A_i*x + B_i*y + C_i, positive inside.
+            float edgeA[3], edgeB[3], edgeC[3];
+            bool topLeft[3];
+            float invArea;
+            // Screen-space depth and perspective terms at vertex 0, plus deltas to vertices 1 and 2.
+            float z0, dz1, dz2;
+            float invW0, dInvW1, dInvW2;
+            glm::vec3 colorOverW0, dColorOverW1, dColorOverW2;
+            float nearZ;
+            int minX, minY, maxX, maxY;
+        };
+        void SetupTriangle(const ClipVertex& a, const ClipVertex& b, const ClipVertex& c, std::vector<RasterTriangle>& out) const;
+        void SetupClipped(const ClipVertex* triangle, std::vector<RasterTriangle>& out) const;
+        void BinTriangles(size_t chunk);
+        void RasterizeTile(int tileIndex);
+        bool RasterizeBlock(const RasterTriangle& triangle, int blockX, int blockY, int minX, int minY, int maxX, int maxY);
+        JobSystem* mJobs;
+        int mWidth;
+        int mHeight;
+        int mStride;        // pixels per row, padded to whole blocks
+        int mPaddedHeight;
+        int mTilesX;
+        int mTilesY;
+        int mBlocksX;
+        bool mDepthTest;
+        bool mCullBackFaces;
+        std::vector<uint32_t> mColor;
+        std::vector<float> mDepth;
+        std::vector<float> mBlockFarDepth;
+        std::vector<float> mTileFarDepth;
+        std::vector<unsigned char> mResolved;
+        std::vector<ClipVertex> mTransformed;
+        // One triangle list and one set of tile bins per setup chunk; walking the
+        // chunks in order keeps submission order within every tile.
+        std::vector<std::vector<RasterTriangle>> mChunkTriangles;
+        std::vector<std::vector<std::vector<uint32_t>>> mChunkBins;
+};
+#endif
@@ -0,0 +1,31 @@
+#ifndef TANGENTSPACE_HPP
+#define TANGENTSPACE_HPP
+#include "../OBJLoader.h"
+
+// Per-vertex normal and tangent generation, run as optional OBJ loader stages.
+// Both work per triangle corner in parallel on the shared JobSystem and split
+// a vertex whenever its corners end up with different results.
+class TangentSpace{
+    public:
+    enum NormalWeighting{
+        // Each face counts with its area.
+        kWeightArea,
+        // Each face counts with its angle at the vertex, so the result does
+        // not depend on how a surface is triangulated.
+        kWeightAngle
+    };
+    // Smooth normals over faces sharing a position, in the same smoothing group
+    // (mesh.smoothingGroups, group 0 never smooths) and meeting at no more than
+    // smoothingAngle degrees. Positions are matched through mesh.positionIds
+    // when present, otherwise by value.
+    static void GenerateNormals(Mesh& mesh, float smoothingAngle, NormalWeighting weighting = kWeightAngle);
+    // MikkTSpace-compatible tangents: per-face UV gradients are projected into
+    // the vertex normal's plane, angle-weighted and summed over corners with
+    // identical position, normal and texture coordinate and the same UV
+    // winding, so normal maps baked against MikkTSpace shade without seams.
+    static void GenerateTangents(Mesh& mesh);
+    // Generates an OBJ-like (unwelded) mesh of about triangleCount triangles
+    // and times both stages.
+    static void RunMicrobenchmark(int triangleCount);
+};
+#endif
@@ -0,0 +1,110 @@
+#ifndef TEXTURE_HPP
+#define TEXTURE_HPP
+#include <glad/glad.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "BlockCompression.hpp"
+
+// Tightly packed RGBA8 rows, bottom row first as GL expects.
+struct Image{
+    int mWidth = 0;
+    int mHeight = 0;
+    std::vector<uint8_t> mPixels;
+};
+
+enum MipFilter{
+    kMipBox,    // 2x2 average
+    kMipKaiser  // Kaiser-windowed sinc over 8x8 texels: sharper, less aliasing
+};
+
+class ImageCodec{
+    public:
+    static bool ReadFile(const std::string& path, std::vector<uint8_t>& data);
+    // Binary (P6) and ASCII (P3) PPM, and uncompressed or RLE true-colour and
+    // greyscale TGA; the format is told from the contents.
+    static bool Decode(const std::string& path, Image& image);
+    static bool Decode(const uint8_t* data, size_t size, Image& image);
+    // Full chain down to 1x1, levels[0] being a copy of base. Colour channels are
+    // treated as sRGB and filtered in linear space, one pixel per SIMD vector.
+    static void GenerateMips(const Image& base, MipFilter filter, std::vector<Image>& levels);
+};
+
+// Keeps textures in GPU memory within a byte budget. Decoding and mip generation
+// run on the JobSystem; the render thread uploads through a pixel unpack buffer.
+// The mip tail (levels of kMipTailSize texels and below) is uploaded as soon as a
+// texture is decoded and stays resident; higher levels stream in as the objects
+// using a texture cover more of the screen and are dropped again, most
+// oversampled first, when the budget runs out.
+class TextureStreamer{
+    public:
+    static const int kMipTailSize = 64;
+    TextureStreamer(size_t budgetBytes = (size_t)64 << 20, size_t uploadBytesPerFrame = (size_t)8 << 20);
+    ~TextureStreamer();
+    TextureStreamer(const TextureStreamer&) = delete;
+    TextureStreamer& operator=(const TextureStreamer&) = delete;
+    // Applies to later Loads: textures are block-compressed on the decode job, and
+    // the encoded chains are cached in cacheDirectory (when not empty) under a hash
+    // of the source file, so later runs skip decoding and encoding. Call with the
+    // render context current; formats it cannot sample fall back to BC3, then RGBA8.
+    void SetCompression(BlockFormat format, const std::string& cacheDirectory);
+    // Returns a handle for RequestPixels/GetTexture; decoding starts right away.
+    int Load(const std::string& path, MipFilter filter = kMipKaiser);
+    // Blocks until every texture requested so far is decoded (or failed).
+    void WaitForDecodes();
+    // Render thread, each frame before Update: the texture spans about this many
+    // pixels on screen along its larger axis. The largest request of a frame wins;
+    // textures nobody asks for fall back to their mip tail.
+    void RequestPixels(int handle, float pixels);
+    // Render thread, once a frame: picks the resident levels of every texture
+    // within the budget and uploads the changes, at most uploadBytesPerFrame
+    // unless a single texture needs more.
+    void Update();
+    // 0 until the mip tail is resident.
+    GLuint GetTexture(int handle) const;
+    // Top resident level, or -1 while nothing is resident.
+    int GetResidentLevel(int handle) const;
+    size_t GetResidentBytes() const { return mResidentBytes; }
+    // Deletes the GL objects; the render context must be current.
+    void Destroy();
+    // Decode and mip generation throughput on generated PPM and TGA images.
+    static void RunMicrobenchmark(int imageSize, int imageCount);
+    private:
+        enum State{
+            kDecoding,
+            kDecoded,
+            kFailed
+        };
+        // Level data as uploaded: RGBA8 rows or blocks of mFormat.
+        struct Level{
+            int mWidth;
+            int mHeight;
+            std::vector<uint8_t> mData;
+        };
+        struct Texture{
+            BlockFormat mFormat = kUncompressed;
+            std::vector<Level> mLevels;
+            std::atomic<int> mState{kDecoding};
+            GLuint mTexture = 0;
+            int mResidentTop = -1;
+            int mWantedTop = -1;
+            int mTailTop = 0;
+            float mRequestedPixels = 0.0f;
+        };
+        size_t GetLevelBytes(const Texture& texture, int top) const;
+        static bool BuildLevels(Texture& texture, const std::string& path, MipFilter filter, const std::string& cacheDirectory);
+        static bool ReadCache(const std::string& cachePath, BlockFormat format, int width, int height, std::vector<Level>& levels);
+        void Upload(Texture& texture, int top);
+        std::vector<std::unique_ptr<Texture>> mTextures;
+        std::atomic<int> mDecoding;
+        BlockFormat mFormat;
+        std::string mCacheDirectory;
+        GLuint mUploadBuffer;
+        size_t mBudgetBytes;
+        size_t mUploadBytesPerFrame;
+        size_t mResidentBytes;
+};
+#endif
@@ -8,8 +8,62 @@
 #include <vector>
 #include <string>
 #include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <utility>
 
+#include "AssetLoader.hpp"
+#include "Benchmark.hpp"
 #include "Camera.hpp"
+#include "CascadedShadows.hpp"
+#include "ClusteredLighting.hpp"
+#include "FrameGraph.hpp"
+#include "FrameScheduler.hpp"
+#include "GLDebug.hpp"
+#include "GpuProfiler.hpp"
+#include "Headless.hpp"
+#include "ImageBasedLighting.hpp"
+#include "InputSystem.hpp"
+#include "OBJLoader.h"
+#include "SoftwareRasterizer.hpp"
+#include "JobSystem.hpp"
+#include "Meshlet.hpp"
+#include "MeshSimplifier.hpp"
+#include "OcclusionCuller.hpp"
+#include "PostProcess.hpp"
+#include "TangentSpace.hpp"
+#include "Texture.hpp"
+#include "Trace.hpp"
+
+// How opaque meshes are ordered and depth tested (--render-path).
+enum RenderPath{
+	kRenderUnordered,
+	kRenderSorted,
+	kRenderDepthPrepass
+};
+
+// Uniform locations of a mesh program, looked up once after it is linked. The
+// transforms are in every mesh program; the rest only in those shading with frag.glsl.
+struct MeshUniforms{
+	GLint mModelMatrix = -1;
+	GLint mViewMatrix = -1;
+	GLint mProjection = -1;
+	GLint mTexture = -1;
+	GLint mUseTexture = -1;
+	GLint mUseLighting = -1;
+	GLint mUseShadows = -1;
+	GLint mUsePbr = -1;
+	GLint mMetallic = -1;
+	GLint mRoughness = -1;
+	ClusteredLighting::Uniforms mLighting;
+	CascadedShadows::Uniforms mShadows;
+	ImageBasedLighting::Uniforms mEnvironment;
+};
 
 struct App{
 int mScreenWidth = 1728;
@@ -17,8 +71,118 @@ int mScreenHeight = 1117;
 SDL_Window* mGraphicsApplicationWindow = nullptr;
 SDL_GLContext mOpenGLContext = nullptr;
 int mQuit = 0;
+// Window events, buffered with their arrival time. Mouse motion is applied to
+// the camera just before drawing (mLateLatch) rather than at the start of the
+// frame; --input-latency feeds in synthetic motion and reports its latency.
+InputSystem mInput;
+bool mLateLatch = true;
+bool mMeasureInputLatency = false;
+int mMouseX = 0;
+int mMouseY = 0;
 GLuint mGraphicsPipelineShaderProgram = 0; // store our shader object
+MeshUniforms mGraphicsPipelineUniforms;
 Camera mCamera;
+// Whether glClipControl maps the camera's 0..w clip depth straight to the depth
+// buffer; without it the GL projection is remapped to the -1..1 convention.
+bool mClipControl = false;
+// Unordered draws without depth test or face culling, as submitted. Sorted culls
+// back faces, depth tests and draws front to back. The pre-pass path lays down
+// depth from a position-only stream first, so the colour pass shades each
+// visible pixel once; the software renderer has no pre-pass and draws it sorted.
+RenderPath mRenderPath = kRenderSorted;
+GLuint mDepthShaderProgram = 0;
+MeshUniforms mDepthUniforms;
+// Headless: draw fragment counts and write heat maps instead of frames (--overdraw)
+bool mOverdraw = false;
+GLuint mOverdrawShaderProgram = 0;
+MeshUniforms mOverdrawUniforms;
+// Point lights scattered around the scene and shaded through clustered forward
+// lighting, binned on the CPU every frame (--lights N, the GL renderer only)
+int mLightCount = 0;
+std::vector<PointLight> mLights;
+ClusteredLighting* mLighting = nullptr;
+// Sunlight with cascaded shadow maps (--shadows, the GL renderer only)
+bool mShadows = false;
+CascadedShadows* mShadowMaps = nullptr;
+// Metallic/roughness shading with image-based lighting (--pbr, the GL renderer
+// only); the environment maps are cached in mTextureCache.
+bool mPbr = false;
+float mMetallic = 0.0f;
+float mRoughness = 0.5f;
+ImageBasedLighting* mEnvironment = nullptr;
+// Draw into an HDR target and finish the frame through the post-process chain
+// (--post bloom,tonemap,fxaa, the GL renderer only)
+bool mPostProcessing = false;
+PostProcessSettings mPostSettings;
+PostProcessPrograms mPostPrograms;
+PostProcessChain* mPostProcess = nullptr;
+// Headless batch mode: render into an FBO and stream frames out instead of opening a window
+bool mHeadless = false;
+int mFrameCount = 60;
+std::string mOutputPath = "frame_%04d.ppm";
+// Render through the CPU rasterizer instead of OpenGL (headless only)
+bool mSoftwareRenderer = false;
+// Optional OBJ model drawn in place of the first quad
+std::string mModelPath;
+// Crease angle (degrees) for normals generated when the model has none
+float mSmoothingAngle = 60.0f;
+// Load the model in the background and draw a placeholder until it is ready
+// (always in a window, --async-load headless); mStartTime anchors the latency report
+bool mAsyncLoad = false;
+AssetLoader* mAssetLoader = nullptr;
+std::chrono::steady_clock::time_point mStartTime;
+int mFramesRendered = 0;
+// Texture drawn on both meshes (--texture, PPM or TGA), streamed within
+// mTextureBudget bytes of GPU memory; the GL renderer only. It is block-compressed
+// to mTextureFormat on load, with the result cached in mTextureCache.
+std::string mTexturePath;
+size_t mTextureBudget = (size_t)64 << 20;
+BlockFormat mTextureFormat = kBC7;
+std::string mTextureCache = "texture_cache";
+TextureStreamer* mTextures = nullptr;
+// Benchmark mode: replay a camera path for mFrameCount frames and write timings as JSON
+std::string mBenchmarkPath;
+std::string mCameraPathFile;
+std::string mRecordPathFile;
+// GPU/CPU scope profiling, written as a Chrome trace on exit (--gpu-profile)
+std::string mGpuProfilePath;
+GpuProfiler* mProfiler = nullptr;
+// CPU trace written on exit (--trace); --microbench runs a named microbenchmark and exits
+std::string mTracePath;
+std::string mMicrobenchmark;
+// Largest screen-space error (pixels) a level of detail may introduce; 0 keeps full detail
+float mLodPixelError = 1.0f;
+// Split models into meshlets and cull them on the CPU each frame (--meshlets)
+bool mMeshlets = false;
+ClusterCullStats mClusterStats;
+// Rasterize occluder meshes into a CPU depth pyramid and skip meshes whose
+// bounds it hides (--occlusion); mOcclusion is set for the run when enabled
+bool mOcclusionCulling = false;
+OcclusionCuller* mOcclusion = nullptr;
+size_t mOcclusionTested = 0;
+size_t mOcclusionCulled = 0;
+int mOcclusionFrames = 0;
+double mOcclusionMilliseconds = 0.0;
+// Swap interval for windowed runs (0 off, 1 vsync, -1 adaptive, falling back to
+// vsync) and an optional frame rate cap enforced by sleeping (--vsync, --fps-limit)
+int mSwapInterval = 1;
+double mFrameRateLimit = 0.0;
+// Camera controls (--camera fly|orbit, orbiting the first mesh) and how many
+// seconds its orientation takes to follow the mouse (--camera-smoothing)
+Camera::Mode mCameraMode = Camera::kFly;
+float mCameraSmoothing = 0.0f;
+// Fixed-step simulation state: the first mesh's spin about Y (degrees, from
+// mSpinBase) and the camera position moved by the arrow keys in fly mode. The previous step's
+// values are kept so frames between steps can blend the two.
+glm::mat4 mSpinBase{1.0f};
+float mSpin = 0.0f;
+float mPreviousSpin = 0.0f;
+float mSpinSpeed = 0.0f;
+glm::vec3 mCameraEye{0.0f};
+glm::vec3 mPreviousCameraEye{0.0f};
+// Counters for the frame being rendered
+int mDrawCalls = 0;
+size_t mTriangleCount = 0;
 };
 
 struct Transform{
@@ -33,30 +197,55 @@ GLuint mVertexBufferObject = 0; // VBO
 //Index Buffer Object
 //To store the array of indices that we want to draw from when we do indexed drawing.
 GLuint mIndexBufferObject = 0;
+// Positions alone (12 of the 32 bytes a vertex) and a VAO over them and the
+// index buffer, for the depth pre-pass
+GLuint mPositionBufferObject = 0;
+GLuint mDepthVertexArrayObject = 0;
 GLuint mPipeline = 0;
+const MeshUniforms* mUniforms = nullptr;
 Transform mTransform;
+// CPU-side copy of the interleaved x,y,z,r,g,b,u,v vertices
+// (OBJLoader::kVertexStreamFloats floats each) and indices. Read by the upload,
+// the depth pre-pass position stream, the bounds, the occlusion culler and the
+// software rasterizer.
+std::vector<GLfloat> mVertexData;
+std::vector<GLuint> mIndexData;
+// Levels of detail as ranges of mIndexData (empty: draw all of it), the
+// bounding sphere they are selected with, and the level picked for this frame
+std::vector<LodLevel> mLods;
+glm::vec3 mBoundsCenter{0.0f};
+float mBoundsRadius = 0.0f;
+int mLod = 0;
+// Object-space bounding box, and whether the mesh is drawn into the occlusion buffer
+glm::vec3 mBoundsMin{0.0f};
+glm::vec3 mBoundsMax{0.0f};
+bool mOccluder = false;
+// Meshlets of every level (level i owns [mLodMeshletStart[i], mLodMeshletStart[i + 1]))
+std::vector<Meshlet> mMeshlets;
+std::vector<unsigned int> mLodMeshletStart;
+// Index runs to draw this frame, filled by MeshPrepareDraw
+std::vector<GLsizei> mDrawCounts;
+std::vector<unsigned int> mDrawFirst;
+// TextureStreamer handle, -1 for vertex colours only
+int mTexture = -1;
 // float m_uOffset = -2.0f;
 // float m_uRotate = 0.0f;
 // float m_uScale = 0.5f;
 
 };
 App gApp;
+// Simulation rate, and how fast the first mesh spins up and the camera moves.
+const double kSimulationStep = 1.0 / 60.0;
+const float kSpinAcceleration = 180.0f; // degrees per second squared
+const float kCameraSpeed = 0.6f;        // units per second
+const float kCameraRollSpeed = 1.5f;    // radians per second
+// Direction the sunlight travels: down and away from the camera, so the first
+// mesh shadows the second.
+const glm::vec3 kSunDirection(0.15f, -0.2f, -1.0f);
 Mesh3D gMesh1;
 Mesh3D gMesh2;
-static void GLClearAllErrors(){
-    while(glGetError() != GL_NO_ERROR){
-
-    }
-}
-static bool GLCheckErrorStatus(const char* function, int line){
-    while (GLenum error = glGetError()){
-        std::cout<<"OpenGL error"<<error<<"\tLine: "<<line<<"\tfunction: "<<function<<std::endl;
-        return true;
-    }
-    return false;
-}
-#define GLCheck(x) GLClearAllErrors(); x; GLCheckErrorStatus(#x,__LINE__);
-//^^^^^^^^^^^^^^^Error Handling Routines^^^^^^^^^^^^
+// This frame's opaque meshes in the order they are drawn
+std::vector<Mesh3D*> gDrawOrder;
 std::string LoadShaderAsString(const std::string& filename){
     std::string result = "";
     std::string line = "";
@@ -77,61 +266,141 @@ void PrintHWInfo() {
 	std::cout << glGetString(GL_SHADING_LANGUAGE_VERSION) << std::endl;
 }
 
-void MeshCreate(Mesh3D* mesh) {
-	// generate and bind VAO
-	const std::vector<GLfloat> vertexData{ // lives on CPU
+void MeshLoadQuad(Mesh3D* mesh) {
+	mesh->mVertexData = { // lives on CPU
 		// x    y     z
 		-0.5f, -0.5f, 0.0f, // left vertex 1
         1.0f, 0.0f, 0.0f, // Red for vertex 1
+        0.0f, 0.0f, // u, v
 		0.5f, -0.5f, 0.0f, // right vertex 2
         0.0f, 1.0f, 0.0f, // Green for vertex 2
+        1.0f, 0.0f,
 		-0.5f, 0.5f, 0.0f, // top left vertex 3
         0.0f, 0.0f, 1.0f, // Blue for vertex 3
+        0.0f, 1.0f,
         
         // 0.5f, -0.5f, 0.0f, // right vertex 1
         // 0.0f, 1.0f, 0.0f, // Red for vertex 1
 		0.5f, 0.5f, 0.0f, // top right vertex 2
         0.0f, 0.0f, 1.0f, // Green for vertex 2
+        1.0f, 1.0f,
 		// -0.5f, 0.5f, 0.0f, // left vertex 3
         // 0.0f, 0.0f, 1.0f // Blue for vertex 3
 	};
-	glGenVertexArrays(1, &mesh->mVertexArrayObject); // start sending to GPU
-	glBindVertexArray(mesh->mVertexArrayObject);
+    mesh->mIndexData = {
+        2,0,1,3,2,1
+    };
+}
+
+bool MeshLoadOBJ(Mesh3D* mesh, const std::string& filepath) {
+	OBJLoadOptions options;
+	options.smoothingAngle = gApp.mSmoothingAngle;
+	Mesh model = OBJLoader::LoadOBJ(filepath, options);
+	if (model.indices.empty()) {
+		return false;
+	}
+	static const std::vector<float> kLodRatios = { 1.0f, 0.5f, 0.25f, 0.125f, 0.0625f };
+	LodChain chain = MeshSimplifier::BuildLodChain(model, kLodRatios);
+	mesh->mVertexData = OBJLoader::BuildVertexStream(chain.mMesh);
+	mesh->mIndexData = std::move(chain.mMesh.indices);
+	mesh->mLods = std::move(chain.mLevels);
+	mesh->mBoundsCenter = chain.mCenter;
+	mesh->mBoundsRadius = chain.mRadius;
+	if (gApp.mMeshlets){
+		for (const LodLevel& level : mesh->mLods){
+			mesh->mLodMeshletStart.push_back((unsigned int)mesh->mMeshlets.size());
+			MeshletBuilder::Build(chain.mMesh.vertices, mesh->mIndexData.data() + level.mIndexOffset, level.mIndexCount,
+			                      level.mIndexOffset, mesh->mMeshlets);
+		}
+		mesh->mLodMeshletStart.push_back((unsigned int)mesh->mMeshlets.size());
+		std::cout << "Meshlets: " << mesh->mMeshlets.size() << " across " << mesh->mLods.size() << " levels" << std::endl;
+	}
+	for (size_t i = 0; i < mesh->mLods.size(); i++){
+		std::cout << "LOD " << i << ": " << mesh->mLods[i].mIndexCount / 3 << " triangles" << std::endl;
+	}
+	return true;
+}
 
-	// Setup position buffer (attribute 0)
+// Creates and fills the vertex and index buffers. Buffers are shared between
+// contexts, so this may run on the upload thread.
+void MeshUploadBuffers(Mesh3D* mesh) {
+	const std::vector<GLfloat>& vertexData = mesh->mVertexData;
 	glGenBuffers(1, &mesh->mVertexBufferObject);
 	glBindBuffer(GL_ARRAY_BUFFER, mesh->mVertexBufferObject);
 	glBufferData(GL_ARRAY_BUFFER, vertexData.size() * sizeof(GLfloat), vertexData.data(), GL_STATIC_DRAW);
-    
-    const std::vector<GLuint> indexBufferData {
-        2,0,1,3,2,1
-    };
-    glGenBuffers(1,&mesh->mIndexBufferObject);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->mIndexBufferObject);
-    //Populate our Index Buffer
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBufferData.size()*sizeof(GLuint), indexBufferData.data(),GL_STATIC_DRAW);
 
+	// Filled through GL_ARRAY_BUFFER: the element binding belongs to a VAO,
+	// which may not exist in this context.
+	const std::vector<GLuint>& indexBufferData = mesh->mIndexData;
+	glGenBuffers(1,&mesh->mIndexBufferObject);
+	glBindBuffer(GL_ARRAY_BUFFER, mesh->mIndexBufferObject);
+	glBufferData(GL_ARRAY_BUFFER, indexBufferData.size()*sizeof(GLuint), indexBufferData.data(),GL_STATIC_DRAW);
+
+	if (gApp.mRenderPath == kRenderDepthPrepass){
+		std::vector<GLfloat> positions;
+		positions.reserve(vertexData.size() / OBJLoader::kVertexStreamFloats * 3);
+		for (size_t i = 0; i + 2 < vertexData.size(); i += OBJLoader::kVertexStreamFloats){
+			positions.insert(positions.end(), { vertexData[i], vertexData[i + 1], vertexData[i + 2] });
+		}
+		glGenBuffers(1, &mesh->mPositionBufferObject);
+		glBindBuffer(GL_ARRAY_BUFFER, mesh->mPositionBufferObject);
+		glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(GLfloat), positions.data(), GL_STATIC_DRAW);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+// Vertex array objects are not shared between contexts; this runs in the one that draws.
+void MeshCreateVertexArray(Mesh3D* mesh) {
+	// generate and bind VAO
+	glGenVertexArrays(1, &mesh->mVertexArrayObject); // start sending to GPU
+	glBindVertexArray(mesh->mVertexArrayObject);
+	glBindBuffer(GL_ARRAY_BUFFER, mesh->mVertexBufferObject);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->mIndexBufferObject);
+
+	const GLsizei stride = sizeof(GL_FLOAT)*OBJLoader::kVertexStreamFloats;
 	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(GL_FLOAT)*6, (void*)0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
     
     // Setup color buffer (attribute 1)
     glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(GL_FLOAT)*6, (GLvoid*)(sizeof(GL_FLOAT)*3));
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (GLvoid*)(sizeof(GL_FLOAT)*3));
+
+    // Texture coordinates (attribute 2)
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (GLvoid*)(sizeof(GL_FLOAT)*6));
 
     // std::cout << "Color array size: " << vertexColor.size() << std::endl;
 
 	glBindVertexArray(0);
 	glDisableVertexAttribArray(0);
     glDisableVertexAttribArray(1);
+    glDisableVertexAttribArray(2);
+
+	if (mesh->mPositionBufferObject != 0){
+		glGenVertexArrays(1, &mesh->mDepthVertexArrayObject);
+		glBindVertexArray(mesh->mDepthVertexArrayObject);
+		glBindBuffer(GL_ARRAY_BUFFER, mesh->mPositionBufferObject);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->mIndexBufferObject);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 3, (void*)0);
+		glBindVertexArray(0);
+	}
+}
+void MeshCreate(Mesh3D* mesh) {
+	MeshUploadBuffers(mesh);
+	MeshCreateVertexArray(mesh);
 }
 
 void MeshDelete(Mesh3D* mesh){
 	glDeleteBuffers(1,&mesh->mVertexBufferObject);
+	glDeleteBuffers(1,&mesh->mIndexBufferObject);
 	glDeleteVertexArrays(1,&mesh->mVertexArrayObject);
+	glDeleteBuffers(1,&mesh->mPositionBufferObject);
+	glDeleteVertexArrays(1,&mesh->mDepthVertexArrayObject);
 
 }
-void MeshSetPipeline(Mesh3D* mesh, GLuint pipeline){
+void MeshSetPipeline(Mesh3D* mesh, GLuint pipeline, const MeshUniforms* uniforms){
 	mesh->mPipeline = pipeline;
+	mesh->mUniforms = uniforms;
 }
 
 GLuint CompileShader(GLuint type, const std::string& source) {
@@ -177,6 +446,37 @@ GLuint CreateShaderProgram(const std::string& VertexShaderSource, const std::str
     glValidateProgram(programObject);
 	return programObject;
 }
+int FindUniformLocation(GLuint pipeline, const GLchar* name){
+	GLint location = glGetUniformLocation(pipeline, name);
+	if (location >= 0){
+		return location;
+	} else {
+		std::cerr<<"could not find "<<name<<std::endl;
+		exit(EXIT_FAILURE);
+	}
+}
+// The transform uniforms of a freshly linked mesh program and, when it shades,
+// the rest of frag.glsl's, so drawing never looks a name up.
+MeshUniforms FindMeshUniforms(GLuint pipeline, bool shading){
+	MeshUniforms uniforms;
+	uniforms.mModelMatrix = FindUniformLocation(pipeline, "u_ModelMatrix");
+	uniforms.mViewMatrix = FindUniformLocation(pipeline, "u_ViewMatrix");
+	uniforms.mProjection = FindUniformLocation(pipeline, "u_Projection");
+	if (!shading){
+		return uniforms;
+	}
+	uniforms.mTexture = FindUniformLocation(pipeline, "u_Texture");
+	uniforms.mUseTexture = FindUniformLocation(pipeline, "u_UseTexture");
+	uniforms.mUseLighting = FindUniformLocation(pipeline, "u_UseLighting");
+	uniforms.mUseShadows = FindUniformLocation(pipeline, "u_UseShadows");
+	uniforms.mUsePbr = FindUniformLocation(pipeline, "u_UsePbr");
+	uniforms.mMetallic = FindUniformLocation(pipeline, "u_Metallic");
+	uniforms.mRoughness = FindUniformLocation(pipeline, "u_Roughness");
+	uniforms.mLighting = ClusteredLighting::FindUniforms(pipeline);
+	uniforms.mShadows = CascadedShadows::FindUniforms(pipeline);
+	uniforms.mEnvironment = ImageBasedLighting::FindUniforms(pipeline);
+	return uniforms;
+}
 
 void CreateGraphicsPipeline() {
     std::string vertexShaderSource = LoadShaderAsString("./shaders/vert.glsl");
@@ -186,45 +486,123 @@ void CreateGraphicsPipeline() {
     std::cout << "Fragment shader loaded: " << (fragmentShaderSource.empty() ? "FAILED" : "SUCCESS") << std::endl;
     
 	gApp.mGraphicsPipelineShaderProgram = CreateShaderProgram(vertexShaderSource, fragmentShaderSource);
+	gApp.mGraphicsPipelineUniforms = FindMeshUniforms(gApp.mGraphicsPipelineShaderProgram, true);
+	if (gApp.mRenderPath == kRenderDepthPrepass || gApp.mShadows){
+		gApp.mDepthShaderProgram = CreateShaderProgram(LoadShaderAsString("./shaders/depth_vert.glsl"),
+		                                               LoadShaderAsString("./shaders/depth_frag.glsl"));
+		gApp.mDepthUniforms = FindMeshUniforms(gApp.mDepthShaderProgram, false);
+	}
+	if (gApp.mOverdraw){
+		gApp.mOverdrawShaderProgram = CreateShaderProgram(vertexShaderSource, LoadShaderAsString("./shaders/overdraw_frag.glsl"));
+		gApp.mOverdrawUniforms = FindMeshUniforms(gApp.mOverdrawShaderProgram, false);
+	}
+	if (gApp.mPostProcessing){
+		std::string postVertexSource = LoadShaderAsString("./shaders/post_vert.glsl");
+		gApp.mPostPrograms.mDownsample = CreateShaderProgram(postVertexSource, LoadShaderAsString("./shaders/post_downsample_frag.glsl"));
+		gApp.mPostPrograms.mUpsample = CreateShaderProgram(postVertexSource, LoadShaderAsString("./shaders/post_upsample_frag.glsl"));
+		gApp.mPostPrograms.mResolve = CreateShaderProgram(postVertexSource, LoadShaderAsString("./shaders/post_resolve_frag.glsl"));
+		gApp.mPostPrograms.mFxaa = CreateShaderProgram(postVertexSource, LoadShaderAsString("./shaders/post_fxaa_frag.glsl"));
+	}
 }
-void Input(){
-	static int mouseX = gApp.mScreenWidth/2;
-	static int mouseY = gApp.mScreenHeight/2;
-SDL_Event e;
-		while (SDL_PollEvent(&e) != 0) {
-			if (e.type == SDL_QUIT) {
-				gApp.mQuit = 1;
-			} else if (e.type == SDL_MOUSEMOTION) {
-				mouseX += e.motion.xrel;
-				mouseY += e.motion.yrel;
-				gApp.mCamera.MouseLook(mouseX, mouseY);
-			}
-		}
-		// g_uRotate -= 1.0f;
-		
-		const Uint8 *state = SDL_GetKeyboardState(NULL);
-
-		float speed = 0.01f;
-		if (state[SDL_SCANCODE_UP]) {
-			gApp.mCamera.MoveForward(speed);
-			// g_uOffset+=0.01f;
-			// std::cout<<"g_uOffset: "<<g_uOffset<<std::endl;
-		}
-		if (state[SDL_SCANCODE_DOWN]){
-			gApp.mCamera.MoveBackward(speed);
-			// g_uOffset-=0.01f;
-			// std::cout<<"g_uOffset: "<<g_uOffset<<std::endl;
-		}
-		if (state[SDL_SCANCODE_LEFT]){
-			gApp.mCamera.MoveLeft(speed);
-			// g_uRotate+=0.01f;
-			// std::cout<<"g_uRotate: "<<g_uRotate<<std::endl;
+// Moves pending window events into the input buffer; headless runs have none.
+void PumpInput(){
+	if (gApp.mHeadless){
+		return;
+	}
+	SDL_Event e;
+	while (SDL_PollEvent(&e) != 0) {
+		InputEvent event;
+		event.mTime = InputSystem::Clock::now();
+		if (e.type == SDL_QUIT) {
+			event.mType = InputEvent::kQuit;
+			gApp.mInput.Push(event);
+		} else if (e.type == SDL_MOUSEMOTION) {
+			event.mX = e.motion.xrel;
+			event.mY = e.motion.yrel;
+			gApp.mInput.Push(event);
 		}
-		if (state[SDL_SCANCODE_RIGHT]){
-			gApp.mCamera.MoveRight(speed);
-			// g_uRotate-=0.01f;
-			// std::cout<<"g_uRotate: "<<g_uRotate<<std::endl;
+	}
+}
+// Turns the camera by all mouse motion that has arrived so far.
+void LatchMouseLook(){
+	TRACE_SCOPE("LatchMouseLook");
+	PumpInput();
+	int dx, dy;
+	if (gApp.mInput.TakeMotion(dx, dy)){
+		gApp.mMouseX += dx;
+		gApp.mMouseY += dy;
+		gApp.mCamera.MouseLook(gApp.mMouseX, gApp.mMouseY);
+	}
+}
+void Input(){
+	TRACE_SCOPE("Input");
+	// A 1 kHz stream of one-pixel turns, like a gaming mouse, from the first
+	// frame on so scene loading does not count.
+	if (gApp.mMeasureInputLatency){
+		gApp.mInput.StartSyntheticMotion(1000.0, 1);
+	}
+	PumpInput();
+	std::vector<InputEvent> events;
+	gApp.mInput.TakeEvents(events);
+	for (const InputEvent& event : events){
+		if (event.mType == InputEvent::kQuit){
+			gApp.mQuit = 1;
 		}
+	}
+	if (!gApp.mLateLatch){
+		LatchMouseLook();
+	}
+}
+// With --input-latency, waits for the frame to finish and stamps the motion it showed.
+void FinishInputFrame(){
+	if (!gApp.mMeasureInputLatency){
+		return;
+	}
+	if (!gApp.mSoftwareRenderer){
+		glFinish();
+	}
+	gApp.mInput.FrameCompleted();
+}
+// Moves the simulated camera by the arrow keys held down (zooming and orbiting
+// in orbit mode), rolls it with Q and E, and advances its smoothing.
+void StepCamera(float seconds){
+	bool fly = gApp.mCamera.GetMode() == Camera::kFly;
+	if (fly){
+		gApp.mPreviousCameraEye = gApp.mCameraEye;
+		gApp.mCamera.SetPosition(gApp.mCameraEye);
+	}
+	const Uint8 *state = SDL_GetKeyboardState(NULL);
+	float speed = kCameraSpeed * seconds;
+	if (state[SDL_SCANCODE_UP]) {
+		gApp.mCamera.MoveForward(speed);
+		// g_uOffset+=0.01f;
+		// std::cout<<"g_uOffset: "<<g_uOffset<<std::endl;
+	}
+	if (state[SDL_SCANCODE_DOWN]){
+		gApp.mCamera.MoveBackward(speed);
+		// g_uOffset-=0.01f;
+		// std::cout<<"g_uOffset: "<<g_uOffset<<std::endl;
+	}
+	if (state[SDL_SCANCODE_LEFT]){
+		gApp.mCamera.MoveLeft(speed);
+		// g_uRotate+=0.01f;
+		// std::cout<<"g_uRotate: "<<g_uRotate<<std::endl;
+	}
+	if (state[SDL_SCANCODE_RIGHT]){
+		gApp.mCamera.MoveRight(speed);
+		// g_uRotate-=0.01f;
+		// std::cout<<"g_uRotate: "<<g_uRotate<<std::endl;
+	}
+	if (state[SDL_SCANCODE_Q]){
+		gApp.mCamera.Roll(-kCameraRollSpeed * seconds);
+	}
+	if (state[SDL_SCANCODE_E]){
+		gApp.mCamera.Roll(kCameraRollSpeed * seconds);
+	}
+	gApp.mCamera.Update(seconds);
+	if (fly){
+		gApp.mCameraEye = gApp.mCamera.GetPosition();
+	}
 }
 void MeshUpdate(Mesh3D* mesh) {
 	// glDisable(GL_DEPTH_TEST);
@@ -237,42 +615,179 @@ void MeshUpdate(Mesh3D* mesh) {
 
 }
 
-int FindUniformLocation(GLuint pipeline, const GLchar* name){
-	GLint location = glGetUniformLocation(pipeline, name);
-	if (location >= 0){
-		return location;
+// Reverse-Z: depth 1 at the near plane falling to 0 at infinity, tested with
+// GL_GREATER against a buffer cleared to 0.
+void SetUpReverseDepth(){
+	gApp.mClipControl = GLAD_GL_ARB_clip_control != 0;
+	if (gApp.mClipControl){
+		glClipControl(GL_LOWER_LEFT, GL_ZERO_TO_ONE);
 	} else {
-		std::cerr<<"could not find "<<name<<std::endl;
-		exit(EXIT_FAILURE);
+		std::cout << "glClipControl is not available: reverse-Z depth goes through the -1..1 clip range" << std::endl;
 	}
+	glClearDepth(0.0);
+	glDepthFunc(GL_GREATER);
 }
-
-void MeshDraw(Mesh3D* mesh) {
-	if (mesh == nullptr){
+// A 0..w clip depth projection as GL wants it: without clip control, clip z is
+// remapped to -w..w (z' = 2z - w), which GL maps back to the same depth.
+glm::mat4 ToGLClipSpace(const glm::mat4& projection){
+	if (gApp.mClipControl){
+		return projection;
+	}
+	glm::mat4 remap(1.0f);
+	remap[2][2] = 2.0f;
+	remap[3][2] = -1.0f;
+	return remap * projection;
+}
+glm::mat4 GetGLProjectionMatrix(){
+	return ToGLClipSpace(gApp.mCamera.GetProjectionMatrix());
+}
+// Picks the level of detail and, with meshlets, the clusters that survive
+// culling; leaves the index runs to draw in mDrawFirst/mDrawCounts.
+void MeshPrepareDraw(Mesh3D* mesh){
+	mesh->mDrawFirst.clear();
+	mesh->mDrawCounts.clear();
+	if (mesh->mLods.empty()){
+		mesh->mDrawFirst.push_back(0);
+		mesh->mDrawCounts.push_back((GLsizei)mesh->mIndexData.size());
+		return;
+	}
+	const glm::mat4& model = mesh->mTransform.mModelMatrix;
+	glm::vec3 worldCenter = glm::vec3(model * glm::vec4(mesh->mBoundsCenter, 1.0f));
+	float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+	mesh->mLod = MeshSimplifier::SelectLod(mesh->mLods, gApp.mCamera, worldCenter, mesh->mBoundsRadius * scale,
+	                                       (float)gApp.mScreenHeight, gApp.mLodPixelError);
+	if (mesh->mMeshlets.empty()){
+		const LodLevel& level = mesh->mLods[mesh->mLod];
+		mesh->mDrawFirst.push_back(level.mIndexOffset);
+		mesh->mDrawCounts.push_back((GLsizei)level.mIndexCount);
 		return;
 	}
-	glUseProgram(mesh->mPipeline);
-	
-	GLuint u_ModelMatrixLocation = FindUniformLocation(gApp.mGraphicsPipelineShaderProgram, "u_ModelMatrix");
-	glUniformMatrix4fv(u_ModelMatrixLocation,1,GL_FALSE,&mesh->mTransform.mModelMatrix[0][0]);
+	glm::mat4 modelViewProjection = gApp.mCamera.GetProjectionMatrix() * gApp.mCamera.GetViewMatrix() * model;
+	glm::vec3 eye = glm::vec3(glm::inverse(model) * glm::vec4(gApp.mCamera.GetPosition(), 1.0f));
+	unsigned int firstMeshlet = mesh->mLodMeshletStart[mesh->mLod];
+	unsigned int meshletCount = mesh->mLodMeshletStart[mesh->mLod + 1] - firstMeshlet;
+	std::vector<unsigned int> indexCounts;
+	ClusterCuller::Cull(&mesh->mMeshlets[firstMeshlet], meshletCount, modelViewProjection, eye,
+	                    mesh->mDrawFirst, indexCounts, &gApp.mClusterStats);
+	mesh->mDrawCounts.assign(indexCounts.begin(), indexCounts.end());
+}
+// Draws the occluders into the CPU depth pyramid from this frame's camera and
+// empties the draw ranges of every other mesh whose bounding box it hides.
+void CullOccludedMeshes(){
+	if (gApp.mOcclusion == nullptr){
+		return;
+	}
+	TRACE_SCOPE("CullOccludedMeshes");
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	Mesh3D* meshes[] = { &gMesh1, &gMesh2 };
+	gApp.mOcclusion->Begin(gApp.mCamera.GetProjectionMatrix() * gApp.mCamera.GetViewMatrix());
+	for (Mesh3D* mesh : meshes){
+		if (!mesh->mOccluder){
+			continue;
+		}
+		// Always the full-detail level, so the occluder never shrinks with distance.
+		size_t first = mesh->mLods.empty() ? 0 : mesh->mLods[0].mIndexOffset;
+		size_t count = mesh->mLods.empty() ? mesh->mIndexData.size() : mesh->mLods[0].mIndexCount;
+		gApp.mOcclusion->RenderOccluder(mesh->mVertexData.data(), OBJLoader::kVertexStreamFloats, mesh->mIndexData.data() + first, count,
+		                                mesh->mTransform.mModelMatrix);
+	}
+	gApp.mOcclusion->BuildPyramid();
+	for (Mesh3D* mesh : meshes){
+		if (mesh->mOccluder){
+			continue;
+		}
+		gApp.mOcclusionTested++;
+		if (gApp.mOcclusion->TestBox(mesh->mBoundsMin, mesh->mBoundsMax, mesh->mTransform.mModelMatrix) != OcclusionCuller::kVisible){
+			mesh->mDrawFirst.clear();
+			mesh->mDrawCounts.clear();
+			gApp.mOcclusionCulled++;
+		}
+	}
+	gApp.mOcclusionFrames++;
+	gApp.mOcclusionMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+// Model, view and projection uniforms, which every mesh program declares.
+void SetTransformUniforms(const MeshUniforms& uniforms, Mesh3D* mesh){
+	glUniformMatrix4fv(uniforms.mModelMatrix,1,GL_FALSE,&mesh->mTransform.mModelMatrix[0][0]);
 
 	//View Matrix
 	glm::mat4 view = gApp.mCamera.GetViewMatrix();
-	GLint u_ViewLocation = FindUniformLocation(gApp.mGraphicsPipelineShaderProgram,"u_ViewMatrix");
-	glUniformMatrix4fv(u_ViewLocation,1,GL_FALSE,&view[0][0]);
+	glUniformMatrix4fv(uniforms.mViewMatrix,1,GL_FALSE,&view[0][0]);
 
 	//Projection matrix
-	glm::mat4 perspective = gApp.mCamera.GetProjectionMatrix();
+	glm::mat4 perspective = GetGLProjectionMatrix();
 	// glm::mat4 perspective = glm::perspective(glm::radians(45.0f),(float)gApp.mScreenWidth/(float)gApp.mScreenHeight,
 											// 0.1f,
 											// 10.0f);
-	GLint u_ProjectionLocation = FindUniformLocation(gApp.mGraphicsPipelineShaderProgram,"u_Projection");
-	glUniformMatrix4fv(u_ProjectionLocation,1,GL_FALSE,&perspective[0][0]);
+	glUniformMatrix4fv(uniforms.mProjection,1,GL_FALSE,&perspective[0][0]);
+}
+// Draws the index runs MeshPrepareDraw left with the bound program and vertex array.
+void MeshDrawRanges(Mesh3D* mesh){
+	std::vector<const void*> offsets(mesh->mDrawFirst.size());
+	for (size_t i = 0; i < offsets.size(); i++){
+		offsets[i] = (const void*)(mesh->mDrawFirst[i] * sizeof(GLuint));
+		gApp.mTriangleCount += mesh->mDrawCounts[i] / 3;
+	}
+    GLCheck(glMultiDrawElements(GL_TRIANGLES, mesh->mDrawCounts.data(), GL_UNSIGNED_INT, offsets.data(), (GLsizei)offsets.size()));
+	gApp.mDrawCalls++;
+}
+void MeshDraw(Mesh3D* mesh) {
+	if (mesh == nullptr){
+		return;
+	}
+	TRACE_SCOPE("MeshDraw");
+	GLuint pipeline = gApp.mOverdraw ? gApp.mOverdrawShaderProgram : mesh->mPipeline;
+	const MeshUniforms& uniforms = gApp.mOverdraw ? gApp.mOverdrawUniforms : *mesh->mUniforms;
+	glUseProgram(pipeline);
+	SetTransformUniforms(uniforms, mesh);
+
+	if (!gApp.mOverdraw){
+		// Vertex colours until the texture's mip tail is resident.
+		GLuint texture = mesh->mTexture >= 0 ? gApp.mTextures->GetTexture(mesh->mTexture) : 0;
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glUniform1i(uniforms.mTexture, 0);
+		glUniform1i(uniforms.mUseTexture, texture != 0);
+		// Light buffers on units 1-3; the samplers need units of their own even when unused.
+		if (gApp.mLighting != nullptr){
+			gApp.mLighting->Bind(uniforms.mLighting, 1, gApp.mScreenWidth, gApp.mScreenHeight);
+		} else {
+			for (int i = 0; i < 3; i++){
+				glUniform1i(uniforms.mLighting.mSamplers[i], 1 + i);
+			}
+		}
+		glUniform1i(uniforms.mUseLighting, gApp.mLighting != nullptr);
+		if (gApp.mShadowMaps != nullptr){
+			gApp.mShadowMaps->Bind(uniforms.mShadows, 4, gApp.mCamera.GetViewMatrix());
+		} else {
+			glUniform1i(uniforms.mShadows.mShadowMap, 4);
+		}
+		glUniform1i(uniforms.mUseShadows, gApp.mShadowMaps != nullptr);
+		if (gApp.mEnvironment != nullptr){
+			gApp.mEnvironment->Bind(uniforms.mEnvironment, 5, gApp.mCamera.GetViewMatrix());
+		} else {
+			for (int i = 0; i < 3; i++){
+				glUniform1i(uniforms.mEnvironment.mSamplers[i], 5 + i);
+			}
+		}
+		glUniform1i(uniforms.mUsePbr, gApp.mEnvironment != nullptr);
+		glUniform1f(uniforms.mMetallic, gApp.mMetallic);
+		glUniform1f(uniforms.mRoughness, gApp.mRoughness);
+	}
 
-	GLCheck(glBindVertexArray(mesh->mVertexArrayObject);)
-	// GLCheck(glBindBuffer(GL_ARRAY_BUFFER, gVertexBufferObject);)
+	GLCheck(glBindVertexArray(mesh->mVertexArrayObject));
+	// GLCheck(glBindBuffer(GL_ARRAY_BUFFER, gVertexBufferObject));
 	// glDrawArrays(GL_TRIANGLES, 0, 6);
-    GLCheck(glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT,0);)
+	MeshDrawRanges(mesh);
+	glUseProgram(0);
+}
+// Depth only, from the position stream.
+void MeshDrawDepth(Mesh3D* mesh){
+	TRACE_SCOPE("MeshDrawDepth");
+	glUseProgram(gApp.mDepthShaderProgram);
+	SetTransformUniforms(gApp.mDepthUniforms, mesh);
+	GLCheck(glBindVertexArray(mesh->mDepthVertexArrayObject));
+	MeshDrawRanges(mesh);
 	glUseProgram(0);
 }
 
@@ -293,19 +808,877 @@ void MeshScale(Mesh3D* mesh, float x, float y, float z)
 // 	model = glm::rotate(model, glm::radians(mesh->m_uRotate), glm::vec3(0.0f,1.0f,0.0f));
 // 	model = glm::scale(model, glm::vec3(mesh->m_uScale, mesh->m_uScale, mesh->m_uScale));
 // }
+// Asks for each textured mesh's texture at its projected size (texture coordinates
+// are taken to span the mesh once) and lets the streamer update residency.
+void StreamTextures(){
+	if (gApp.mTextures == nullptr){
+		return;
+	}
+	const glm::mat4& projection = gApp.mCamera.GetProjectionMatrix();
+	Mesh3D* meshes[] = { &gMesh1, &gMesh2 };
+	for (Mesh3D* mesh : meshes){
+		if (mesh->mTexture < 0 || mesh->mDrawCounts.empty()){
+			continue;
+		}
+		const glm::mat4& model = mesh->mTransform.mModelMatrix;
+		glm::vec3 center = glm::vec3(model * glm::vec4((mesh->mBoundsMin + mesh->mBoundsMax) * 0.5f, 1.0f));
+		float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+		float radius = glm::length(mesh->mBoundsMax - mesh->mBoundsMin) * 0.5f * scale;
+		float distance = std::max(glm::length(center - gApp.mCamera.GetPosition()) - radius, 0.1f);
+		gApp.mTextures->RequestPixels(mesh->mTexture, radius * projection[1][1] * gApp.mScreenHeight / distance);
+	}
+	gApp.mTextures->Update();
+}
+// Front to back by the view depth of each mesh's bounds centre, so depth testing
+// rejects what nearer meshes hide before it is shaded. Unordered keeps submission order.
+void SortOpaqueMeshes(){
+	gDrawOrder = { &gMesh1, &gMesh2 };
+	if (gApp.mRenderPath == kRenderUnordered){
+		return;
+	}
+	glm::mat4 view = gApp.mCamera.GetViewMatrix();
+	std::vector<std::pair<float, Mesh3D*>> keyed;
+	for (Mesh3D* mesh : gDrawOrder){
+		glm::vec3 center = (mesh->mBoundsMin + mesh->mBoundsMax) * 0.5f;
+		float depth = -(view * mesh->mTransform.mModelMatrix * glm::vec4(center, 1.0f)).z;
+		keyed.push_back(std::make_pair(depth, mesh));
+	}
+	std::stable_sort(keyed.begin(), keyed.end(),
+	                 [](const std::pair<float, Mesh3D*>& a, const std::pair<float, Mesh3D*>& b){ return a.first < b.first; });
+	for (size_t i = 0; i < keyed.size(); i++){
+		gDrawOrder[i] = keyed[i].second;
+	}
+}
+// One fixed step of the simulation. Headless runs follow their camera path
+// instead of the keyboard.
+void StepSimulation(float seconds){
+	gApp.mPreviousSpin = gApp.mSpin;
+	gApp.mSpinSpeed += kSpinAcceleration * seconds;
+	gApp.mSpin += gApp.mSpinSpeed * seconds;
+	if (gApp.mSpin >= 360.0f){
+		gApp.mSpin -= 360.0f;
+		gApp.mPreviousSpin -= 360.0f;
+	}
+	if (!gApp.mHeadless){
+		StepCamera(seconds);
+	}
+}
+// Places the scene alpha of the way from the previous simulation step to the last one.
+void ApplySimulationState(float alpha){
+	float spin = gApp.mPreviousSpin + (gApp.mSpin - gApp.mPreviousSpin) * alpha;
+	gMesh1.mTransform.mModelMatrix = glm::rotate(gApp.mSpinBase, glm::radians(spin), glm::vec3(0.0f,1.0f,0.0f));
+	if (!gApp.mHeadless && gApp.mCamera.GetMode() == Camera::kFly){
+		gApp.mCamera.SetPosition(glm::mix(gApp.mPreviousCameraEye, gApp.mCameraEye, alpha));
+	}
+}
+// Runs steps fixed simulation steps, then prepares the frame alpha of a step
+// past the last of them.
+void UpdateScene(int steps, float alpha){
+	TRACE_SCOPE("UpdateScene");
+	if (gApp.mAssetLoader != nullptr){
+		gApp.mAssetLoader->Poll();
+	}
+	for (int i = 0; i < steps; i++){
+		StepSimulation((float)kSimulationStep);
+	}
+	ApplySimulationState(alpha);
+	MeshPrepareDraw(&gMesh1);
+	MeshPrepareDraw(&gMesh2);
+	CullOccludedMeshes();
+	SortOpaqueMeshes();
+	StreamTextures();
+}
+// Fits the cascades to this frame's view, culls the meshes against all of them
+// in one pass and draws each cascade's casters depth-only. Casters are drawn at
+// their selected level of detail whether or not the camera sees them.
+void RenderShadowMaps(){
+	if (gApp.mShadowMaps == nullptr){
+		return;
+	}
+	TRACE_SCOPE("RenderShadowMaps");
+	GpuProfileScope scope(gApp.mProfiler, "ShadowMaps");
+	CascadedShadows* shadows = gApp.mShadowMaps;
+	shadows->Update(gApp.mCamera);
+	Mesh3D* meshes[] = { &gMesh1, &gMesh2 };
+	const size_t meshCount = sizeof(meshes) / sizeof(meshes[0]);
+	glm::vec4 spheres[meshCount];
+	uint8_t masks[meshCount];
+	for (size_t i = 0; i < meshCount; i++){
+		const glm::mat4& model = meshes[i]->mTransform.mModelMatrix;
+		glm::vec3 center = glm::vec3(model * glm::vec4((meshes[i]->mBoundsMin + meshes[i]->mBoundsMax) * 0.5f, 1.0f));
+		float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+		spheres[i] = glm::vec4(center, glm::length(meshes[i]->mBoundsMax - meshes[i]->mBoundsMin) * 0.5f * scale);
+	}
+	shadows->CullCasters(spheres, meshCount, masks);
+
+	GLint framebuffer = 0;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+	glEnable(GL_DEPTH_TEST);
+	glDisable(GL_CULL_FACE);
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	// Reverse-Z: negative offsets push the casters away from the light.
+	glEnable(GL_POLYGON_OFFSET_FILL);
+	glPolygonOffset(-1.0f, -1.0f);
+	const MeshUniforms& uniforms = gApp.mDepthUniforms;
+	glUseProgram(gApp.mDepthShaderProgram);
+	glUniformMatrix4fv(uniforms.mViewMatrix, 1, GL_FALSE, &shadows->GetLightView()[0][0]);
+	for (int cascade = 0; cascade < CascadedShadows::kCascadeCount; cascade++){
+		shadows->BeginCascade(cascade);
+		glm::mat4 projection = ToGLClipSpace(shadows->GetProjection(cascade));
+		glUniformMatrix4fv(uniforms.mProjection, 1, GL_FALSE, &projection[0][0]);
+		for (size_t i = 0; i < meshCount; i++){
+			if (!(masks[i] & (1 << cascade))){
+				continue;
+			}
+			Mesh3D* mesh = meshes[i];
+			size_t first = mesh->mLods.empty() ? 0 : mesh->mLods[mesh->mLod].mIndexOffset;
+			size_t count = mesh->mLods.empty() ? mesh->mIndexData.size() : mesh->mLods[mesh->mLod].mIndexCount;
+			glUniformMatrix4fv(uniforms.mModelMatrix, 1, GL_FALSE, &mesh->mTransform.mModelMatrix[0][0]);
+			glBindVertexArray(mesh->mVertexArrayObject);
+			glDrawElements(GL_TRIANGLES, (GLsizei)count, GL_UNSIGNED_INT, (const void*)(first * sizeof(GLuint)));
+			gApp.mTriangleCount += count / 3;
+			gApp.mDrawCalls++;
+		}
+	}
+	glUseProgram(0);
+	glDisable(GL_POLYGON_OFFSET_FILL);
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+}
+// Clears and draws the meshes to the bound framebuffer.
+void DrawScene(){
+	{
+		GpuProfileScope scope(gApp.mProfiler, "Clear");
+		if (gApp.mRenderPath == kRenderUnordered){
+			glDisable(GL_DEPTH_TEST);
+			glDisable(GL_CULL_FACE);
+		} else {
+			glEnable(GL_DEPTH_TEST);
+			glEnable(GL_CULL_FACE);
+		}
+		glViewport(0, 0, gApp.mScreenWidth, gApp.mScreenHeight);
+		if (gApp.mOverdraw){
+			glClearColor(0.f, 0.f, 0.f, 0.f);
+		} else {
+			glClearColor(1.f, 1.f, 0.f, 1.f);
+		}
+		glDepthMask(GL_TRUE);
+
+		glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
+	}
+
+	// MeshUpdate(&gMesh1);
+	// MeshUpdate(&gMesh2);
+	if (gApp.mRenderPath == kRenderDepthPrepass){
+		GpuProfileScope scope(gApp.mProfiler, "DepthPrepass");
+		glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+		for (Mesh3D* mesh : gDrawOrder){
+			MeshDrawDepth(mesh);
+		}
+		// Only the fragment that wrote the depth passes; nothing is written twice.
+		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+		glDepthFunc(GL_EQUAL);
+		glDepthMask(GL_FALSE);
+	}
+	if (gApp.mOverdraw){
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_ONE, GL_ONE);
+	}
+	{
+		GpuProfileScope scope(gApp.mProfiler, "MeshDraw");
+		for (Mesh3D* mesh : gDrawOrder){
+			MeshDraw(mesh);
+		}
+	}
+	glDisable(GL_BLEND);
+	glDepthFunc(GL_GREATER);
+	glDepthMask(GL_TRUE);
+}
+void RenderFrame(){
+	TRACE_SCOPE("RenderFrame");
+	gApp.mDrawCalls = 0;
+	gApp.mTriangleCount = 0;
+	// Culling and level selection in UpdateScene used the view from the start
+	// of the frame; the turn since then is small enough for their margins.
+	if (gApp.mLateLatch){
+		LatchMouseLook();
+	}
+	if (gApp.mLighting != nullptr){
+		// The light lists are in view space.
+		gApp.mLighting->Build(gApp.mCamera, gApp.mLights);
+		gApp.mLighting->Upload();
+	}
+	RenderShadowMaps();
+	if (gApp.mPostProcess != nullptr){
+		// The scene goes to a target of the chain, the result to what is bound now.
+		GLint output = 0;
+		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &output);
+		GpuProfileScope scope(gApp.mProfiler, "PostProcess");
+		gApp.mPostProcess->Render(output, gApp.mScreenWidth, gApp.mScreenHeight, DrawScene);
+	} else {
+		DrawScene();
+	}
+}
+// Same frame as RenderFrame() through the CPU rasterizer, with matching state.
+void RenderFrameSoftware(SoftwareRasterizer* rasterizer){
+	TRACE_SCOPE("RenderFrameSoftware");
+	gApp.mDrawCalls = 0;
+	gApp.mTriangleCount = 0;
+	rasterizer->SetDepthTest(gApp.mRenderPath != kRenderUnordered);
+	rasterizer->SetCullBackFaces(gApp.mRenderPath != kRenderUnordered);
+	rasterizer->Clear(glm::vec4(1.f, 1.f, 0.f, 1.f), 0.0f);
+	if (gApp.mLateLatch){
+		LatchMouseLook();
+	}
+	glm::mat4 viewProjection = gApp.mCamera.GetProjectionMatrix() * gApp.mCamera.GetViewMatrix();
+	for (Mesh3D* mesh : gDrawOrder){
+		glm::mat4 modelViewProjection = viewProjection * mesh->mTransform.mModelMatrix;
+		for (size_t i = 0; i < mesh->mDrawFirst.size(); i++){
+			rasterizer->DrawIndexed(mesh->mVertexData.data(), OBJLoader::kVertexStreamFloats,
+			                        mesh->mVertexData.size() / OBJLoader::kVertexStreamFloats,
+			                        mesh->mIndexData.data() + mesh->mDrawFirst[i], mesh->mDrawCounts[i], modelViewProjection);
+			gApp.mTriangleCount += mesh->mDrawCounts[i] / 3;
+		}
+		gApp.mDrawCalls++;
+	}
+}
+void MeshComputeBounds(Mesh3D* mesh){
+	for (size_t i = 0; i + 2 < mesh->mVertexData.size(); i += OBJLoader::kVertexStreamFloats){
+		glm::vec3 position(mesh->mVertexData[i], mesh->mVertexData[i + 1], mesh->mVertexData[i + 2]);
+		mesh->mBoundsMin = i == 0 ? position : glm::min(mesh->mBoundsMin, position);
+		mesh->mBoundsMax = i == 0 ? position : glm::max(mesh->mBoundsMax, position);
+	}
+}
+double MillisecondsSinceStart(){
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - gApp.mStartTime).count();
+}
+// Call once a frame has been presented; reports how long the first one took.
+void CountFrame(){
+	if (gApp.mFramesRendered++ == 0){
+		std::cout << "First frame after " << MillisecondsSinceStart() << " ms" << std::endl;
+	}
+}
+// Swaps a model loaded in the background in for the placeholder, keeping the
+// placeholder's transform.
+void PublishModel(Mesh3D* loaded){
+	glm::mat4 modelMatrix = gMesh1.mTransform.mModelMatrix;
+	int texture = gMesh1.mTexture;
+	if (!gApp.mSoftwareRenderer){
+		MeshDelete(&gMesh1);
+	}
+	gMesh1 = std::move(*loaded);
+	gMesh1.mTransform.mModelMatrix = modelMatrix;
+	gMesh1.mTexture = texture;
+	gMesh1.mOccluder = true;
+	MeshComputeBounds(&gMesh1);
+	if (!gApp.mSoftwareRenderer){
+		MeshCreateVertexArray(&gMesh1);
+		MeshSetPipeline(&gMesh1, gApp.mGraphicsPipelineShaderProgram, &gApp.mGraphicsPipelineUniforms);
+	}
+	std::cout << "Model ready after " << MillisecondsSinceStart() << " ms (frame " << gApp.mFramesRendered << ")" << std::endl;
+}
+void RequestModel(){
+	std::shared_ptr<Mesh3D> loaded = std::make_shared<Mesh3D>();
+	std::string path = gApp.mModelPath;
+	AssetLoader::Job job;
+	job.mParse = [loaded, path](){ return MeshLoadOBJ(loaded.get(), path); };
+	if (!gApp.mSoftwareRenderer){
+		job.mUpload = [loaded](){ MeshUploadBuffers(loaded.get()); };
+	}
+	job.mPublish = [loaded](){ PublishModel(loaded.get()); };
+	gApp.mAssetLoader->Load(job);
+}
+void LoadSceneGeometry(){
+	// The model, when there is one, is the scene's only occluder.
+	if (!gApp.mModelPath.empty() && gApp.mAssetLoader != nullptr){
+		// Placeholder until the model is published.
+		MeshLoadQuad(&gMesh1);
+		RequestModel();
+	} else if (gApp.mModelPath.empty() || !MeshLoadOBJ(&gMesh1, gApp.mModelPath)){
+		MeshLoadQuad(&gMesh1);
+	} else {
+		gMesh1.mOccluder = true;
+	}
+	MeshTranslate(&gMesh1,0.0f, 0.0f, -2.0f);
+	gApp.mSpinBase = gMesh1.mTransform.mModelMatrix;
+	MeshLoadQuad(&gMesh2);
+	MeshTranslate(&gMesh2,0.0f, 0.0f, -4.0f);
+	MeshComputeBounds(&gMesh1);
+	MeshComputeBounds(&gMesh2);
+}
+// Lights of random colour in a slab between the camera and the first mesh. Up
+// to 64 they dim as they are added; past that their radii shrink instead, so
+// brightness and the length of the cluster lists stay about level.
+void PlaceLights(){
+	std::minstd_rand random(5);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	float intensity = std::min(1.0f, 48.0f / std::min(gApp.mLightCount, 64));
+	float radiusScale = std::min(1.0f, std::cbrt(64.0f / gApp.mLightCount));
+	gApp.mLights.resize(gApp.mLightCount);
+	for (PointLight& light : gApp.mLights){
+		light.mPosition = glm::vec3(4.0f * unit(random) - 2.0f, 3.0f * unit(random) - 1.5f, -0.3f - 1.2f * unit(random));
+		light.mRadius = (0.5f + 1.0f * unit(random)) * radiusScale;
+		light.mColor = glm::vec3(unit(random), unit(random), unit(random)) * intensity;
+	}
+}
+void InitializeScene(){
+	PrintHWInfo();
+	GLDebug::Install();
+	SetUpReverseDepth();
+	LoadSceneGeometry();
+	MeshCreate(&gMesh1);
+	MeshCreate(&gMesh2);
+
+	CreateGraphicsPipeline();
+	MeshSetPipeline(&gMesh1, gApp.mGraphicsPipelineShaderProgram, &gApp.mGraphicsPipelineUniforms);
+	MeshSetPipeline(&gMesh2, gApp.mGraphicsPipelineShaderProgram, &gApp.mGraphicsPipelineUniforms);
+	if (gApp.mLightCount > 0){
+		PlaceLights();
+		gApp.mLighting = new ClusteredLighting();
+		gApp.mLighting->Create();
+	}
+	if (gApp.mShadows){
+		gApp.mShadowMaps = new CascadedShadows();
+		gApp.mShadowMaps->SetLightDirection(kSunDirection);
+		if (!gApp.mShadowMaps->Create()){
+			delete gApp.mShadowMaps;
+			gApp.mShadowMaps = nullptr;
+		}
+	}
+	// Overdraw counts are read straight from the frame, untouched.
+	if (gApp.mPostProcessing && !gApp.mOverdraw){
+		gApp.mPostProcess = new PostProcessChain(gApp.mPostSettings, gApp.mPostPrograms);
+		gApp.mPostProcess->Create();
+	}
+	if (gApp.mPbr){
+		gApp.mEnvironment = new ImageBasedLighting();
+		gApp.mEnvironment->SetSunDirection(kSunDirection);
+		gApp.mEnvironment->Prepare(gApp.mTextureCache);
+		gApp.mEnvironment->Create();
+	}
+
+	if (!gApp.mTexturePath.empty()){
+		gApp.mTextures = new TextureStreamer(gApp.mTextureBudget);
+		gApp.mTextures->SetCompression(gApp.mTextureFormat, gApp.mTextureCache);
+		gMesh1.mTexture = gMesh2.mTexture = gApp.mTextures->Load(gApp.mTexturePath);
+		// Headless frames stay reproducible unless asked to load in the background.
+		if (gApp.mHeadless && !gApp.mAsyncLoad){
+			gApp.mTextures->WaitForDecodes();
+		}
+	}
+}
+void PrintCullingStats(){
+	if (gApp.mOcclusionTested > 0){
+		std::cout << "Occlusion culling: " << gApp.mOcclusionCulled << "/" << gApp.mOcclusionTested << " meshes culled, "
+		          << gApp.mOcclusionMilliseconds / gApp.mOcclusionFrames << " ms/frame" << std::endl;
+	}
+	const ClusterCullStats& stats = gApp.mClusterStats;
+	if (stats.mTriangles == 0){
+		return;
+	}
+	std::cout << "Cluster culling: " << 100.0 * stats.mBackfaceCulledTriangles / stats.mTriangles << "% of triangles backfacing, "
+	          << 100.0 * stats.mFrustumCulledTriangles / stats.mTriangles << "% outside the frustum" << std::endl;
+}
+void CleanUpScene(){
+	if (gApp.mAssetLoader != nullptr){
+		gApp.mAssetLoader->Stop();
+	}
+	MeshDelete(&gMesh1);
+	MeshDelete(&gMesh2);
+	if (gApp.mTextures != nullptr){
+		std::cout << "Textures resident: " << gApp.mTextures->GetResidentBytes() / 1024 << " KB" << std::endl;
+		gApp.mTextures->Destroy();
+		delete gApp.mTextures;
+		gApp.mTextures = nullptr;
+	}
+	if (gApp.mLighting != nullptr){
+		gApp.mLighting->Destroy();
+		delete gApp.mLighting;
+		gApp.mLighting = nullptr;
+	}
+	if (gApp.mShadowMaps != nullptr){
+		gApp.mShadowMaps->Destroy();
+		delete gApp.mShadowMaps;
+		gApp.mShadowMaps = nullptr;
+	}
+	if (gApp.mPostProcess != nullptr){
+		gApp.mPostProcess->PrintReport();
+		gApp.mPostProcess->Destroy();
+		delete gApp.mPostProcess;
+		gApp.mPostProcess = nullptr;
+	}
+	if (gApp.mEnvironment != nullptr){
+		gApp.mEnvironment->Destroy();
+		delete gApp.mEnvironment;
+		gApp.mEnvironment = nullptr;
+	}
+	glDeleteProgram(gApp.mGraphicsPipelineShaderProgram);
+	glDeleteProgram(gApp.mDepthShaderProgram);
+	glDeleteProgram(gApp.mOverdrawShaderProgram);
+	glDeleteProgram(gApp.mPostPrograms.mDownsample);
+	glDeleteProgram(gApp.mPostPrograms.mUpsample);
+	glDeleteProgram(gApp.mPostPrograms.mResolve);
+	glDeleteProgram(gApp.mPostPrograms.mFxaa);
+	GLDebug::PrintSummary();
+	PrintCullingStats();
+}
+bool ParseCommandLine(int argc, char* args[]){
+	for (int i = 1; i < argc; i++){
+		const char* arg = args[i];
+		bool hasValue = i + 1 < argc;
+		if (strcmp(arg, "--headless") == 0){
+			gApp.mHeadless = true;
+		} else if (strcmp(arg, "--frames") == 0 && hasValue){
+			gApp.mFrameCount = atoi(args[++i]);
+		} else if (strcmp(arg, "--output") == 0 && hasValue){
+			gApp.mOutputPath = args[++i];
+		} else if (strcmp(arg, "--renderer") == 0 && hasValue){
+			gApp.mSoftwareRenderer = strcmp(args[++i], "software") == 0;
+		} else if (strcmp(arg, "--model") == 0 && hasValue){
+			gApp.mModelPath = args[++i];
+		} else if (strcmp(arg, "--smoothing-angle") == 0 && hasValue){
+			gApp.mSmoothingAngle = (float)atof(args[++i]);
+		} else if (strcmp(arg, "--async-load") == 0){
+			gApp.mAsyncLoad = true;
+		} else if (strcmp(arg, "--texture") == 0 && hasValue){
+			gApp.mTexturePath = args[++i];
+		} else if (strcmp(arg, "--texture-budget") == 0 && hasValue){
+			gApp.mTextureBudget = (size_t)(atof(args[++i]) * 1024.0 * 1024.0);
+		} else if (strcmp(arg, "--texture-format") == 0 && hasValue){
+			const char* format = args[++i];
+			gApp.mTextureFormat = strcmp(format, "bc1") == 0 ? kBC1 : strcmp(format, "bc3") == 0 ? kBC3
+			                    : strcmp(format, "bc7") == 0 ? kBC7 : kUncompressed;
+		} else if (strcmp(arg, "--texture-cache") == 0 && hasValue){
+			gApp.mTextureCache = args[++i];
+		} else if (strcmp(arg, "--vsync") == 0 && hasValue){
+			const char* mode = args[++i];
+			gApp.mSwapInterval = strcmp(mode, "off") == 0 ? 0 : strcmp(mode, "adaptive") == 0 ? -1 : 1;
+		} else if (strcmp(arg, "--fps-limit") == 0 && hasValue){
+			gApp.mFrameRateLimit = atof(args[++i]);
+		} else if (strcmp(arg, "--late-latch") == 0 && hasValue){
+			gApp.mLateLatch = strcmp(args[++i], "off") != 0;
+		} else if (strcmp(arg, "--input-latency") == 0){
+			gApp.mMeasureInputLatency = true;
+		} else if (strcmp(arg, "--camera") == 0 && hasValue){
+			gApp.mCameraMode = strcmp(args[++i], "orbit") == 0 ? Camera::kOrbit : Camera::kFly;
+		} else if (strcmp(arg, "--camera-smoothing") == 0 && hasValue){
+			gApp.mCameraSmoothing = (float)atof(args[++i]);
+		} else if (strcmp(arg, "--benchmark") == 0 && hasValue){
+			gApp.mBenchmarkPath = args[++i];
+			gApp.mHeadless = true;
+		} else if (strcmp(arg, "--camera-path") == 0 && hasValue){
+			gApp.mCameraPathFile = args[++i];
+		} else if (strcmp(arg, "--record-path") == 0 && hasValue){
+			gApp.mRecordPathFile = args[++i];
+		} else if (strcmp(arg, "--gpu-profile") == 0 && hasValue){
+			gApp.mGpuProfilePath = args[++i];
+		} else if (strcmp(arg, "--trace") == 0 && hasValue){
+			gApp.mTracePath = args[++i];
+		} else if (strcmp(arg, "--microbench") == 0 && hasValue){
+			gApp.mMicrobenchmark = args[++i];
+		} else if (strcmp(arg, "--lod-error") == 0 && hasValue){
+			gApp.mLodPixelError = (float)atof(args[++i]);
+		} else if (strcmp(arg, "--meshlets") == 0){
+			gApp.mMeshlets = true;
+		} else if (strcmp(arg, "--render-path") == 0 && hasValue){
+			const char* path = args[++i];
+			gApp.mRenderPath = strcmp(path, "unordered") == 0 ? kRenderUnordered
+			                 : strcmp(path, "prepass") == 0 ? kRenderDepthPrepass : kRenderSorted;
+		} else if (strcmp(arg, "--lights") == 0 && hasValue){
+			gApp.mLightCount = atoi(args[++i]);
+		} else if (strcmp(arg, "--shadows") == 0){
+			gApp.mShadows = true;
+		} else if (strcmp(arg, "--pbr") == 0){
+			gApp.mPbr = true;
+		} else if (strcmp(arg, "--material") == 0 && hasValue){
+			if (sscanf(args[++i], "%f,%f", &gApp.mMetallic, &gApp.mRoughness) != 2){
+				std::cerr << "--material expects METALLIC,ROUGHNESS" << std::endl;
+				return false;
+			}
+			gApp.mPbr = true;
+		} else if (strcmp(arg, "--post") == 0 && hasValue){
+			std::stringstream stages(args[++i]);
+			std::string stage;
+			while (std::getline(stages, stage, ',')){
+				if (stage == "bloom"){
+					gApp.mPostSettings.mBloom = true;
+				} else if (stage == "tonemap"){
+					gApp.mPostSettings.mTonemap = true;
+				} else if (stage == "fxaa"){
+					gApp.mPostSettings.mFxaa = true;
+				} else if (stage != "hdr"){
+					std::cerr << "--post expects a list of hdr, bloom, tonemap, fxaa" << std::endl;
+					return false;
+				}
+			}
+			gApp.mPostProcessing = true;
+		} else if (strcmp(arg, "--exposure") == 0 && hasValue){
+			gApp.mPostSettings.mExposure = (float)atof(args[++i]);
+		} else if (strcmp(arg, "--overdraw") == 0){
+			gApp.mOverdraw = true;
+			gApp.mHeadless = true;
+		} else if (strcmp(arg, "--occlusion") == 0){
+			gApp.mOcclusionCulling = true;
+		} else if (strcmp(arg, "--size") == 0 && hasValue){
+			if (sscanf(args[++i], "%dx%d", &gApp.mScreenWidth, &gApp.mScreenHeight) != 2){
+				std::cerr << "--size expects WIDTHxHEIGHT" << std::endl;
+				return false;
+			}
+		} else {
+			std::cerr << "usage: " << args[0] << " [--headless] [--frames N] [--output frame_%04d.ppm|-] [--size WxH]"
+			          << " [--renderer gl|software] [--model file.obj] [--smoothing-angle degrees] [--async-load]"
+			          << " [--texture file.ppm|file.tga] [--texture-budget MB] [--texture-format rgba8|bc1|bc3|bc7]"
+			          << " [--texture-cache dir] [--vsync off|on|adaptive] [--fps-limit N]"
+			          << " [--late-latch on|off] [--input-latency] [--camera fly|orbit] [--camera-smoothing seconds]"
+			          << " [--benchmark report.json] [--camera-path file] [--record-path file]"
+			          << " [--gpu-profile trace.json] [--trace trace.json] [--lod-error pixels]"
+			          << " [--render-path unordered|sorted|prepass] [--overdraw] [--lights N] [--shadows]"
+			          << " [--pbr] [--material metallic,roughness] [--post hdr,bloom,tonemap,fxaa] [--exposure X]"
+			          << " [--meshlets] [--occlusion] [--microbench trace|lod|meshlets|occlusion|normals|objstream|textures|bc|limiter|camera|depth|lights|shadows|ibl|framegraph]" << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+// Adaptive vsync tears late frames instead of waiting a whole refresh for them;
+// drivers without it get plain vsync.
+void SetSwapInterval(){
+	if (SDL_GL_SetSwapInterval(gApp.mSwapInterval) == 0){
+		return;
+	}
+	if (gApp.mSwapInterval < 0 && SDL_GL_SetSwapInterval(1) == 0){
+		std::cout << "Adaptive vsync is not supported, using vsync" << std::endl;
+	} else {
+		std::cout << "Could not set the swap interval: " << SDL_GetError() << std::endl;
+	}
+}
+void StartProfiler(){
+	if (gApp.mGpuProfilePath.empty()){
+		return;
+	}
+	gApp.mProfiler = new GpuProfiler();
+	gApp.mProfiler->Create();
+}
+void FinishProfiler(){
+	if (gApp.mProfiler == nullptr){
+		return;
+	}
+	gApp.mProfiler->Flush();
+	gApp.mProfiler->WriteChromeTrace(gApp.mGpuProfilePath);
+	gApp.mProfiler->Destroy();
+	delete gApp.mProfiler;
+	gApp.mProfiler = nullptr;
+}
+void BeginProfiledFrame(){
+	if (gApp.mProfiler != nullptr){
+		gApp.mProfiler->BeginFrame();
+	}
+}
+void EndProfiledFrame(){
+	if (gApp.mProfiler != nullptr){
+		gApp.mProfiler->EndFrame();
+	}
+}
+// Camera path for headless runs: --camera-path if given, otherwise a fixed
+// orbit around the scene when benchmarking so runs are comparable.
+bool PrepareCameraPath(CameraPath* path){
+	if (!gApp.mCameraPathFile.empty()){
+		return path->Load(gApp.mCameraPathFile);
+	}
+	if (!gApp.mBenchmarkPath.empty()){
+		path->MakeOrbit(glm::vec3(0.0f, 0.0f, -3.0f), 3.0f, 0.5f, 64);
+	}
+	return true;
+}
+void RecordFrameSample(BenchmarkReport* report, int frame, std::chrono::steady_clock::time_point start){
+	FrameSample& sample = (*report)[frame];
+	sample.mCpuMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	sample.mDrawCalls = gApp.mDrawCalls;
+	sample.mTriangles = gApp.mTriangleCount;
+}
+// Renders mFrameCount frames into an offscreen framebuffer. Readbacks are queued
+// through a PBO ring and retired a few frames later, so the GPU keeps rendering
+// while earlier frames are copied out and written. In benchmark mode frames are
+// not read back; CPU time per frame and GPU time from timer queries are reported.
+int RunHeadless(){
+	bool benchmark = !gApp.mBenchmarkPath.empty();
+	CameraPath path;
+	if (!PrepareCameraPath(&path)){
+		return 1;
+	}
+	HeadlessContext context;
+	if (!context.Create(gApp.mScreenWidth, gApp.mScreenHeight)){
+		return 1;
+	}
+	if (!gladLoadGLLoader(HeadlessContext::GetProcAddress)) {
+		std::cout << "glad was not initialized" << std::endl;
+		return 1;
+	}
+	if (gApp.mAssetLoader != nullptr && context.CreateSharedContext()){
+		gApp.mAssetLoader->Start([&context](){ return context.MakeSharedCurrent(); }, [&context](){ context.ReleaseShared(); });
+	}
+	FrameWriter writer;
+	if (!benchmark && !writer.Open(gApp.mOutputPath)){
+		return 1;
+	}
+	// Keep stdout clean for the frame stream when writing to a pipe.
+	std::streambuf* coutBuffer = std::cout.rdbuf();
+	if (gApp.mOutputPath == "-"){
+		std::cout.rdbuf(std::cerr.rdbuf());
+	}
+	InitializeScene();
+	OffscreenTarget target;
+	AsyncReadback readback;
+	GpuFrameTimer timer;
+	OverdrawCounter overdraw;
+	BenchmarkReport report;
+	report.Resize(gApp.mFrameCount);
+	if (target.Create(gApp.mScreenWidth, gApp.mScreenHeight)){
+		readback.Create(gApp.mScreenWidth, gApp.mScreenHeight, &writer);
+		timer.Create();
+		StartProfiler();
+		target.Bind();
+		for (int frame = 0; frame < gApp.mFrameCount; frame++){
+			path.Apply(&gApp.mCamera, frame, gApp.mFrameCount);
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			BeginProfiledFrame();
+			if (benchmark){
+				timer.Begin(frame);
+			}
+			Input();
+			UpdateScene(1, 1.0f);
+			RenderFrame();
+			FinishInputFrame();
+			if (benchmark){
+				timer.End();
+			} else if (gApp.mOverdraw){
+				overdraw.Resolve(frame, gApp.mScreenWidth, gApp.mScreenHeight, &writer);
+			} else {
+				GpuProfileScope scope(gApp.mProfiler, "Readback");
+				readback.Queue(frame);
+				readback.Poll();
+			}
+			EndProfiledFrame();
+			RecordFrameSample(&report, frame, start);
+			CountFrame();
+		}
+		FinishProfiler();
+		readback.Flush();
+		readback.Destroy();
+		timer.Flush();
+		const std::vector<double>& gpuTimes = timer.GetResults();
+		for (size_t frame = 0; frame < gpuTimes.size(); frame++){
+			report[(int)frame].mGpuMilliseconds = gpuTimes[frame];
+		}
+		timer.Destroy();
+		overdraw.PrintReport();
+		OffscreenTarget::Unbind();
+		target.Destroy();
+	}
+	CleanUpScene();
+	writer.Close();
+	std::cout.rdbuf(coutBuffer);
+	context.Destroy();
+	if (benchmark && !report.WriteJson(gApp.mBenchmarkPath, "gl", gApp.mScreenWidth, gApp.mScreenHeight)){
+		return 1;
+	}
+	return 0;
+}
+// Headless rendering without any OpenGL context, for machines with no GPU or driver.
+int RunSoftware(){
+	bool benchmark = !gApp.mBenchmarkPath.empty();
+	CameraPath path;
+	if (!PrepareCameraPath(&path)){
+		return 1;
+	}
+	FrameWriter writer;
+	if (!benchmark && !writer.Open(gApp.mOutputPath)){
+		return 1;
+	}
+	std::streambuf* coutBuffer = std::cout.rdbuf();
+	if (gApp.mOutputPath == "-"){
+		std::cout.rdbuf(std::cerr.rdbuf());
+	}
+	if (gApp.mOverdraw){
+		std::cout << "--overdraw needs the GL renderer; writing shaded frames" << std::endl;
+		gApp.mOverdraw = false;
+	}
+	if (gApp.mPbr){
+		std::cout << "--pbr needs the GL renderer; writing unlit frames" << std::endl;
+		gApp.mPbr = false;
+	}
+	if (gApp.mPostProcessing){
+		std::cout << "--post needs the GL renderer; writing frames without it" << std::endl;
+		gApp.mPostProcessing = false;
+	}
+	LoadSceneGeometry();
+	SoftwareRasterizer rasterizer;
+	rasterizer.Resize(gApp.mScreenWidth, gApp.mScreenHeight);
+	BenchmarkReport report;
+	report.Resize(gApp.mFrameCount);
+	double renderMilliseconds = 0.0;
+	for (int frame = 0; frame < gApp.mFrameCount; frame++){
+		path.Apply(&gApp.mCamera, frame, gApp.mFrameCount);
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		Input();
+		UpdateScene(1, 1.0f);
+		RenderFrameSoftware(&rasterizer);
+		FinishInputFrame();
+		RecordFrameSample(&report, frame, start);
+		CountFrame();
+		renderMilliseconds += report[frame].mCpuMilliseconds;
+		if (!benchmark){
+			writer.Write(frame, rasterizer.GetColorBuffer(), gApp.mScreenWidth, gApp.mScreenHeight);
+		}
+	}
+	if (gApp.mFrameCount > 0){
+		std::cout << "Software renderer: " << renderMilliseconds / gApp.mFrameCount << " ms/frame on "
+		          << JobSystem::Shared().GetThreadCount() << " threads" << std::endl;
+	}
+	PrintCullingStats();
+	writer.Close();
+	std::cout.rdbuf(coutBuffer);
+	if (benchmark && !report.WriteJson(gApp.mBenchmarkPath, "software", gApp.mScreenWidth, gApp.mScreenHeight)){
+		return 1;
+	}
+	return 0;
+}
+int RunMicrobenchmark(const std::string& name){
+	if (name == "trace"){
+		TraceCollector::RunMicrobenchmark(10000000);
+		return 0;
+	}
+	if (name == "meshlets"){
+		ClusterCuller::RunMicrobenchmark(gApp.mModelPath.empty() ? "heart.obj" : gApp.mModelPath, gApp.mFrameCount);
+		return 0;
+	}
+	if (name == "occlusion"){
+		OcclusionCuller::RunMicrobenchmark(gApp.mFrameCount);
+		return 0;
+	}
+	if (name == "normals"){
+		TangentSpace::RunMicrobenchmark(1000000);
+		return 0;
+	}
+	if (name == "objstream"){
+		OBJLoader::RunMicrobenchmark(4000000);
+		return 0;
+	}
+	if (name == "textures"){
+		TextureStreamer::RunMicrobenchmark(2048, 8);
+		return 0;
+	}
+	if (name == "bc"){
+		BlockCompressor::RunMicrobenchmark(1024);
+		return 0;
+	}
+	if (name == "limiter"){
+		FrameScheduler::RunMicrobenchmark(60.0, 120);
+		return 0;
+	}
+	if (name == "camera"){
+		Camera::RunMicrobenchmark(5000000);
+		return 0;
+	}
+	if (name == "depth"){
+		Camera::RunDepthMicrobenchmark();
+		return 0;
+	}
+	if (name == "lights"){
+		ClusteredLighting::RunMicrobenchmark(20);
+		return 0;
+	}
+	if (name == "framegraph"){
+		FrameGraph::RunMicrobenchmark();
+		return 0;
+	}
+	if (name == "ibl"){
+		ImageBasedLighting::RunMicrobenchmark(gApp.mTextureCache);
+		return 0;
+	}
+	if (name == "shadows"){
+		CascadedShadows::RunMicrobenchmark(100000);
+		return 0;
+	}
+	if (name == "lod"){
+		MeshSimplifier::RunMicrobenchmark(gApp.mModelPath, 1000000);
+		return 0;
+	}
+	std::cerr << "unknown microbenchmark: " << name << std::endl;
+	return 1;
+}
+void ReportInputLatency(){
+	if (gApp.mMeasureInputLatency){
+		gApp.mInput.StopSyntheticMotion();
+		gApp.mInput.PrintLatencyReport();
+	}
+}
+int RunApplication();
 int main(int argc, char* args[])
 {
+	if (!ParseCommandLine(argc, args)){
+		return 1;
+	}
+	if (!gApp.mMicrobenchmark.empty()){
+		return RunMicrobenchmark(gApp.mMicrobenchmark);
+	}
+	if (gApp.mTracePath.empty()){
+		return RunApplication();
+	}
+	TRACE_THREAD_NAME("Main");
+	TraceCollector::Start();
+	int result = RunApplication();
+	TraceCollector::Stop();
+	// Loading and decoding belong on workers; on Main they stall a frame.
+	for (const char* name : { "AssetLoader::Parse", "TextureStreamer::Decode" }){
+		size_t count = TraceCollector::CountEvents(name, "Main");
+		if (count > 0){
+			std::cerr << "Trace check failed: " << count << " " << name << " events ran on Main" << std::endl;
+			result = 1;
+		}
+	}
+	TraceCollector::WriteChromeTrace(gApp.mTracePath);
+	return result;
+}
+int RunApplication()
+{
+	gApp.mStartTime = std::chrono::steady_clock::now();
+	//Setup the camera
+	gApp.mCamera.SetProjectionMatrix(glm::radians(45.0f), (float)gApp.mScreenWidth/(float)gApp.mScreenHeight, 0.1f);
+	gApp.mCamera.SetSmoothing(gApp.mCameraSmoothing);
+	gApp.mCamera.SetOrbitDistance(2.0f);
+	gApp.mCamera.SetMode(gApp.mCameraMode);
+	OcclusionCuller occlusion;
+	if (gApp.mOcclusionCulling){
+		gApp.mOcclusion = &occlusion;
+	}
+	// Interactive runs never wait for the model; headless ones do unless asked,
+	// so their frames stay reproducible.
+	AssetLoader loader;
+	if (gApp.mAsyncLoad || !gApp.mHeadless){
+		gApp.mAssetLoader = &loader;
+	}
+	gApp.mMouseX = gApp.mScreenWidth/2;
+	gApp.mMouseY = gApp.mScreenHeight/2;
+	if (gApp.mHeadless){
+		int result = gApp.mSoftwareRenderer ? RunSoftware() : RunHeadless();
+		ReportInputLatency();
+		return result;
+	}
+
 	SDL_Init(SDL_INIT_VIDEO);
     SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 4);
 	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 1);
 	SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, GL_DEBUG ? SDL_GL_CONTEXT_DEBUG_FLAG : 0);
 	SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
+	// Window surfaces rarely offer float depth; the headless target uses 32F.
 	SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
-	//Setup the camera
-	gApp.mCamera.SetProjectionMatrix(glm::radians(45.0f), (float)gApp.mScreenWidth/(float)gApp.mScreenHeight, 0.1f, 10.0f);
 
 	gApp.mGraphicsApplicationWindow = SDL_CreateWindow("hello", 10, 50, gApp.mScreenWidth, gApp.mScreenHeight, SDL_WINDOW_OPENGL);
-	if (SDL_GL_CreateContext(gApp.mGraphicsApplicationWindow) == NULL) {
+	gApp.mOpenGLContext = SDL_GL_CreateContext(gApp.mGraphicsApplicationWindow);
+	SDL_GLContext uploadContext = nullptr;
+	if (gApp.mOpenGLContext == NULL) {
 		std::cout << "OpenGL context failed: " << SDL_GetError() << std::endl;
 	}
 	else {
@@ -314,45 +1687,62 @@ int main(int argc, char* args[])
 			exit(1);
 		}
 		else {
-			PrintHWInfo();
-			MeshCreate(&gMesh1);
-			MeshTranslate(&gMesh1,0.0f, 0.0f, -2.0f);
-			MeshCreate(&gMesh2);
-			MeshTranslate(&gMesh2,0.0f, 0.0f, -4.0f);
-
-			CreateGraphicsPipeline();
-			MeshSetPipeline(&gMesh1, gApp.mGraphicsPipelineShaderProgram);
-			MeshSetPipeline(&gMesh2, gApp.mGraphicsPipelineShaderProgram);
+			// Second context for the asset upload thread, sharing buffers with this one.
+			SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 1);
+			uploadContext = SDL_GL_CreateContext(gApp.mGraphicsApplicationWindow);
+			SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 0);
+			SDL_GL_MakeCurrent(gApp.mGraphicsApplicationWindow, gApp.mOpenGLContext);
+			if (uploadContext != nullptr){
+				loader.Start([uploadContext](){ return SDL_GL_MakeCurrent(gApp.mGraphicsApplicationWindow, uploadContext) == 0; },
+				             [](){ SDL_GL_MakeCurrent(gApp.mGraphicsApplicationWindow, nullptr); });
+			}
+			SetSwapInterval();
+			InitializeScene();
 		}
 	}
 	//Store the current mouse position
 	// int mouseX, mouseY;
 	SDL_WarpMouseInWindow(gApp.mGraphicsApplicationWindow, gApp.mScreenWidth/2, gApp.mScreenHeight/2);
 	SDL_SetRelativeMouseMode(SDL_TRUE);
+	CameraPath recordedPath;
+	gApp.mCameraEye = gApp.mPreviousCameraEye = gApp.mCamera.GetPosition();
+	FrameScheduler scheduler(kSimulationStep);
+	scheduler.SetFrameRateLimit(gApp.mFrameRateLimit);
+	StartProfiler();
 	while (gApp.mQuit == 0) {
+		BeginProfiledFrame();
 		Input();	
-		//Update our mesh
-			glDisable(GL_DEPTH_TEST);
-	glDisable(GL_CULL_FACE);
-	glViewport(0, 0, gApp.mScreenWidth, gApp.mScreenHeight);
-	glClearColor(1.f, 1.f, 0.f, 1.f);
-
-	glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
-
-		// MeshUpdate(&gMesh1);
-		// MeshUpdate(&gMesh2);
-		static float rotate = 0.0f;
-		rotate+= 0.05f;
-		MeshRotate(&gMesh1,rotate,glm::vec3(0.0f,1.0f,0.0f));
-		MeshDraw(&gMesh1);
-		MeshDraw(&gMesh2);
-		SDL_GL_SwapWindow(gApp.mGraphicsApplicationWindow);
+		int steps = scheduler.BeginFrame();
+		UpdateScene(steps, scheduler.GetAlpha());
+		RenderFrame();
+		{
+			GpuProfileScope scope(gApp.mProfiler, "Swap");
+			SDL_GL_SwapWindow(gApp.mGraphicsApplicationWindow);
+		}
+		FinishInputFrame();
+		EndProfiledFrame();
+		CountFrame();
+		if (!gApp.mRecordPathFile.empty()){
+			recordedPath.Append(gApp.mCamera);
+		}
+		scheduler.EndFrame();
+	}
+	if (scheduler.GetDroppedSteps() > 0){
+		std::cout << "Simulation fell behind: " << scheduler.GetDroppedSteps() << " steps dropped" << std::endl;
+	}
+	FinishProfiler();
+	if (!gApp.mRecordPathFile.empty()){
+		recordedPath.Save(gApp.mRecordPathFile);
 	}
 
+	loader.Stop();
+	if (uploadContext != nullptr){
+		SDL_GL_DeleteContext(uploadContext);
+	}
 	SDL_DestroyWindow(gApp.mGraphicsApplicationWindow);
 	gApp.mGraphicsApplicationWindow = nullptr;
-	MeshDelete(&gMesh1);	
-	glDeleteProgram(gApp.mGraphicsPipelineShaderProgram);
+	CleanUpScene();
 	SDL_Quit();
+	ReportInputLatency();
 	return 0;
 }
\ No newline at end of file
@@ -0,0 +1,4 @@
+#version 410 core
+void main()
+{
+}
@@ -1,7 +1,161 @@
 #version 410 core
 in vec3 v_vertexColors ;
+in vec2 v_texCoord;
+in vec3 v_viewPosition;
+uniform sampler2D u_Texture;
+uniform int u_UseTexture;
+// Clustered lights (ClusteredLighting): two texels a light (view-space position
+// and radius, colour), offset and count of each cluster's run of light indices.
+uniform int u_UseLighting;
+uniform samplerBuffer u_Lights;
+uniform usamplerBuffer u_LightClusters;
+uniform usamplerBuffer u_LightIndices;
+uniform ivec3 u_ClusterCount;
+// Tiles per pixel in x and y, then the depth slice as log(depth) * z + w.
+uniform vec4 u_ClusterScale;
+// Directional light with cascaded shadows (CascadedShadows), four cascades: the
+// view depth each ends at, its texel size in world units, and view space to
+// shadow map coordinates.
+uniform int u_UseShadows;
+uniform sampler2DArrayShadow u_ShadowMap;
+uniform mat4 u_ShadowMatrices[4];
+uniform vec4 u_CascadeEnds;
+uniform vec4 u_CascadeTexels;
+uniform float u_ShadowTexel;
+uniform vec3 u_SunDirection;
+// Metallic/roughness material (u_UsePbr), with the texture or vertex colour as
+// the base colour, lit by the lights above and by split-sum image-based
+// lighting (ImageBasedLighting): an irradiance cube, a specular cube with one
+// roughness per mip level and the GGX scale and bias to F0 by NdotV and
+// roughness. The cubes are in world space.
+uniform int u_UsePbr;
+uniform float u_Metallic;
+uniform float u_Roughness;
+uniform samplerCube u_Irradiance;
+uniform samplerCube u_Specular;
+uniform sampler2D u_BrdfLut;
+uniform float u_SpecularLevels;
+uniform mat3 u_ViewToWorld;
 out vec4 color;
+
+const float kPi = 3.14159265f;
+// Sunlight reaching a surface facing the sun.
+const float kSunIlluminance = 3.0f;
+
+// The vertex stream has no normals; the face normal comes from the derivatives.
+vec3 FaceNormal()
+{
+    return normalize(cross(dFdx(v_viewPosition), dFdy(v_viewPosition)));
+}
+
+// Offset and count of the light indices of the fragment's cluster.
+uvec2 FindCluster()
+{
+    ivec3 cell = ivec3(gl_FragCoord.xy * u_ClusterScale.xy, log(-v_viewPosition.z) * u_ClusterScale.z + u_ClusterScale.w);
+    cell = clamp(cell, ivec3(0), u_ClusterCount - 1);
+    return texelFetch(u_LightClusters, (cell.z * u_ClusterCount.y + cell.y) * u_ClusterCount.x + cell.x).xy;
+}
+
+vec3 ShadeLights(vec3 albedo)
+{
+    vec3 normal = FaceNormal();
+    uvec2 cluster = FindCluster();
+    vec3 light = vec3(0.05f);
+    for (uint i = 0u; i < cluster.y; i++) {
+        int index = int(texelFetch(u_LightIndices, int(cluster.x + i)).r);
+        vec4 positionRadius = texelFetch(u_Lights, index * 2);
+        vec3 toLight = positionRadius.xyz - v_viewPosition;
+        float distance = max(length(toLight), 1e-4f);
+        float falloff = clamp(1.0f - distance * distance / (positionRadius.w * positionRadius.w), 0.0f, 1.0f);
+        light += texelFetch(u_Lights, index * 2 + 1).rgb * max(dot(normal, toLight / distance), 0.0f) * falloff * falloff;
+    }
+    return albedo * light;
+}
+
+float SampleShadow(vec3 normal)
+{
+    int cascade = int(dot(vec4(greaterThan(vec4(-v_viewPosition.z), u_CascadeEnds)), vec4(1.0f)));
+    if (cascade >= 4) {
+        return 1.0f;
+    }
+    // Looked up a texel and a half off the surface, clear of its own depth.
+    vec3 position = v_viewPosition + normal * (1.5f * u_CascadeTexels[cascade]);
+    vec4 coord = u_ShadowMatrices[cascade] * vec4(position, 1.0f);
+    float lit = 0.0f;
+    for (int y = -1; y <= 1; y++) {
+        for (int x = -1; x <= 1; x++) {
+            lit += texture(u_ShadowMap, vec4(coord.xy + vec2(x, y) * u_ShadowTexel, float(cascade), coord.z));
+        }
+    }
+    return lit / 9.0f;
+}
+
+// Light arriving from direction l, diffuse plus GGX specular; Smith-Schlick
+// visibility with the k of analytic lights.
+vec3 ShadeDirect(vec3 n, vec3 v, vec3 l, vec3 light, vec3 diffuseColor, vec3 f0, float roughness)
+{
+    float nl = max(dot(n, l), 0.0f);
+    vec3 h = normalize(v + l);
+    float nh = max(dot(n, h), 0.0f);
+    float nv = max(dot(n, v), 1e-4f);
+    float alpha2 = roughness * roughness * roughness * roughness;
+    float d = nh * nh * (alpha2 - 1.0f) + 1.0f;
+    float k = (roughness + 1.0f) * (roughness + 1.0f) / 8.0f;
+    float visibility = 1.0f / (4.0f * (nv * (1.0f - k) + k) * (nl * (1.0f - k) + k));
+    vec3 fresnel = f0 + (1.0f - f0) * pow(1.0f - max(dot(v, h), 0.0f), 5.0f);
+    vec3 specular = fresnel * (alpha2 / (kPi * d * d) * visibility);
+    return ((1.0f - fresnel) * diffuseColor / kPi + specular) * light * nl;
+}
+
+vec3 ShadePbr(vec3 baseColor)
+{
+    vec3 n = FaceNormal();
+    vec3 v = normalize(-v_viewPosition);
+    float roughness = clamp(u_Roughness, 0.04f, 1.0f);
+    vec3 f0 = mix(vec3(0.04f), baseColor, u_Metallic);
+    vec3 diffuseColor = baseColor * (1.0f - u_Metallic);
+    // Image-based: prefiltered radiance times the table's response to F0; the
+    // diffuse gets what the specular leaves.
+    vec2 response = texture(u_BrdfLut, vec2(max(dot(n, v), 0.0f), roughness)).rg;
+    vec3 reflectance = f0 * response.x + response.y;
+    vec3 prefiltered = textureLod(u_Specular, u_ViewToWorld * reflect(-v, n), roughness * u_SpecularLevels).rgb;
+    vec3 result = prefiltered * reflectance + texture(u_Irradiance, u_ViewToWorld * n).rgb * diffuseColor * (1.0f - reflectance);
+    if (u_UseShadows != 0) {
+        result += ShadeDirect(n, v, u_SunDirection, vec3(kSunIlluminance), diffuseColor, f0, roughness) * SampleShadow(n);
+    }
+    if (u_UseLighting != 0) {
+        uvec2 cluster = FindCluster();
+        for (uint i = 0u; i < cluster.y; i++) {
+            int index = int(texelFetch(u_LightIndices, int(cluster.x + i)).r);
+            vec4 positionRadius = texelFetch(u_Lights, index * 2);
+            vec3 toLight = positionRadius.xyz - v_viewPosition;
+            float distance = max(length(toLight), 1e-4f);
+            float falloff = clamp(1.0f - distance * distance / (positionRadius.w * positionRadius.w), 0.0f, 1.0f);
+            // Light colours are what a white diffuse surface facing the light reflects.
+            vec3 light = texelFetch(u_Lights, index * 2 + 1).rgb * (kPi * falloff * falloff);
+            result += ShadeDirect(n, v, toLight / distance, light, diffuseColor, f0, roughness);
+        }
+    }
+    return result;
+}
+
 void main()
 {
-    color = vec4(v_vertexColors.r, v_vertexColors.g, v_vertexColors.b, 1.0f);
+    if (u_UseTexture != 0) {
+        color = texture(u_Texture, v_texCoord);
+    } else {
+        color = vec4(v_vertexColors.r, v_vertexColors.g, v_vertexColors.b, 1.0f);
+    }
+    if (u_UsePbr != 0) {
+        color.rgb = ShadePbr(color.rgb);
+        return;
+    }
+    if (u_UseLighting != 0) {
+        color.rgb = ShadeLights(color.rgb);
+    }
+    if (u_UseShadows != 0) {
+        vec3 normal = FaceNormal();
+        float sun = max(dot(normal, u_SunDirection), 0.0f) * SampleShadow(normal);
+        color.rgb *= 0.35f + 0.65f * sun;
+    }
 }
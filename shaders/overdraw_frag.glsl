@@ -0,0 +1,7 @@
+#version 410 core
+out vec4 color;
+void main()
+{
+    // One unit of red per fragment, summed by additive blending.
+    color = vec4(1.0f / 255.0f, 0.0f, 0.0f, 1.0f);
+}
@@ -0,0 +1,37 @@
+#version 410 core
+in vec2 v_texCoord;
+uniform sampler2D u_Source;
+uniform vec2 u_SourceTexel;
+// First level: keep only what is brighter than u_Threshold, with a soft knee,
+// and weight the taps by 1 / (1 + luma) so lone bright pixels do not flicker.
+uniform int u_Prefilter;
+uniform float u_Threshold;
+out vec4 color;
+
+vec3 Tap(vec2 offset, out float weight)
+{
+    vec3 tap = texture(u_Source, v_texCoord + offset * u_SourceTexel).rgb;
+    weight = 1.0f;
+    if (u_Prefilter != 0) {
+        float brightness = max(tap.r, max(tap.g, tap.b));
+        float knee = 0.5f * u_Threshold;
+        float soft = clamp(brightness - u_Threshold + knee, 0.0f, 2.0f * knee);
+        soft = soft * soft / (4.0f * knee + 1e-4f);
+        tap *= max(soft, brightness - u_Threshold) / max(brightness, 1e-4f);
+        weight = 1.0f / (1.0f + dot(tap, vec3(0.2126f, 0.7152f, 0.0722f)));
+    }
+    return tap;
+}
+
+// Dual filter: the centre and four diagonal taps a texel out, each a bilinear
+// average of four source texels.
+void main()
+{
+    float weights[5];
+    vec3 sum = Tap(vec2(0.0f), weights[0]) * (4.0f * weights[0]);
+    sum += Tap(vec2(-1.0f, -1.0f), weights[1]) * weights[1];
+    sum += Tap(vec2(1.0f, -1.0f), weights[2]) * weights[2];
+    sum += Tap(vec2(-1.0f, 1.0f), weights[3]) * weights[3];
+    sum += Tap(vec2(1.0f, 1.0f), weights[4]) * weights[4];
+    color = vec4(sum / (4.0f * weights[0] + weights[1] + weights[2] + weights[3] + weights[4]), 1.0f);
+}
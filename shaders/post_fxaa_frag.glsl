@@ -0,0 +1,40 @@
+#version 410 core
+in vec2 v_texCoord;
+uniform sampler2D u_Source;
+uniform vec2 u_SourceTexel;
+out vec4 color;
+// FXAA in the style of Lottes' console version: finds the edge direction from
+// the luma of the four diagonal neighbours and blurs along it, keeping the wide
+// blur only when its luma stays within the neighbourhood's range.
+const float kReduceMin = 1.0f / 128.0f;
+const float kReduceScale = 1.0f / 8.0f;
+const float kSpanMax = 8.0f;
+
+float Luma(vec3 rgb)
+{
+    return dot(rgb, vec3(0.299f, 0.587f, 0.114f));
+}
+
+void main()
+{
+    vec3 center = texture(u_Source, v_texCoord).rgb;
+    float lumaNW = Luma(texture(u_Source, v_texCoord + vec2(-1.0f, -1.0f) * u_SourceTexel).rgb);
+    float lumaNE = Luma(texture(u_Source, v_texCoord + vec2(1.0f, -1.0f) * u_SourceTexel).rgb);
+    float lumaSW = Luma(texture(u_Source, v_texCoord + vec2(-1.0f, 1.0f) * u_SourceTexel).rgb);
+    float lumaSE = Luma(texture(u_Source, v_texCoord + vec2(1.0f, 1.0f) * u_SourceTexel).rgb);
+    float lumaM = Luma(center);
+    float lumaMin = min(lumaM, min(min(lumaNW, lumaNE), min(lumaSW, lumaSE)));
+    float lumaMax = max(lumaM, max(max(lumaNW, lumaNE), max(lumaSW, lumaSE)));
+
+    vec2 direction = vec2(-((lumaNW + lumaNE) - (lumaSW + lumaSE)), (lumaNW + lumaSW) - (lumaNE + lumaSE));
+    float reduce = max((lumaNW + lumaNE + lumaSW + lumaSE) * 0.25f * kReduceScale, kReduceMin);
+    float scale = 1.0f / (min(abs(direction.x), abs(direction.y)) + reduce);
+    direction = clamp(direction * scale, vec2(-kSpanMax), vec2(kSpanMax)) * u_SourceTexel;
+
+    vec3 narrow = 0.5f * (texture(u_Source, v_texCoord + direction * (1.0f / 3.0f - 0.5f)).rgb
+                        + texture(u_Source, v_texCoord + direction * (2.0f / 3.0f - 0.5f)).rgb);
+    vec3 wide = narrow * 0.5f + 0.25f * (texture(u_Source, v_texCoord - direction * 0.5f).rgb
+                                       + texture(u_Source, v_texCoord + direction * 0.5f).rgb);
+    float lumaWide = Luma(wide);
+    color = vec4(lumaWide < lumaMin || lumaWide > lumaMax ? narrow : wide, 1.0f);
+}
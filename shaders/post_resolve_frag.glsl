@@ -0,0 +1,31 @@
+#version 410 core
+in vec2 v_texCoord;
+uniform sampler2D u_Scene;
+uniform sampler2D u_Bloom;
+uniform int u_UseBloom;
+uniform float u_BloomStrength;
+uniform float u_Exposure;
+// ACES filmic curve when set, a plain clamp otherwise.
+uniform int u_Tonemap;
+out vec4 color;
+
+// Narkowicz's fit of the ACES reference tonemapper.
+vec3 Aces(vec3 x)
+{
+    return clamp(x * (2.51f * x + 0.03f) / (x * (2.43f * x + 0.59f) + 0.14f), 0.0f, 1.0f);
+}
+
+vec3 EncodeSrgb(vec3 linear)
+{
+    return mix(linear * 12.92f, 1.055f * pow(linear, vec3(1.0f / 2.4f)) - 0.055f, step(vec3(0.0031308f), linear));
+}
+
+void main()
+{
+    vec3 hdr = texture(u_Scene, v_texCoord).rgb * u_Exposure;
+    if (u_UseBloom != 0) {
+        hdr += texture(u_Bloom, v_texCoord).rgb * u_BloomStrength;
+    }
+    vec3 ldr = u_Tonemap != 0 ? EncodeSrgb(Aces(hdr)) : clamp(hdr, 0.0f, 1.0f);
+    color = vec4(ldr, 1.0f);
+}
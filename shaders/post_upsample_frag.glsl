@@ -0,0 +1,20 @@
+#version 410 core
+in vec2 v_texCoord;
+uniform sampler2D u_Source;
+uniform vec2 u_SourceTexel;
+out vec4 color;
+// Dual filter: a tent of four taps along the axes and four diagonal ones of
+// the smaller level, added onto the larger one by blending.
+void main()
+{
+    vec3 sum = vec3(0.0f);
+    sum += texture(u_Source, v_texCoord + vec2(-1.0f, 0.0f) * u_SourceTexel).rgb;
+    sum += texture(u_Source, v_texCoord + vec2(1.0f, 0.0f) * u_SourceTexel).rgb;
+    sum += texture(u_Source, v_texCoord + vec2(0.0f, -1.0f) * u_SourceTexel).rgb;
+    sum += texture(u_Source, v_texCoord + vec2(0.0f, 1.0f) * u_SourceTexel).rgb;
+    sum += texture(u_Source, v_texCoord + vec2(-0.5f, -0.5f) * u_SourceTexel).rgb * 2.0f;
+    sum += texture(u_Source, v_texCoord + vec2(0.5f, -0.5f) * u_SourceTexel).rgb * 2.0f;
+    sum += texture(u_Source, v_texCoord + vec2(-0.5f, 0.5f) * u_SourceTexel).rgb * 2.0f;
+    sum += texture(u_Source, v_texCoord + vec2(0.5f, 0.5f) * u_SourceTexel).rgb * 2.0f;
+    color = vec4(sum / 12.0f, 1.0f);
+}
@@ -0,0 +1,9 @@
+#version 410 core
+out vec2 v_texCoord;
+// One triangle covering the screen, from the vertex index alone.
+void main()
+{
+    vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    v_texCoord = corner;
+    gl_Position = vec4(corner * 2.0f - 1.0f, 0.0f, 1.0f);
+}
@@ -2,13 +2,21 @@
 #version 410 core
 layout(location=0) in vec3 position;
 layout(location=1) in vec3 vertexColors;
+layout(location=2) in vec2 texCoord;
 uniform mat4 u_ModelMatrix;
 uniform mat4 u_ViewMatrix;
 uniform mat4 u_Projection;
 out vec3 v_vertexColors;
+out vec2 v_texCoord;
+out vec3 v_viewPosition;
+// Same position as depth_vert.glsl to the bit, so the colour pass after a depth
+// pre-pass can test with GL_EQUAL.
+invariant gl_Position;
 void main()
 {
     v_vertexColors = vertexColors;
+    v_texCoord = texCoord;
+    v_viewPosition = (u_ViewMatrix * u_ModelMatrix * vec4(position,1.0f)).xyz;
     vec4 newPosition = u_Projection * u_ViewMatrix * u_ModelMatrix * vec4(position,1.0f);
     gl_Position = vec4(newPosition.x, newPosition.y, newPosition.z, newPosition.w);
 }
@@ -0,0 +1,137 @@
+#include "AssetLoader.hpp"
+#include "JobSystem.hpp"
+#include "Trace.hpp"
+#include <chrono>
+#include <iostream>
+
+    AssetLoader::AssetLoader(){
+        mParsing = 0;
+        mUploadThreadRunning = false;
+        mStopping = false;
+    }
+    AssetLoader::~AssetLoader(){
+        Stop();
+    }
+
+    void AssetLoader::Start(std::function<bool()> makeCurrent, std::function<void()> release){
+        if (mUploadThreadRunning){
+            return;
+        }
+        mStopping = false;
+        mUploadThreadRunning = true;
+        mUploadThread = std::thread(&AssetLoader::UploadLoop, this, makeCurrent, release);
+    }
+
+    void AssetLoader::Stop(){
+        // Parse jobs reference this loader, so let them finish first.
+        while (mParsing.load() > 0){
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        if (mUploadThreadRunning){
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                mStopping = true;
+            }
+            mWake.notify_all();
+            mUploadThread.join();
+            mUploadThreadRunning = false;
+        }
+        for (const std::shared_ptr<Entry>& entry : mEntries){
+            if (entry->mFence != nullptr){
+                glDeleteSync(entry->mFence);
+            }
+        }
+        mEntries.clear();
+    }
+
+    void AssetLoader::Load(Job job){
+        std::shared_ptr<Entry> entry = std::make_shared<Entry>();
+        entry->mJob = std::move(job);
+        mEntries.push_back(entry);
+        mParsing++;
+        JobSystem::Shared().SubmitBackground([this, entry](){
+            TRACE_SCOPE("AssetLoader::Parse");
+            bool parsed = !entry->mJob.mParse || entry->mJob.mParse();
+            if (!parsed){
+                entry->mStage = kFailed;
+            } else if (mUploadThreadRunning && entry->mJob.mUpload){
+                {
+                    std::lock_guard<std::mutex> lock(mMutex);
+                    mUploads.push_back(entry);
+                }
+                mWake.notify_one();
+            } else {
+                entry->mStage = kParsed;
+            }
+            mParsing--;
+        });
+    }
+
+    void AssetLoader::UploadLoop(std::function<bool()> makeCurrent, std::function<void()> release){
+        TRACE_THREAD_NAME("Upload");
+        bool current = makeCurrent && makeCurrent();
+        if (!current){
+            std::cout << "Upload context could not be made current; uploads fall back to the render thread" << std::endl;
+        }
+        while (true){
+            std::shared_ptr<Entry> entry;
+            {
+                std::unique_lock<std::mutex> lock(mMutex);
+                mWake.wait(lock, [this](){ return mStopping || !mUploads.empty(); });
+                if (mUploads.empty()){
+                    break;
+                }
+                entry = mUploads.front();
+                mUploads.pop_front();
+            }
+            if (!current){
+                entry->mStage = kParsed;
+                continue;
+            }
+            TRACE_SCOPE("AssetLoader::Upload");
+            entry->mJob.mUpload();
+            // The fence must reach the GPU before another context can wait on it.
+            entry->mFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            glFlush();
+            entry->mStage = kUploaded;
+        }
+        if (current && release){
+            release();
+        }
+    }
+
+    void AssetLoader::Poll(){
+        TRACE_SCOPE("AssetLoader::Poll");
+        for (size_t i = 0; i < mEntries.size();){
+            Entry& entry = *mEntries[i];
+            int stage = entry.mStage.load();
+            bool done = false;
+            if (stage == kFailed){
+                done = true;
+            } else if (stage == kParsed){
+                // No upload thread: upload here, in the render context.
+                if (entry.mJob.mUpload){
+                    entry.mJob.mUpload();
+                }
+                if (entry.mJob.mPublish){
+                    entry.mJob.mPublish();
+                }
+                done = true;
+            } else if (stage == kUploaded){
+                GLenum status = glClientWaitSync(entry.mFence, 0, 0);
+                if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED){
+                    glDeleteSync(entry.mFence);
+                    entry.mFence = nullptr;
+                    if (entry.mJob.mPublish){
+                        entry.mJob.mPublish();
+                    }
+                    done = true;
+                }
+            }
+            if (done){
+                mEntries.erase(mEntries.begin() + i);
+            } else {
+                i++;
+            }
+        }
+    }
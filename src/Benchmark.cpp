@@ -0,0 +1,185 @@
+#include "Benchmark.hpp"
+#include "Camera.hpp"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+    bool CameraPath::Load(const std::string& filepath){
+        std::ifstream file(filepath);
+        if (!file.is_open()){
+            std::cerr << "Failed to open camera path: " << filepath << std::endl;
+            return false;
+        }
+        mKeys.clear();
+        std::string line;
+        while (std::getline(file, line)){
+            line = line.substr(0, line.find('#'));
+            std::istringstream iss(line);
+            Key key;
+            if (iss >> key.mPosition.x >> key.mPosition.y >> key.mPosition.z
+                    >> key.mViewDirection.x >> key.mViewDirection.y >> key.mViewDirection.z){
+                mKeys.push_back(key);
+            }
+        }
+        if (mKeys.empty()){
+            std::cerr << "Camera path has no keys: " << filepath << std::endl;
+            return false;
+        }
+        return true;
+    }
+    bool CameraPath::Save(const std::string& filepath) const{
+        std::ofstream file(filepath);
+        if (!file.is_open()){
+            std::cerr << "Failed to write camera path: " << filepath << std::endl;
+            return false;
+        }
+        file << "# px py pz dx dy dz\n";
+        file.precision(9);
+        for (const Key& key : mKeys){
+            file << key.mPosition.x << " " << key.mPosition.y << " " << key.mPosition.z << " "
+                 << key.mViewDirection.x << " " << key.mViewDirection.y << " " << key.mViewDirection.z << "\n";
+        }
+        return true;
+    }
+    void CameraPath::MakeOrbit(const glm::vec3& target, float radius, float height, int keyCount){
+        mKeys.clear();
+        for (int i = 0; i < keyCount; i++){
+            float angle = 2.0f * 3.14159265f * i / (keyCount - 1);
+            Key key;
+            key.mPosition = target + glm::vec3(std::sin(angle) * radius, height, std::cos(angle) * radius);
+            key.mViewDirection = glm::normalize(target - key.mPosition);
+            mKeys.push_back(key);
+        }
+    }
+    void CameraPath::Append(const Camera& camera){
+        Key key;
+        key.mPosition = camera.GetPosition();
+        key.mViewDirection = camera.GetViewDirection();
+        mKeys.push_back(key);
+    }
+    void CameraPath::Apply(Camera* camera, int frame, int frameCount) const{
+        if (mKeys.empty()){
+            return;
+        }
+        float t = frameCount > 1 ? (float)frame / (frameCount - 1) : 0.0f;
+        float position = t * (mKeys.size() - 1);
+        size_t key = std::min((size_t)position, mKeys.size() - 1);
+        size_t next = std::min(key + 1, mKeys.size() - 1);
+        float blend = position - key;
+        camera->SetPosition(mKeys[key].mPosition + (mKeys[next].mPosition - mKeys[key].mPosition) * blend);
+        camera->SetViewDirection(mKeys[key].mViewDirection + (mKeys[next].mViewDirection - mKeys[key].mViewDirection) * blend);
+    }
+
+    GpuFrameTimer::GpuFrameTimer(){
+        for (int i = 0; i < kLatency; i++){
+            mQueries[i] = 0;
+            mFrames[i] = -1;
+        }
+        mCurrent = 0;
+    }
+    void GpuFrameTimer::Create(){
+        glGenQueries(kLatency, mQueries);
+    }
+    void GpuFrameTimer::Destroy(){
+        glDeleteQueries(kLatency, mQueries);
+        for (int i = 0; i < kLatency; i++){
+            mQueries[i] = 0;
+            mFrames[i] = -1;
+        }
+    }
+    void GpuFrameTimer::Begin(int frame){
+        if (mFrames[mCurrent] >= 0){
+            Retire(mCurrent);
+        }
+        mFrames[mCurrent] = frame;
+        glBeginQuery(GL_TIME_ELAPSED, mQueries[mCurrent]);
+    }
+    void GpuFrameTimer::End(){
+        glEndQuery(GL_TIME_ELAPSED);
+        mCurrent = (mCurrent + 1) % kLatency;
+    }
+    void GpuFrameTimer::Flush(){
+        for (int i = 0; i < kLatency; i++){
+            int slot = (mCurrent + i) % kLatency;
+            if (mFrames[slot] >= 0){
+                Retire(slot);
+            }
+        }
+    }
+    void GpuFrameTimer::Retire(int slot){
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(mQueries[slot], GL_QUERY_RESULT, &nanoseconds);
+        int frame = mFrames[slot];
+        if (frame >= (int)mResults.size()){
+            mResults.resize(frame + 1, -1.0);
+        }
+        mResults[frame] = nanoseconds / 1.0e6;
+        mFrames[slot] = -1;
+    }
+
+    void BenchmarkReport::Resize(int frameCount){
+        mSamples.assign(frameCount, FrameSample());
+    }
+    static double Percentile(const std::vector<double>& sorted, double percentile){
+        // Nearest-rank percentile.
+        size_t rank = (size_t)std::ceil(percentile / 100.0 * sorted.size());
+        return sorted[rank > 0 ? rank - 1 : 0];
+    }
+    static void WriteSummary(std::ostream& out, const char* name, std::vector<double> values){
+        out << "  \"" << name << "\": ";
+        if (values.empty()){
+            out << "null";
+            return;
+        }
+        std::sort(values.begin(), values.end());
+        double sum = 0.0;
+        for (double value : values){
+            sum += value;
+        }
+        out << "{ \"mean\": " << sum / values.size()
+            << ", \"min\": " << values.front()
+            << ", \"p50\": " << Percentile(values, 50.0)
+            << ", \"p95\": " << Percentile(values, 95.0)
+            << ", \"p99\": " << Percentile(values, 99.0)
+            << ", \"max\": " << values.back() << " }";
+    }
+    bool BenchmarkReport::WriteJson(const std::string& filepath, const std::string& renderer, int width, int height) const{
+        std::ofstream file(filepath);
+        if (!file.is_open()){
+            std::cerr << "Failed to write benchmark report: " << filepath << std::endl;
+            return false;
+        }
+        std::vector<double> cpu;
+        std::vector<double> gpu;
+        for (const FrameSample& sample : mSamples){
+            cpu.push_back(sample.mCpuMilliseconds);
+            if (sample.mGpuMilliseconds >= 0.0){
+                gpu.push_back(sample.mGpuMilliseconds);
+            }
+        }
+        file << "{\n";
+        file << "  \"renderer\": \"" << renderer << "\",\n";
+        file << "  \"width\": " << width << ",\n";
+        file << "  \"height\": " << height << ",\n";
+        file << "  \"frame_count\": " << mSamples.size() << ",\n";
+        WriteSummary(file, "cpu_ms", cpu);
+        file << ",\n";
+        WriteSummary(file, "gpu_ms", gpu);
+        file << ",\n  \"frames\": [\n";
+        for (size_t i = 0; i < mSamples.size(); i++){
+            const FrameSample& sample = mSamples[i];
+            file << "    { \"cpu_ms\": " << sample.mCpuMilliseconds << ", \"gpu_ms\": ";
+            if (sample.mGpuMilliseconds >= 0.0){
+                file << sample.mGpuMilliseconds;
+            } else {
+                file << "null";
+            }
+            file << ", \"draw_calls\": " << sample.mDrawCalls
+                 << ", \"triangles\": " << sample.mTriangles << " }"
+                 << (i + 1 < mSamples.size() ? ",\n" : "\n");
+        }
+        file << "  ]\n}\n";
+        return true;
+    }
@@ -0,0 +1,637 @@
+#include "BlockCompression.hpp"
+#include "JobSystem.hpp"
+#include "Simd.hpp"
+#include "Texture.hpp"
+#include "Trace.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+    static const size_t kBlockRowsPerJob = 4;
+    // How far index i of a four-colour BC1 block lies from colour0 towards colour1.
+    static const float kBC1Weights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+    // BC7 4-bit index weights, out of 64.
+    static const int kBC7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+    static const float kBC7Fractions[16] = { 0 / 64.0f, 4 / 64.0f, 9 / 64.0f, 13 / 64.0f, 17 / 64.0f, 21 / 64.0f, 26 / 64.0f,
+                                             30 / 64.0f, 34 / 64.0f, 38 / 64.0f, 43 / 64.0f, 47 / 64.0f, 51 / 64.0f,
+                                             55 / 64.0f, 60 / 64.0f, 64 / 64.0f };
+
+    // One 4x4 block as planes of 16 values in 0..255; texel i sits at x = i % 4, y = i / 4.
+    struct TexelBlock{
+        float mChannels[4][16];
+    };
+
+    static void LoadBlock(const Image& image, int blockX, int blockY, TexelBlock& block){
+        for (int y = 0; y < 4; y++){
+            int sy = std::min(blockY * 4 + y, image.mHeight - 1);
+            for (int x = 0; x < 4; x++){
+                int sx = std::min(blockX * 4 + x, image.mWidth - 1);
+                const uint8_t* texel = &image.mPixels[((size_t)sy * image.mWidth + sx) * 4];
+                for (int c = 0; c < 4; c++){
+                    block.mChannels[c][y * 4 + x] = texel[c];
+                }
+            }
+        }
+    }
+
+    static float HorizontalSum(Float4 v){
+        float lanes[4];
+        Float4Store(lanes, v);
+        return lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    }
+
+    // Block mean and dominant direction over the first channelCount channels, by
+    // power iteration on the covariance matrix. A flat block gets a zero axis.
+    static void PrincipalAxis(const TexelBlock& block, int channelCount, float* mean, float* axis){
+        Float4 centered[4][4];
+        for (int c = 0; c < channelCount; c++){
+            Float4 total = Float4Load(&block.mChannels[c][0]) + Float4Load(&block.mChannels[c][4])
+                         + Float4Load(&block.mChannels[c][8]) + Float4Load(&block.mChannels[c][12]);
+            mean[c] = HorizontalSum(total) * (1.0f / 16.0f);
+            for (int row = 0; row < 4; row++){
+                centered[c][row] = Float4Load(&block.mChannels[c][row * 4]) - Float4Splat(mean[c]);
+            }
+        }
+        float covariance[4][4];
+        for (int i = 0; i < channelCount; i++){
+            for (int j = i; j < channelCount; j++){
+                Float4 total = centered[i][0] * centered[j][0] + centered[i][1] * centered[j][1]
+                             + centered[i][2] * centered[j][2] + centered[i][3] * centered[j][3];
+                covariance[i][j] = covariance[j][i] = HorizontalSum(total);
+            }
+        }
+        // Start from the column of the widest channel, which is never orthogonal
+        // to the dominant axis unless the block is flat.
+        int widest = 0;
+        for (int c = 1; c < channelCount; c++){
+            widest = covariance[c][c] > covariance[widest][widest] ? c : widest;
+        }
+        for (int c = 0; c < channelCount; c++){
+            axis[c] = covariance[widest][c];
+        }
+        for (int iteration = 0; iteration < 8; iteration++){
+            float next[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+            float largest = 0.0f;
+            for (int i = 0; i < channelCount; i++){
+                for (int j = 0; j < channelCount; j++){
+                    next[i] += covariance[i][j] * axis[j];
+                }
+                largest = std::max(largest, std::fabs(next[i]));
+            }
+            if (largest == 0.0f){
+                break;
+            }
+            for (int c = 0; c < channelCount; c++){
+                axis[c] = next[c] / largest;
+            }
+        }
+        float length = 0.0f;
+        for (int c = 0; c < channelCount; c++){
+            length += axis[c] * axis[c];
+        }
+        length = std::sqrt(length);
+        for (int c = 0; c < channelCount; c++){
+            axis[c] = length > 0.0f ? axis[c] / length : 0.0f;
+        }
+    }
+
+    // The block's extent along its principal axis.
+    static void AxisEndpoints(const TexelBlock& block, int channelCount, float* e0, float* e1){
+        float mean[4];
+        float axis[4];
+        PrincipalAxis(block, channelCount, mean, axis);
+        Float4 lowest = Float4Splat(3.0e38f);
+        Float4 highest = Float4Splat(-3.0e38f);
+        for (int row = 0; row < 4; row++){
+            Float4 t = Float4Splat(0.0f);
+            for (int c = 0; c < channelCount; c++){
+                t = t + (Float4Load(&block.mChannels[c][row * 4]) - Float4Splat(mean[c])) * Float4Splat(axis[c]);
+            }
+            lowest = Float4Min(lowest, t);
+            highest = Float4Max(highest, t);
+        }
+        float tMin = Float4HorizontalMin(lowest);
+        float tMax = Float4HorizontalMax(highest);
+        for (int c = 0; c < channelCount; c++){
+            e0[c] = std::min(std::max(mean[c] + tMin * axis[c], 0.0f), 255.0f);
+            e1[c] = std::min(std::max(mean[c] + tMax * axis[c], 0.0f), 255.0f);
+        }
+    }
+
+    // Nearest of count palette entries for every texel, four texels per step;
+    // returns the summed squared error.
+    static float FitIndices(const TexelBlock& block, const float (*palette)[4], int count, int channelCount, int* indices){
+        float error = 0.0f;
+        for (int row = 0; row < 4; row++){
+            Float4 bestDistance = Float4Splat(3.0e38f);
+            Float4 bestIndex = Float4Splat(0.0f);
+            for (int i = 0; i < count; i++){
+                Float4 distance = Float4Splat(0.0f);
+                for (int c = 0; c < channelCount; c++){
+                    Float4 delta = Float4Load(&block.mChannels[c][row * 4]) - Float4Splat(palette[i][c]);
+                    distance = distance + delta * delta;
+                }
+                Float4 closer = Float4CmpLt(distance, bestDistance);
+                bestDistance = Float4Select(closer, distance, bestDistance);
+                bestIndex = Float4Select(closer, Float4Splat((float)i), bestIndex);
+            }
+            float lanes[4];
+            Float4Store(lanes, bestIndex);
+            for (int k = 0; k < 4; k++){
+                indices[row * 4 + k] = (int)lanes[k];
+            }
+            error += HorizontalSum(bestDistance);
+        }
+        return error;
+    }
+
+    // Endpoints minimising the squared error for fixed indices, where index i
+    // lies weights[i] of the way from e0 to e1. False when the system is singular.
+    static bool RefineEndpoints(const TexelBlock& block, int channelCount, const int* indices, const float* weights,
+                                float* e0, float* e1){
+        float aa = 0.0f;
+        float ab = 0.0f;
+        float bb = 0.0f;
+        float ax[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        float bx[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        for (int t = 0; t < 16; t++){
+            float b = weights[indices[t]];
+            float a = 1.0f - b;
+            aa += a * a;
+            ab += a * b;
+            bb += b * b;
+            for (int c = 0; c < channelCount; c++){
+                ax[c] += a * block.mChannels[c][t];
+                bx[c] += b * block.mChannels[c][t];
+            }
+        }
+        float determinant = aa * bb - ab * ab;
+        if (std::fabs(determinant) < 1e-6f){
+            return false;
+        }
+        for (int c = 0; c < channelCount; c++){
+            e0[c] = std::min(std::max((ax[c] * bb - bx[c] * ab) / determinant, 0.0f), 255.0f);
+            e1[c] = std::min(std::max((bx[c] * aa - ax[c] * ab) / determinant, 0.0f), 255.0f);
+        }
+        return true;
+    }
+
+    static uint16_t PackRGB565(const float* color){
+        int r = (int)(color[0] * (31.0f / 255.0f) + 0.5f);
+        int g = (int)(color[1] * (63.0f / 255.0f) + 0.5f);
+        int b = (int)(color[2] * (31.0f / 255.0f) + 0.5f);
+        return (uint16_t)((r << 11) | (g << 5) | b);
+    }
+
+    static void UnpackRGB565(uint16_t packed, int* color){
+        int r = (packed >> 11) & 31;
+        int g = (packed >> 5) & 63;
+        int b = packed & 31;
+        color[0] = (r << 3) | (r >> 2);
+        color[1] = (g << 2) | (g >> 4);
+        color[2] = (b << 3) | (b >> 2);
+        color[3] = 255;
+    }
+
+    // Palette as decoders build it, thirds rounded down. BC1 uses three colours
+    // and black when colour0 <= colour1; BC3 always uses four.
+    static void BuildBC1Palette(uint16_t c0, uint16_t c1, bool fourColors, int (*palette)[4]){
+        UnpackRGB565(c0, palette[0]);
+        UnpackRGB565(c1, palette[1]);
+        for (int c = 0; c < 4; c++){
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+        if (!fourColors){
+            for (int c = 0; c < 3; c++){
+                palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+                palette[3][c] = 0;
+            }
+        }
+    }
+
+    // Quantizes the endpoints with colour0 > colour1 (four-colour mode) and fits
+    // the indices. Equal endpoints leave every index at 0.
+    static float FitBC1(const TexelBlock& block, const float* e0, const float* e1, uint16_t& c0, uint16_t& c1, int* indices){
+        c0 = PackRGB565(e0);
+        c1 = PackRGB565(e1);
+        if (c0 < c1){
+            std::swap(c0, c1);
+        }
+        int decoded[4][4];
+        BuildBC1Palette(c0, c1, true, decoded);
+        float palette[4][4];
+        for (int i = 0; i < 4; i++){
+            for (int c = 0; c < 4; c++){
+                palette[i][c] = (float)decoded[i][c];
+            }
+        }
+        return FitIndices(block, palette, c0 == c1 ? 1 : 4, 3, indices);
+    }
+
+    static void EncodeColor(const TexelBlock& block, uint8_t* out){
+        float e0[4];
+        float e1[4];
+        AxisEndpoints(block, 3, e0, e1);
+        uint16_t c0;
+        uint16_t c1;
+        int indices[16];
+        float error = FitBC1(block, e0, e1, c0, c1, indices);
+        if (c0 != c1){
+            int decoded[4][4];
+            BuildBC1Palette(c0, c1, true, decoded);
+            for (int c = 0; c < 3; c++){
+                e0[c] = (float)decoded[0][c];
+                e1[c] = (float)decoded[1][c];
+            }
+            uint16_t r0;
+            uint16_t r1;
+            int refined[16];
+            if (RefineEndpoints(block, 3, indices, kBC1Weights, e0, e1) && FitBC1(block, e0, e1, r0, r1, refined) < error){
+                c0 = r0;
+                c1 = r1;
+                memcpy(indices, refined, sizeof(refined));
+            }
+        }
+        uint32_t bits = 0;
+        for (int t = 0; t < 16; t++){
+            bits |= (uint32_t)indices[t] << (t * 2);
+        }
+        out[0] = (uint8_t)(c0 & 255);
+        out[1] = (uint8_t)(c0 >> 8);
+        out[2] = (uint8_t)(c1 & 255);
+        out[3] = (uint8_t)(c1 >> 8);
+        for (int i = 0; i < 4; i++){
+            out[4 + i] = (uint8_t)(bits >> (i * 8));
+        }
+    }
+
+    static void BuildAlphaPalette(int a0, int a1, int* palette){
+        palette[0] = a0;
+        palette[1] = a1;
+        if (a0 > a1){
+            for (int i = 2; i < 8; i++){
+                palette[i] = ((8 - i) * a0 + (i - 1) * a1) / 7;
+            }
+        } else {
+            for (int i = 2; i < 6; i++){
+                palette[i] = ((6 - i) * a0 + (i - 1) * a1) / 5;
+            }
+            palette[6] = 0;
+            palette[7] = 255;
+        }
+    }
+
+    // BC3 alpha: the block's alpha range in eight steps, 3-bit indices.
+    static void EncodeAlpha(const TexelBlock& block, uint8_t* out){
+        const float* alpha = block.mChannels[3];
+        float lowest = 255.0f;
+        float highest = 0.0f;
+        for (int t = 0; t < 16; t++){
+            lowest = std::min(lowest, alpha[t]);
+            highest = std::max(highest, alpha[t]);
+        }
+        int a0 = (int)(highest + 0.5f);
+        int a1 = (int)(lowest + 0.5f);
+        int palette[8];
+        BuildAlphaPalette(a0, a1, palette);
+        uint64_t bits = 0;
+        for (int t = 0; t < 16; t++){
+            int best = 0;
+            for (int i = 1; i < 8; i++){
+                if (std::fabs(palette[i] - alpha[t]) < std::fabs(palette[best] - alpha[t])){
+                    best = i;
+                }
+            }
+            bits |= (uint64_t)best << (t * 3);
+        }
+        out[0] = (uint8_t)a0;
+        out[1] = (uint8_t)a1;
+        for (int i = 0; i < 6; i++){
+            out[2 + i] = (uint8_t)(bits >> (i * 8));
+        }
+    }
+
+    struct BC7Endpoints{
+        int mLow[4];   // 7-bit
+        int mHigh[4];
+        int mLowBit;
+        int mHighBit;
+    };
+
+    static void BuildBC7Palette(const BC7Endpoints& endpoints, float (*palette)[4]){
+        for (int c = 0; c < 4; c++){
+            int low = (endpoints.mLow[c] << 1) | endpoints.mLowBit;
+            int high = (endpoints.mHigh[c] << 1) | endpoints.mHighBit;
+            for (int i = 0; i < 16; i++){
+                palette[i][c] = (float)(((64 - kBC7Weights[i]) * low + kBC7Weights[i] * high + 32) >> 6);
+            }
+        }
+    }
+
+    // Quantizes to 7 bits plus a shared low bit per endpoint, trying all four
+    // p-bit pairs, and fits 4-bit indices.
+    static float FitBC7(const TexelBlock& block, const float* e0, const float* e1, BC7Endpoints& best, int* indices){
+        float bestError = 3.0e38f;
+        for (int pbits = 0; pbits < 4; pbits++){
+            BC7Endpoints candidate;
+            candidate.mLowBit = pbits & 1;
+            candidate.mHighBit = pbits >> 1;
+            for (int c = 0; c < 4; c++){
+                candidate.mLow[c] = std::min(std::max((int)((e0[c] - candidate.mLowBit) * 0.5f + 0.5f), 0), 127);
+                candidate.mHigh[c] = std::min(std::max((int)((e1[c] - candidate.mHighBit) * 0.5f + 0.5f), 0), 127);
+            }
+            float palette[16][4];
+            BuildBC7Palette(candidate, palette);
+            int fitted[16];
+            float error = FitIndices(block, palette, 16, 4, fitted);
+            if (error < bestError){
+                bestError = error;
+                best = candidate;
+                memcpy(indices, fitted, sizeof(fitted));
+            }
+        }
+        return bestError;
+    }
+
+    // Little-endian bit stream over a zeroed block.
+    struct BitWriter{
+        uint8_t* mOut;
+        int mPosition;
+        void Write(uint32_t value, int bits){
+            for (int i = 0; i < bits; i++, mPosition++){
+                if ((value >> i) & 1){
+                    mOut[mPosition >> 3] |= (uint8_t)(1 << (mPosition & 7));
+                }
+            }
+        }
+    };
+    struct BitReader{
+        const uint8_t* mIn;
+        int mPosition;
+        int Read(int bits){
+            int value = 0;
+            for (int i = 0; i < bits; i++, mPosition++){
+                value |= ((mIn[mPosition >> 3] >> (mPosition & 7)) & 1) << i;
+            }
+            return value;
+        }
+    };
+
+    static void EncodeBC7(const TexelBlock& block, uint8_t* out){
+        float e0[4];
+        float e1[4];
+        AxisEndpoints(block, 4, e0, e1);
+        BC7Endpoints endpoints;
+        int indices[16];
+        float error = FitBC7(block, e0, e1, endpoints, indices);
+        for (int c = 0; c < 4; c++){
+            e0[c] = (float)((endpoints.mLow[c] << 1) | endpoints.mLowBit);
+            e1[c] = (float)((endpoints.mHigh[c] << 1) | endpoints.mHighBit);
+        }
+        BC7Endpoints refined;
+        int refinedIndices[16];
+        if (RefineEndpoints(block, 4, indices, kBC7Fractions, e0, e1) && FitBC7(block, e0, e1, refined, refinedIndices) < error){
+            endpoints = refined;
+            memcpy(indices, refinedIndices, sizeof(refinedIndices));
+        }
+        // The first texel's index is stored without its top bit, which must be clear.
+        if (indices[0] >= 8){
+            std::swap(endpoints.mLow, endpoints.mHigh);
+            std::swap(endpoints.mLowBit, endpoints.mHighBit);
+            for (int t = 0; t < 16; t++){
+                indices[t] = 15 - indices[t];
+            }
+        }
+        memset(out, 0, 16);
+        BitWriter writer = { out, 0 };
+        writer.Write(1 << 6, 7);  // mode 6
+        for (int c = 0; c < 4; c++){
+            writer.Write(endpoints.mLow[c], 7);
+            writer.Write(endpoints.mHigh[c], 7);
+        }
+        writer.Write(endpoints.mLowBit, 1);
+        writer.Write(endpoints.mHighBit, 1);
+        writer.Write(indices[0], 3);
+        for (int t = 1; t < 16; t++){
+            writer.Write(indices[t], 4);
+        }
+    }
+
+    size_t BlockCompressor::GetEncodedSize(int width, int height, BlockFormat format){
+        if (format == kUncompressed){
+            return (size_t)width * height * 4;
+        }
+        size_t blocks = (size_t)((width + 3) / 4) * ((height + 3) / 4);
+        return blocks * (format == kBC1 ? 8 : 16);
+    }
+
+    GLenum BlockCompressor::GetGLFormat(BlockFormat format){
+        switch (format){
+            case kBC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+            case kBC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+            case kBC7: return GL_COMPRESSED_RGBA_BPTC_UNORM_ARB;
+            default: return 0;
+        }
+    }
+
+    bool BlockCompressor::IsSupported(BlockFormat format){
+        switch (format){
+            case kBC1:
+            case kBC3: return GLAD_GL_EXT_texture_compression_s3tc != 0;
+            case kBC7: return GLAD_GL_ARB_texture_compression_bptc != 0;
+            default: return true;
+        }
+    }
+
+    const char* BlockCompressor::GetName(BlockFormat format){
+        switch (format){
+            case kBC1: return "BC1";
+            case kBC3: return "BC3";
+            case kBC7: return "BC7";
+            default: return "RGBA8";
+        }
+    }
+
+    void BlockCompressor::Encode(const Image& image, BlockFormat format, std::vector<uint8_t>& blocks){
+        TRACE_SCOPE("BlockCompressor::Encode");
+        if (format == kUncompressed){
+            blocks = image.mPixels;
+            return;
+        }
+        int blocksX = (image.mWidth + 3) / 4;
+        int blocksY = (image.mHeight + 3) / 4;
+        size_t blockBytes = format == kBC1 ? 8 : 16;
+        blocks.resize(GetEncodedSize(image.mWidth, image.mHeight, format));
+        JobSystem::Shared().ParallelFor(blocksY, kBlockRowsPerJob, [&](size_t begin, size_t end){
+            TexelBlock block;
+            for (size_t y = begin; y < end; y++){
+                for (int x = 0; x < blocksX; x++){
+                    LoadBlock(image, x, (int)y, block);
+                    uint8_t* out = &blocks[(y * blocksX + x) * blockBytes];
+                    if (format == kBC1){
+                        EncodeColor(block, out);
+                    } else if (format == kBC3){
+                        EncodeAlpha(block, out);
+                        EncodeColor(block, out + 8);
+                    } else {
+                        EncodeBC7(block, out);
+                    }
+                }
+            }
+        });
+    }
+
+    // Writes one decoded block's texels that fall inside the image.
+    static void StoreBlock(const int (*texels)[4], int blockX, int blockY, Image& image){
+        for (int t = 0; t < 16; t++){
+            int x = blockX * 4 + t % 4;
+            int y = blockY * 4 + t / 4;
+            if (x < image.mWidth && y < image.mHeight){
+                uint8_t* pixel = &image.mPixels[((size_t)y * image.mWidth + x) * 4];
+                for (int c = 0; c < 4; c++){
+                    pixel[c] = (uint8_t)texels[t][c];
+                }
+            }
+        }
+    }
+
+    static void DecodeColor(const uint8_t* in, bool alwaysFourColors, int (*texels)[4]){
+        uint16_t c0 = (uint16_t)(in[0] | (in[1] << 8));
+        uint16_t c1 = (uint16_t)(in[2] | (in[3] << 8));
+        int palette[4][4];
+        BuildBC1Palette(c0, c1, alwaysFourColors || c0 > c1, palette);
+        uint32_t bits = in[4] | (in[5] << 8) | (in[6] << 16) | ((uint32_t)in[7] << 24);
+        for (int t = 0; t < 16; t++){
+            const int* color = palette[(bits >> (t * 2)) & 3];
+            texels[t][0] = color[0];
+            texels[t][1] = color[1];
+            texels[t][2] = color[2];
+        }
+    }
+
+    bool BlockCompressor::Decode(const uint8_t* blocks, int width, int height, BlockFormat format, Image& image){
+        image.mWidth = width;
+        image.mHeight = height;
+        if (format == kUncompressed){
+            image.mPixels.assign(blocks, blocks + (size_t)width * height * 4);
+            return true;
+        }
+        image.mPixels.resize((size_t)width * height * 4);
+        int blocksX = (width + 3) / 4;
+        int blocksY = (height + 3) / 4;
+        size_t blockBytes = format == kBC1 ? 8 : 16;
+        for (int by = 0; by < blocksY; by++){
+            for (int bx = 0; bx < blocksX; bx++){
+                const uint8_t* in = blocks + ((size_t)by * blocksX + bx) * blockBytes;
+                int texels[16][4];
+                if (format == kBC1){
+                    DecodeColor(in, false, texels);
+                    for (int t = 0; t < 16; t++){
+                        texels[t][3] = 255;
+                    }
+                } else if (format == kBC3){
+                    int palette[8];
+                    BuildAlphaPalette(in[0], in[1], palette);
+                    uint64_t bits = 0;
+                    for (int i = 0; i < 6; i++){
+                        bits |= (uint64_t)in[2 + i] << (i * 8);
+                    }
+                    DecodeColor(in + 8, true, texels);
+                    for (int t = 0; t < 16; t++){
+                        texels[t][3] = palette[(bits >> (t * 3)) & 7];
+                    }
+                } else {
+                    BitReader reader = { in, 0 };
+                    if (reader.Read(7) != (1 << 6)){
+                        return false;
+                    }
+                    BC7Endpoints endpoints;
+                    for (int c = 0; c < 4; c++){
+                        endpoints.mLow[c] = reader.Read(7);
+                        endpoints.mHigh[c] = reader.Read(7);
+                    }
+                    endpoints.mLowBit = reader.Read(1);
+                    endpoints.mHighBit = reader.Read(1);
+                    float palette[16][4];
+                    BuildBC7Palette(endpoints, palette);
+                    for (int t = 0; t < 16; t++){
+                        int index = reader.Read(t == 0 ? 3 : 4);
+                        for (int c = 0; c < 4; c++){
+                            texels[t][c] = (int)palette[index][c];
+                        }
+                    }
+                }
+                StoreBlock(texels, bx, by, image);
+            }
+        }
+        return true;
+    }
+
+    double BlockCompressor::ComputePSNR(const Image& reference, const Image& image, bool alpha){
+        int channels = alpha ? 4 : 3;
+        double squaredError = 0.0;
+        size_t pixelCount = (size_t)reference.mWidth * reference.mHeight;
+        for (size_t i = 0; i < pixelCount; i++){
+            for (int c = 0; c < channels; c++){
+                double delta = (double)reference.mPixels[i * 4 + c] - image.mPixels[i * 4 + c];
+                squaredError += delta * delta;
+            }
+        }
+        double meanSquaredError = squaredError / ((double)pixelCount * channels);
+        if (meanSquaredError == 0.0){
+            return 99.0;
+        }
+        return 10.0 * std::log10(255.0 * 255.0 / meanSquaredError);
+    }
+
+    // Soft gradients, a sharp-edged disc, fine stripes and noise, with an alpha
+    // ramp: a mix of the content block formats find easy and hard.
+    static Image MakeTestImage(int size){
+        Image image;
+        image.mWidth = size;
+        image.mHeight = size;
+        image.mPixels.resize((size_t)size * size * 4);
+        unsigned int seed = 12345u;
+        for (int y = 0; y < size; y++){
+            for (int x = 0; x < size; x++){
+                seed = seed * 1664525u + 1013904223u;
+                float u = (float)x / size;
+                float v = (float)y / size;
+                float noise = (float)((seed >> 24) & 15) - 7.5f;
+                bool disc = (u - 0.3f) * (u - 0.3f) + (v - 0.6f) * (v - 0.6f) < 0.04f;
+                float stripes = std::sin(u * 200.0f) * 40.0f * (v > 0.8f ? 1.0f : 0.0f);
+                uint8_t* p = &image.mPixels[((size_t)y * size + x) * 4];
+                p[0] = (uint8_t)std::min(std::max(u * 200.0f + noise + stripes + (disc ? 50.0f : 0.0f), 0.0f), 255.0f);
+                p[1] = (uint8_t)std::min(std::max(v * 180.0f + noise + (disc ? -60.0f : 30.0f), 0.0f), 255.0f);
+                p[2] = (uint8_t)std::min(std::max(128.0f + 100.0f * std::sin(u * 6.0f + v * 4.0f) + noise, 0.0f), 255.0f);
+                p[3] = (uint8_t)(v * 255.0f);
+            }
+        }
+        return image;
+    }
+
+    void BlockCompressor::RunMicrobenchmark(int imageSize){
+        Image image = MakeTestImage(imageSize);
+        double megapixels = (double)imageSize * imageSize / 1e6;
+        std::cout << "Block compression of a " << imageSize << "x" << imageSize << " image on "
+                  << JobSystem::Shared().GetThreadCount() << " threads" << std::endl;
+        const BlockFormat formats[3] = { kBC1, kBC3, kBC7 };
+        for (BlockFormat format : formats){
+            std::vector<uint8_t> blocks;
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            Encode(image, format, blocks);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            Image decoded;
+            Decode(blocks.data(), image.mWidth, image.mHeight, format, decoded);
+            std::cout << "\t" << GetName(format) << ": " << seconds * 1000.0 << " ms (" << megapixels / seconds
+                      << " Mpixels/sec), " << blocks.size() / 1024 << " KB, PSNR " << ComputePSNR(image, decoded, false)
+                      << " dB RGB";
+            if (format != kBC1){
+                std::cout << ", " << ComputePSNR(image, decoded, true) << " dB RGBA";
+            }
+            std::cout << std::endl;
+        }
+    }
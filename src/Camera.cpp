@@ -2,49 +2,281 @@
 #include "glm/gtc/matrix_transform.hpp"
 #define GLM_ENABLE_EXPERIMENTAL
 #include "glm/gtx/rotate_vector.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <iostream>
+
+namespace{
+    const double kPi = 3.14159265358979323846;
+    // Short of vertical, where yaw and roll would turn about the same axis.
+    const double kMaxPitch = 89.0 * kPi / 180.0;
+
+    double WrapAngle(double radians){
+        if (radians > kPi || radians < -kPi){
+            radians -= 2.0 * kPi * std::floor((radians + kPi) / (2.0 * kPi));
+        }
+        return radians;
+    }
+}
     Camera::Camera(){
         //Assume placed at origin
+        mMode = kFly;
         mEye = glm::vec3(0.0f, 0.0f, 0.0f);
-        mViewDirection = glm::vec3(0.0f, 0.0f, -1.0f);
-        mUpVector = glm::vec3(0.0f, 1.0f, 0.0f);
+        mOrientation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+        mYaw = 0.0;
+        mPitch = 0.0;
+        mRoll = 0.0;
+        mSmoothing = 0.0f;
+        mOrbitTarget = glm::vec3(0.0f, 0.0f, -1.0f);
+        mOrbitDistance = 1.0f;
+        mHasMouse = false;
+        mOldMouseX = 0;
+        mOldMouseY = 0;
     }
-    void Camera::SetProjectionMatrix(float fovy, float aspect, float near, float far)
+    void Camera::SetProjectionMatrix(float fovy, float aspect, float near)
     {
-        mProjectionMatrix = glm::perspective(fovy,aspect,near,far);
+        // x and y as glm::perspective; z = near and w = -z_view.
+        float tanHalfFovy = std::tan(fovy / 2.0f);
+        mProjectionMatrix = glm::mat4(0.0f);
+        mProjectionMatrix[0][0] = 1.0f / (aspect * tanHalfFovy);
+        mProjectionMatrix[1][1] = 1.0f / tanHalfFovy;
+        mProjectionMatrix[2][3] = -1.0f;
+        mProjectionMatrix[3][2] = near;
     }
 
     glm::mat4 Camera::GetViewMatrix() const{
-        return glm::lookAt(mEye, mEye + mViewDirection, mUpVector);
+        glm::mat3 rotation = glm::mat3_cast(mOrientation);
+        glm::mat4 view(1.0f);
+        for (int column = 0; column < 3; column++){
+            for (int row = 0; row < 3; row++){
+                view[column][row] = rotation[row][column];
+            }
+        }
+        view[3] = glm::vec4(-glm::dot(rotation[0], mEye), -glm::dot(rotation[1], mEye), -glm::dot(rotation[2], mEye), 1.0f);
+        return view;
     }
     glm::mat4 Camera::GetProjectionMatrix() const{
 	    return mProjectionMatrix;
-        
+
+    }
+    glm::quat Camera::GetTargetOrientation() const{
+        return glm::angleAxis((float)mYaw, glm::vec3(0.0f, 1.0f, 0.0f)) * glm::angleAxis((float)mPitch, glm::vec3(1.0f, 0.0f, 0.0f))
+             * glm::angleAxis((float)mRoll, glm::vec3(0.0f, 0.0f, -1.0f));
+    }
+    void Camera::SetOrientation(const glm::quat& orientation){
+        mOrientation = glm::normalize(orientation);
+        if (mMode == kOrbit){
+            mEye = mOrbitTarget - GetViewDirection() * mOrbitDistance;
+        }
     }
     void Camera::MouseLook(int mouseX, int mouseY){
-        std::cout<<"mouse: "<<mouseX<<","<<mouseY<<std::endl;
-        glm::vec2 currentMouse = glm::vec2(mouseX,mouseY);
-        static bool firstLook = true;
-        if(firstLook){
-            mOldMousePosition = currentMouse;
-            firstLook = false;
-        }
-        glm::vec2 mouseDelta = mOldMousePosition - currentMouse;
-        float mX = mouseX;
-        mViewDirection = glm::rotate(mViewDirection, glm::radians(mouseDelta.x), mUpVector);
-        mOldMousePosition = currentMouse;
+        if(!mHasMouse){
+            mOldMouseX = mouseX;
+            mOldMouseY = mouseY;
+            mHasMouse = true;
+        }
+        int deltaX = mOldMouseX - mouseX;
+        int deltaY = mOldMouseY - mouseY;
+        mOldMouseX = mouseX;
+        mOldMouseY = mouseY;
+        mYaw = WrapAngle(mYaw + deltaX * kPi / 180.0);
+        mPitch = std::min(std::max(mPitch + deltaY * kPi / 180.0, -kMaxPitch), kMaxPitch);
+        if (mSmoothing <= 0.0f){
+            SetOrientation(GetTargetOrientation());
+        }
+    }
+    void Camera::Roll(float radians){
+        mRoll = WrapAngle(mRoll + radians);
+        if (mSmoothing <= 0.0f){
+            SetOrientation(GetTargetOrientation());
+        }
+    }
+    void Camera::Update(float seconds){
+        // Exponential approach, the same per second whatever the step; renormalized
+        // by SetOrientation either way.
+        if (mSmoothing > 0.0f){
+            SetOrientation(glm::slerp(mOrientation, GetTargetOrientation(), 1.0f - std::exp(-seconds / mSmoothing)));
+        } else {
+            SetOrientation(GetTargetOrientation());
+        }
     }
     void Camera::MoveForward(float speed){
-        mEye += mViewDirection * speed;
+        if (mMode == kOrbit){
+            SetOrbitDistance(mOrbitDistance - speed);
+            return;
+        }
+        mEye += GetViewDirection() * speed;
     }
     void Camera::MoveBackward(float speed){
-        mEye -= mViewDirection * speed;
+        MoveForward(-speed);
     }
     void Camera::MoveLeft(float speed){
-        glm::vec3 rightVector = glm::cross(mViewDirection, mUpVector);
-        mEye -= rightVector * speed;
+        MoveRight(-speed);
     }
     void Camera::MoveRight(float speed){
-        glm::vec3 rightVector = glm::cross(mViewDirection, mUpVector);
-        mEye += rightVector * speed;
-    }
\ No newline at end of file
+        if (mMode == kOrbit){
+            // speed is the arc length travelled around the target.
+            mYaw = WrapAngle(mYaw + (double)speed / mOrbitDistance);
+            if (mSmoothing <= 0.0f){
+                SetOrientation(GetTargetOrientation());
+            }
+            return;
+        }
+        mEye += mOrientation * glm::vec3(1.0f, 0.0f, 0.0f) * speed;
+    }
+    void Camera::SetMode(Mode mode){
+        if (mode == kOrbit && mMode != kOrbit){
+            mOrbitTarget = mEye + GetViewDirection() * mOrbitDistance;
+        }
+        mMode = mode;
+    }
+    void Camera::SetOrbitTarget(const glm::vec3& target){
+        mOrbitTarget = target;
+        SetOrientation(mOrientation);
+    }
+    void Camera::SetOrbitDistance(float distance){
+        mOrbitDistance = std::max(distance, 0.1f);
+        SetOrientation(mOrientation);
+    }
+    void Camera::SetSmoothing(float seconds){
+        mSmoothing = std::max(seconds, 0.0f);
+    }
+    // Placement moves the orbit target along with the camera rather than the
+    // camera around the target.
+    void Camera::SetPosition(const glm::vec3& eye){
+        mEye = eye;
+        mOrbitTarget = mEye + GetViewDirection() * mOrbitDistance;
+    }
+    void Camera::SetViewDirection(const glm::vec3& direction){
+        glm::vec3 forward = glm::normalize(direction);
+        mYaw = std::atan2(-forward.x, -forward.z);
+        mPitch = std::min(std::max((double)std::asin(glm::clamp(forward.y, -1.0f, 1.0f)), -kMaxPitch), kMaxPitch);
+        mOrientation = glm::normalize(GetTargetOrientation());
+        mOrbitTarget = mEye + GetViewDirection() * mOrbitDistance;
+    }
+    glm::vec3 Camera::GetPosition() const{
+        return mEye;
+    }
+    glm::vec3 Camera::GetViewDirection() const{
+        return mOrientation * glm::vec3(0.0f, 0.0f, -1.0f);
+    }
+
+    void Camera::RunMicrobenchmark(int updateCount){
+        // Random mouse motion with smoothing: yaw wanders, pitch and roll jitter
+        // around level. The total yaw is known exactly in whole pixels.
+        Camera camera;
+        camera.SetSmoothing(0.05f);
+        glm::vec3 legacyDirection(0.0f, 0.0f, -1.0f);
+        unsigned int seed = 12345u;
+        int mouseX = 0;
+        int mouseY = 0;
+        int lastDy = 0;
+        long long totalYaw = 0;
+        float worstNorm = 0.0f;
+        float worstOrthogonality = 0.0f;
+        camera.MouseLook(mouseX, mouseY);
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (int i = 0; i < updateCount; i++){
+            seed = seed * 1664525u + 1013904223u;
+            int dx = (int)(seed >> 28) - 8;
+            // Pitch goes back where it came from every other update.
+            int dy = (i & 1) ? -lastDy : (int)((seed >> 24) & 7) - 4;
+            lastDy = dy;
+            mouseX += dx;
+            mouseY += dy;
+            totalYaw -= dx;
+            camera.MouseLook(mouseX, mouseY);
+            camera.Roll((i & 1) ? -0.01f : 0.01f);
+            camera.Update(1.0f / 60.0f);
+            if ((i & 1023) == 0){
+                glm::mat4 view = camera.GetViewMatrix();
+                worstNorm = std::max(worstNorm, std::fabs(glm::length(camera.GetOrientation()) - 1.0f));
+                for (int a = 0; a < 3; a++){
+                    for (int b = 0; b < 3; b++){
+                        float expected = a == b ? 1.0f : 0.0f;
+                        worstOrthogonality = std::max(worstOrthogonality, std::fabs(glm::dot(glm::vec3(view[a]), glm::vec3(view[b])) - expected));
+                    }
+                }
+            }
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        // Let smoothing settle, then compare with the yaw the motion adds up to.
+        camera.Update(10.0f);
+        double yaw = std::fmod(totalYaw * 3.14159265358979 / 180.0, 2.0 * 3.14159265358979);
+        glm::vec3 expected((float)-std::sin(yaw), 0.0f, (float)-std::cos(yaw));
+        float cameraError = glm::degrees(std::acos(glm::clamp(glm::dot(camera.GetViewDirection(), expected), -1.0f, 1.0f)));
+
+        // The previous camera: rotate the direction itself by every yaw delta.
+        seed = 12345u;
+        for (int i = 0; i < updateCount; i++){
+            seed = seed * 1664525u + 1013904223u;
+            int dx = (int)(seed >> 28) - 8;
+            legacyDirection = glm::rotate(legacyDirection, glm::radians((float)-dx), glm::vec3(0.0f, 1.0f, 0.0f));
+        }
+        float legacyError = glm::degrees(std::acos(glm::clamp(glm::dot(glm::normalize(legacyDirection), expected), -1.0f, 1.0f)));
+
+        std::cout << "Camera: " << updateCount << " updates, " << seconds * 1e9 / updateCount << " ns each" << std::endl;
+        std::cout << "Quaternion camera: |q| error " << worstNorm << ", basis orthogonality error " << worstOrthogonality
+                  << ", heading error " << cameraError << " degrees" << std::endl;
+        std::cout << "Rotated direction: length error " << std::fabs(glm::length(legacyDirection) - 1.0f)
+                  << ", heading error " << legacyError << " degrees" << std::endl;
+    }
+
+namespace{
+    // Stored depth at distance in front of the camera; depth increases with distance.
+    typedef double (*DepthFunction)(const glm::mat4& projection, double distance);
+
+    // Conventional projection, GL's -1..1 clip range, 24-bit fixed-point buffer.
+    double StandardDepth24(const glm::mat4& projection, double distance){
+        glm::vec4 clip = projection * glm::vec4(0.0f, 0.0f, (float)-distance, 1.0f);
+        float window = clip.z / clip.w * 0.5f + 0.5f;
+        return std::floor((double)window * 16777215.0 + 0.5);
+    }
+    // Reverse-Z through the -1..1 clip range (no glClipControl): the final
+    // z * 0.5 + 0.5 rounds away the small values that carry the precision.
+    double ReverseDepthRemapped(const glm::mat4& projection, double distance){
+        glm::vec4 clip = projection * glm::vec4(0.0f, 0.0f, (float)-distance, 1.0f);
+        float ndc = (2.0f * clip.z - clip.w) / clip.w;
+        return -(double)(ndc * 0.5f + 0.5f);
+    }
+    // Reverse-Z with GL_ZERO_TO_ONE into a 32-bit float buffer.
+    double ReverseDepth(const glm::mat4& projection, double distance){
+        glm::vec4 clip = projection * glm::vec4(0.0f, 0.0f, (float)-distance, 1.0f);
+        return -(double)(clip.z / clip.w);
+    }
+    // Smallest step beyond distance that changes the stored depth.
+    double ResolvableStep(DepthFunction depth, const glm::mat4& projection, double distance){
+        double base = depth(projection, distance);
+        double high = distance * 1e-7;
+        while (depth(projection, distance + high) == base && high < distance * 1e3){
+            high *= 2.0;
+        }
+        double low = 0.0;
+        for (int i = 0; i < 64; i++){
+            double middle = (low + high) * 0.5;
+            if (depth(projection, distance + middle) == base){
+                low = middle;
+            } else {
+                high = middle;
+            }
+        }
+        return high;
+    }
+}
+    void Camera::RunDepthMicrobenchmark(){
+        const float nearPlane = 0.1f;
+        const float farPlane = 100000.0f;
+        glm::mat4 standard = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, nearPlane, farPlane);
+        Camera camera;
+        camera.SetProjectionMatrix(glm::radians(45.0f), 16.0f / 9.0f, nearPlane);
+        glm::mat4 reverse = camera.GetProjectionMatrix();
+        std::cout << "Smallest resolvable depth step (near " << nearPlane << ", standard far " << farPlane << "):" << std::endl;
+        std::cout << "distance, standard 24-bit, reverse-Z float via -1..1, reverse-Z float 0..1" << std::endl;
+        const double distances[] = { 1.0, 10.0, 100.0, 1000.0, 10000.0, 50000.0 };
+        for (double distance : distances){
+            std::cout << distance << ", " << ResolvableStep(StandardDepth24, standard, distance) << ", "
+                      << ResolvableStep(ReverseDepthRemapped, reverse, distance) << ", "
+                      << ResolvableStep(ReverseDepth, reverse, distance) << std::endl;
+        }
+    }
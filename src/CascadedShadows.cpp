@@ -0,0 +1,252 @@
+#include "CascadedShadows.hpp"
+#include "Camera.hpp"
+#include "Simd.hpp"
+#include "Trace.hpp"
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+    // Distance toward the light past a cascade's sphere that casters still reach it from.
+    static const float kCasterReach = 20.0f;
+    // Split placement: 0 spaces cascades evenly, 1 logarithmically.
+    static const float kSplitBlend = 0.75f;
+
+    CascadedShadows::CascadedShadows(int resolution, float shadowDistance){
+        mResolution = resolution;
+        mShadowDistance = shadowDistance;
+        mTexture = 0;
+        mFramebuffer = 0;
+        for (int i = 0; i < kCascadeCount; i++){
+            mProjections[i] = glm::mat4(1.0f);
+            mCenterX[i] = mCenterY[i] = mFarZ[i] = mNearZ[i] = mSplitEnds[i] = 0.0f;
+            mHalfExtent[i] = mTexelSizes[i] = 1.0f;
+        }
+        SetLightDirection(glm::vec3(0.0f, -1.0f, 0.0f));
+    }
+
+    void CascadedShadows::SetLightDirection(const glm::vec3& direction){
+        mLightDirection = glm::normalize(direction);
+        glm::vec3 up = std::fabs(mLightDirection.y) > 0.99f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+        // Rotation only: each cascade's position goes into its projection, where it can be snapped.
+        mLightView = glm::lookAt(glm::vec3(0.0f), mLightDirection, up);
+    }
+
+    void CascadedShadows::Update(const Camera& camera){
+        TRACE_SCOPE("CascadedShadows::Update");
+        glm::mat4 projection = camera.GetProjectionMatrix();
+        // Camera's reverse-Z infinite projection keeps the near plane in [3][2].
+        float nearPlane = projection[3][2];
+        float tanHalfX = 1.0f / projection[0][0];
+        float tanHalfY = 1.0f / projection[1][1];
+        float spread = tanHalfX * tanHalfX + tanHalfY * tanHalfY;
+        glm::vec3 eye = camera.GetPosition();
+        glm::vec3 forward = glm::normalize(camera.GetViewDirection());
+        float start = nearPlane;
+        for (int i = 0; i < kCascadeCount; i++){
+            float t = (float)(i + 1) / kCascadeCount;
+            float end = kSplitBlend * nearPlane * std::pow(mShadowDistance / nearPlane, t)
+                      + (1.0f - kSplitBlend) * (nearPlane + (mShadowDistance - nearPlane) * t);
+            // Smallest sphere through the slice's near and far corners, centered on
+            // the view axis. It depends on distances alone, so turning never resizes it.
+            float centerDepth = std::min(0.5f * (start + end) * (1.0f + spread), end);
+            float radius = std::sqrt(std::max((end - centerDepth) * (end - centerDepth) + spread * end * end,
+                                              (centerDepth - start) * (centerDepth - start) + spread * start * start));
+            // Rounded up so float noise in the fit never changes the texel size.
+            radius = std::ceil(radius * 16.0f) / 16.0f;
+            float texel = 2.0f * radius / mResolution;
+            glm::vec3 center = glm::vec3(mLightView * glm::vec4(eye + forward * centerDepth, 1.0f));
+            float centerX = std::floor(center.x / texel) * texel;
+            float centerY = std::floor(center.y / texel) * texel;
+            float farZ = center.z - radius;
+            float nearZ = center.z + radius + kCasterReach;
+
+            glm::mat4 cascade(1.0f);
+            cascade[0][0] = 1.0f / radius;
+            cascade[1][1] = 1.0f / radius;
+            cascade[3][0] = -centerX / radius;
+            cascade[3][1] = -centerY / radius;
+            cascade[2][2] = 1.0f / (nearZ - farZ);
+            cascade[3][2] = -farZ / (nearZ - farZ);
+            mProjections[i] = cascade;
+            mCenterX[i] = centerX;
+            mCenterY[i] = centerY;
+            mHalfExtent[i] = radius;
+            mFarZ[i] = farZ;
+            mNearZ[i] = nearZ;
+            mSplitEnds[i] = end;
+            mTexelSizes[i] = texel;
+            start = end;
+        }
+    }
+
+    void CascadedShadows::CullCasters(const glm::vec4* spheres, size_t count, uint8_t* masks) const{
+        TRACE_SCOPE("CascadedShadows::CullCasters");
+        static_assert(kCascadeCount == 4, "one cascade per SIMD lane");
+        // Each sphere is moved to light space once and tested against every
+        // cascade at the same time, one lane each.
+        const Float4 zero = Float4Splat(0.0f);
+        const Float4 centerX = Float4Load(mCenterX);
+        const Float4 centerY = Float4Load(mCenterY);
+        const Float4 extent = Float4Load(mHalfExtent);
+        const Float4 farZ = Float4Load(mFarZ);
+        const Float4 nearZ = Float4Load(mNearZ);
+        const glm::mat4& view = mLightView;
+        for (size_t i = 0; i < count; i++){
+            const glm::vec4& sphere = spheres[i];
+            Float4 radius = Float4Splat(sphere.w);
+            Float4 x = Float4Splat(view[0][0] * sphere.x + view[1][0] * sphere.y + view[2][0] * sphere.z + view[3][0]);
+            Float4 y = Float4Splat(view[0][1] * sphere.x + view[1][1] * sphere.y + view[2][1] * sphere.z + view[3][1]);
+            Float4 z = Float4Splat(view[0][2] * sphere.x + view[1][2] * sphere.y + view[2][2] * sphere.z + view[3][2]);
+            Float4 dx = x - centerX;
+            Float4 dy = y - centerY;
+            Float4 reach = extent + radius;
+            Float4 inside = Float4And(Float4CmpLe(Float4Max(dx, zero - dx), reach), Float4CmpLe(Float4Max(dy, zero - dy), reach));
+            inside = Float4And(inside, Float4And(Float4CmpGe(z + radius, farZ), Float4CmpLe(z - radius, nearZ)));
+            masks[i] = (uint8_t)Float4MoveMask(inside);
+        }
+    }
+
+    bool CascadedShadows::Create(){
+        glGenTextures(1, &mTexture);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, mTexture);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT32F, mResolution, mResolution, kCascadeCount, 0,
+                     GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        // Outside the map reads depth 0, infinitely far from the light: lit.
+        const GLfloat border[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+        glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, border);
+        // Reverse-Z: lit when the fragment is at least as near the light as the stored depth.
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_GEQUAL);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+        glGenFramebuffers(1, &mFramebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, mFramebuffer);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, mTexture, 0, 0);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        if (status != GL_FRAMEBUFFER_COMPLETE){
+            std::cerr << "Shadow map framebuffer incomplete: 0x" << std::hex << status << std::dec << std::endl;
+            Destroy();
+            return false;
+        }
+        return true;
+    }
+
+    void CascadedShadows::Destroy(){
+        glDeleteFramebuffers(1, &mFramebuffer);
+        glDeleteTextures(1, &mTexture);
+        mFramebuffer = 0;
+        mTexture = 0;
+    }
+
+    void CascadedShadows::BeginCascade(int cascade){
+        glBindFramebuffer(GL_FRAMEBUFFER, mFramebuffer);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, mTexture, 0, cascade);
+        glViewport(0, 0, mResolution, mResolution);
+        glDepthMask(GL_TRUE);
+        glClear(GL_DEPTH_BUFFER_BIT);
+    }
+
+    CascadedShadows::Uniforms CascadedShadows::FindUniforms(GLuint program){
+        Uniforms uniforms;
+        uniforms.mShadowMap = glGetUniformLocation(program, "u_ShadowMap");
+        uniforms.mShadowMatrices = glGetUniformLocation(program, "u_ShadowMatrices");
+        uniforms.mCascadeEnds = glGetUniformLocation(program, "u_CascadeEnds");
+        uniforms.mCascadeTexels = glGetUniformLocation(program, "u_CascadeTexels");
+        uniforms.mShadowTexel = glGetUniformLocation(program, "u_ShadowTexel");
+        uniforms.mSunDirection = glGetUniformLocation(program, "u_SunDirection");
+        return uniforms;
+    }
+
+    void CascadedShadows::Bind(const Uniforms& uniforms, int unit, const glm::mat4& cameraView) const{
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, mTexture);
+        glActiveTexture(GL_TEXTURE0);
+        glUniform1i(uniforms.mShadowMap, unit);
+        // Camera view space straight to shadow map coordinates: x and y in 0..1, z the stored depth.
+        glm::mat4 toTexture(1.0f);
+        toTexture[0][0] = 0.5f;
+        toTexture[1][1] = 0.5f;
+        toTexture[3][0] = 0.5f;
+        toTexture[3][1] = 0.5f;
+        glm::mat4 viewToLight = mLightView * glm::inverse(cameraView);
+        glm::mat4 matrices[kCascadeCount];
+        for (int i = 0; i < kCascadeCount; i++){
+            matrices[i] = toTexture * mProjections[i] * viewToLight;
+        }
+        glUniformMatrix4fv(uniforms.mShadowMatrices, kCascadeCount, GL_FALSE, &matrices[0][0][0]);
+        glUniform4fv(uniforms.mCascadeEnds, 1, mSplitEnds);
+        glUniform4fv(uniforms.mCascadeTexels, 1, mTexelSizes);
+        glUniform1f(uniforms.mShadowTexel, 1.0f / mResolution);
+        glm::vec3 toLight = glm::mat3(cameraView) * -mLightDirection;
+        glUniform3f(uniforms.mSunDirection, toLight.x, toLight.y, toLight.z);
+    }
+
+    void CascadedShadows::RunMicrobenchmark(size_t casterCount){
+        // Casters scattered over a 400 x 400 unit district under a low sun, seen
+        // by a camera walking and turning at street level.
+        std::minstd_rand random(13);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        std::vector<glm::vec4> spheres(casterCount);
+        for (glm::vec4& sphere : spheres){
+            sphere = glm::vec4(400.0f * unit(random) - 200.0f, 10.0f * unit(random), 400.0f * unit(random) - 200.0f, 0.5f + 4.0f * unit(random));
+        }
+        std::vector<uint8_t> masks(casterCount);
+        CascadedShadows shadows(2048, 100.0f);
+        shadows.SetLightDirection(glm::vec3(0.5f, -0.6f, 0.3f));
+        Camera camera;
+        camera.SetProjectionMatrix(glm::radians(60.0f), 16.0f / 9.0f, 0.1f);
+
+        const int kFrames = 200;
+        double fitMilliseconds = 0.0;
+        double cullMilliseconds = 0.0;
+        size_t casters[kCascadeCount] = {};
+        float largestOffset = 0.0f;
+        float previousExtent[kCascadeCount] = {};
+        int extentChanges = 0;
+        for (int frame = 0; frame < kFrames; frame++){
+            // Sub-texel steps and a slow turn.
+            float yaw = 0.01f * frame;
+            camera.SetPosition(glm::vec3(0.013f * frame, 1.7f, -0.021f * frame));
+            camera.SetViewDirection(glm::vec3(std::sin(yaw), -0.1f, -std::cos(yaw)));
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            shadows.Update(camera);
+            std::chrono::steady_clock::time_point fitted = std::chrono::steady_clock::now();
+            shadows.CullCasters(spheres.data(), spheres.size(), masks.data());
+            std::chrono::steady_clock::time_point culled = std::chrono::steady_clock::now();
+            fitMilliseconds += std::chrono::duration<double, std::milli>(fitted - start).count();
+            cullMilliseconds += std::chrono::duration<double, std::milli>(culled - fitted).count();
+            for (size_t i = 0; i < casterCount; i++){
+                for (int c = 0; c < kCascadeCount; c++){
+                    casters[c] += (masks[i] >> c) & 1;
+                }
+            }
+            for (int c = 0; c < kCascadeCount; c++){
+                // How far off the texel grid the cascade's origin lands.
+                float origin = shadows.mCenterX[c] / shadows.mTexelSizes[c];
+                largestOffset = std::max(largestOffset, std::fabs(origin - std::round(origin)));
+                extentChanges += frame > 0 && shadows.mHalfExtent[c] != previousExtent[c];
+                previousExtent[c] = shadows.mHalfExtent[c];
+            }
+        }
+        std::cout << kCascadeCount << " cascades at " << shadows.mResolution << "^2 over " << shadows.mShadowDistance
+                  << " units, " << casterCount << " casters, " << kFrames << " frames" << std::endl;
+        std::cout << "Fit: " << 1000.0 * fitMilliseconds / kFrames << " us/frame; cascade origin at most " << largestOffset
+                  << " texels off the grid, extent changed " << extentChanges << " times while turning" << std::endl;
+        std::cout << "Caster culling, one pass for all cascades: " << cullMilliseconds / kFrames << " ms/frame ("
+                  << 1e6 * cullMilliseconds / kFrames / casterCount << " ns/caster); casters per cascade:";
+        for (int c = 0; c < kCascadeCount; c++){
+            std::cout << " " << casters[c] / kFrames;
+        }
+        std::cout << std::endl;
+    }
@@ -0,0 +1,314 @@
+#include "ClusteredLighting.hpp"
+#include "Camera.hpp"
+#include "JobSystem.hpp"
+#include "Simd.hpp"
+#include "Trace.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+    ClusteredLighting::ClusteredLighting(JobSystem* jobs, float sliceFar){
+        mJobs = jobs != nullptr ? jobs : &JobSystem::Shared();
+        mSliceFar = sliceFar;
+        mNear = 0.1f;
+        mSliceScale = 1.0f;
+        mLights = nullptr;
+        mVisibleCount = 0;
+        mSliceIndices.resize(kClustersZ);
+        mClusters.assign((size_t)kClusterCount * 2, 0);
+        for (int i = 0; i < 3; i++){
+            mBuffers[i] = 0;
+            mTextures[i] = 0;
+        }
+    }
+
+    int ClusteredLighting::GetSlice(float depth) const{
+        int slice = (int)std::floor(std::log(depth / mNear) * mSliceScale);
+        return std::min(std::max(slice, 0), kClustersZ - 1);
+    }
+
+    void ClusteredLighting::Build(const Camera& camera, const std::vector<PointLight>& lights){
+        TRACE_SCOPE("ClusteredLighting::Build");
+        // Camera's reverse-Z infinite projection keeps the near plane in [3][2].
+        glm::mat4 projection = camera.GetProjectionMatrix();
+        mNear = projection[3][2];
+        mSliceScale = kClustersZ / std::log(mSliceFar / mNear);
+        float tanHalfX = 1.0f / projection[0][0];
+        float tanHalfY = 1.0f / projection[1][1];
+        for (int i = 0; i <= kClustersX; i++){
+            mTileX[i] = (2.0f * i / kClustersX - 1.0f) * tanHalfX;
+            mTileXScale[i] = 1.0f / std::sqrt(1.0f + mTileX[i] * mTileX[i]);
+        }
+        for (int i = 0; i <= kClustersY; i++){
+            mTileY[i] = (2.0f * i / kClustersY - 1.0f) * tanHalfY;
+            mTileYScale[i] = 1.0f / std::sqrt(1.0f + mTileY[i] * mTileY[i]);
+        }
+
+        mLights = &lights;
+        size_t padded = (lights.size() + 3) & ~(size_t)3;
+        mLightData.resize(lights.size() * 2);
+        mLightBounds.resize(padded);
+        mLightVisible.resize(padded);
+        glm::mat4 view = camera.GetViewMatrix();
+        mJobs->ParallelFor(padded / 4, 256, [this, &view](size_t begin, size_t end){
+            BoundLights(view, begin * 4, end * 4);
+        });
+        mBounds.clear();
+        for (size_t i = 0; i < lights.size(); i++){
+            if (mLightVisible[i]){
+                mBounds.push_back(mLightBounds[i]);
+            }
+        }
+        mVisibleCount = mBounds.size();
+        // Bucket the visible lights by the slices they span, so each slice job
+        // only walks its own.
+        uint32_t sliceStarts[kClustersZ + 1] = {};
+        for (const LightBounds& bounds : mBounds){
+            for (int slice = bounds.mZ0; slice <= bounds.mZ1; slice++){
+                sliceStarts[slice + 1]++;
+            }
+        }
+        for (int slice = 0; slice < kClustersZ; slice++){
+            sliceStarts[slice + 1] += sliceStarts[slice];
+            mSliceLightStart[slice] = sliceStarts[slice];
+        }
+        mSliceLightStart[kClustersZ] = sliceStarts[kClustersZ];
+        mSliceLights.resize(sliceStarts[kClustersZ]);
+        for (uint32_t i = 0; i < (uint32_t)mBounds.size(); i++){
+            for (int slice = mBounds[i].mZ0; slice <= mBounds[i].mZ1; slice++){
+                mSliceLights[sliceStarts[slice]++] = i;
+            }
+        }
+
+        mJobs->ParallelFor(kClustersZ, 1, [this](size_t begin, size_t end){
+            for (size_t slice = begin; slice < end; slice++){
+                FillSlice((int)slice);
+            }
+        });
+        // Slices were filled with offsets into their own lists.
+        mIndices.clear();
+        const size_t sliceClusters = (size_t)kClustersX * kClustersY;
+        for (int slice = 0; slice < kClustersZ; slice++){
+            uint32_t base = (uint32_t)mIndices.size();
+            for (size_t cluster = slice * sliceClusters; cluster < (slice + 1) * sliceClusters; cluster++){
+                mClusters[cluster * 2] += base;
+            }
+            mIndices.insert(mIndices.end(), mSliceIndices[slice].begin(), mSliceIndices[slice].end());
+        }
+    }
+
+    void ClusteredLighting::BoundLights(const glm::mat4& view, size_t begin, size_t end){
+        const std::vector<PointLight>& lights = *mLights;
+        const Float4 zero = Float4Splat(0.0f);
+        const Float4 one = Float4Splat(1.0f);
+        for (size_t first = begin; first < end; first += 4){
+            float world[3][4];
+            float radii[4];
+            for (int lane = 0; lane < 4; lane++){
+                // Padding lanes get a negative radius, which rejects them.
+                size_t i = first + lane;
+                const PointLight* light = i < lights.size() ? &lights[i] : nullptr;
+                for (int axis = 0; axis < 3; axis++){
+                    world[axis][lane] = light != nullptr ? light->mPosition[axis] : 0.0f;
+                }
+                radii[lane] = light != nullptr ? light->mRadius : -1.0f;
+            }
+            Float4 wx = Float4Load(world[0]);
+            Float4 wy = Float4Load(world[1]);
+            Float4 wz = Float4Load(world[2]);
+            Float4 radius = Float4Load(radii);
+            Float4 negRadius = zero - radius;
+            Float4 x = Float4Splat(view[0][0]) * wx + Float4Splat(view[1][0]) * wy + Float4Splat(view[2][0]) * wz + Float4Splat(view[3][0]);
+            Float4 y = Float4Splat(view[0][1]) * wx + Float4Splat(view[1][1]) * wy + Float4Splat(view[2][1]) * wz + Float4Splat(view[3][1]);
+            Float4 z = Float4Splat(view[0][2]) * wx + Float4Splat(view[1][2]) * wy + Float4Splat(view[2][2]) * wz + Float4Splat(view[3][2]);
+            Float4 depth = zero - z;
+            Float4 visible = Float4And(Float4CmpGe(radius, zero), Float4CmpGt(depth + radius, Float4Splat(mNear)));
+
+            // The sphere starts in the column after every tile plane it lies wholly
+            // to the right of and ends before every one it lies wholly left of.
+            // Counting planes stays conservative for spheres reaching behind the eye.
+            Float4 x0 = zero;
+            Float4 x1 = Float4Splat((float)(kClustersX - 1));
+            for (int i = 0; i <= kClustersX; i++){
+                Float4 distance = (x + Float4Splat(mTileX[i]) * z) * Float4Splat(mTileXScale[i]);
+                if (i == 0){
+                    visible = Float4And(visible, Float4CmpGe(distance, negRadius));
+                } else if (i == kClustersX){
+                    visible = Float4And(visible, Float4CmpLe(distance, radius));
+                } else {
+                    x0 = x0 + Float4And(Float4CmpGt(distance, radius), one);
+                    x1 = x1 - Float4And(Float4CmpLt(distance, negRadius), one);
+                }
+            }
+            Float4 y0 = zero;
+            Float4 y1 = Float4Splat((float)(kClustersY - 1));
+            for (int i = 0; i <= kClustersY; i++){
+                Float4 distance = (y + Float4Splat(mTileY[i]) * z) * Float4Splat(mTileYScale[i]);
+                if (i == 0){
+                    visible = Float4And(visible, Float4CmpGe(distance, negRadius));
+                } else if (i == kClustersY){
+                    visible = Float4And(visible, Float4CmpLe(distance, radius));
+                } else {
+                    y0 = y0 + Float4And(Float4CmpGt(distance, radius), one);
+                    y1 = y1 - Float4And(Float4CmpLt(distance, negRadius), one);
+                }
+            }
+
+            int visibleMask = Float4MoveMask(visible);
+            float lanes[7][4];
+            Float4Store(lanes[0], x);
+            Float4Store(lanes[1], y);
+            Float4Store(lanes[2], depth);
+            Float4Store(lanes[3], x0);
+            Float4Store(lanes[4], x1);
+            Float4Store(lanes[5], y0);
+            Float4Store(lanes[6], y1);
+            for (int lane = 0; lane < 4; lane++){
+                size_t i = first + lane;
+                if (i >= lights.size()){
+                    break;
+                }
+                float laneDepth = lanes[2][lane];
+                mLightData[i * 2] = glm::vec4(lanes[0][lane], lanes[1][lane], -laneDepth, radii[lane]);
+                mLightData[i * 2 + 1] = glm::vec4(lights[i].mColor, 0.0f);
+                mLightVisible[i] = (visibleMask >> lane) & 1;
+                if (!mLightVisible[i]){
+                    continue;
+                }
+                LightBounds& bounds = mLightBounds[i];
+                bounds.mLight = (uint32_t)i;
+                bounds.mX0 = (uint8_t)lanes[3][lane];
+                bounds.mX1 = (uint8_t)lanes[4][lane];
+                bounds.mY0 = (uint8_t)lanes[5][lane];
+                bounds.mY1 = (uint8_t)lanes[6][lane];
+                bounds.mZ0 = (uint8_t)GetSlice(std::max(laneDepth - radii[lane], mNear));
+                bounds.mZ1 = (uint8_t)GetSlice(laneDepth + radii[lane]);
+            }
+        }
+    }
+
+    void ClusteredLighting::FillSlice(int slice){
+        const int sliceClusters = kClustersX * kClustersY;
+        uint32_t* clusters = &mClusters[(size_t)slice * sliceClusters * 2];
+        std::fill(clusters, clusters + sliceClusters * 2, 0u);
+        const uint32_t* first = mSliceLights.data() + mSliceLightStart[slice];
+        const uint32_t* last = mSliceLights.data() + mSliceLightStart[slice + 1];
+        for (const uint32_t* light = first; light != last; light++){
+            const LightBounds& bounds = mBounds[*light];
+            for (int y = bounds.mY0; y <= bounds.mY1; y++){
+                for (int x = bounds.mX0; x <= bounds.mX1; x++){
+                    clusters[(y * kClustersX + x) * 2 + 1]++;
+                }
+            }
+        }
+        uint32_t offset = 0;
+        for (int cluster = 0; cluster < sliceClusters; cluster++){
+            clusters[cluster * 2] = offset;
+            offset += clusters[cluster * 2 + 1];
+            clusters[cluster * 2 + 1] = 0;
+        }
+        std::vector<uint32_t>& indices = mSliceIndices[slice];
+        indices.resize(offset);
+        for (const uint32_t* light = first; light != last; light++){
+            const LightBounds& bounds = mBounds[*light];
+            for (int y = bounds.mY0; y <= bounds.mY1; y++){
+                for (int x = bounds.mX0; x <= bounds.mX1; x++){
+                    uint32_t* cluster = &clusters[(y * kClustersX + x) * 2];
+                    indices[cluster[0] + cluster[1]++] = bounds.mLight;
+                }
+            }
+        }
+    }
+
+    void ClusteredLighting::Create(){
+        static const GLenum kFormats[3] = { GL_RGBA32F, GL_RG32UI, GL_R32UI };
+        glGenBuffers(3, mBuffers);
+        glGenTextures(3, mTextures);
+        for (int i = 0; i < 3; i++){
+            glBindBuffer(GL_TEXTURE_BUFFER, mBuffers[i]);
+            glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+            glBindTexture(GL_TEXTURE_BUFFER, mTextures[i]);
+            glTexBuffer(GL_TEXTURE_BUFFER, kFormats[i], mBuffers[i]);
+        }
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+
+    void ClusteredLighting::Destroy(){
+        glDeleteTextures(3, mTextures);
+        glDeleteBuffers(3, mBuffers);
+        for (int i = 0; i < 3; i++){
+            mBuffers[i] = 0;
+            mTextures[i] = 0;
+        }
+    }
+
+    void ClusteredLighting::Upload(){
+        TRACE_SCOPE("ClusteredLighting::Upload");
+        const void* data[3] = { mLightData.data(), mClusters.data(), mIndices.data() };
+        size_t sizes[3] = { mLightData.size() * sizeof(glm::vec4), mClusters.size() * sizeof(uint32_t), mIndices.size() * sizeof(uint32_t) };
+        for (int i = 0; i < 3; i++){
+            // Orphaned every frame so the driver never waits on the last frame's copy.
+            glBindBuffer(GL_TEXTURE_BUFFER, mBuffers[i]);
+            glBufferData(GL_TEXTURE_BUFFER, std::max(sizes[i], (size_t)16), nullptr, GL_STREAM_DRAW);
+            glBufferSubData(GL_TEXTURE_BUFFER, 0, sizes[i], data[i]);
+        }
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+
+    ClusteredLighting::Uniforms ClusteredLighting::FindUniforms(GLuint program){
+        static const char* kSamplers[3] = { "u_Lights", "u_LightClusters", "u_LightIndices" };
+        Uniforms uniforms;
+        for (int i = 0; i < 3; i++){
+            uniforms.mSamplers[i] = glGetUniformLocation(program, kSamplers[i]);
+        }
+        uniforms.mClusterCount = glGetUniformLocation(program, "u_ClusterCount");
+        uniforms.mClusterScale = glGetUniformLocation(program, "u_ClusterScale");
+        return uniforms;
+    }
+
+    void ClusteredLighting::Bind(const Uniforms& uniforms, int firstUnit, int screenWidth, int screenHeight) const{
+        for (int i = 0; i < 3; i++){
+            glActiveTexture(GL_TEXTURE0 + firstUnit + i);
+            glBindTexture(GL_TEXTURE_BUFFER, mTextures[i]);
+            glUniform1i(uniforms.mSamplers[i], firstUnit + i);
+        }
+        glActiveTexture(GL_TEXTURE0);
+        glUniform3i(uniforms.mClusterCount, kClustersX, kClustersY, kClustersZ);
+        glUniform4f(uniforms.mClusterScale, (float)kClustersX / screenWidth, (float)kClustersY / screenHeight,
+                    mSliceScale, -std::log(mNear) * mSliceScale);
+    }
+
+    void ClusteredLighting::RunMicrobenchmark(int iterations){
+        // Lights scattered over a 400 x 400 unit district in front of a camera
+        // at street level, the far ones binned into the last slice.
+        Camera camera;
+        camera.SetProjectionMatrix(glm::radians(60.0f), 16.0f / 9.0f, 0.1f);
+        camera.SetPosition(glm::vec3(0.0f, 2.0f, 0.0f));
+        camera.SetViewDirection(glm::vec3(0.0f, 0.0f, -1.0f));
+        ClusteredLighting lighting;
+        std::cout << kClustersX << "x" << kClustersY << "x" << kClustersZ << " clusters, "
+                  << JobSystem::Shared().GetThreadCount() << " threads" << std::endl;
+        for (size_t count = 1024; count <= 65536; count *= 4){
+            std::minstd_rand random(11);
+            std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+            std::vector<PointLight> lights(count);
+            for (PointLight& light : lights){
+                light.mPosition = glm::vec3(400.0f * unit(random) - 200.0f, 12.0f * unit(random), -400.0f * unit(random) + 20.0f);
+                light.mRadius = 1.0f + 7.0f * unit(random);
+                light.mColor = glm::vec3(unit(random), unit(random), unit(random));
+            }
+            lighting.Build(camera, lights);
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for (int i = 0; i < iterations; i++){
+                lighting.Build(camera, lights);
+            }
+            double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+            size_t visible = lighting.GetVisibleLightCount();
+            std::cout << count << " lights: " << milliseconds << " ms to bin, " << visible << " in the frustum, "
+                      << lighting.GetReferenceCount() << " cluster references ("
+                      << (visible > 0 ? (double)lighting.GetReferenceCount() / visible : 0.0) << " per light)" << std::endl;
+        }
+    }
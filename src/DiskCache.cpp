@@ -0,0 +1,35 @@
+#include "DiskCache.hpp"
+#include <sys/stat.h>
+#include <cstdio>
+#include <iostream>
+
+    uint64_t DiskCache::Hash(const void* data, size_t size, uint64_t hash){
+        const uint8_t* bytes = (const uint8_t*)data;
+        for (size_t i = 0; i < size; i++){
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+        }
+        return hash;
+    }
+
+    std::string DiskCache::GetPath(const std::string& directory, uint64_t hash, const char* extension){
+        char name[48];
+        snprintf(name, sizeof(name), "%016llx.%s", (unsigned long long)hash, extension);
+        return directory + "/" + name;
+    }
+
+    bool DiskCache::Write(const std::string& path, const std::function<void(std::ofstream&)>& write){
+        size_t slash = path.find_last_of('/');
+        if (slash != std::string::npos){
+            mkdir(path.substr(0, slash).c_str(), 0755);
+        }
+        std::string temporaryPath = path + ".tmp";
+        std::ofstream file(temporaryPath, std::ios::binary);
+        write(file);
+        file.close();
+        if (!file || rename(temporaryPath.c_str(), path.c_str()) != 0){
+            std::cout << "Could not write cache file " << path << std::endl;
+            remove(temporaryPath.c_str());
+            return false;
+        }
+        return true;
+    }
@@ -0,0 +1,641 @@
+#include "FrameGraph.hpp"
+#include "Trace.hpp"
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <iostream>
+#include <random>
+
+    static size_t BytesPerPixel(GLenum format){
+        switch (format){
+            case GL_NONE: return 0;
+            case GL_R8: return 1;
+            case GL_RG16F: return 4;
+            case GL_RGBA16F: return 8;
+            case GL_RGBA32F: return 16;
+            default: return 4;    // GL_RGBA8, GL_R11F_G11F_B10F, GL_DEPTH_COMPONENT32F
+        }
+    }
+
+    static const char* GetFormatName(GLenum format){
+        switch (format){
+            case GL_R8: return "R8";
+            case GL_RG16F: return "RG16F";
+            case GL_RGBA8: return "RGBA8";
+            case GL_RGBA16F: return "RGBA16F";
+            case GL_RGBA32F: return "RGBA32F";
+            case GL_R11F_G11F_B10F: return "R11G11B10F";
+            case GL_DEPTH_COMPONENT32F: return "D32F";
+            default: return "?";
+        }
+    }
+
+    static bool SameTexture(const FrameGraphResourceDesc& a, const FrameGraphResourceDesc& b){
+        return a.mWidth == b.mWidth && a.mHeight == b.mHeight && a.mFormat == b.mFormat && a.mDepthFormat == b.mDepthFormat;
+    }
+
+    void FrameGraph::Reset(){
+        mPasses.clear();
+        mResources.clear();
+        mOrder.clear();
+        mSlots.clear();
+        mTargetSwitches = 0;
+        mDeclaredTargetSwitches = 0;
+    }
+
+    int FrameGraph::AddResource(const std::string& name, const FrameGraphResourceDesc& desc){
+        mResources.emplace_back();
+        mResources.back().mName = name;
+        mResources.back().mDesc = desc;
+        return (int)mResources.size() - 1;
+    }
+
+    int FrameGraph::CreateTexture(const std::string& name, int width, int height, GLenum format, GLenum depthFormat){
+        FrameGraphResourceDesc desc;
+        desc.mWidth = width;
+        desc.mHeight = height;
+        desc.mFormat = format;
+        desc.mDepthFormat = depthFormat;
+        return AddResource(name, desc);
+    }
+
+    int FrameGraph::CreateBuffer(const std::string& name, size_t byteSize){
+        FrameGraphResourceDesc desc;
+        desc.mByteSize = byteSize;
+        return AddResource(name, desc);
+    }
+
+    int FrameGraph::Import(const std::string& name, const FrameGraphResourceDesc& desc){
+        int resource = AddResource(name, desc);
+        mResources[resource].mDesc.mImported = true;
+        return resource;
+    }
+
+    int FrameGraph::AddPass(const std::string& name, std::function<void()> execute){
+        mPasses.emplace_back();
+        mPasses.back().mName = name;
+        mPasses.back().mExecute = std::move(execute);
+        return (int)mPasses.size() - 1;
+    }
+
+    void FrameGraph::Read(int pass, int resource){
+        mPasses[pass].mReads.push_back(resource);
+    }
+
+    void FrameGraph::Write(int pass, int resource){
+        mPasses[pass].mWrites.push_back(resource);
+    }
+
+    void FrameGraph::SetSideEffect(int pass){
+        mPasses[pass].mSideEffect = true;
+    }
+
+    size_t FrameGraph::GetByteSize(const FrameGraphResourceDesc& desc){
+        if (desc.mWidth > 0){
+            return (size_t)desc.mWidth * desc.mHeight * (BytesPerPixel(desc.mFormat) + BytesPerPixel(desc.mDepthFormat));
+        }
+        return desc.mByteSize;
+    }
+
+    std::vector<int> FrameGraph::GetTargets(int pass) const{
+        std::vector<int> targets;
+        for (int resource : mPasses[pass].mWrites){
+            if (IsTexture(resource)){
+                targets.push_back(resource);
+            }
+        }
+        std::sort(targets.begin(), targets.end());
+        targets.erase(std::unique(targets.begin(), targets.end()), targets.end());
+        return targets;
+    }
+
+    void FrameGraph::Compile(){
+        TRACE_SCOPE("FrameGraph::Compile");
+        Cull();
+        Schedule();
+        PlaceResources();
+    }
+
+    // Walks the passes backwards tracking which resources still have a reader
+    // ahead. A pass that writes none of them (nor an import) is culled; a pass
+    // that is kept makes what it reads live, and what it only writes dead
+    // before it, since it replaces the contents.
+    void FrameGraph::Cull(){
+        std::vector<char> live(mResources.size(), 0);
+        for (int i = (int)mPasses.size() - 1; i >= 0; i--){
+            Pass& pass = mPasses[i];
+            bool needed = pass.mSideEffect;
+            for (int resource : pass.mWrites){
+                needed = needed || live[resource] || mResources[resource].mDesc.mImported;
+            }
+            pass.mCulled = !needed;
+            if (!needed){
+                continue;
+            }
+            for (int resource : pass.mWrites){
+                live[resource] = 0;
+            }
+            for (int resource : pass.mReads){
+                live[resource] = 1;
+            }
+        }
+    }
+
+    // Declaration order decides which write a read sees: a read depends on the
+    // last writer before it, a write on the last writer and on every reader
+    // since.
+    void FrameGraph::BuildDependencies(std::vector<std::vector<int>>& successors) const{
+        successors.assign(mPasses.size(), std::vector<int>());
+        std::vector<int> lastWriter(mResources.size(), -1);
+        std::vector<std::vector<int>> readers(mResources.size());
+        auto depend = [&successors](int before, int after){
+            if (before >= 0 && before != after){
+                successors[before].push_back(after);
+            }
+        };
+        for (int i = 0; i < (int)mPasses.size(); i++){
+            const Pass& pass = mPasses[i];
+            if (pass.mCulled){
+                continue;
+            }
+            for (int resource : pass.mReads){
+                depend(lastWriter[resource], i);
+                readers[resource].push_back(i);
+            }
+            for (int resource : pass.mWrites){
+                depend(lastWriter[resource], i);
+                for (int reader : readers[resource]){
+                    depend(reader, i);
+                }
+                lastWriter[resource] = i;
+                readers[resource].clear();
+            }
+        }
+        for (std::vector<int>& list : successors){
+            std::sort(list.begin(), list.end());
+            list.erase(std::unique(list.begin(), list.end()), list.end());
+        }
+    }
+
+    // Topological order that picks among the passes ready to run, in turn: one
+    // drawing to the same targets as the pass before; one that is the last
+    // writer of all its targets, so they are finished before another target
+    // is started; the first declared.
+    void FrameGraph::Schedule(){
+        std::vector<std::vector<int>> successors;
+        BuildDependencies(successors);
+        std::vector<int> waiting(mPasses.size(), 0);
+        for (const std::vector<int>& list : successors){
+            for (int pass : list){
+                waiting[pass]++;
+            }
+        }
+        std::vector<int> writers(mResources.size(), 0);
+        std::vector<std::vector<int>> targets(mPasses.size());
+        std::vector<int> ready;
+        for (int i = 0; i < (int)mPasses.size(); i++){
+            if (mPasses[i].mCulled){
+                continue;
+            }
+            targets[i] = GetTargets(i);
+            for (int resource : targets[i]){
+                writers[resource]++;
+            }
+            if (waiting[i] == 0){
+                ready.push_back(i);
+            }
+        }
+
+        mOrder.clear();
+        const std::vector<int>* bound = nullptr;
+        while (!ready.empty()){
+            size_t best = 0;
+            int bestRank = INT_MAX;
+            for (size_t i = 0; i < ready.size(); i++){
+                const std::vector<int>& candidate = targets[ready[i]];
+                int rank = 2;
+                if (bound != nullptr && !candidate.empty() && candidate == *bound){
+                    rank = 0;
+                } else if (std::all_of(candidate.begin(), candidate.end(), [&writers](int resource){ return writers[resource] == 1; })){
+                    rank = 1;
+                }
+                if (rank < bestRank || (rank == bestRank && ready[i] < ready[best])){
+                    best = i;
+                    bestRank = rank;
+                }
+            }
+            int pass = ready[best];
+            ready.erase(ready.begin() + best);
+            mOrder.push_back(pass);
+            for (int resource : targets[pass]){
+                writers[resource]--;
+            }
+            if (!targets[pass].empty()){
+                bound = &targets[pass];
+            }
+            for (int next : successors[pass]){
+                if (--waiting[next] == 0){
+                    ready.push_back(next);
+                }
+            }
+        }
+
+        auto countSwitches = [&targets](const std::vector<int>& order){
+            int switches = 0;
+            const std::vector<int>* current = nullptr;
+            for (int pass : order){
+                if (!targets[pass].empty() && (current == nullptr || *current != targets[pass])){
+                    switches++;
+                    current = &targets[pass];
+                }
+            }
+            return switches;
+        };
+        std::vector<int> declared;
+        for (int i = 0; i < (int)mPasses.size(); i++){
+            if (!mPasses[i].mCulled){
+                declared.push_back(i);
+            }
+        }
+        mTargetSwitches = countSwitches(mOrder);
+        mDeclaredTargetSwitches = countSwitches(declared);
+    }
+
+    // Lifetimes in the compiled order, then, by first use, every transient goes
+    // to the first slot free by then that fits it: a texture of the same size and
+    // formats, or any buffer slot, which grows to the largest buffer it holds.
+    void FrameGraph::PlaceResources(){
+        for (Resource& resource : mResources){
+            resource.mSlot = -1;
+            resource.mFirstUse = -1;
+            resource.mLastUse = -1;
+        }
+        for (int position = 0; position < (int)mOrder.size(); position++){
+            const Pass& pass = mPasses[mOrder[position]];
+            for (const std::vector<int>* list : { &pass.mReads, &pass.mWrites }){
+                for (int index : *list){
+                    Resource& resource = mResources[index];
+                    if (resource.mFirstUse < 0){
+                        resource.mFirstUse = position;
+                    }
+                    resource.mLastUse = position;
+                }
+            }
+        }
+        std::vector<int> byFirstUse;
+        for (int i = 0; i < (int)mResources.size(); i++){
+            if (mResources[i].mFirstUse >= 0){
+                byFirstUse.push_back(i);
+            }
+        }
+        std::stable_sort(byFirstUse.begin(), byFirstUse.end(), [this](int a, int b){
+            return mResources[a].mFirstUse < mResources[b].mFirstUse;
+        });
+        mSlots.clear();
+        for (int index : byFirstUse){
+            Resource& resource = mResources[index];
+            int slot = -1;
+            if (!resource.mDesc.mImported){
+                for (int i = 0; i < (int)mSlots.size() && slot < 0; i++){
+                    const Slot& candidate = mSlots[i];
+                    bool fits = IsTexture(index) ? SameTexture(candidate.mDesc, resource.mDesc) : candidate.mDesc.mWidth == 0;
+                    if (!candidate.mDesc.mImported && fits && candidate.mFreeAfter < resource.mFirstUse){
+                        slot = i;
+                    }
+                }
+            }
+            if (slot < 0){
+                mSlots.push_back({ resource.mDesc, -1 });
+                slot = (int)mSlots.size() - 1;
+            }
+            mSlots[slot].mDesc.mByteSize = std::max(mSlots[slot].mDesc.mByteSize, resource.mDesc.mByteSize);
+            mSlots[slot].mFreeAfter = resource.mDesc.mImported ? INT_MAX : resource.mLastUse;
+            resource.mSlot = slot;
+        }
+    }
+
+    void FrameGraph::Execute(FrameGraphBackend& backend) const{
+        TRACE_SCOPE("FrameGraph::Execute");
+        std::vector<int> slotOwner(mSlots.size(), -1);
+        std::vector<int> slotLastUse(mSlots.size(), -1);
+        for (const Resource& resource : mResources){
+            if (resource.mSlot >= 0){
+                slotLastUse[resource.mSlot] = std::max(slotLastUse[resource.mSlot], resource.mLastUse);
+            }
+        }
+        std::vector<FrameGraphBackend::Access> access(mResources.size(), FrameGraphBackend::kNone);
+        std::vector<int> targetSlots;
+        for (int position = 0; position < (int)mOrder.size(); position++){
+            int index = mOrder[position];
+            const Pass& pass = mPasses[index];
+            // Resources starting here take over their slot: the first acquires it,
+            // later ones inherit whatever the last one left.
+            for (const std::vector<int>* list : { &pass.mReads, &pass.mWrites }){
+                for (int resource : *list){
+                    int slot = mResources[resource].mSlot;
+                    if (mResources[resource].mFirstUse != position || slotOwner[slot] == resource){
+                        continue;
+                    }
+                    if (slotOwner[slot] < 0){
+                        backend.AcquireSlot(slot, mSlots[slot].mDesc);
+                    } else {
+                        backend.Barrier(slot, access[slotOwner[slot]], FrameGraphBackend::kNone);
+                    }
+                    slotOwner[slot] = resource;
+                }
+            }
+            for (int resource : pass.mReads){
+                bool written = std::find(pass.mWrites.begin(), pass.mWrites.end(), resource) != pass.mWrites.end();
+                if (!written && access[resource] != FrameGraphBackend::kRead){
+                    backend.Barrier(mResources[resource].mSlot, access[resource], FrameGraphBackend::kRead);
+                    access[resource] = FrameGraphBackend::kRead;
+                }
+            }
+            for (int resource : pass.mWrites){
+                if (access[resource] != FrameGraphBackend::kWrite){
+                    backend.Barrier(mResources[resource].mSlot, access[resource], FrameGraphBackend::kWrite);
+                    access[resource] = FrameGraphBackend::kWrite;
+                }
+            }
+            targetSlots.clear();
+            for (int resource : GetTargets(index)){
+                targetSlots.push_back(mResources[resource].mSlot);
+            }
+            backend.BeginPass(pass.mName, targetSlots);
+            if (pass.mExecute){
+                pass.mExecute();
+            }
+            for (int slot = 0; slot < (int)mSlots.size(); slot++){
+                if (slotLastUse[slot] == position){
+                    backend.ReleaseSlot(slot);
+                }
+            }
+        }
+    }
+
+    bool FrameGraph::Validate(std::string* error) const{
+        std::vector<int> position(mPasses.size(), -1);
+        for (int i = 0; i < (int)mOrder.size(); i++){
+            position[mOrder[i]] = i;
+        }
+        for (int i = 0; i < (int)mPasses.size(); i++){
+            if (mPasses[i].mCulled != (position[i] < 0)){
+                *error = "pass " + mPasses[i].mName + (position[i] < 0 ? " neither culled nor scheduled" : " culled but scheduled");
+                return false;
+            }
+        }
+        std::vector<std::vector<int>> successors;
+        BuildDependencies(successors);
+        for (int i = 0; i < (int)mPasses.size(); i++){
+            for (int next : successors[i]){
+                if (position[next] <= position[i]){
+                    *error = "pass " + mPasses[next].mName + " runs before " + mPasses[i].mName;
+                    return false;
+                }
+            }
+        }
+        for (size_t a = 0; a < mResources.size(); a++){
+            for (size_t b = a + 1; b < mResources.size(); b++){
+                const Resource& first = mResources[a];
+                const Resource& second = mResources[b];
+                if (first.mSlot >= 0 && first.mSlot == second.mSlot && first.mFirstUse <= second.mLastUse && second.mFirstUse <= first.mLastUse){
+                    *error = first.mName + " and " + second.mName + " share a slot while both alive";
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    size_t FrameGraph::GetUnaliasedBytes() const{
+        size_t bytes = 0;
+        for (const Resource& resource : mResources){
+            if (resource.mSlot >= 0 && !resource.mDesc.mImported){
+                bytes += GetByteSize(resource.mDesc);
+            }
+        }
+        return bytes;
+    }
+
+    size_t FrameGraph::GetAliasedBytes() const{
+        size_t bytes = 0;
+        for (const Slot& slot : mSlots){
+            if (!slot.mDesc.mImported){
+                bytes += GetByteSize(slot.mDesc);
+            }
+        }
+        return bytes;
+    }
+
+    void RecordingFrameGraphBackend::AcquireSlot(int slot, const FrameGraphResourceDesc& desc){
+        char line[96];
+        if (desc.mImported){
+            snprintf(line, sizeof(line), "acquire s%d imported", slot);
+        } else if (desc.mWidth > 0){
+            std::string formats = desc.mFormat != GL_NONE ? GetFormatName(desc.mFormat) : "";
+            if (desc.mDepthFormat != GL_NONE){
+                formats += (formats.empty() ? "" : "+") + std::string(GetFormatName(desc.mDepthFormat));
+            }
+            snprintf(line, sizeof(line), "acquire s%d %dx%d %s", slot, desc.mWidth, desc.mHeight, formats.c_str());
+        } else {
+            snprintf(line, sizeof(line), "acquire s%d buffer %zu bytes", slot, desc.mByteSize);
+        }
+        mLog.push_back(line);
+    }
+
+    void RecordingFrameGraphBackend::ReleaseSlot(int slot){
+        mLog.push_back("release s" + std::to_string(slot));
+    }
+
+    void RecordingFrameGraphBackend::Barrier(int slot, Access before, Access after){
+        static const char* kNames[3] = { "none", "write", "read" };
+        mLog.push_back("barrier s" + std::to_string(slot) + " " + kNames[before] + "->" + kNames[after]);
+    }
+
+    void RecordingFrameGraphBackend::BeginPass(const std::string& name, const std::vector<int>& targets){
+        std::string line = "pass " + name;
+        for (size_t i = 0; i < targets.size(); i++){
+            line += (i == 0 ? " -> s" : ", s") + std::to_string(targets[i]);
+        }
+        mLog.push_back(line);
+    }
+
+    // A deferred frame at 1280x720, declared in the order a renderer might
+    // write it down: the sky is declared before the SSAO it does not need, and
+    // a debug view nobody displays.
+    static void BuildExampleFrame(FrameGraph& graph){
+        const int width = 1280;
+        const int height = 720;
+        FrameGraphResourceDesc backbuffer;
+        backbuffer.mWidth = width;
+        backbuffer.mHeight = height;
+        backbuffer.mFormat = GL_RGBA8;
+        int output = graph.Import("Backbuffer", backbuffer);
+        int albedo = graph.CreateTexture("Albedo", width, height, GL_RGBA8);
+        int normal = graph.CreateTexture("Normal", width, height, GL_RGBA16F);
+        int depth = graph.CreateTexture("Depth", width, height, GL_NONE, GL_DEPTH_COMPONENT32F);
+        int ao = graph.CreateTexture("AO", width / 2, height / 2, GL_R8);
+        int aoBlurred = graph.CreateTexture("AOBlurred", width / 2, height / 2, GL_R8);
+        int hdr = graph.CreateTexture("HDR", width, height, GL_RGBA16F);
+        int debug = graph.CreateTexture("DebugNormals", width, height, GL_RGBA8);
+        int histogram = graph.CreateBuffer("Histogram", 256 * 4);
+        int exposure = graph.CreateBuffer("Exposure", 16);
+        int ldr = graph.CreateTexture("LDR", width, height, GL_RGBA8);
+
+        int pass = graph.AddPass("GBuffer", nullptr);
+        graph.Write(pass, albedo);
+        graph.Write(pass, normal);
+        graph.Write(pass, depth);
+        pass = graph.AddPass("Sky", nullptr);
+        graph.Write(pass, hdr);
+        pass = graph.AddPass("SSAO", nullptr);
+        graph.Read(pass, normal);
+        graph.Read(pass, depth);
+        graph.Write(pass, ao);
+        pass = graph.AddPass("SSAOBlur", nullptr);
+        graph.Read(pass, ao);
+        graph.Write(pass, aoBlurred);
+        pass = graph.AddPass("Lighting", nullptr);
+        for (int resource : { albedo, normal, depth, aoBlurred, hdr }){
+            graph.Read(pass, resource);
+        }
+        graph.Write(pass, hdr);
+        pass = graph.AddPass("DebugNormals", nullptr);
+        graph.Read(pass, normal);
+        graph.Write(pass, debug);
+        pass = graph.AddPass("Particles", nullptr);
+        graph.Read(pass, depth);
+        graph.Read(pass, hdr);
+        graph.Write(pass, hdr);
+        pass = graph.AddPass("Histogram", nullptr);
+        graph.Read(pass, hdr);
+        graph.Write(pass, histogram);
+        pass = graph.AddPass("Exposure", nullptr);
+        graph.Read(pass, histogram);
+        graph.Write(pass, exposure);
+        int source = hdr;
+        std::vector<int> bloom;
+        for (int i = 0; i < 4; i++){
+            bloom.push_back(graph.CreateTexture("Bloom" + std::to_string(i), width >> (i + 1), height >> (i + 1), GL_R11F_G11F_B10F));
+            pass = graph.AddPass("BloomDown" + std::to_string(i), nullptr);
+            graph.Read(pass, source);
+            graph.Write(pass, bloom[i]);
+            source = bloom[i];
+        }
+        for (int i = 3; i > 0; i--){
+            pass = graph.AddPass("BloomUp" + std::to_string(i), nullptr);
+            graph.Read(pass, bloom[i]);
+            graph.Read(pass, bloom[i - 1]);
+            graph.Write(pass, bloom[i - 1]);
+        }
+        pass = graph.AddPass("Tonemap", nullptr);
+        graph.Read(pass, hdr);
+        graph.Read(pass, bloom[0]);
+        graph.Read(pass, exposure);
+        graph.Write(pass, ldr);
+        pass = graph.AddPass("FXAA", nullptr);
+        graph.Read(pass, ldr);
+        graph.Write(pass, output);
+        pass = graph.AddPass("UI", nullptr);
+        graph.Read(pass, output);
+        graph.Write(pass, output);
+    }
+
+    // Random frames: passes read a few earlier resources and write one or two,
+    // some have side effects, the last writes the output.
+    static void BuildRandomFrame(FrameGraph& graph, std::minstd_rand& random, int passCount){
+        FrameGraphResourceDesc backbuffer;
+        backbuffer.mWidth = 1920;
+        backbuffer.mHeight = 1080;
+        backbuffer.mFormat = GL_RGBA8;
+        int output = graph.Import("Backbuffer", backbuffer);
+        static const GLenum kFormats[3] = { GL_RGBA8, GL_RGBA16F, GL_R8 };
+        std::vector<int> resources;
+        int resourceCount = std::max(4, passCount / 2);
+        for (int i = 0; i < resourceCount; i++){
+            if (random() % 8 == 0){
+                resources.push_back(graph.CreateBuffer("Buffer" + std::to_string(i), 1024 << (random() % 8)));
+            } else {
+                int scale = 1 << (random() % 3);
+                resources.push_back(graph.CreateTexture("Texture" + std::to_string(i), 1920 / scale, 1080 / scale, kFormats[random() % 3]));
+            }
+        }
+        for (int i = 0; i < passCount; i++){
+            int pass = graph.AddPass("Pass" + std::to_string(i), nullptr);
+            int reads = (int)(random() % 4);
+            for (int r = 0; r < reads; r++){
+                graph.Read(pass, resources[random() % resources.size()]);
+            }
+            int writes = 1 + (int)(random() % 2);
+            for (int w = 0; w < writes; w++){
+                graph.Write(pass, resources[random() % resources.size()]);
+            }
+            if (random() % 20 == 0){
+                graph.SetSideEffect(pass);
+            }
+            if (i == passCount - 1){
+                graph.Write(pass, output);
+            }
+        }
+    }
+
+    void FrameGraph::RunMicrobenchmark(){
+        FrameGraph graph;
+        BuildExampleFrame(graph);
+        graph.Compile();
+        RecordingFrameGraphBackend backend;
+        graph.Execute(backend);
+        std::string error;
+        bool valid = graph.Validate(&error);
+        std::cout << "Example frame: " << graph.GetPassCount() << " passes, culled:";
+        for (int i = 0; i < graph.GetPassCount(); i++){
+            if (graph.IsCulled(i)){
+                std::cout << " " << graph.GetPassName(i);
+            }
+        }
+        std::cout << std::endl << "Schedule:";
+        for (int pass : graph.GetOrder()){
+            std::cout << " " << graph.GetPassName(pass);
+        }
+        std::cout << std::endl << "Render target switches: " << graph.GetTargetSwitches() << " (" << graph.GetDeclaredTargetSwitches()
+                  << " in declaration order); transient memory " << graph.GetAliasedBytes() / 1024 << " KB in " << graph.GetSlotCount()
+                  << " slots (" << graph.GetUnaliasedBytes() / 1024 << " KB unaliased); " << (valid ? "valid" : error) << std::endl;
+        for (const std::string& line : backend.GetLog()){
+            std::cout << "  " << line << std::endl;
+        }
+
+        std::minstd_rand random(7);
+        int failures = 0;
+        size_t unaliased = 0;
+        size_t aliased = 0;
+        int switches = 0;
+        int declaredSwitches = 0;
+        const int graphCount = 1000;
+        for (int i = 0; i < graphCount; i++){
+            graph.Reset();
+            BuildRandomFrame(graph, random, 10 + (int)(random() % 50));
+            graph.Compile();
+            if (!graph.Validate(&error)){
+                if (failures++ == 0){
+                    std::cout << "Random frame " << i << ": " << error << std::endl;
+                }
+            }
+            unaliased += graph.GetUnaliasedBytes();
+            aliased += graph.GetAliasedBytes();
+            switches += graph.GetTargetSwitches();
+            declaredSwitches += graph.GetDeclaredTargetSwitches();
+        }
+        std::cout << graphCount << " random frames: " << graphCount - failures << " valid schedules, memory "
+                  << 100.0 * aliased / std::max(unaliased, (size_t)1) << "% of unaliased, " << switches << " target switches against "
+                  << declaredSwitches << " in declaration order" << std::endl;
+
+        for (int passCount : { 100, 1000, 4000 }){
+            graph.Reset();
+            BuildRandomFrame(graph, random, passCount);
+            auto start = std::chrono::steady_clock::now();
+            graph.Compile();
+            double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            std::cout << passCount << " passes: compiled in " << milliseconds << " ms" << std::endl;
+        }
+    }
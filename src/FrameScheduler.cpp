@@ -0,0 +1,102 @@
+#include "FrameScheduler.hpp"
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+#include <iostream>
+#include <thread>
+
+    FrameScheduler::FrameScheduler(double stepSeconds, int maxStepsPerFrame){
+        mStepSeconds = stepSeconds;
+        mMaxStepsPerFrame = std::max(maxStepsPerFrame, 1);
+        mAccumulator = 0.0;
+        mStarted = false;
+        mDroppedSteps = 0;
+        mFramePeriod = Clock::duration::zero();
+        // Until measured, assume sleeps overshoot by a millisecond.
+        mSleepMean = 0.002;
+        mSleepM2 = 0.0;
+        mSleepCount = 1;
+    }
+
+    void FrameScheduler::SetFrameRateLimit(double framesPerSecond){
+        mFramePeriod = framesPerSecond > 0.0 ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / framesPerSecond))
+                                             : Clock::duration::zero();
+        mNextFrame = Clock::time_point();
+    }
+
+    int FrameScheduler::BeginFrame(){
+        Clock::time_point now = Clock::now();
+        // The first frame simulates one step so there is a state to show.
+        mAccumulator += mStarted ? std::chrono::duration<double>(now - mLastFrame).count() : mStepSeconds;
+        mStarted = true;
+        mLastFrame = now;
+        int steps = (int)(mAccumulator / mStepSeconds);
+        mAccumulator -= steps * mStepSeconds;
+        if (steps > mMaxStepsPerFrame){
+            mDroppedSteps += steps - mMaxStepsPerFrame;
+            steps = mMaxStepsPerFrame;
+        }
+        return steps;
+    }
+
+    float FrameScheduler::GetAlpha() const{
+        return (float)std::min(mAccumulator / mStepSeconds, 1.0);
+    }
+
+    void FrameScheduler::EndFrame(){
+        if (mFramePeriod == Clock::duration::zero()){
+            return;
+        }
+        Clock::time_point now = Clock::now();
+        // A frame more than a period late restarts the cadence instead of
+        // rushing the following frames to catch up.
+        if (mNextFrame == Clock::time_point() || now >= mNextFrame + mFramePeriod){
+            mNextFrame = now + mFramePeriod;
+            return;
+        }
+        SleepUntil(mNextFrame);
+        mNextFrame += mFramePeriod;
+    }
+
+    void FrameScheduler::SleepUntil(Clock::time_point deadline){
+        for (;;){
+            double remaining = std::chrono::duration<double>(deadline - Clock::now()).count();
+            double estimate = mSleepMean + std::sqrt(mSleepM2 / mSleepCount);
+            if (remaining <= estimate){
+                break;
+            }
+            Clock::time_point start = Clock::now();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            double observed = std::chrono::duration<double>(Clock::now() - start).count();
+            mSleepCount++;
+            double delta = observed - mSleepMean;
+            mSleepMean += delta / mSleepCount;
+            mSleepM2 += delta * (observed - mSleepMean);
+        }
+        while (Clock::now() < deadline){
+            std::this_thread::yield();
+        }
+    }
+
+    void FrameScheduler::RunMicrobenchmark(double framesPerSecond, int frameCount){
+        FrameScheduler scheduler;
+        scheduler.SetFrameRateLimit(framesPerSecond);
+        double period = 1.0 / framesPerSecond;
+        double totalError = 0.0;
+        double worstError = 0.0;
+        scheduler.EndFrame();
+        Clock::time_point last = Clock::now();
+        std::clock_t cpuStart = std::clock();
+        for (int frame = 0; frame < frameCount; frame++){
+            scheduler.EndFrame();
+            Clock::time_point now = Clock::now();
+            double error = std::fabs(std::chrono::duration<double>(now - last).count() - period);
+            totalError += error;
+            worstError = std::max(worstError, error);
+            last = now;
+        }
+        double cpuSeconds = (double)(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+        std::cout << "Frame limiter at " << framesPerSecond << " fps: " << totalError / frameCount * 1e6 << " us mean error, "
+                  << worstError * 1e6 << " us worst, " << 100.0 * cpuSeconds / (frameCount * period) << "% CPU, sleep estimate "
+                  << (scheduler.mSleepMean + std::sqrt(scheduler.mSleepM2 / scheduler.mSleepCount)) * 1e3 << " ms" << std::endl;
+    }
@@ -0,0 +1,147 @@
+#include "GLDebug.hpp"
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <unordered_map>
+
+    struct CallSite{
+        const char* mCall;
+        const char* mFile;
+        int mLine;
+    };
+    struct MessageRecord{
+        GLenum mSeverity;
+        unsigned int mCount;
+    };
+
+    static thread_local CallSite sCallSite = { nullptr, nullptr, 0 };
+    static std::mutex sMessagesMutex;
+    static std::unordered_map<uint64_t, MessageRecord> sMessages;
+    static bool sCallbackInstalled = false;
+
+    static const char* SourceName(GLenum source){
+        switch (source){
+            case GL_DEBUG_SOURCE_API: return "API";
+            case GL_DEBUG_SOURCE_WINDOW_SYSTEM: return "window system";
+            case GL_DEBUG_SOURCE_SHADER_COMPILER: return "shader compiler";
+            case GL_DEBUG_SOURCE_THIRD_PARTY: return "third party";
+            case GL_DEBUG_SOURCE_APPLICATION: return "application";
+            default: return "other";
+        }
+    }
+    static const char* TypeName(GLenum type){
+        switch (type){
+            case GL_DEBUG_TYPE_ERROR: return "error";
+            case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR: return "deprecated";
+            case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR: return "undefined behavior";
+            case GL_DEBUG_TYPE_PORTABILITY: return "portability";
+            case GL_DEBUG_TYPE_PERFORMANCE: return "performance";
+            case GL_DEBUG_TYPE_MARKER: return "marker";
+            default: return "other";
+        }
+    }
+    static const char* SeverityName(GLenum severity){
+        switch (severity){
+            case GL_DEBUG_SEVERITY_HIGH: return "high";
+            case GL_DEBUG_SEVERITY_MEDIUM: return "medium";
+            case GL_DEBUG_SEVERITY_LOW: return "low";
+            default: return "notification";
+        }
+    }
+    static void PrintCallSite(){
+        if (sCallSite.mCall != nullptr){
+            std::cout << "\t" << sCallSite.mFile << ":" << sCallSite.mLine << "\t" << sCallSite.mCall;
+        }
+        std::cout << std::endl;
+    }
+
+    static void APIENTRY DebugCallback(GLenum source, GLenum type, GLuint id, GLenum severity,
+                                       GLsizei length, const GLchar* message, const void* userParam){
+        (void)length;
+        (void)userParam;
+        if (type == GL_DEBUG_TYPE_PUSH_GROUP || type == GL_DEBUG_TYPE_POP_GROUP){
+            return;
+        }
+        // Drivers reuse ids across sources and types, so all three form the key.
+        uint64_t key = ((uint64_t)id << 32) ^ ((uint64_t)(source & 0xffff) << 16) ^ (uint64_t)(type & 0xffff);
+        {
+            std::lock_guard<std::mutex> lock(sMessagesMutex);
+            MessageRecord& record = sMessages[key];
+            record.mSeverity = severity;
+            if (record.mCount++ > 0){
+                return;
+            }
+        }
+        std::cout << "OpenGL " << SeverityName(severity) << " " << TypeName(type)
+                  << " (" << SourceName(source) << ", id " << id << "): " << message;
+        PrintCallSite();
+    }
+
+    bool GLDebug::Install(GLenum minimumSeverity){
+#if GL_DEBUG
+        if (!GLAD_GL_KHR_debug || glDebugMessageCallback == nullptr){
+            std::cout << "KHR_debug unavailable, GLCheck falls back to glGetError" << std::endl;
+            return false;
+        }
+        GLint flags = 0;
+        glGetIntegerv(GL_CONTEXT_FLAGS, &flags);
+        if ((flags & GL_CONTEXT_FLAG_DEBUG_BIT) == 0){
+            std::cout << "Not a debug context, driver messages may be incomplete" << std::endl;
+        }
+        glEnable(GL_DEBUG_OUTPUT);
+        // Synchronous delivery keeps the callback on the calling thread, inside
+        // the GL call, which is what makes the GLCheck attribution valid.
+        glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+        glDebugMessageCallback(DebugCallback, nullptr);
+        // Everything off, then back on from the requested severity upwards.
+        glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, nullptr, GL_FALSE);
+        const GLenum severities[] = { GL_DEBUG_SEVERITY_HIGH, GL_DEBUG_SEVERITY_MEDIUM,
+                                      GL_DEBUG_SEVERITY_LOW, GL_DEBUG_SEVERITY_NOTIFICATION };
+        for (GLenum severity : severities){
+            glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, severity, 0, nullptr, GL_TRUE);
+            if (severity == minimumSeverity){
+                break;
+            }
+        }
+        sCallbackInstalled = true;
+        return true;
+#else
+        (void)minimumSeverity;
+        return false;
+#endif
+    }
+    bool GLDebug::IsCallbackInstalled(){
+        return sCallbackInstalled;
+    }
+    void GLDebug::BeginCall(const char* call, const char* file, int line){
+        sCallSite.mCall = call;
+        sCallSite.mFile = file;
+        sCallSite.mLine = line;
+    }
+    void GLDebug::EndCall(){
+        if (!sCallbackInstalled){
+            // One query after the call; errors raised earlier are attributed here too.
+            while (GLenum error = glGetError()){
+                std::cout << "OpenGL error 0x" << std::hex << error << std::dec;
+                PrintCallSite();
+            }
+        }
+        sCallSite.mCall = nullptr;
+    }
+    void GLDebug::PrintSummary(){
+        std::lock_guard<std::mutex> lock(sMessagesMutex);
+        unsigned int total = 0;
+        for (const auto& entry : sMessages){
+            total += entry.second.mCount;
+        }
+        if (total == 0){
+            return;
+        }
+        std::cout << "OpenGL debug: " << sMessages.size() << " distinct messages, " << total << " total" << std::endl;
+        for (const auto& entry : sMessages){
+            if (entry.second.mCount > 1){
+                std::cout << "\tid " << (entry.first >> 32) << " (" << SeverityName(entry.second.mSeverity)
+                          << ") repeated " << entry.second.mCount << " times" << std::endl;
+            }
+        }
+    }
@@ -0,0 +1,120 @@
+#include "GpuProfiler.hpp"
+#include <fstream>
+#include <iostream>
+
+    GpuProfiler::GpuProfiler(){
+        mGpuToCpuOffset = 0;
+        mFrameCounter = 0;
+        mDepth = 0;
+        mCreated = false;
+    }
+    bool GpuProfiler::Create(){
+        for (FrameQueries& frame : mFrames){
+            frame.mQueries.resize(kMaxScopesPerFrame * 2);
+            glGenQueries((GLsizei)frame.mQueries.size(), frame.mQueries.data());
+            frame.mScopes.reserve(kMaxScopesPerFrame);
+        }
+        // Calibrate GPU timestamps against the CPU clock once so both tracks
+        // share a timeline. glGetInteger64v(GL_TIMESTAMP) does not wait for
+        // queued work to finish.
+        mEpoch = std::chrono::steady_clock::now();
+        GLint64 gpuNow = 0;
+        glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+        mGpuToCpuOffset = CpuNow() - gpuNow;
+        mCreated = true;
+        return true;
+    }
+    void GpuProfiler::Destroy(){
+        if (!mCreated){
+            return;
+        }
+        for (FrameQueries& frame : mFrames){
+            glDeleteQueries((GLsizei)frame.mQueries.size(), frame.mQueries.data());
+            frame = FrameQueries();
+        }
+        mCreated = false;
+    }
+    long long GpuProfiler::CpuNow() const{
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - mEpoch).count();
+    }
+    void GpuProfiler::BeginFrame(){
+        FrameQueries& frame = mFrames[mFrameCounter % kFrameLatency];
+        if (frame.mFrameIndex >= 0){
+            // Issued kFrameLatency frames ago; normally complete by now.
+            Collect(frame);
+        }
+        frame.mScopes.clear();
+        frame.mFrameIndex = mFrameCounter;
+        mDepth = 0;
+        frame.mRootScope = BeginScope("Frame");
+    }
+    void GpuProfiler::EndFrame(){
+        FrameQueries& frame = mFrames[mFrameCounter % kFrameLatency];
+        EndScope(frame.mRootScope);
+        mFrameCounter++;
+    }
+    int GpuProfiler::BeginScope(const char* name){
+        FrameQueries& frame = mFrames[mFrameCounter % kFrameLatency];
+        if (!mCreated || frame.mFrameIndex != mFrameCounter || (int)frame.mScopes.size() >= kMaxScopesPerFrame){
+            return -1;
+        }
+        int scope = (int)frame.mScopes.size();
+        frame.mScopes.push_back({ name, mDepth++, CpuNow(), 0 });
+        glQueryCounter(frame.mQueries[scope * 2], GL_TIMESTAMP);
+        return scope;
+    }
+    void GpuProfiler::EndScope(int scope){
+        if (scope < 0){
+            return;
+        }
+        FrameQueries& frame = mFrames[mFrameCounter % kFrameLatency];
+        glQueryCounter(frame.mQueries[scope * 2 + 1], GL_TIMESTAMP);
+        frame.mScopes[scope].mCpuEnd = CpuNow();
+        mDepth--;
+    }
+    void GpuProfiler::Collect(FrameQueries& frame){
+        for (size_t i = 0; i < frame.mScopes.size(); i++){
+            const Scope& scope = frame.mScopes[i];
+            GLuint64 gpuBegin = 0;
+            GLuint64 gpuEnd = 0;
+            glGetQueryObjectui64v(frame.mQueries[i * 2], GL_QUERY_RESULT, &gpuBegin);
+            glGetQueryObjectui64v(frame.mQueries[i * 2 + 1], GL_QUERY_RESULT, &gpuEnd);
+            mEvents.push_back({ scope.mName, frame.mFrameIndex, scope.mDepth, scope.mCpuBegin, scope.mCpuEnd,
+                                (long long)gpuBegin + mGpuToCpuOffset, (long long)gpuEnd + mGpuToCpuOffset });
+        }
+        frame.mScopes.clear();
+        frame.mFrameIndex = -1;
+    }
+    void GpuProfiler::Flush(){
+        for (int i = 0; i < kFrameLatency; i++){
+            FrameQueries& frame = mFrames[(mFrameCounter + i) % kFrameLatency];
+            if (frame.mFrameIndex >= 0 && frame.mFrameIndex < mFrameCounter){
+                Collect(frame);
+            }
+        }
+    }
+    bool GpuProfiler::WriteChromeTrace(const std::string& filepath) const{
+        std::ofstream file(filepath);
+        if (!file.is_open()){
+            std::cerr << "Failed to write trace: " << filepath << std::endl;
+            return false;
+        }
+        file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+        file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n";
+        file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}";
+        file.setf(std::ios::fixed);
+        file.precision(3);
+        for (const Event& event : mEvents){
+            // Chrome trace timestamps are microseconds.
+            file << ",\n{\"name\":\"" << event.mName << "\",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":1,\"tid\":1"
+                 << ",\"ts\":" << event.mCpuBegin / 1000.0 << ",\"dur\":" << (event.mCpuEnd - event.mCpuBegin) / 1000.0
+                 << ",\"args\":{\"frame\":" << event.mFrameIndex << ",\"depth\":" << event.mDepth << "}}";
+            file << ",\n{\"name\":\"" << event.mName << "\",\"cat\":\"gpu\",\"ph\":\"X\",\"pid\":1,\"tid\":2"
+                 << ",\"ts\":" << event.mGpuBegin / 1000.0 << ",\"dur\":" << (event.mGpuEnd - event.mGpuBegin) / 1000.0
+                 << ",\"args\":{\"frame\":" << event.mFrameIndex << ",\"depth\":" << event.mDepth
+                 << ",\"gpu_ms\":" << (event.mGpuEnd - event.mGpuBegin) / 1.0e6
+                 << ",\"cpu_ms\":" << (event.mCpuEnd - event.mCpuBegin) / 1.0e6 << "}}";
+        }
+        file << "\n]}\n";
+        return true;
+    }
@@ -0,0 +1,471 @@
+#include "Headless.hpp"
+#include "GLDebug.hpp"
+#include <SDL2/SDL.h>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#if defined(__linux__)
+#define HEADLESS_HAS_EGL 1
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+    HeadlessContext::HeadlessContext(){
+        mDisplay = nullptr;
+        mConfig = nullptr;
+        mSurface = nullptr;
+        mContext = nullptr;
+        mSharedSurface = nullptr;
+        mSharedContext = nullptr;
+        mHiddenWindow = nullptr;
+    }
+    HeadlessContext::~HeadlessContext(){
+        Destroy();
+    }
+#if HEADLESS_HAS_EGL
+    static bool HasExtension(const char* extensions, const char* name){
+        if (extensions == nullptr){
+            return false;
+        }
+        size_t length = strlen(name);
+        for (const char* p = strstr(extensions, name); p != nullptr; p = strstr(p + length, name)){
+            if ((p == extensions || p[-1] == ' ') && (p[length] == ' ' || p[length] == '\0')){
+                return true;
+            }
+        }
+        return false;
+    }
+    bool HeadlessContext::Create(int width, int height){
+        EGLDisplay display = EGL_NO_DISPLAY;
+        // Prefer Mesa's surfaceless platform: no X11/Wayland/GBM device needed.
+        const char* clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+        PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+            (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (getPlatformDisplay && HasExtension(clientExtensions, "EGL_MESA_platform_surfaceless")){
+            display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+        }
+        if (display == EGL_NO_DISPLAY){
+            display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        }
+        EGLint major = 0, minor = 0;
+        if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)){
+            std::cout << "EGL display could not be initialized: 0x" << std::hex << eglGetError() << std::dec << std::endl;
+            return false;
+        }
+        mDisplay = display;
+        if (!eglBindAPI(EGL_OPENGL_API)){
+            std::cout << "EGL does not support desktop OpenGL" << std::endl;
+            Destroy();
+            return false;
+        }
+        bool surfaceless = HasExtension(eglQueryString(display, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context");
+        const EGLint configAttributes[] = {
+            EGL_SURFACE_TYPE, surfaceless ? 0 : EGL_PBUFFER_BIT,
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+            EGL_RED_SIZE, 8,
+            EGL_GREEN_SIZE, 8,
+            EGL_BLUE_SIZE, 8,
+            EGL_ALPHA_SIZE, 8,
+            EGL_NONE
+        };
+        EGLConfig config = nullptr;
+        EGLint configCount = 0;
+        if (!eglChooseConfig(display, configAttributes, &config, 1, &configCount) || configCount == 0){
+            std::cout << "EGL found no OpenGL capable config" << std::endl;
+            Destroy();
+            return false;
+        }
+        mConfig = config;
+        const EGLint contextAttributes[] = {
+            EGL_CONTEXT_MAJOR_VERSION, 4,
+            EGL_CONTEXT_MINOR_VERSION, 1,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+            EGL_CONTEXT_OPENGL_DEBUG, GL_DEBUG ? EGL_TRUE : EGL_FALSE,
+            EGL_NONE
+        };
+        EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+        if (context == EGL_NO_CONTEXT){
+            std::cout << "EGL context failed: 0x" << std::hex << eglGetError() << std::dec << std::endl;
+            Destroy();
+            return false;
+        }
+        mContext = context;
+        EGLSurface surface = EGL_NO_SURFACE;
+        if (!surfaceless){
+            // We always render into an FBO; the pbuffer only exists to make the context current.
+            const EGLint pbufferAttributes[] = { EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE };
+            surface = eglCreatePbufferSurface(display, config, pbufferAttributes);
+            if (surface == EGL_NO_SURFACE){
+                std::cout << "EGL pbuffer failed: 0x" << std::hex << eglGetError() << std::dec << std::endl;
+                Destroy();
+                return false;
+            }
+            mSurface = surface;
+        }
+        if (!eglMakeCurrent(display, surface, surface, context)){
+            std::cout << "EGL make current failed: 0x" << std::hex << eglGetError() << std::dec << std::endl;
+            Destroy();
+            return false;
+        }
+        std::cout << "EGL " << major << "." << minor << (surfaceless ? " (surfaceless)" : " (pbuffer)") << std::endl;
+        return true;
+    }
+    bool HeadlessContext::CreateSharedContext(){
+        if (mContext == nullptr || mSharedContext != nullptr){
+            return mSharedContext != nullptr;
+        }
+        const EGLint contextAttributes[] = {
+            EGL_CONTEXT_MAJOR_VERSION, 4,
+            EGL_CONTEXT_MINOR_VERSION, 1,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+            EGL_CONTEXT_OPENGL_DEBUG, GL_DEBUG ? EGL_TRUE : EGL_FALSE,
+            EGL_NONE
+        };
+        EGLContext context = eglCreateContext(mDisplay, mConfig, mContext, contextAttributes);
+        if (context == EGL_NO_CONTEXT){
+            std::cout << "EGL shared context failed: 0x" << std::hex << eglGetError() << std::dec << std::endl;
+            return false;
+        }
+        mSharedContext = context;
+        if (mSurface != nullptr){
+            // A surface is current on one thread at a time, so the upload thread gets its own.
+            const EGLint pbufferAttributes[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+            mSharedSurface = eglCreatePbufferSurface(mDisplay, mConfig, pbufferAttributes);
+            if (mSharedSurface == EGL_NO_SURFACE){
+                mSharedSurface = nullptr;
+                eglDestroyContext(mDisplay, mSharedContext);
+                mSharedContext = nullptr;
+                return false;
+            }
+        }
+        return true;
+    }
+    bool HeadlessContext::MakeSharedCurrent(){
+        EGLSurface surface = mSharedSurface != nullptr ? (EGLSurface)mSharedSurface : EGL_NO_SURFACE;
+        return mSharedContext != nullptr && eglMakeCurrent(mDisplay, surface, surface, mSharedContext);
+    }
+    void HeadlessContext::ReleaseShared(){
+        eglMakeCurrent(mDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    }
+    void HeadlessContext::Destroy(){
+        if (mDisplay != nullptr){
+            eglMakeCurrent(mDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+            if (mSharedContext != nullptr){
+                eglDestroyContext(mDisplay, mSharedContext);
+            }
+            if (mSharedSurface != nullptr){
+                eglDestroySurface(mDisplay, mSharedSurface);
+            }
+            if (mContext != nullptr){
+                eglDestroyContext(mDisplay, mContext);
+            }
+            if (mSurface != nullptr){
+                eglDestroySurface(mDisplay, mSurface);
+            }
+            eglTerminate(mDisplay);
+        }
+        mDisplay = nullptr;
+        mConfig = nullptr;
+        mSurface = nullptr;
+        mContext = nullptr;
+        mSharedSurface = nullptr;
+        mSharedContext = nullptr;
+    }
+    void* HeadlessContext::GetProcAddress(const char* name){
+        return (void*)eglGetProcAddress(name);
+    }
+#else
+    bool HeadlessContext::Create(int width, int height){
+        // No EGL on this platform: fall back to a context on a window that is never shown.
+        if (SDL_InitSubSystem(SDL_INIT_VIDEO) != 0){
+            std::cout << "SDL video init failed: " << SDL_GetError() << std::endl;
+            return false;
+        }
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 4);
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 1);
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, GL_DEBUG ? SDL_GL_CONTEXT_DEBUG_FLAG : 0);
+        SDL_Window* window = SDL_CreateWindow("headless", 0, 0, width, height, SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN);
+        if (window == nullptr){
+            std::cout << "Hidden window failed: " << SDL_GetError() << std::endl;
+            return false;
+        }
+        mHiddenWindow = window;
+        mContext = SDL_GL_CreateContext(window);
+        if (mContext == nullptr){
+            std::cout << "OpenGL context failed: " << SDL_GetError() << std::endl;
+            Destroy();
+            return false;
+        }
+        return true;
+    }
+    bool HeadlessContext::CreateSharedContext(){
+        if (mContext == nullptr || mSharedContext != nullptr){
+            return mSharedContext != nullptr;
+        }
+        SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 1);
+        mSharedContext = SDL_GL_CreateContext((SDL_Window*)mHiddenWindow);
+        SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 0);
+        // Creating a context makes it current; hand the thread back its own.
+        SDL_GL_MakeCurrent((SDL_Window*)mHiddenWindow, mContext);
+        if (mSharedContext == nullptr){
+            std::cout << "Shared OpenGL context failed: " << SDL_GetError() << std::endl;
+            return false;
+        }
+        return true;
+    }
+    bool HeadlessContext::MakeSharedCurrent(){
+        return mSharedContext != nullptr && SDL_GL_MakeCurrent((SDL_Window*)mHiddenWindow, mSharedContext) == 0;
+    }
+    void HeadlessContext::ReleaseShared(){
+        SDL_GL_MakeCurrent((SDL_Window*)mHiddenWindow, nullptr);
+    }
+    void HeadlessContext::Destroy(){
+        if (mSharedContext != nullptr){
+            SDL_GL_DeleteContext(mSharedContext);
+        }
+        if (mContext != nullptr){
+            SDL_GL_DeleteContext(mContext);
+        }
+        if (mHiddenWindow != nullptr){
+            SDL_DestroyWindow((SDL_Window*)mHiddenWindow);
+            SDL_QuitSubSystem(SDL_INIT_VIDEO);
+        }
+        mContext = nullptr;
+        mSharedContext = nullptr;
+        mHiddenWindow = nullptr;
+    }
+    void* HeadlessContext::GetProcAddress(const char* name){
+        return SDL_GL_GetProcAddress(name);
+    }
+#endif
+
+    OffscreenTarget::OffscreenTarget(){
+        mFramebuffer = 0;
+        mColorBuffer = 0;
+        mDepthBuffer = 0;
+        mWidth = 0;
+        mHeight = 0;
+    }
+    bool OffscreenTarget::Create(int width, int height){
+        mWidth = width;
+        mHeight = height;
+        glGenRenderbuffers(1, &mColorBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, mColorBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glGenRenderbuffers(1, &mDepthBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, mDepthBuffer);
+        // Float depth for the reverse-Z projection: its precision sits where the
+        // projection needs it, unlike 24-bit fixed point.
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT32F, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        glGenFramebuffers(1, &mFramebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, mFramebuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, mColorBuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, mDepthBuffer);
+        GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        if (status != GL_FRAMEBUFFER_COMPLETE){
+            std::cout << "Offscreen framebuffer incomplete: 0x" << std::hex << status << std::dec << std::endl;
+            Destroy();
+            return false;
+        }
+        return true;
+    }
+    void OffscreenTarget::Destroy(){
+        glDeleteFramebuffers(1, &mFramebuffer);
+        glDeleteRenderbuffers(1, &mColorBuffer);
+        glDeleteRenderbuffers(1, &mDepthBuffer);
+        mFramebuffer = 0;
+        mColorBuffer = 0;
+        mDepthBuffer = 0;
+    }
+    void OffscreenTarget::Bind() const{
+        glBindFramebuffer(GL_FRAMEBUFFER, mFramebuffer);
+    }
+    void OffscreenTarget::Unbind(){
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    FrameWriter::FrameWriter(){
+        mPipe = nullptr;
+    }
+    FrameWriter::~FrameWriter(){
+        Close();
+    }
+    bool FrameWriter::Open(const std::string& output){
+        if (output == "-"){
+            mPipe = stdout;
+            return true;
+        }
+        if (output.find('%') == std::string::npos){
+            std::cout << "Output pattern needs a frame number, e.g. frame_%04d.ppm" << std::endl;
+            return false;
+        }
+        mPattern = output;
+        return true;
+    }
+    void FrameWriter::Close(){
+        if (mPipe != nullptr){
+            fflush(mPipe);
+        }
+        mPipe = nullptr;
+    }
+    bool FrameWriter::Write(int frameIndex, const unsigned char* pixels, int width, int height){
+        FILE* file = mPipe;
+        if (file == nullptr){
+            char filename[1024];
+            snprintf(filename, sizeof(filename), mPattern.c_str(), frameIndex);
+            file = fopen(filename, "wb");
+            if (file == nullptr){
+                std::cerr << "Failed to open frame output: " << filename << std::endl;
+                return false;
+            }
+        }
+        fprintf(file, "P6\n%d %d\n255\n", width, height);
+        mRow.resize((size_t)width * 3);
+        // GL rows start at the bottom; PPM rows start at the top.
+        for (int y = height - 1; y >= 0; y--){
+            const unsigned char* src = pixels + (size_t)y * width * 4;
+            for (int x = 0; x < width; x++){
+                mRow[x * 3 + 0] = src[x * 4 + 0];
+                mRow[x * 3 + 1] = src[x * 4 + 1];
+                mRow[x * 3 + 2] = src[x * 4 + 2];
+            }
+            fwrite(mRow.data(), 1, mRow.size(), file);
+        }
+        if (file != mPipe){
+            fclose(file);
+        }
+        return true;
+    }
+
+    AsyncReadback::AsyncReadback(){
+        mNext = 0;
+        mWidth = 0;
+        mHeight = 0;
+        mWriter = nullptr;
+    }
+    bool AsyncReadback::Create(int width, int height, FrameWriter* writer){
+        mWidth = width;
+        mHeight = height;
+        mWriter = writer;
+        mNext = 0;
+        for (Slot& slot : mSlots){
+            glGenBuffers(1, &slot.mBuffer);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.mBuffer);
+            glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)width * height * 4, nullptr, GL_STREAM_READ);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        return true;
+    }
+    void AsyncReadback::Destroy(){
+        for (Slot& slot : mSlots){
+            if (slot.mFence != nullptr){
+                glDeleteSync(slot.mFence);
+            }
+            glDeleteBuffers(1, &slot.mBuffer);
+            slot = Slot();
+        }
+    }
+    void AsyncReadback::Queue(int frameIndex){
+        Slot& slot = mSlots[mNext];
+        if (slot.mFence != nullptr){
+            // The ring is full: the oldest readback has to land before we can reuse its buffer.
+            Retire(slot, GL_TIMEOUT_IGNORED);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.mBuffer);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, mWidth, mHeight, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        slot.mFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        slot.mFrameIndex = frameIndex;
+        // Make sure the fence reaches the GPU so polling it can ever succeed.
+        glFlush();
+        mNext = (mNext + 1) % kRingSize;
+    }
+    void AsyncReadback::Poll(){
+        // Slots complete in submission order, so stop at the first one still in flight.
+        for (int i = 0; i < kRingSize; i++){
+            Slot& slot = mSlots[(mNext + i) % kRingSize];
+            if (slot.mFence != nullptr && !Retire(slot, 0)){
+                return;
+            }
+        }
+    }
+    void AsyncReadback::Flush(){
+        for (int i = 0; i < kRingSize; i++){
+            Slot& slot = mSlots[(mNext + i) % kRingSize];
+            if (slot.mFence != nullptr){
+                Retire(slot, GL_TIMEOUT_IGNORED);
+            }
+        }
+    }
+    bool AsyncReadback::Retire(Slot& slot, GLuint64 timeout){
+        GLenum result = glClientWaitSync(slot.mFence, timeout == 0 ? 0 : GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+        if (result == GL_TIMEOUT_EXPIRED){
+            return false;
+        }
+        if (result == GL_WAIT_FAILED){
+            std::cout << "Readback fence wait failed for frame " << slot.mFrameIndex << std::endl;
+        }
+        glDeleteSync(slot.mFence);
+        slot.mFence = nullptr;
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.mBuffer);
+        const unsigned char* pixels = (const unsigned char*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0,
+                                                                            (GLsizeiptr)mWidth * mHeight * 4, GL_MAP_READ_BIT);
+        if (pixels != nullptr){
+            if (mWriter != nullptr){
+                mWriter->Write(slot.mFrameIndex, pixels, mWidth, mHeight);
+            }
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        slot.mFrameIndex = -1;
+        return true;
+    }
+
+    OverdrawCounter::OverdrawCounter(){
+        mFragments = 0;
+        mCoveredPixels = 0;
+        mPixelCount = 0;
+        mMaxLayers = 0;
+    }
+
+    void OverdrawCounter::Resolve(int frameIndex, int width, int height, FrameWriter* writer){
+        static const unsigned char kHeat[][3] = {
+            { 0, 0, 0 }, { 0, 0, 255 }, { 0, 255, 0 }, { 255, 255, 0 }, { 255, 128, 0 }, { 255, 0, 0 }, { 255, 255, 255 }
+        };
+        const int heatLevels = (int)(sizeof(kHeat) / sizeof(kHeat[0]));
+        size_t pixelCount = (size_t)width * height;
+        mPixels.resize(pixelCount * 4);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, mPixels.data());
+        for (size_t i = 0; i < pixelCount; i++){
+            unsigned char* pixel = &mPixels[i * 4];
+            int layers = pixel[0];
+            mFragments += layers;
+            mCoveredPixels += layers > 0;
+            mMaxLayers = std::max(mMaxLayers, layers);
+            const unsigned char* heat = kHeat[std::min(layers, heatLevels - 1)];
+            pixel[0] = heat[0];
+            pixel[1] = heat[1];
+            pixel[2] = heat[2];
+            pixel[3] = 255;
+        }
+        mPixelCount += pixelCount;
+        if (writer != nullptr){
+            writer->Write(frameIndex, mPixels.data(), width, height);
+        }
+    }
+
+    void OverdrawCounter::PrintReport() const{
+        if (mPixelCount == 0){
+            return;
+        }
+        double perCovered = mCoveredPixels > 0 ? (double)mFragments / mCoveredPixels : 0.0;
+        std::cout << "Overdraw: " << perCovered << " fragments shaded per covered pixel (deepest pixel " << mMaxLayers
+                  << "), " << 100.0 * mCoveredPixels / mPixelCount << "% of pixels covered" << std::endl;
+    }
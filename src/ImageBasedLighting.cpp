@@ -0,0 +1,470 @@
+#include "ImageBasedLighting.hpp"
+#include "DiskCache.hpp"
+#include "JobSystem.hpp"
+#include "Simd.hpp"
+#include "Trace.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+    static const char kCacheMagic[4] = { 'I', 'B', 'L', 'M' };
+    static const uint32_t kCacheVersion = 1;
+    // Face size the sky is drawn at before being halved for the convolutions.
+    static const int kSkySize = 128;
+    // GGX samples per table entry.
+    static const int kLutSamples = 512;
+    // Angular radius of the sun disc in radians, and its radiance.
+    static const float kSunRadius = 0.03f;
+    static const float kSunRadiance = 40.0f;
+    static const float kPi = 3.14159265358979f;
+
+    // Direction through the centre of texel (x, y) of a cube face, in GL's layout.
+    static glm::vec3 CubeDirection(int face, int size, int x, int y){
+        float s = 2.0f * (x + 0.5f) / size - 1.0f;
+        float t = 2.0f * (y + 0.5f) / size - 1.0f;
+        glm::vec3 direction;
+        switch (face){
+            case 0: direction = glm::vec3(1.0f, -t, -s); break;
+            case 1: direction = glm::vec3(-1.0f, -t, s); break;
+            case 2: direction = glm::vec3(s, 1.0f, t); break;
+            case 3: direction = glm::vec3(s, -1.0f, -t); break;
+            case 4: direction = glm::vec3(s, -t, 1.0f); break;
+            default: direction = glm::vec3(-s, -t, -1.0f); break;
+        }
+        return glm::normalize(direction);
+    }
+
+    // Solid angle of texel (x, y), the same on every face.
+    static float TexelSolidAngle(int size, int x, int y){
+        float s = 2.0f * (x + 0.5f) / size - 1.0f;
+        float t = 2.0f * (y + 0.5f) / size - 1.0f;
+        float texel = 2.0f / size;
+        return texel * texel / std::pow(1.0f + s * s + t * t, 1.5f);
+    }
+
+    // A cube's texels as the convolutions read them: direction, radiance times
+    // solid angle and solid angle, padded to a multiple of four with no weight.
+    struct SourceTexels{
+        std::vector<float> mX;
+        std::vector<float> mY;
+        std::vector<float> mZ;
+        std::vector<float> mR;
+        std::vector<float> mG;
+        std::vector<float> mB;
+        std::vector<float> mWeight;
+    };
+
+    static void GatherTexels(const std::vector<float>& cube, int size, SourceTexels& texels){
+        size_t count = 6 * (size_t)size * size;
+        size_t padded = (count + 3) & ~(size_t)3;
+        for (std::vector<float>* channel : { &texels.mX, &texels.mY, &texels.mZ, &texels.mR, &texels.mG, &texels.mB, &texels.mWeight }){
+            channel->assign(padded, 0.0f);
+        }
+        size_t i = 0;
+        for (int face = 0; face < 6; face++){
+            for (int y = 0; y < size; y++){
+                for (int x = 0; x < size; x++, i++){
+                    glm::vec3 direction = CubeDirection(face, size, x, y);
+                    float weight = TexelSolidAngle(size, x, y);
+                    texels.mX[i] = direction.x;
+                    texels.mY[i] = direction.y;
+                    texels.mZ[i] = direction.z;
+                    texels.mR[i] = cube[i * 3] * weight;
+                    texels.mG[i] = cube[i * 3 + 1] * weight;
+                    texels.mB[i] = cube[i * 3 + 2] * weight;
+                    texels.mWeight[i] = weight;
+                }
+            }
+        }
+    }
+
+    // Averages 2x2 texels into one.
+    static void Downsample(const std::vector<float>& cube, int size, std::vector<float>& half){
+        int halfSize = size / 2;
+        half.resize(6 * (size_t)halfSize * halfSize * 3);
+        for (int face = 0; face < 6; face++){
+            const float* source = cube.data() + (size_t)face * size * size * 3;
+            float* target = half.data() + (size_t)face * halfSize * halfSize * 3;
+            for (int y = 0; y < halfSize; y++){
+                for (int x = 0; x < halfSize; x++){
+                    for (int c = 0; c < 3; c++){
+                        const float* texel = source + ((size_t)(2 * y) * size + 2 * x) * 3 + c;
+                        target[((size_t)y * halfSize + x) * 3 + c] = 0.25f * (texel[0] + texel[3] + texel[size * 3] + texel[size * 3 + 3]);
+                    }
+                }
+            }
+        }
+    }
+
+    static float HorizontalSum(Float4 a){
+        float lanes[4];
+        Float4Store(lanes, a);
+        return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    }
+
+    // One output texel as a weighted sum over every source texel in direction n:
+    // the cosine lobe (irradiance) or, with N = V = R, the GGX lobe weighted by
+    // NdotL, normalised by its total weight (the split-sum prefilter).
+    template<bool kCosine>
+    static glm::vec3 ConvolveTexel(const SourceTexels& source, const glm::vec3& n, float alpha2){
+        Float4 zero = Float4Splat(0.0f);
+        Float4 one = Float4Splat(1.0f);
+        Float4 half = Float4Splat(0.5f);
+        Float4 a2 = Float4Splat(alpha2);
+        Float4 a2MinusOne = Float4Splat(alpha2 - 1.0f);
+        Float4 nx = Float4Splat(n.x);
+        Float4 ny = Float4Splat(n.y);
+        Float4 nz = Float4Splat(n.z);
+        Float4 r = zero;
+        Float4 g = zero;
+        Float4 b = zero;
+        Float4 w = zero;
+        for (size_t i = 0; i < source.mX.size(); i += 4){
+            Float4 cosine = nx * Float4Load(&source.mX[i]) + ny * Float4Load(&source.mY[i]) + nz * Float4Load(&source.mZ[i]);
+            Float4 lobe = Float4Max(cosine, zero);
+            if (!kCosine){
+                // NdotH^2 = (1 + NdotL) / 2 when N = V.
+                Float4 d = (one + cosine) * half * a2MinusOne + one;
+                lobe = lobe * a2 / (d * d);
+            }
+            r = r + lobe * Float4Load(&source.mR[i]);
+            g = g + lobe * Float4Load(&source.mG[i]);
+            b = b + lobe * Float4Load(&source.mB[i]);
+            w = w + lobe * Float4Load(&source.mWeight[i]);
+        }
+        glm::vec3 sum(HorizontalSum(r), HorizontalSum(g), HorizontalSum(b));
+        if (kCosine){
+            // Irradiance over pi, so the shader multiplies by the albedo alone.
+            return sum / kPi;
+        }
+        float weight = HorizontalSum(w);
+        return weight > 0.0f ? sum / weight : glm::vec3(0.0f);
+    }
+
+    // Convolves source into a size x size cube: the cosine lobe when roughness
+    // is negative, otherwise the GGX lobe of that roughness.
+    static void Convolve(const SourceTexels& source, int size, float roughness, std::vector<float>& cube, JobSystem& jobs){
+        cube.resize(6 * (size_t)size * size * 3);
+        float alpha2 = roughness * roughness * roughness * roughness;
+        jobs.ParallelFor(6 * (size_t)size, 1, [&](size_t begin, size_t end){
+            for (size_t row = begin; row < end; row++){
+                int face = (int)row / size;
+                int y = (int)row % size;
+                for (int x = 0; x < size; x++){
+                    glm::vec3 n = CubeDirection(face, size, x, y);
+                    glm::vec3 value = roughness < 0.0f ? ConvolveTexel<true>(source, n, 0.0f) : ConvolveTexel<false>(source, n, alpha2);
+                    float* texel = &cube[(row * size + x) * 3];
+                    texel[0] = value.x;
+                    texel[1] = value.y;
+                    texel[2] = value.z;
+                }
+            }
+        });
+    }
+
+    static float RadicalInverse(uint32_t bits){
+        bits = (bits << 16u) | (bits >> 16u);
+        bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+        bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+        bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+        bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+        return (float)bits * 2.3283064365386963e-10f;
+    }
+
+    ImageBasedLighting::ImageBasedLighting(JobSystem* jobs){
+        mJobs = jobs != nullptr ? jobs : &JobSystem::Shared();
+        mSunDirection = glm::vec3(0.0f, -1.0f, 0.0f);
+        for (int i = 0; i < 3; i++){
+            mTextures[i] = 0;
+        }
+    }
+
+    void ImageBasedLighting::SetSunDirection(const glm::vec3& direction){
+        mSunDirection = glm::normalize(direction);
+    }
+
+    glm::vec3 ImageBasedLighting::SampleSky(const glm::vec3& direction) const{
+        const glm::vec3 zenith(0.2f, 0.4f, 0.9f);
+        const glm::vec3 horizon(0.85f, 0.85f, 0.8f);
+        const glm::vec3 ground(0.3f, 0.25f, 0.2f);
+        glm::vec3 radiance = direction.y > 0.0f ? glm::mix(horizon, zenith, std::sqrt(direction.y))
+                                                : glm::mix(horizon, ground, std::min(-4.0f * direction.y, 1.0f));
+        if (glm::dot(direction, -mSunDirection) > std::cos(kSunRadius)){
+            radiance += glm::vec3(kSunRadiance, 0.95f * kSunRadiance, 0.85f * kSunRadiance);
+        }
+        return radiance;
+    }
+
+    // Table of the GGX specular response to F0: NdotV across, roughness down.
+    // Four entries of a row at a time; the half vectors depend only on the row.
+    void ImageBasedLighting::ComputeLut(){
+        mLut.resize((size_t)kLutSize * kLutSize * 2);
+        mJobs->ParallelFor(kLutSize, 4, [this](size_t begin, size_t end){
+            std::vector<float> halfX(kLutSamples);
+            std::vector<float> halfZ(kLutSamples);
+            for (size_t row = begin; row < end; row++){
+                float roughness = (row + 0.5f) / kLutSize;
+                float alpha = roughness * roughness;
+                // Smith-Schlick for image-based lighting: k = alpha / 2.
+                float k = 0.5f * alpha;
+                for (int s = 0; s < kLutSamples; s++){
+                    float phi = 2.0f * kPi * s / kLutSamples;
+                    float u = RadicalInverse((uint32_t)s);
+                    float cosTheta = std::sqrt((1.0f - u) / (1.0f + (alpha * alpha - 1.0f) * u));
+                    halfX[s] = std::sqrt(1.0f - cosTheta * cosTheta) * std::cos(phi);
+                    halfZ[s] = cosTheta;
+                }
+                Float4 zero = Float4Splat(0.0f);
+                Float4 one = Float4Splat(1.0f);
+                Float4 two = Float4Splat(2.0f);
+                Float4 oneMinusK = Float4Splat(1.0f - k);
+                Float4 kk = Float4Splat(k);
+                for (int x = 0; x < kLutSize; x += 4){
+                    Float4 nv = Float4Set((x + 0.5f) / kLutSize, (x + 1.5f) / kLutSize, (x + 2.5f) / kLutSize, (x + 3.5f) / kLutSize);
+                    Float4 vx = Float4Sqrt(one - nv * nv);
+                    Float4 gv = nv / (nv * oneMinusK + kk);
+                    Float4 scale = zero;
+                    Float4 bias = zero;
+                    for (int s = 0; s < kLutSamples; s++){
+                        Float4 hx = Float4Splat(halfX[s]);
+                        Float4 hz = Float4Splat(halfZ[s]);
+                        Float4 vh = Float4Max(vx * hx + nv * hz, zero);
+                        Float4 nl = two * vh * hz - nv;
+                        Float4 lit = Float4CmpGt(nl, zero);
+                        nl = Float4Max(nl, zero);
+                        Float4 visibility = gv * nl / (nl * oneMinusK + kk) * vh / (hz * nv);
+                        Float4 fc = one - vh;
+                        Float4 fc2 = fc * fc;
+                        fc = fc2 * fc2 * fc;
+                        scale = scale + Float4Select(lit, (one - fc) * visibility, zero);
+                        bias = bias + Float4Select(lit, fc * visibility, zero);
+                    }
+                    float scales[4];
+                    float biases[4];
+                    Float4Store(scales, scale);
+                    Float4Store(biases, bias);
+                    for (int i = 0; i < 4; i++){
+                        mLut[(row * kLutSize + x + i) * 2] = scales[i] / kLutSamples;
+                        mLut[(row * kLutSize + x + i) * 2 + 1] = biases[i] / kLutSamples;
+                    }
+                }
+            }
+        });
+    }
+
+    void ImageBasedLighting::Compute(){
+        TRACE_SCOPE("ImageBasedLighting::Compute");
+        // The sky at kSkySize, then halved down to the smallest source used.
+        std::vector<std::vector<float>> sky(1);
+        sky[0].resize(6 * (size_t)kSkySize * kSkySize * 3);
+        mJobs->ParallelFor(6 * (size_t)kSkySize, 16, [this, &sky](size_t begin, size_t end){
+            for (size_t row = begin; row < end; row++){
+                for (int x = 0; x < kSkySize; x++){
+                    glm::vec3 radiance = SampleSky(CubeDirection((int)row / kSkySize, kSkySize, x, (int)row % kSkySize));
+                    float* texel = &sky[0][(row * kSkySize + x) * 3];
+                    texel[0] = radiance.x;
+                    texel[1] = radiance.y;
+                    texel[2] = radiance.z;
+                }
+            }
+        });
+        for (int size = kSkySize; size > 16; size /= 2){
+            sky.emplace_back();
+            Downsample(sky[sky.size() - 2], size, sky.back());
+        }
+        auto level = [&sky](int size) -> const std::vector<float>& {
+            int index = 0;
+            while ((kSkySize >> index) > size){
+                index++;
+            }
+            return sky[index];
+        };
+
+        SourceTexels source;
+        GatherTexels(level(2 * kIrradianceSize), 2 * kIrradianceSize, source);
+        Convolve(source, kIrradianceSize, -1.0f, mIrradiance, *mJobs);
+        // Level 0 is the mirror: the sky itself.
+        mSpecular[0] = level(kSpecularSize);
+        for (int i = 1; i < kSpecularLevels; i++){
+            // Sources at twice the output size keep the narrow lobes smooth.
+            int size = kSpecularSize >> i;
+            int sourceSize = std::max(2 * size, 16);
+            GatherTexels(level(sourceSize), sourceSize, source);
+            Convolve(source, size, (float)i / (kSpecularLevels - 1), mSpecular[i], *mJobs);
+        }
+        ComputeLut();
+    }
+
+    // Keyed on everything the maps depend on, kCacheVersion standing for the code.
+    std::string ImageBasedLighting::GetCachePath(const std::string& cacheDirectory) const{
+        uint32_t words[12] = { kCacheVersion, (uint32_t)kSkySize, (uint32_t)kIrradianceSize, (uint32_t)kSpecularSize,
+                               (uint32_t)kSpecularLevels, (uint32_t)kLutSize, (uint32_t)kLutSamples };
+        const float parameters[5] = { mSunDirection.x, mSunDirection.y, mSunDirection.z, kSunRadius, kSunRadiance };
+        memcpy(&words[7], parameters, sizeof(parameters));
+        return DiskCache::GetPath(cacheDirectory, DiskCache::Hash(words, sizeof(words)), "ibl");
+    }
+
+    // Cache file: magic and version, then the irradiance cube, the specular
+    // levels and the table as raw floats.
+    bool ImageBasedLighting::LoadCache(const std::string& path){
+        std::ifstream cache(path, std::ios::binary);
+        char magic[4];
+        uint32_t version;
+        if (!cache.read(magic, 4) || !cache.read((char*)&version, sizeof(version)) || memcmp(magic, kCacheMagic, 4) != 0
+            || version != kCacheVersion){
+            return false;
+        }
+        mIrradiance.resize(6 * (size_t)kIrradianceSize * kIrradianceSize * 3);
+        cache.read((char*)mIrradiance.data(), mIrradiance.size() * sizeof(float));
+        for (int i = 0; i < kSpecularLevels; i++){
+            int size = kSpecularSize >> i;
+            mSpecular[i].resize(6 * (size_t)size * size * 3);
+            cache.read((char*)mSpecular[i].data(), mSpecular[i].size() * sizeof(float));
+        }
+        mLut.resize((size_t)kLutSize * kLutSize * 2);
+        cache.read((char*)mLut.data(), mLut.size() * sizeof(float));
+        return (bool)cache;
+    }
+
+    bool ImageBasedLighting::SaveCache(const std::string& path) const{
+        return DiskCache::Write(path, [this](std::ofstream& cache){
+            cache.write(kCacheMagic, 4);
+            cache.write((const char*)&kCacheVersion, sizeof(kCacheVersion));
+            cache.write((const char*)mIrradiance.data(), mIrradiance.size() * sizeof(float));
+            for (int i = 0; i < kSpecularLevels; i++){
+                cache.write((const char*)mSpecular[i].data(), mSpecular[i].size() * sizeof(float));
+            }
+            cache.write((const char*)mLut.data(), mLut.size() * sizeof(float));
+        });
+    }
+
+    void ImageBasedLighting::Prepare(const std::string& cacheDirectory){
+        std::string path = cacheDirectory.empty() ? std::string() : GetCachePath(cacheDirectory);
+        if (!path.empty() && LoadCache(path)){
+            std::cout << "Loaded environment lighting from " << path << std::endl;
+            return;
+        }
+        auto start = std::chrono::steady_clock::now();
+        Compute();
+        std::cout << "Precomputed environment lighting in "
+                  << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms" << std::endl;
+        if (!path.empty()){
+            SaveCache(path);
+        }
+    }
+
+    void ImageBasedLighting::Create(){
+        glGenTextures(3, mTextures);
+        // Filtering across cube faces; without it every face edge shows a seam.
+        glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, mTextures[0]);
+        for (int face = 0; face < 6; face++){
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_RGB16F, kIrradianceSize, kIrradianceSize, 0, GL_RGB, GL_FLOAT,
+                         mIrradiance.data() + (size_t)face * kIrradianceSize * kIrradianceSize * 3);
+        }
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, 0);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, mTextures[1]);
+        for (int i = 0; i < kSpecularLevels; i++){
+            int size = kSpecularSize >> i;
+            for (int face = 0; face < 6; face++){
+                glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, i, GL_RGB16F, size, size, 0, GL_RGB, GL_FLOAT,
+                             mSpecular[i].data() + (size_t)face * size * size * 3);
+            }
+        }
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, kSpecularLevels - 1);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+        glBindTexture(GL_TEXTURE_2D, mTextures[2]);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, kLutSize, kLutSize, 0, GL_RG, GL_FLOAT, mLut.data());
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    void ImageBasedLighting::Destroy(){
+        glDeleteTextures(3, mTextures);
+        for (int i = 0; i < 3; i++){
+            mTextures[i] = 0;
+        }
+    }
+
+    ImageBasedLighting::Uniforms ImageBasedLighting::FindUniforms(GLuint program){
+        static const char* kSamplers[3] = { "u_Irradiance", "u_Specular", "u_BrdfLut" };
+        Uniforms uniforms;
+        for (int i = 0; i < 3; i++){
+            uniforms.mSamplers[i] = glGetUniformLocation(program, kSamplers[i]);
+        }
+        uniforms.mSpecularLevels = glGetUniformLocation(program, "u_SpecularLevels");
+        uniforms.mViewToWorld = glGetUniformLocation(program, "u_ViewToWorld");
+        return uniforms;
+    }
+
+    void ImageBasedLighting::Bind(const Uniforms& uniforms, int firstUnit, const glm::mat4& cameraView) const{
+        static const GLenum kTargets[3] = { GL_TEXTURE_CUBE_MAP, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_2D };
+        for (int i = 0; i < 3; i++){
+            glActiveTexture(GL_TEXTURE0 + firstUnit + i);
+            glBindTexture(kTargets[i], mTextures[i]);
+            glUniform1i(uniforms.mSamplers[i], firstUnit + i);
+        }
+        glActiveTexture(GL_TEXTURE0);
+        glUniform1f(uniforms.mSpecularLevels, (float)(kSpecularLevels - 1));
+        // The view is a rotation and a translation: its inverse rotation is the transpose.
+        glm::mat3 viewToWorld = glm::transpose(glm::mat3(cameraView));
+        glUniformMatrix3fv(uniforms.mViewToWorld, 1, GL_FALSE, &viewToWorld[0][0]);
+    }
+
+    void ImageBasedLighting::RunMicrobenchmark(const std::string& cacheDirectory){
+        typedef std::chrono::steady_clock Clock;
+        auto milliseconds = [](Clock::time_point start){
+            return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        };
+        ImageBasedLighting lighting;
+        lighting.SetSunDirection(glm::vec3(0.15f, -0.2f, -1.0f));
+        std::cout << "Irradiance " << kIrradianceSize << "^2, specular " << kSpecularSize << "^2 x " << kSpecularLevels
+                  << " levels, table " << kLutSize << "^2 x " << kLutSamples << " samples, "
+                  << JobSystem::Shared().GetThreadCount() << " threads" << std::endl;
+        Clock::time_point start = Clock::now();
+        lighting.Compute();
+        double computeTime = milliseconds(start);
+        start = Clock::now();
+        lighting.ComputeLut();
+        double lutTime = milliseconds(start);
+        std::cout << "Precompute: " << computeTime << " ms (cubes " << computeTime - lutTime << " ms, table " << lutTime << " ms)" << std::endl;
+
+        std::string directory = cacheDirectory.empty() ? std::string(".") : cacheDirectory;
+        std::string path = lighting.GetCachePath(directory);
+        start = Clock::now();
+        lighting.SaveCache(path);
+        double saveTime = milliseconds(start);
+        ImageBasedLighting loaded;
+        start = Clock::now();
+        bool ok = loaded.LoadCache(path);
+        double loadTime = milliseconds(start);
+        remove(path.c_str());
+        ok = ok && loaded.mSpecular[1] == lighting.mSpecular[1] && loaded.mLut == lighting.mLut;
+        std::cout << "Cache: written in " << saveTime << " ms, read back in " << loadTime << " ms"
+                  << (ok ? "" : " (MISMATCH)") << ", " << computeTime / std::max(loadTime, 1e-3) << "x faster than computing" << std::endl;
+
+        // White furnace: under a uniform white sky the irradiance is 1 everywhere,
+        // and a smooth surface with F0 = 1 reflects scale + bias = 1 head on.
+        std::vector<float> white(6 * 32 * 32 * 3, 1.0f);
+        SourceTexels source;
+        GatherTexels(white, 32, source);
+        std::vector<float> irradiance;
+        Convolve(source, 8, -1.0f, irradiance, JobSystem::Shared());
+        const float* smooth = &lighting.mLut[(size_t)(kLutSize - 1) * 2];
+        std::cout << "White furnace: irradiance " << *std::min_element(irradiance.begin(), irradiance.end()) << ".."
+                  << *std::max_element(irradiance.begin(), irradiance.end()) << ", table at NdotV 1, roughness 0: "
+                  << smooth[0] + smooth[1] << std::endl;
+    }
@@ -0,0 +1,109 @@
+#include "InputSystem.hpp"
+#include <algorithm>
+#include <iostream>
+
+namespace{
+    void PrintLatency(const char* name, std::vector<double> samples){
+        if (samples.empty()){
+            return;
+        }
+        double total = 0.0;
+        for (double sample : samples){
+            total += sample;
+        }
+        size_t percentile = samples.size() * 99 / 100;
+        std::nth_element(samples.begin(), samples.begin() + percentile, samples.end());
+        std::cout << "Input latency to " << name << ": " << total / samples.size() << " ms mean, "
+                  << samples[percentile] << " ms p99 over " << samples.size() << " events" << std::endl;
+    }
+}
+
+    InputSystem::InputSystem(){
+        mSyntheticRunning = false;
+    }
+    InputSystem::~InputSystem(){
+        StopSyntheticMotion();
+    }
+
+    void InputSystem::Push(const InputEvent& event){
+        std::lock_guard<std::mutex> lock(mMutex);
+        mEvents.push_back(event);
+    }
+
+    void InputSystem::TakeEvents(std::vector<InputEvent>& events){
+        std::lock_guard<std::mutex> lock(mMutex);
+        size_t kept = 0;
+        for (const InputEvent& event : mEvents){
+            if (event.mType == InputEvent::kMouseMotion){
+                mEvents[kept++] = event;
+            } else {
+                events.push_back(event);
+            }
+        }
+        mEvents.resize(kept);
+    }
+
+    bool InputSystem::TakeMotion(int& dx, int& dy){
+        dx = 0;
+        dy = 0;
+        bool moved = false;
+        Clock::time_point now = Clock::now();
+        std::lock_guard<std::mutex> lock(mMutex);
+        size_t kept = 0;
+        for (const InputEvent& event : mEvents){
+            if (event.mType != InputEvent::kMouseMotion){
+                mEvents[kept++] = event;
+                continue;
+            }
+            dx += event.mX;
+            dy += event.mY;
+            moved = true;
+            mLatchedArrivals.push_back(event.mTime);
+            mLatchTimes.push_back(now);
+        }
+        mEvents.resize(kept);
+        return moved;
+    }
+
+    void InputSystem::FrameCompleted(){
+        Clock::time_point now = Clock::now();
+        std::lock_guard<std::mutex> lock(mMutex);
+        for (size_t i = 0; i < mLatchedArrivals.size(); i++){
+            mLatchMilliseconds.push_back(std::chrono::duration<double, std::milli>(mLatchTimes[i] - mLatchedArrivals[i]).count());
+            mFrameMilliseconds.push_back(std::chrono::duration<double, std::milli>(now - mLatchedArrivals[i]).count());
+        }
+        mLatchedArrivals.clear();
+        mLatchTimes.clear();
+    }
+
+    void InputSystem::StartSyntheticMotion(double eventsPerSecond, int dx){
+        if (mSyntheticRunning || eventsPerSecond <= 0.0){
+            return;
+        }
+        mSyntheticRunning = true;
+        mSyntheticThread = std::thread([this, eventsPerSecond, dx](){
+            Clock::duration period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / eventsPerSecond));
+            Clock::time_point next = Clock::now();
+            while (mSyntheticRunning){
+                next += period;
+                std::this_thread::sleep_until(next);
+                InputEvent event;
+                event.mTime = Clock::now();
+                event.mX = dx;
+                Push(event);
+            }
+        });
+    }
+
+    void InputSystem::StopSyntheticMotion(){
+        if (!mSyntheticRunning){
+            return;
+        }
+        mSyntheticRunning = false;
+        mSyntheticThread.join();
+    }
+
+    void InputSystem::PrintLatencyReport() const{
+        PrintLatency("latch", mLatchMilliseconds);
+        PrintLatency("frame complete", mFrameMilliseconds);
+    }
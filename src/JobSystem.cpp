@@ -0,0 +1,110 @@
+#include "JobSystem.hpp"
+#include "Trace.hpp"
+#include <atomic>
+
+    JobSystem::JobSystem(unsigned int threadCount){
+        mStopping = false;
+        if (threadCount == 0){
+            unsigned int hardware = std::thread::hardware_concurrency();
+            threadCount = hardware > 1 ? hardware - 1 : 1;
+        }
+        for (unsigned int i = 0; i < threadCount; i++){
+            mThreads.emplace_back(&JobSystem::WorkerLoop, this);
+        }
+    }
+    JobSystem::~JobSystem(){
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mStopping = true;
+        }
+        mWake.notify_all();
+        for (std::thread& thread : mThreads){
+            thread.join();
+        }
+    }
+    void JobSystem::Submit(std::function<void()> job){
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mJobs.push_back(std::move(job));
+        }
+        mWake.notify_one();
+    }
+    void JobSystem::SubmitBackground(std::function<void()> job){
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mBackgroundJobs.push_back(std::move(job));
+        }
+        mWake.notify_one();
+    }
+    void JobSystem::ParallelFor(size_t count, size_t grainSize, const std::function<void(size_t, size_t)>& body){
+        if (count == 0){
+            return;
+        }
+        if (grainSize == 0){
+            grainSize = 1;
+        }
+        size_t chunkCount = (count + grainSize - 1) / grainSize;
+        if (chunkCount == 1){
+            body(0, count);
+            return;
+        }
+        std::atomic<size_t> remaining(chunkCount);
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            // The caller takes chunk 0 itself, everything else goes to the pool.
+            for (size_t chunk = 1; chunk < chunkCount; chunk++){
+                size_t begin = chunk * grainSize;
+                size_t end = begin + grainSize < count ? begin + grainSize : count;
+                mJobs.push_back([&body, &remaining, begin, end](){
+                    body(begin, end);
+                    remaining.fetch_sub(1, std::memory_order_release);
+                });
+            }
+        }
+        mWake.notify_all();
+        body(0, grainSize < count ? grainSize : count);
+        remaining.fetch_sub(1, std::memory_order_release);
+        while (remaining.load(std::memory_order_acquire) != 0){
+            if (!RunOne()){
+                std::this_thread::yield();
+            }
+        }
+    }
+    unsigned int JobSystem::GetThreadCount() const{
+        return (unsigned int)mThreads.size() + 1;
+    }
+    JobSystem& JobSystem::Shared(){
+        static JobSystem shared;
+        return shared;
+    }
+    bool JobSystem::RunOne(){
+        std::function<void()> job;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            if (mJobs.empty()){
+                return false;
+            }
+            job = std::move(mJobs.front());
+            mJobs.pop_front();
+        }
+        job();
+        return true;
+    }
+    void JobSystem::WorkerLoop(){
+        TRACE_THREAD_NAME("JobSystem worker");
+        for (;;){
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(mMutex);
+                mWake.wait(lock, [this](){ return mStopping || !mJobs.empty() || !mBackgroundJobs.empty(); });
+                if (mStopping && mJobs.empty() && mBackgroundJobs.empty()){
+                    return;
+                }
+                // Loop chunks first: someone is waiting on them.
+                std::deque<std::function<void()>>& queue = !mJobs.empty() ? mJobs : mBackgroundJobs;
+                job = std::move(queue.front());
+                queue.pop_front();
+            }
+            job();
+        }
+    }
@@ -0,0 +1,616 @@
+#include "MeshSimplifier.hpp"
+#include "Camera.hpp"
+#include "Trace.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <queue>
+#include <unordered_map>
+
+    // Quadrics live in x,y,z,nx,ny,nz,u,v space. Attributes are scaled by the
+    // mesh radius so their error is measured in the same units as position.
+    static const int kDimensions = 8;
+    static const int kMatrixSize = kDimensions * (kDimensions + 1) / 2;
+    static const double kNormalWeight = 0.05;
+    static const double kTexCoordWeight = 0.05;
+    // Flat regions cost almost nothing everywhere, so without a limit one vertex
+    // keeps absorbing its neighbours into a fan of slivers.
+    static const size_t kMaxValence = 12;
+
+    struct Quadric{
+        double mA[kMatrixSize];   // upper triangle, row by row
+        double mB[kDimensions];
+        double mC;
+    };
+
+    static void QuadricAddTriangle(Quadric& quadric, const double* p, const double* q, const double* r, double weight){
+        // Squared distance to the plane through p, q, r in attribute space:
+        // A = I - e1 e1^T - e2 e2^T, b = (p.e1) e1 + (p.e2) e2 - p, c = p.p - (p.e1)^2 - (p.e2)^2
+        double e1[kDimensions];
+        double e2[kDimensions];
+        double length1 = 0.0;
+        for (int i = 0; i < kDimensions; i++){
+            e1[i] = q[i] - p[i];
+            length1 += e1[i] * e1[i];
+        }
+        if (length1 <= 0.0){
+            return;
+        }
+        length1 = 1.0 / std::sqrt(length1);
+        double projection = 0.0;
+        for (int i = 0; i < kDimensions; i++){
+            e1[i] *= length1;
+            projection += e1[i] * (r[i] - p[i]);
+        }
+        double length2 = 0.0;
+        for (int i = 0; i < kDimensions; i++){
+            e2[i] = r[i] - p[i] - projection * e1[i];
+            length2 += e2[i] * e2[i];
+        }
+        if (length2 <= 0.0){
+            return;
+        }
+        length2 = 1.0 / std::sqrt(length2);
+        double pe1 = 0.0;
+        double pe2 = 0.0;
+        double pp = 0.0;
+        for (int i = 0; i < kDimensions; i++){
+            e2[i] *= length2;
+            pe1 += p[i] * e1[i];
+            pe2 += p[i] * e2[i];
+            pp += p[i] * p[i];
+        }
+        int index = 0;
+        for (int i = 0; i < kDimensions; i++){
+            for (int j = i; j < kDimensions; j++){
+                double identity = i == j ? 1.0 : 0.0;
+                quadric.mA[index++] += weight * (identity - e1[i] * e1[j] - e2[i] * e2[j]);
+            }
+            quadric.mB[i] += weight * (pe1 * e1[i] + pe2 * e2[i] - p[i]);
+        }
+        quadric.mC += weight * (pp - pe1 * pe1 - pe2 * pe2);
+    }
+    static void QuadricAdd(Quadric& quadric, const Quadric& other){
+        for (int i = 0; i < kMatrixSize; i++){
+            quadric.mA[i] += other.mA[i];
+        }
+        for (int i = 0; i < kDimensions; i++){
+            quadric.mB[i] += other.mB[i];
+        }
+        quadric.mC += other.mC;
+    }
+    static double QuadricEvaluate(const Quadric& quadric, const double* x){
+        double result = quadric.mC;
+        int index = 0;
+        for (int i = 0; i < kDimensions; i++){
+            result += quadric.mA[index++] * x[i] * x[i];
+            for (int j = i + 1; j < kDimensions; j++){
+                result += 2.0 * quadric.mA[index++] * x[i] * x[j];
+            }
+            result += 2.0 * quadric.mB[i] * x[i];
+        }
+        return std::max(result, 0.0);
+    }
+
+    // Area-weighted squared distance to triangle planes in position space only,
+    // kept apart from the attribute quadric so the error reported per level is
+    // a length: the quadric divided by its area is a mean squared distance.
+    struct PlaneQuadric{
+        double mA[6];   // upper triangle of the 3x3 matrix, row by row
+        double mB[3];
+        double mC;
+        double mArea;
+    };
+
+    static void PlaneQuadricAdd(PlaneQuadric& quadric, const PlaneQuadric& other){
+        for (int i = 0; i < 6; i++){
+            quadric.mA[i] += other.mA[i];
+        }
+        for (int i = 0; i < 3; i++){
+            quadric.mB[i] += other.mB[i];
+        }
+        quadric.mC += other.mC;
+        quadric.mArea += other.mArea;
+    }
+    static double PlaneQuadricDistance(const PlaneQuadric& quadric, const double* x){
+        if (quadric.mArea <= 0.0){
+            return 0.0;
+        }
+        const double* a = quadric.mA;
+        double squared = a[0] * x[0] * x[0] + a[3] * x[1] * x[1] + a[5] * x[2] * x[2]
+                         + 2.0 * (a[1] * x[0] * x[1] + a[2] * x[0] * x[2] + a[4] * x[1] * x[2])
+                         + 2.0 * (quadric.mB[0] * x[0] + quadric.mB[1] * x[1] + quadric.mB[2] * x[2]) + quadric.mC;
+        return std::sqrt(std::max(squared, 0.0) / quadric.mArea);
+    }
+
+    struct VertexHash{
+        size_t operator()(const Vertex& vertex) const{
+            uint32_t words[sizeof(Vertex) / sizeof(uint32_t)];
+            memcpy(words, &vertex, sizeof(words));
+            uint64_t hash = 1469598103934665603ull;
+            for (uint32_t word : words){
+                hash = (hash ^ word) * 1099511628211ull;
+            }
+            return (size_t)hash;
+        }
+    };
+    struct VertexEqual{
+        bool operator()(const Vertex& a, const Vertex& b) const{
+            return memcmp(&a, &b, sizeof(Vertex)) == 0;
+        }
+    };
+    struct PositionHash{
+        size_t operator()(const glm::vec3& position) const{
+            uint32_t words[3];
+            memcpy(words, &position, sizeof(words));
+            return (size_t)(((uint64_t)words[0] * 73856093u) ^ ((uint64_t)words[1] * 19349663u) ^ ((uint64_t)words[2] * 83492791u));
+        }
+    };
+
+    Mesh MeshSimplifier::WeldVertices(const Mesh& mesh){
+        static_assert(sizeof(Vertex) == 12 * sizeof(float), "Vertex is hashed as twelve packed floats");
+        Mesh welded;
+        std::unordered_map<Vertex, unsigned int, VertexHash, VertexEqual> lookup;
+        lookup.reserve(mesh.vertices.size());
+        welded.indices.reserve(mesh.indices.size());
+        for (unsigned int index : mesh.indices){
+            const Vertex& vertex = mesh.vertices[index];
+            auto inserted = lookup.emplace(vertex, (unsigned int)welded.vertices.size());
+            if (inserted.second){
+                welded.vertices.push_back(vertex);
+            }
+            welded.indices.push_back(inserted.first->second);
+        }
+        return welded;
+    }
+
+    // Collapse state over welded positions; each position owns one or more
+    // wedges (vertices that share it but differ in normal or UV).
+    class EdgeCollapser{
+        public:
+        EdgeCollapser(const Mesh& mesh, float radius);
+        // Collapses until at most targetTriangles remain or nothing legal is left.
+        void CollapseTo(size_t targetTriangles);
+        void AppendIndices(std::vector<unsigned int>& out) const;
+        size_t GetTriangleCount() const { return mLiveTriangles; }
+        // The largest plane distance (see PlaneQuadric) of any collapse so far.
+        float GetError() const { return (float)mMaxDistance; }
+        private:
+            struct Candidate{
+                double mCost;
+                uint32_t mVertex;
+                uint32_t mTarget;
+                uint32_t mVersion;
+                bool operator<(const Candidate& other) const { return mCost > other.mCost; }
+            };
+            uint32_t PositionOf(uint32_t triangle, int corner) const { return mWedgePosition[mTriangleWedges[triangle * 3 + corner]]; }
+            bool Contains(uint32_t triangle, uint32_t position) const;
+            void GatherNeighbors(uint32_t position, std::vector<uint32_t>& out) const;
+            // fromNeighbors: the one-ring of from, as gathered by the caller.
+            bool IsLegal(uint32_t from, uint32_t to, const std::vector<uint32_t>& fromNeighbors);
+            // Queues the cheapest collapse of position. Legality is expensive, so
+            // by default it is left to CollapseTo, which re-queues with
+            // checkLegality when the cheapest edge turns out to be illegal.
+            void UpdateCandidate(uint32_t position, bool checkLegality = false);
+            void Collapse(uint32_t from, uint32_t to);
+            uint32_t MatchWedge(uint32_t wedge, uint32_t position) const;
+
+            std::vector<double> mWedgeAttributes;
+            std::vector<uint32_t> mWedgePosition;
+            std::vector<uint32_t> mPositionWedgeStart;
+            std::vector<uint32_t> mPositionWedges;
+            std::vector<Quadric> mQuadrics;
+            std::vector<PlaneQuadric> mPlaneQuadrics;
+            // Each quadric evaluated at its own position, which only changes
+            // when the position absorbs a collapse.
+            std::vector<double> mResidual;
+            std::vector<std::vector<uint32_t>> mPositionTriangles;
+            std::vector<uint32_t> mVersion;
+            std::vector<uint8_t> mRemoved;
+            std::vector<uint8_t> mBorder;
+            std::vector<uint32_t> mTriangleWedges;
+            std::vector<uint8_t> mTriangleAlive;
+            std::priority_queue<Candidate> mQueue;
+            std::vector<uint32_t> mScratchB;
+            std::vector<uint32_t> mScratchNeighbors;
+            std::vector<uint32_t> mScratchCollapse;
+            size_t mLiveTriangles;
+            double mMaxDistance;
+    };
+
+    EdgeCollapser::EdgeCollapser(const Mesh& mesh, float radius){
+        mLiveTriangles = mesh.indices.size() / 3;
+        mMaxDistance = 0.0;
+        size_t wedgeCount = mesh.vertices.size();
+        double normalScale = kNormalWeight * radius;
+        double texCoordScale = kTexCoordWeight * radius;
+        mWedgeAttributes.resize(wedgeCount * kDimensions);
+        mWedgePosition.resize(wedgeCount);
+        std::unordered_map<glm::vec3, uint32_t, PositionHash> positions;
+        positions.reserve(wedgeCount);
+        for (size_t w = 0; w < wedgeCount; w++){
+            const Vertex& vertex = mesh.vertices[w];
+            double* x = &mWedgeAttributes[w * kDimensions];
+            x[0] = vertex.position.x;
+            x[1] = vertex.position.y;
+            x[2] = vertex.position.z;
+            x[3] = vertex.normal.x * normalScale;
+            x[4] = vertex.normal.y * normalScale;
+            x[5] = vertex.normal.z * normalScale;
+            x[6] = vertex.texCoord.x * texCoordScale;
+            x[7] = vertex.texCoord.y * texCoordScale;
+            mWedgePosition[w] = positions.emplace(vertex.position, (uint32_t)positions.size()).first->second;
+        }
+        size_t positionCount = positions.size();
+        // Wedges grouped by position; the first one is the position's representative.
+        mPositionWedgeStart.assign(positionCount + 1, 0);
+        for (size_t w = 0; w < wedgeCount; w++){
+            mPositionWedgeStart[mWedgePosition[w] + 1]++;
+        }
+        for (size_t p = 0; p < positionCount; p++){
+            mPositionWedgeStart[p + 1] += mPositionWedgeStart[p];
+        }
+        mPositionWedges.resize(wedgeCount);
+        std::vector<uint32_t> fill(mPositionWedgeStart.begin(), mPositionWedgeStart.end() - 1);
+        for (size_t w = 0; w < wedgeCount; w++){
+            mPositionWedges[fill[mWedgePosition[w]]++] = (uint32_t)w;
+        }
+
+        size_t triangleCount = mesh.indices.size() / 3;
+        mTriangleWedges.assign(mesh.indices.begin(), mesh.indices.begin() + triangleCount * 3);
+        mTriangleAlive.assign(triangleCount, 1);
+        mQuadrics.assign(positionCount, Quadric());
+        mPlaneQuadrics.assign(positionCount, PlaneQuadric());
+        mPositionTriangles.resize(positionCount);
+        for (uint32_t t = 0; t < triangleCount; t++){
+            const uint32_t* wedges = &mTriangleWedges[t * 3];
+            const double* p = &mWedgeAttributes[wedges[0] * kDimensions];
+            const double* q = &mWedgeAttributes[wedges[1] * kDimensions];
+            const double* r = &mWedgeAttributes[wedges[2] * kDimensions];
+            glm::dvec3 e1(q[0] - p[0], q[1] - p[1], q[2] - p[2]);
+            glm::dvec3 e2(r[0] - p[0], r[1] - p[1], r[2] - p[2]);
+            glm::dvec3 cross = glm::cross(e1, e2);
+            double area = 0.5 * glm::length(cross);
+            Quadric quadric = {};
+            QuadricAddTriangle(quadric, p, q, r, area);
+            PlaneQuadric plane = {};
+            if (area > 0.0){
+                glm::dvec3 n = glm::normalize(cross);
+                double d = -(n.x * p[0] + n.y * p[1] + n.z * p[2]);
+                double a[6] = { n.x * n.x, n.x * n.y, n.x * n.z, n.y * n.y, n.y * n.z, n.z * n.z };
+                for (int i = 0; i < 6; i++){
+                    plane.mA[i] = area * a[i];
+                }
+                plane.mB[0] = area * d * n.x;
+                plane.mB[1] = area * d * n.y;
+                plane.mB[2] = area * d * n.z;
+                plane.mC = area * d * d;
+                plane.mArea = area;
+            }
+            for (int corner = 0; corner < 3; corner++){
+                uint32_t position = mWedgePosition[wedges[corner]];
+                QuadricAdd(mQuadrics[position], quadric);
+                PlaneQuadricAdd(mPlaneQuadrics[position], plane);
+                mPositionTriangles[position].push_back(t);
+            }
+        }
+
+        // Border positions have an edge used by a single triangle, i.e. a
+        // neighbour that appears in only one of their triangles.
+        mBorder.assign(positionCount, 0);
+        std::vector<uint32_t> ring;
+        for (uint32_t p = 0; p < positionCount; p++){
+            ring.clear();
+            for (uint32_t t : mPositionTriangles[p]){
+                for (int corner = 0; corner < 3; corner++){
+                    if (PositionOf(t, corner) != p){
+                        ring.push_back(PositionOf(t, corner));
+                    }
+                }
+            }
+            std::sort(ring.begin(), ring.end());
+            for (size_t i = 0; i < ring.size(); ){
+                size_t j = i;
+                while (j < ring.size() && ring[j] == ring[i]){
+                    j++;
+                }
+                if (j - i == 1){
+                    mBorder[p] = 1;
+                    break;
+                }
+                i = j;
+            }
+        }
+        mResidual.resize(positionCount);
+        for (uint32_t p = 0; p < positionCount; p++){
+            mResidual[p] = QuadricEvaluate(mQuadrics[p], &mWedgeAttributes[mPositionWedges[mPositionWedgeStart[p]] * kDimensions]);
+        }
+        mVersion.assign(positionCount, 0);
+        mRemoved.assign(positionCount, 0);
+        for (uint32_t p = 0; p < positionCount; p++){
+            UpdateCandidate(p);
+        }
+    }
+    bool EdgeCollapser::Contains(uint32_t triangle, uint32_t position) const{
+        return PositionOf(triangle, 0) == position || PositionOf(triangle, 1) == position || PositionOf(triangle, 2) == position;
+    }
+    void EdgeCollapser::GatherNeighbors(uint32_t position, std::vector<uint32_t>& out) const{
+        out.clear();
+        for (uint32_t t : mPositionTriangles[position]){
+            if (!mTriangleAlive[t]){
+                continue;
+            }
+            for (int corner = 0; corner < 3; corner++){
+                uint32_t other = PositionOf(t, corner);
+                if (other != position && std::find(out.begin(), out.end(), other) == out.end()){
+                    out.push_back(other);
+                }
+            }
+        }
+    }
+    bool EdgeCollapser::IsLegal(uint32_t from, uint32_t to, const std::vector<uint32_t>& fromNeighbors){
+        int sharedTriangles = 0;
+        for (uint32_t t : mPositionTriangles[from]){
+            if (mTriangleAlive[t] && Contains(t, to)){
+                sharedTriangles++;
+            }
+        }
+        // Border vertices may only slide along the border.
+        if (mBorder[from] && sharedTriangles != 1){
+            return false;
+        }
+        // Link condition: the endpoints may share no neighbours other than the
+        // apexes of the triangles on the edge, or the collapse pinches the surface.
+        GatherNeighbors(to, mScratchB);
+        int sharedNeighbors = 0;
+        for (uint32_t neighbor : fromNeighbors){
+            if (std::find(mScratchB.begin(), mScratchB.end(), neighbor) != mScratchB.end()){
+                sharedNeighbors++;
+            }
+        }
+        if (sharedNeighbors != sharedTriangles){
+            return false;
+        }
+        if (fromNeighbors.size() + mScratchB.size() - sharedNeighbors - 2 > kMaxValence){
+            return false;
+        }
+        // Reject collapses that flip a surviving triangle.
+        const double* target = &mWedgeAttributes[mPositionWedges[mPositionWedgeStart[to]] * kDimensions];
+        glm::dvec3 targetPosition(target[0], target[1], target[2]);
+        for (uint32_t t : mPositionTriangles[from]){
+            if (!mTriangleAlive[t] || Contains(t, to)){
+                continue;
+            }
+            glm::dvec3 corners[3];
+            glm::dvec3 moved[3];
+            for (int corner = 0; corner < 3; corner++){
+                const double* x = &mWedgeAttributes[mTriangleWedges[t * 3 + corner] * kDimensions];
+                corners[corner] = glm::dvec3(x[0], x[1], x[2]);
+                moved[corner] = PositionOf(t, corner) == from ? targetPosition : corners[corner];
+            }
+            glm::dvec3 before = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+            glm::dvec3 after = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+            if (glm::dot(before, after) <= 0.0){
+                return false;
+            }
+        }
+        return true;
+    }
+    void EdgeCollapser::UpdateCandidate(uint32_t position, bool checkLegality){
+        mVersion[position]++;
+        std::vector<uint32_t>& neighbors = mScratchNeighbors;
+        GatherNeighbors(position, neighbors);
+        Candidate best = { 0.0, position, 0, mVersion[position] };
+        bool found = false;
+        for (uint32_t neighbor : neighbors){
+            const double* x = &mWedgeAttributes[mPositionWedges[mPositionWedgeStart[neighbor]] * kDimensions];
+            double cost = QuadricEvaluate(mQuadrics[position], x) + mResidual[neighbor];
+            if ((!found || cost < best.mCost) && (!checkLegality || IsLegal(position, neighbor, neighbors))){
+                best.mCost = cost;
+                best.mTarget = neighbor;
+                found = true;
+            }
+        }
+        if (found){
+            mQueue.push(best);
+        }
+    }
+    uint32_t EdgeCollapser::MatchWedge(uint32_t wedge, uint32_t position) const{
+        // The target wedge whose normal and UV are closest to the one being replaced.
+        const double* x = &mWedgeAttributes[wedge * kDimensions];
+        uint32_t best = mPositionWedges[mPositionWedgeStart[position]];
+        double bestDistance = -1.0;
+        for (uint32_t i = mPositionWedgeStart[position]; i < mPositionWedgeStart[position + 1]; i++){
+            const double* y = &mWedgeAttributes[mPositionWedges[i] * kDimensions];
+            double distance = 0.0;
+            for (int k = 3; k < kDimensions; k++){
+                distance += (x[k] - y[k]) * (x[k] - y[k]);
+            }
+            if (bestDistance < 0.0 || distance < bestDistance){
+                bestDistance = distance;
+                best = mPositionWedges[i];
+            }
+        }
+        return best;
+    }
+    void EdgeCollapser::Collapse(uint32_t from, uint32_t to){
+        std::vector<uint32_t>& targetTriangles = mPositionTriangles[to];
+        for (uint32_t t : mPositionTriangles[from]){
+            if (!mTriangleAlive[t]){
+                continue;
+            }
+            if (Contains(t, to)){
+                mTriangleAlive[t] = 0;
+                mLiveTriangles--;
+                continue;
+            }
+            for (int corner = 0; corner < 3; corner++){
+                uint32_t& wedge = mTriangleWedges[t * 3 + corner];
+                if (mWedgePosition[wedge] == from){
+                    wedge = MatchWedge(wedge, to);
+                }
+            }
+            targetTriangles.push_back(t);
+        }
+        mPositionTriangles[from].clear();
+        targetTriangles.erase(std::remove_if(targetTriangles.begin(), targetTriangles.end(),
+            [this](uint32_t t){ return !mTriangleAlive[t]; }), targetTriangles.end());
+        QuadricAdd(mQuadrics[to], mQuadrics[from]);
+        PlaneQuadricAdd(mPlaneQuadrics[to], mPlaneQuadrics[from]);
+        mMaxDistance = std::max(mMaxDistance, PlaneQuadricDistance(mPlaneQuadrics[to], &mWedgeAttributes[mPositionWedges[mPositionWedgeStart[to]] * kDimensions]));
+        mResidual[to] = QuadricEvaluate(mQuadrics[to], &mWedgeAttributes[mPositionWedges[mPositionWedgeStart[to]] * kDimensions]);
+        mRemoved[from] = 1;
+        mVersion[from]++;
+
+        std::vector<uint32_t>& neighbors = mScratchCollapse;
+        GatherNeighbors(to, neighbors);
+        UpdateCandidate(to);
+        for (uint32_t neighbor : neighbors){
+            UpdateCandidate(neighbor);
+        }
+    }
+    void EdgeCollapser::CollapseTo(size_t targetTriangles){
+        while (mLiveTriangles > targetTriangles && !mQueue.empty()){
+            Candidate candidate = mQueue.top();
+            mQueue.pop();
+            if (mRemoved[candidate.mVertex] || candidate.mVersion != mVersion[candidate.mVertex] || mRemoved[candidate.mTarget]){
+                continue;
+            }
+            GatherNeighbors(candidate.mVertex, mScratchNeighbors);
+            if (!IsLegal(candidate.mVertex, candidate.mTarget, mScratchNeighbors)){
+                UpdateCandidate(candidate.mVertex, true);
+                continue;
+            }
+            Collapse(candidate.mVertex, candidate.mTarget);
+        }
+    }
+    void EdgeCollapser::AppendIndices(std::vector<unsigned int>& out) const{
+        for (size_t t = 0; t < mTriangleAlive.size(); t++){
+            if (mTriangleAlive[t]){
+                out.push_back(mTriangleWedges[t * 3 + 0]);
+                out.push_back(mTriangleWedges[t * 3 + 1]);
+                out.push_back(mTriangleWedges[t * 3 + 2]);
+            }
+        }
+    }
+
+    LodChain MeshSimplifier::BuildLodChain(const Mesh& mesh, const std::vector<float>& ratios){
+        TRACE_SCOPE("BuildLodChain");
+        LodChain chain;
+        chain.mMesh = WeldVertices(mesh);
+        if (chain.mMesh.vertices.empty()){
+            return chain;
+        }
+        glm::vec3 minimum = chain.mMesh.vertices[0].position;
+        glm::vec3 maximum = minimum;
+        for (const Vertex& vertex : chain.mMesh.vertices){
+            minimum = glm::min(minimum, vertex.position);
+            maximum = glm::max(maximum, vertex.position);
+        }
+        chain.mCenter = (minimum + maximum) * 0.5f;
+        for (const Vertex& vertex : chain.mMesh.vertices){
+            chain.mRadius = std::max(chain.mRadius, glm::length(vertex.position - chain.mCenter));
+        }
+
+        std::vector<unsigned int> lodIndices;
+        EdgeCollapser collapser(chain.mMesh, chain.mRadius);
+        size_t sourceTriangles = chain.mMesh.indices.size() / 3;
+        for (float ratio : ratios){
+            collapser.CollapseTo((size_t)(sourceTriangles * ratio));
+            LodLevel level;
+            level.mIndexOffset = (unsigned int)lodIndices.size();
+            level.mError = collapser.GetError();
+            collapser.AppendIndices(lodIndices);
+            level.mIndexCount = (unsigned int)lodIndices.size() - level.mIndexOffset;
+            // Stop once the collapser runs out of legal moves.
+            if (!chain.mLevels.empty() && level.mIndexCount == chain.mLevels.back().mIndexCount){
+                lodIndices.resize(level.mIndexOffset);
+                break;
+            }
+            chain.mLevels.push_back(level);
+        }
+        chain.mMesh.indices = std::move(lodIndices);
+        return chain;
+    }
+
+    int MeshSimplifier::SelectLod(const std::vector<LodLevel>& levels, const Camera& camera,
+                                  const glm::vec3& worldCenter, float worldRadius,
+                                  float viewportHeight, float maxPixelError){
+        if (levels.empty()){
+            return 0;
+        }
+        // projection[1][1] = cot(fovy / 2): pixels per unit of object-space
+        // error at distance d is projection[1][1] * viewportHeight / (2 d).
+        float distance = glm::length(worldCenter - camera.GetPosition()) - worldRadius;
+        if (distance <= 1e-4f){
+            return 0;
+        }
+        float pixelsPerUnit = camera.GetProjectionMatrix()[1][1] * viewportHeight * 0.5f / distance;
+        int selected = 0;
+        for (size_t i = 1; i < levels.size(); i++){
+            if (levels[i].mError * pixelsPerUnit > maxPixelError){
+                break;
+            }
+            selected = (int)i;
+        }
+        return selected;
+    }
+
+    static Mesh MakeTorus(int triangleCount){
+        // Seams in both directions exercise the wedge handling.
+        int rings = std::max(3, (int)std::sqrt(triangleCount / 4.0));
+        int segments = std::max(3, triangleCount / (2 * rings));
+        const float kPi = 3.14159265358979f;
+        Mesh mesh;
+        mesh.vertices.reserve((size_t)(rings + 1) * (segments + 1));
+        for (int i = 0; i <= rings; i++){
+            float u = (float)i / rings;
+            float theta = u * 2.0f * kPi;
+            for (int j = 0; j <= segments; j++){
+                float v = (float)j / segments;
+                float phi = v * 2.0f * kPi;
+                glm::vec3 normal(std::cos(phi) * std::cos(theta), std::sin(phi), std::cos(phi) * std::sin(theta));
+                glm::vec3 center(std::cos(theta), 0.0f, std::sin(theta));
+                Vertex vertex;
+                vertex.position = center + normal * 0.35f;
+                vertex.normal = normal;
+                vertex.texCoord = glm::vec2(u, v);
+                mesh.vertices.push_back(vertex);
+            }
+        }
+        for (int i = 0; i < rings; i++){
+            for (int j = 0; j < segments; j++){
+                unsigned int a = i * (segments + 1) + j;
+                unsigned int b = a + segments + 1;
+                mesh.indices.insert(mesh.indices.end(), { a, a + 1, b, b, a + 1, b + 1 });
+            }
+        }
+        return mesh;
+    }
+
+    void MeshSimplifier::RunMicrobenchmark(const std::string& modelPath, int triangleCount){
+        Mesh source = modelPath.empty() ? MakeTorus(triangleCount) : OBJLoader::LoadOBJ(modelPath);
+        size_t sourceTriangles = source.indices.size() / 3;
+        if (sourceTriangles == 0){
+            std::cout << "LOD benchmark: no triangles to simplify" << std::endl;
+            return;
+        }
+        const std::vector<float> ratios = { 1.0f, 0.5f, 0.25f, 0.125f, 0.0625f, 0.03125f };
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        LodChain chain = BuildLodChain(source, ratios);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "LOD chain for " << (modelPath.empty() ? "generated torus" : modelPath) << ": "
+                  << sourceTriangles << " triangles, " << chain.mMesh.vertices.size() << " welded vertices" << std::endl;
+        for (size_t i = 0; i < chain.mLevels.size(); i++){
+            const LodLevel& level = chain.mLevels[i];
+            size_t triangles = level.mIndexCount / 3;
+            std::cout << "\tLOD " << i << ": " << triangles << " triangles ("
+                      << 100.0 * (1.0 - (double)triangles / sourceTriangles) << "% saved), error "
+                      << level.mError / chain.mRadius * 100.0f << "% of radius" << std::endl;
+        }
+        std::cout << "Simplified in " << seconds * 1000.0 << " ms ("
+                  << sourceTriangles / seconds / 1e6 << " M source tris/sec)" << std::endl;
+    }
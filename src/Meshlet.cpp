@@ -0,0 +1,312 @@
+#include "Meshlet.hpp"
+#include "Benchmark.hpp"
+#include "Camera.hpp"
+#include "MeshSimplifier.hpp"
+#include "Trace.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+    // How many extra vertices a face turned 90 degrees from the cluster is worth.
+    static const float kConeWeight = 4.0f;
+
+    void ClusterCullStats::Add(const ClusterCullStats& other){
+        mMeshlets += other.mMeshlets;
+        mTriangles += other.mTriangles;
+        mFrustumCulledMeshlets += other.mFrustumCulledMeshlets;
+        mFrustumCulledTriangles += other.mFrustumCulledTriangles;
+        mBackfaceCulledMeshlets += other.mBackfaceCulledMeshlets;
+        mBackfaceCulledTriangles += other.mBackfaceCulledTriangles;
+    }
+
+    static void ComputeBounds(const std::vector<Vertex>& vertices, const unsigned int* indices,
+                              const std::vector<glm::vec3>& normals, const unsigned int* triangles,
+                              size_t triangleCount, Meshlet& meshlet){
+        glm::vec3 minimum(0.0f);
+        glm::vec3 maximum(0.0f);
+        glm::vec3 normalSum(0.0f);
+        for (size_t i = 0; i < triangleCount; i++){
+            for (int corner = 0; corner < 3; corner++){
+                const glm::vec3& p = vertices[indices[triangles[i] * 3 + corner]].position;
+                minimum = i == 0 && corner == 0 ? p : glm::min(minimum, p);
+                maximum = i == 0 && corner == 0 ? p : glm::max(maximum, p);
+            }
+            normalSum = normalSum + normals[triangles[i]];
+        }
+        meshlet.mCenter = (minimum + maximum) * 0.5f;
+        meshlet.mRadius = 0.0f;
+        for (size_t i = 0; i < triangleCount; i++){
+            for (int corner = 0; corner < 3; corner++){
+                const glm::vec3& p = vertices[indices[triangles[i] * 3 + corner]].position;
+                meshlet.mRadius = std::max(meshlet.mRadius, glm::length(p - meshlet.mCenter));
+            }
+        }
+        // Cone around the mean face normal; its cutoff is the sine of the
+        // angle to the widest normal, as used by the culling test below.
+        meshlet.mConeCutoff = 1.0f;
+        float length = glm::length(normalSum);
+        if (length < 1e-6f){
+            return;
+        }
+        meshlet.mConeAxis = normalSum / length;
+        float minimumDot = 1.0f;
+        for (size_t i = 0; i < triangleCount; i++){
+            const glm::vec3& normal = normals[triangles[i]];
+            if (glm::dot(normal, normal) > 0.0f){
+                minimumDot = std::min(minimumDot, glm::dot(normal, meshlet.mConeAxis));
+            }
+        }
+        if (minimumDot <= 0.1f){
+            return;
+        }
+        meshlet.mConeCutoff = std::sqrt(1.0f - minimumDot * minimumDot);
+        // Apex: pull the cone back along the axis until every triangle's plane
+        // lies in front of it, so a single direction test covers the cluster.
+        float apexDistance = 0.0f;
+        for (size_t i = 0; i < triangleCount; i++){
+            const glm::vec3& normal = normals[triangles[i]];
+            float alignment = glm::dot(normal, meshlet.mConeAxis);
+            if (alignment > 0.0f){
+                const glm::vec3& p = vertices[indices[triangles[i] * 3]].position;
+                apexDistance = std::max(apexDistance, glm::dot(meshlet.mCenter - p, normal) / alignment);
+            }
+        }
+        meshlet.mConeApex = meshlet.mCenter - meshlet.mConeAxis * apexDistance;
+    }
+
+    void MeshletBuilder::Build(const std::vector<Vertex>& vertices, unsigned int* indices, size_t indexCount,
+                               unsigned int indexBase, std::vector<Meshlet>& out){
+        TRACE_SCOPE("MeshletBuilder::Build");
+        size_t triangleCount = indexCount / 3;
+        std::vector<glm::vec3> normals(triangleCount);
+        // Vertex -> triangle adjacency, CSR style.
+        std::vector<unsigned int> adjacencyStart(vertices.size() + 1, 0);
+        for (size_t t = 0; t < triangleCount; t++){
+            const glm::vec3& a = vertices[indices[t * 3 + 0]].position;
+            const glm::vec3& b = vertices[indices[t * 3 + 1]].position;
+            const glm::vec3& c = vertices[indices[t * 3 + 2]].position;
+            glm::vec3 normal = glm::cross(b - a, c - a);
+            float length = glm::length(normal);
+            normals[t] = length > 0.0f ? normal / length : glm::vec3(0.0f);
+            for (int corner = 0; corner < 3; corner++){
+                adjacencyStart[indices[t * 3 + corner] + 1]++;
+            }
+        }
+        for (size_t v = 0; v < vertices.size(); v++){
+            adjacencyStart[v + 1] += adjacencyStart[v];
+        }
+        std::vector<unsigned int> adjacency(adjacencyStart.back());
+        std::vector<unsigned int> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+        for (size_t t = 0; t < triangleCount; t++){
+            for (int corner = 0; corner < 3; corner++){
+                adjacency[fill[indices[t * 3 + corner]]++] = (unsigned int)t;
+            }
+        }
+
+        std::vector<bool> emitted(triangleCount, false);
+        // Stamp per vertex: the meshlet it was last added to, so membership is O(1).
+        std::vector<unsigned int> vertexStamp(vertices.size(), ~0u);
+        std::vector<unsigned int> order;
+        order.reserve(triangleCount);
+        std::vector<unsigned int> candidates;
+        size_t seedCursor = 0;
+        unsigned int meshletIndex = 0;
+        while (order.size() < triangleCount){
+            Meshlet meshlet;
+            meshlet.mIndexOffset = indexBase + (unsigned int)order.size() * 3;
+            size_t first = order.size();
+            glm::vec3 normalSum(0.0f);
+            // Seed with a leftover neighbour of the previous meshlet when there is
+            // one, so consecutive meshlets stay spatially close.
+            unsigned int seed = ~0u;
+            for (unsigned int candidate : candidates){
+                if (!emitted[candidate]){
+                    seed = candidate;
+                    break;
+                }
+            }
+            if (seed == ~0u){
+                while (emitted[seedCursor]){
+                    seedCursor++;
+                }
+                seed = (unsigned int)seedCursor;
+            }
+            candidates.clear();
+            unsigned int next = seed;
+            while (next != ~0u){
+                emitted[next] = true;
+                order.push_back(next);
+                normalSum = normalSum + normals[next];
+                for (int corner = 0; corner < 3; corner++){
+                    unsigned int vertex = indices[next * 3 + corner];
+                    if (vertexStamp[vertex] != meshletIndex){
+                        vertexStamp[vertex] = meshletIndex;
+                        meshlet.mVertexCount++;
+                        for (unsigned int i = adjacencyStart[vertex]; i < adjacencyStart[vertex + 1]; i++){
+                            if (!emitted[adjacency[i]]){
+                                candidates.push_back(adjacency[i]);
+                            }
+                        }
+                    }
+                }
+                if (order.size() - first == Meshlet::kMaxTriangles){
+                    break;
+                }
+                // Fewest new vertices, traded against how far the face bends away
+                // from the cluster's mean normal (a tighter cone culls more often).
+                next = ~0u;
+                float bestScore = 0.0f;
+                glm::vec3 meanNormal = glm::length(normalSum) > 0.0f ? glm::normalize(normalSum) : normalSum;
+                size_t kept = 0;
+                for (size_t i = 0; i < candidates.size(); i++){
+                    unsigned int candidate = candidates[i];
+                    if (emitted[candidate]){
+                        continue;
+                    }
+                    candidates[kept++] = candidate;
+                    unsigned int newVertices = 0;
+                    for (int corner = 0; corner < 3; corner++){
+                        newVertices += vertexStamp[indices[candidate * 3 + corner]] != meshletIndex ? 1 : 0;
+                    }
+                    if (meshlet.mVertexCount + newVertices > Meshlet::kMaxVertices){
+                        continue;
+                    }
+                    float score = (float)newVertices + kConeWeight * (1.0f - glm::dot(normals[candidate], meanNormal));
+                    if (next == ~0u || score < bestScore){
+                        bestScore = score;
+                        next = candidate;
+                    }
+                }
+                candidates.resize(kept);
+            }
+            meshlet.mTriangleCount = (unsigned int)(order.size() - first);
+            ComputeBounds(vertices, indices, normals, &order[first], meshlet.mTriangleCount, meshlet);
+            out.push_back(meshlet);
+            meshletIndex++;
+        }
+
+        std::vector<unsigned int> reordered(triangleCount * 3);
+        for (size_t i = 0; i < triangleCount; i++){
+            for (int corner = 0; corner < 3; corner++){
+                reordered[i * 3 + corner] = indices[order[i] * 3 + corner];
+            }
+        }
+        std::copy(reordered.begin(), reordered.end(), indices);
+    }
+
+    void ClusterCuller::Cull(const Meshlet* meshlets, size_t meshletCount,
+                             const glm::mat4& modelViewProjection, const glm::vec3& eye,
+                             std::vector<unsigned int>& firstIndices, std::vector<unsigned int>& indexCounts,
+                             ClusterCullStats* stats){
+        TRACE_SCOPE("ClusterCuller::Cull");
+        // Frustum planes in model space (Gribb & Hartmann), normalized so the
+        // plane equation gives distances to compare against the sphere radius.
+        // Clip space is -w <= x, y <= w and 0 <= z <= w with the far plane at
+        // infinity, which leaves the near plane z <= w.
+        glm::vec4 planes[5];
+        glm::vec4 w(modelViewProjection[0][3], modelViewProjection[1][3], modelViewProjection[2][3], modelViewProjection[3][3]);
+        for (int i = 0; i < 3; i++){
+            glm::vec4 row(modelViewProjection[0][i], modelViewProjection[1][i], modelViewProjection[2][i], modelViewProjection[3][i]);
+            if (i < 2){
+                planes[i * 2 + 0] = w + row;
+                planes[i * 2 + 1] = w - row;
+            } else {
+                planes[4] = w - row;
+            }
+        }
+        for (glm::vec4& plane : planes){
+            plane = plane / glm::length(glm::vec3(plane));
+        }
+        firstIndices.clear();
+        indexCounts.clear();
+        ClusterCullStats local;
+        unsigned int runEnd = ~0u;
+        for (size_t m = 0; m < meshletCount; m++){
+            const Meshlet& meshlet = meshlets[m];
+            local.mMeshlets++;
+            local.mTriangles += meshlet.mTriangleCount;
+            bool outside = false;
+            for (const glm::vec4& plane : planes){
+                if (glm::dot(glm::vec3(plane), meshlet.mCenter) + plane.w < -meshlet.mRadius){
+                    outside = true;
+                    break;
+                }
+            }
+            if (outside){
+                local.mFrustumCulledMeshlets++;
+                local.mFrustumCulledTriangles += meshlet.mTriangleCount;
+                continue;
+            }
+            // Every triangle faces away when the eye sits inside the cone's
+            // back-facing region, seen from the apex.
+            glm::vec3 fromEye = meshlet.mConeApex - eye;
+            if (glm::dot(fromEye, meshlet.mConeAxis) >= meshlet.mConeCutoff * glm::length(fromEye)){
+                local.mBackfaceCulledMeshlets++;
+                local.mBackfaceCulledTriangles += meshlet.mTriangleCount;
+                continue;
+            }
+            unsigned int indexCount = meshlet.mTriangleCount * 3;
+            if (meshlet.mIndexOffset == runEnd){
+                indexCounts.back() += indexCount;
+            } else {
+                firstIndices.push_back(meshlet.mIndexOffset);
+                indexCounts.push_back(indexCount);
+            }
+            runEnd = meshlet.mIndexOffset + indexCount;
+        }
+        if (stats != nullptr){
+            stats->Add(local);
+        }
+    }
+
+    void ClusterCuller::RunMicrobenchmark(const std::string& modelPath, int frameCount){
+        Mesh mesh = MeshSimplifier::WeldVertices(OBJLoader::LoadOBJ(modelPath));
+        if (mesh.indices.empty()){
+            std::cout << "Meshlet benchmark: no triangles in " << modelPath << std::endl;
+            return;
+        }
+        std::vector<Meshlet> meshlets;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        MeshletBuilder::Build(mesh.vertices, mesh.indices.data(), mesh.indices.size(), 0, meshlets);
+        double buildMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << mesh.indices.size() / 3 << " triangles in " << meshlets.size() << " meshlets (built in "
+                  << buildMilliseconds << " ms)" << std::endl;
+
+        glm::vec3 minimum = mesh.vertices[0].position;
+        glm::vec3 maximum = minimum;
+        for (const Vertex& vertex : mesh.vertices){
+            minimum = glm::min(minimum, vertex.position);
+            maximum = glm::max(maximum, vertex.position);
+        }
+        glm::vec3 center = (minimum + maximum) * 0.5f;
+        float radius = glm::length(maximum - minimum) * 0.5f;
+        Camera camera;
+        camera.SetProjectionMatrix(glm::radians(45.0f), 16.0f / 9.0f, 0.1f);
+        CameraPath path;
+        path.MakeOrbit(center, radius * 1.5f, radius * 0.25f, 64);
+
+        ClusterCullStats total;
+        std::vector<unsigned int> firstIndices;
+        std::vector<unsigned int> indexCounts;
+        double cullMicroseconds = 0.0;
+        for (int frame = 0; frame < frameCount; frame++){
+            path.Apply(&camera, frame, frameCount);
+            glm::mat4 viewProjection = camera.GetProjectionMatrix() * camera.GetViewMatrix();
+            ClusterCullStats stats;
+            start = std::chrono::steady_clock::now();
+            Cull(meshlets.data(), meshlets.size(), viewProjection, camera.GetPosition(), firstIndices, indexCounts, &stats);
+            cullMicroseconds += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+            total.Add(stats);
+            if (frame % 8 == 0){
+                std::cout << "\tframe " << frame << ": " << stats.mTriangles - stats.mFrustumCulledTriangles - stats.mBackfaceCulledTriangles
+                          << "/" << stats.mTriangles << " triangles submitted in " << indexCounts.size() << " draws ("
+                          << stats.mBackfaceCulledMeshlets << " meshlets backfacing, "
+                          << stats.mFrustumCulledMeshlets << " outside the frustum)" << std::endl;
+            }
+        }
+        std::cout << "Cluster culling over " << frameCount << " frames: "
+                  << 100.0 * total.mBackfaceCulledTriangles / total.mTriangles << "% of triangles backface culled, "
+                  << 100.0 * total.mFrustumCulledTriangles / total.mTriangles << "% frustum culled, "
+                  << cullMicroseconds / frameCount << " us/frame" << std::endl;
+    }
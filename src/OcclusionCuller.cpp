@@ -0,0 +1,351 @@
+#include "OcclusionCuller.hpp"
+#include "Camera.hpp"
+#include "Simd.hpp"
+#include "Trace.hpp"
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+    OcclusionCuller::OcclusionCuller(int width, int height)
+        : mWidth((std::max(width, 4) + 3) & ~3), mHeight(std::max(height, 1)), mViewProjection(1.0f){
+        int levelWidth = mWidth;
+        int levelHeight = mHeight;
+        while (true){
+            mLevels.push_back(std::vector<float>((size_t)levelWidth * levelHeight, 0.0f));
+            mLevelWidths.push_back(levelWidth);
+            mLevelHeights.push_back(levelHeight);
+            if (levelWidth == 1 && levelHeight == 1){
+                break;
+            }
+            levelWidth = std::max(1, (levelWidth + 1) / 2);
+            levelHeight = std::max(1, (levelHeight + 1) / 2);
+        }
+    }
+
+    void OcclusionCuller::Begin(const glm::mat4& viewProjection){
+        mViewProjection = viewProjection;
+        std::fill(mLevels[0].begin(), mLevels[0].end(), 0.0f);
+    }
+
+    OcclusionCuller::ScreenVertex OcclusionCuller::ToScreen(const glm::vec4& clip) const{
+        float inverseW = 1.0f / clip.w;
+        ScreenVertex result;
+        result.x = (clip.x * inverseW * 0.5f + 0.5f) * mWidth;
+        result.y = (clip.y * inverseW * 0.5f + 0.5f) * mHeight;
+        result.z = clip.z * inverseW;
+        return result;
+    }
+
+    void OcclusionCuller::RenderOccluder(const float* positions, size_t stride, const unsigned int* indices, size_t indexCount,
+                                         const glm::mat4& model){
+        TRACE_SCOPE("OcclusionCuller::RenderOccluder");
+        glm::mat4 modelViewProjection = mViewProjection * model;
+        for (size_t i = 0; i + 2 < indexCount; i += 3){
+            glm::vec4 clip[3];
+            for (int corner = 0; corner < 3; corner++){
+                const float* p = positions + (size_t)indices[i + corner] * stride;
+                clip[corner] = modelViewProjection * glm::vec4(p[0], p[1], p[2], 1.0f);
+            }
+            ClipAndRaster(clip);
+        }
+    }
+
+    void OcclusionCuller::ClipAndRaster(const glm::vec4* clip){
+        // Trivially reject triangles entirely outside one side of the frustum
+        // (-w <= x, y <= w; z <= w is the near plane, and the far one is at infinity).
+        for (int axis = 0; axis < 3; axis++){
+            if ((clip[0][axis] > clip[0].w && clip[1][axis] > clip[1].w && clip[2][axis] > clip[2].w) ||
+                (axis < 2 && clip[0][axis] < -clip[0].w && clip[1][axis] < -clip[1].w && clip[2][axis] < -clip[2].w)){
+                return;
+            }
+        }
+        // Clip against the near plane (z <= w); one triangle becomes at most a quad.
+        glm::vec4 polygon[4];
+        int count = 0;
+        for (int i = 0; i < 3; i++){
+            const glm::vec4& a = clip[i];
+            const glm::vec4& b = clip[(i + 1) % 3];
+            float distanceA = a.w - a.z;
+            float distanceB = b.w - b.z;
+            if (distanceA >= 0.0f){
+                polygon[count++] = a;
+            }
+            if ((distanceA >= 0.0f) != (distanceB >= 0.0f)){
+                float t = distanceA / (distanceA - distanceB);
+                polygon[count++] = a + (b - a) * t;
+            }
+        }
+        if (count < 3){
+            return;
+        }
+        ScreenVertex screen[4];
+        for (int i = 0; i < count; i++){
+            screen[i] = ToScreen(polygon[i]);
+        }
+        for (int i = 1; i + 1 < count; i++){
+            RasterTriangle(screen[0], screen[i], screen[i + 1]);
+        }
+    }
+
+    void OcclusionCuller::RasterTriangle(const ScreenVertex& v0, const ScreenVertex& in1, const ScreenVertex& in2){
+        // Occluders are drawn two-sided, so wind every triangle counter-clockwise.
+        float area = (in1.x - v0.x) * (in2.y - v0.y) - (in1.y - v0.y) * (in2.x - v0.x);
+        if (area == 0.0f){
+            return;
+        }
+        const ScreenVertex& v1 = area > 0.0f ? in1 : in2;
+        const ScreenVertex& v2 = area > 0.0f ? in2 : in1;
+        area = std::fabs(area);
+
+        int minX = std::max(0, (int)std::floor(std::min(v0.x, std::min(v1.x, v2.x))));
+        int maxX = std::min(mWidth - 1, (int)std::ceil(std::max(v0.x, std::max(v1.x, v2.x))));
+        int minY = std::max(0, (int)std::floor(std::min(v0.y, std::min(v1.y, v2.y))));
+        int maxY = std::min(mHeight - 1, (int)std::ceil(std::max(v0.y, std::max(v1.y, v2.y))));
+        if (minX > maxX || minY > maxY){
+            return;
+        }
+        minX &= ~3;
+
+        // Edge functions E(x, y) = A x + B y + C, positive inside; edge k is
+        // opposite vertex k so E_k / area is that vertex's barycentric weight.
+        const ScreenVertex* v[3] = { &v0, &v1, &v2 };
+        float edgeA[3];
+        float edgeB[3];
+        float edgeC[3];
+        for (int k = 0; k < 3; k++){
+            const ScreenVertex& a = *v[(k + 1) % 3];
+            const ScreenVertex& b = *v[(k + 2) % 3];
+            edgeA[k] = a.y - b.y;
+            edgeB[k] = b.x - a.x;
+            edgeC[k] = -(edgeA[k] * a.x + edgeB[k] * a.y);
+        }
+        // NDC depth is affine in screen space, so it is a plane too.
+        float inverseArea = 1.0f / area;
+        float depthA = (edgeA[0] * v0.z + edgeA[1] * v1.z + edgeA[2] * v2.z) * inverseArea;
+        float depthB = (edgeB[0] * v0.z + edgeB[1] * v1.z + edgeB[2] * v2.z) * inverseArea;
+        float depthC = (edgeC[0] * v0.z + edgeC[1] * v1.z + edgeC[2] * v2.z) * inverseArea;
+
+        Float4 laneOffsets = Float4Set(0.5f, 1.5f, 2.5f, 3.5f);
+        Float4 zero = Float4Splat(0.0f);
+        Float4 edgeStep[3];
+        for (int k = 0; k < 3; k++){
+            edgeStep[k] = Float4Splat(edgeA[k] * 4.0f);
+        }
+        Float4 depthStep = Float4Splat(depthA * 4.0f);
+        float* depth = mLevels[0].data();
+        for (int y = minY; y <= maxY; y++){
+            float pixelY = (float)y + 0.5f;
+            Float4 pixelX = Float4Splat((float)minX) + laneOffsets;
+            Float4 edge[3];
+            for (int k = 0; k < 3; k++){
+                edge[k] = Float4Splat(edgeA[k]) * pixelX + Float4Splat(edgeB[k] * pixelY + edgeC[k]);
+            }
+            Float4 z = Float4Splat(depthA) * pixelX + Float4Splat(depthB * pixelY + depthC);
+            float* row = depth + (size_t)y * mWidth;
+            for (int x = minX; x <= maxX; x += 4){
+                Float4 inside = Float4And(Float4And(Float4CmpGt(edge[0], zero), Float4CmpGt(edge[1], zero)),
+                                          Float4CmpGt(edge[2], zero));
+                if (Float4MoveMask(inside) != 0){
+                    Float4 stored = Float4Load(row + x);
+                    Float4 write = Float4And(inside, Float4CmpGt(z, stored));
+                    Float4Store(row + x, Float4Select(write, z, stored));
+                }
+                for (int k = 0; k < 3; k++){
+                    edge[k] = edge[k] + edgeStep[k];
+                }
+                z = z + depthStep;
+            }
+        }
+    }
+
+    void OcclusionCuller::BuildPyramid(){
+        TRACE_SCOPE("OcclusionCuller::BuildPyramid");
+        for (size_t level = 1; level < mLevels.size(); level++){
+            const std::vector<float>& source = mLevels[level - 1];
+            int sourceWidth = mLevelWidths[level - 1];
+            int sourceHeight = mLevelHeights[level - 1];
+            std::vector<float>& target = mLevels[level];
+            int width = mLevelWidths[level];
+            int height = mLevelHeights[level];
+            for (int y = 0; y < height; y++){
+                const float* row0 = source.data() + (size_t)std::min(2 * y, sourceHeight - 1) * sourceWidth;
+                const float* row1 = source.data() + (size_t)std::min(2 * y + 1, sourceHeight - 1) * sourceWidth;
+                for (int x = 0; x < width; x++){
+                    int x0 = std::min(2 * x, sourceWidth - 1);
+                    int x1 = std::min(2 * x + 1, sourceWidth - 1);
+                    target[(size_t)y * width + x] = std::min(std::min(row0[x0], row0[x1]), std::min(row1[x0], row1[x1]));
+                }
+            }
+        }
+    }
+
+    OcclusionCuller::Result OcclusionCuller::TestBox(const glm::vec3& boxMin, const glm::vec3& boxMax, const glm::mat4& model) const{
+        glm::mat4 modelViewProjection = mViewProjection * model;
+        int outside[5] = { 0, 0, 0, 0, 0 };
+        bool crossesNear = false;
+        float minX = (float)mWidth;
+        float maxX = 0.0f;
+        float minY = (float)mHeight;
+        float maxY = 0.0f;
+        float nearestDepth = 0.0f;
+        for (int corner = 0; corner < 8; corner++){
+            glm::vec3 p((corner & 1) ? boxMax.x : boxMin.x, (corner & 2) ? boxMax.y : boxMin.y, (corner & 4) ? boxMax.z : boxMin.z);
+            glm::vec4 clip = modelViewProjection * glm::vec4(p, 1.0f);
+            outside[0] += clip.x < -clip.w;
+            outside[1] += clip.x > clip.w;
+            outside[2] += clip.y < -clip.w;
+            outside[3] += clip.y > clip.w;
+            outside[4] += clip.z > clip.w;
+            if (clip.z > clip.w){
+                crossesNear = true;
+                continue;
+            }
+            ScreenVertex screen = ToScreen(clip);
+            minX = std::min(minX, screen.x);
+            maxX = std::max(maxX, screen.x);
+            minY = std::min(minY, screen.y);
+            maxY = std::max(maxY, screen.y);
+            nearestDepth = std::max(nearestDepth, screen.z);
+        }
+        for (int plane = 0; plane < 5; plane++){
+            if (outside[plane] == 8){
+                return kOutsideFrustum;
+            }
+        }
+        // A box reaching behind the camera has no bounded screen rectangle.
+        if (crossesNear){
+            return kVisible;
+        }
+        int x0 = std::max(0, (int)std::floor(minX));
+        int x1 = std::min(mWidth - 1, (int)std::floor(maxX));
+        int y0 = std::max(0, (int)std::floor(minY));
+        int y1 = std::min(mHeight - 1, (int)std::floor(maxY));
+        if (x0 > x1 || y0 > y1){
+            return kOutsideFrustum;
+        }
+        // Coarsest level at which the rectangle touches at most 2x2 texels.
+        int level = 0;
+        int lastLevel = (int)mLevels.size() - 1;
+        while (level < lastLevel && ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1)){
+            level++;
+        }
+        const std::vector<float>& depth = mLevels[level];
+        int width = mLevelWidths[level];
+        float farthest = 1.0f;
+        for (int y = y0 >> level; y <= (y1 >> level); y++){
+            for (int x = x0 >> level; x <= (x1 >> level); x++){
+                farthest = std::min(farthest, depth[(size_t)y * width + x]);
+            }
+        }
+        return nearestDepth < farthest ? kOccluded : kVisible;
+    }
+
+    // Unit cube [0,1]^3, instanced with a per-object scale and translation.
+    static const float kCubePositions[] = {
+        0, 0, 0,  1, 0, 0,  1, 1, 0,  0, 1, 0,
+        0, 0, 1,  1, 0, 1,  1, 1, 1,  0, 1, 1
+    };
+    static const unsigned int kCubeIndices[] = {
+        0, 2, 1, 0, 3, 2,  4, 5, 6, 4, 6, 7,
+        0, 1, 5, 0, 5, 4,  3, 7, 6, 3, 6, 2,
+        0, 4, 7, 0, 7, 3,  1, 2, 6, 1, 6, 5
+    };
+
+    void OcclusionCuller::RunMicrobenchmark(int frameCount){
+        // A grid of blocks separated by streets, one building per block plus
+        // street furniture along its kerbs.
+        const int kBlocks = 32;
+        const float kPitch = 40.0f;
+        const float kStreetWidth = 12.0f;
+        const int kPropsPerBlock = 8;
+        const size_t kOccluderCount = 48;
+        std::minstd_rand random(7);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        std::vector<glm::mat4> instances;
+        std::vector<glm::vec3> centers;
+        size_t buildingCount = 0;
+        for (int i = 0; i < kBlocks; i++){
+            for (int j = 0; j < kBlocks; j++){
+                float blockX = i * kPitch + kStreetWidth * 0.5f;
+                float blockZ = j * kPitch + kStreetWidth * 0.5f;
+                float footprint = kPitch - kStreetWidth;
+                glm::vec3 size(footprint, 10.0f + 70.0f * unit(random), footprint);
+                glm::mat4 model = glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(blockX, 0.0f, blockZ)), size);
+                instances.push_back(model);
+                centers.push_back(glm::vec3(blockX, 0.0f, blockZ) + size * 0.5f);
+            }
+        }
+        buildingCount = instances.size();
+        for (int i = 0; i < kBlocks; i++){
+            for (int j = 0; j < kBlocks; j++){
+                for (int prop = 0; prop < kPropsPerBlock; prop++){
+                    // Alternate between the west and east kerb.
+                    float x = i * kPitch + kStreetWidth * 0.5f + ((prop & 1) ? kPitch - kStreetWidth + 0.5f : -2.3f);
+                    float z = j * kPitch + kStreetWidth * 0.5f + (kPitch - kStreetWidth) * unit(random);
+                    glm::vec3 size(1.8f, 1.2f + unit(random), 4.0f);
+                    glm::mat4 model = glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(x, 0.0f, z)), size);
+                    instances.push_back(model);
+                    centers.push_back(glm::vec3(x, 0.0f, z) + size * 0.5f);
+                }
+            }
+        }
+        std::cout << "City: " << buildingCount << " buildings, " << instances.size() - buildingCount
+                  << " props, " << kOccluderCount << " nearest buildings as occluders, "
+                  << kDefaultWidth << "x" << kDefaultHeight << " depth buffer" << std::endl;
+
+        OcclusionCuller culler;
+        Camera camera;
+        camera.SetProjectionMatrix(glm::radians(60.0f), (float)kDefaultWidth / kDefaultHeight, 0.5f);
+        std::vector<std::pair<float, size_t>> byDistance(buildingCount);
+        double rasterMilliseconds = 0.0;
+        double testMilliseconds = 0.0;
+        size_t tested = 0;
+        size_t outsideFrustum = 0;
+        size_t occluded = 0;
+        float streetX = (kBlocks / 2) * kPitch;
+        for (int frame = 0; frame < frameCount; frame++){
+            float t = frameCount > 1 ? (float)frame / (frameCount - 1) : 0.0f;
+            glm::vec3 eye(streetX, 1.7f, t * kBlocks * kPitch);
+            float yaw = 0.6f * std::sin(t * 12.0f);
+            camera.SetPosition(eye);
+            camera.SetViewDirection(glm::vec3(std::sin(yaw), 0.0f, std::cos(yaw)));
+
+            for (size_t i = 0; i < buildingCount; i++){
+                glm::vec3 offset = centers[i] - eye;
+                byDistance[i] = std::make_pair(glm::dot(offset, offset), i);
+            }
+            size_t occluderCount = std::min(kOccluderCount, buildingCount);
+            std::partial_sort(byDistance.begin(), byDistance.begin() + occluderCount, byDistance.end());
+
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            culler.Begin(camera.GetProjectionMatrix() * camera.GetViewMatrix());
+            for (size_t i = 0; i < occluderCount; i++){
+                culler.RenderOccluder(kCubePositions, 3, kCubeIndices, 36, instances[byDistance[i].second]);
+            }
+            culler.BuildPyramid();
+            std::chrono::steady_clock::time_point rasterEnd = std::chrono::steady_clock::now();
+            for (const glm::mat4& model : instances){
+                Result result = culler.TestBox(glm::vec3(0.0f), glm::vec3(1.0f), model);
+                outsideFrustum += result == kOutsideFrustum;
+                occluded += result == kOccluded;
+            }
+            tested += instances.size();
+            std::chrono::steady_clock::time_point testEnd = std::chrono::steady_clock::now();
+            rasterMilliseconds += std::chrono::duration<double, std::milli>(rasterEnd - start).count();
+            testMilliseconds += std::chrono::duration<double, std::milli>(testEnd - rasterEnd).count();
+        }
+        if (frameCount <= 0 || tested == 0){
+            return;
+        }
+        size_t inFrustum = tested - outsideFrustum;
+        std::cout << "Occlusion culling over " << frameCount << " frames: "
+                  << rasterMilliseconds / frameCount << " ms/frame rasterizing occluders and building the pyramid, "
+                  << testMilliseconds / frameCount << " ms/frame testing " << instances.size() << " boxes" << std::endl;
+        std::cout << "\t" << 100.0 * outsideFrustum / tested << "% outside the frustum, "
+                  << 100.0 * occluded / tested << "% occluded ("
+                  << (inFrustum > 0 ? 100.0 * occluded / inFrustum : 0.0) << "% of objects in the frustum), "
+                  << 100.0 * (tested - outsideFrustum - occluded) / tested << "% drawn" << std::endl;
+    }
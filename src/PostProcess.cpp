@@ -0,0 +1,314 @@
+#include "PostProcess.hpp"
+#include "Trace.hpp"
+#include <algorithm>
+#include <iostream>
+
+    // Frames a target may sit unused before the pool frees it.
+    static const int kMaxIdleFrames = 3;
+
+    RenderTarget* RenderTargetPool::Acquire(int width, int height, GLenum format, GLenum depthFormat){
+        RenderTarget* target = nullptr;
+        for (const std::unique_ptr<RenderTarget>& candidate : mTargets){
+            if (!candidate->mInUse && candidate->mWidth == width && candidate->mHeight == height
+                && candidate->mFormat == format && candidate->mDepthFormat == depthFormat){
+                target = candidate.get();
+                break;
+            }
+        }
+        if (target == nullptr){
+            mTargets.push_back(std::unique_ptr<RenderTarget>(new RenderTarget()));
+            target = mTargets.back().get();
+            target->mWidth = width;
+            target->mHeight = height;
+            target->mFormat = format;
+            target->mDepthFormat = depthFormat;
+            glGenTextures(1, &target->mTexture);
+            glBindTexture(GL_TEXTURE_2D, target->mTexture);
+            // GL 4.1 has no immutable storage; the data format only has to be one the internal format accepts.
+            glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format == GL_RGBA8 ? GL_RGBA : GL_RGB, GL_FLOAT, nullptr);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glBindTexture(GL_TEXTURE_2D, 0);
+            // Callers track what is bound to skip redundant binds; put theirs back afterwards.
+            GLint previousFramebuffer = 0;
+            glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+            glGenFramebuffers(1, &target->mFramebuffer);
+            glBindFramebuffer(GL_FRAMEBUFFER, target->mFramebuffer);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target->mTexture, 0);
+            if (depthFormat != GL_NONE){
+                glGenRenderbuffers(1, &target->mDepthBuffer);
+                glBindRenderbuffer(GL_RENDERBUFFER, target->mDepthBuffer);
+                glRenderbufferStorage(GL_RENDERBUFFER, depthFormat, width, height);
+                glBindRenderbuffer(GL_RENDERBUFFER, 0);
+                glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, target->mDepthBuffer);
+            }
+            GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+            if (status != GL_FRAMEBUFFER_COMPLETE){
+                std::cout << "Render target " << width << "x" << height << " incomplete: 0x" << std::hex << status << std::dec << std::endl;
+            }
+            glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+        }
+        target->mInUse = true;
+        target->mIdleFrames = 0;
+        mRequestedCount++;
+        mRequestedBytes += GetByteSize(*target);
+        return target;
+    }
+
+    void RenderTargetPool::Release(RenderTarget* target){
+        target->mInUse = false;
+    }
+
+    void RenderTargetPool::EndFrame(){
+        for (size_t i = 0; i < mTargets.size();){
+            RenderTarget* target = mTargets[i].get();
+            if (!target->mInUse && ++target->mIdleFrames > kMaxIdleFrames){
+                glDeleteFramebuffers(1, &target->mFramebuffer);
+                glDeleteTextures(1, &target->mTexture);
+                glDeleteRenderbuffers(1, &target->mDepthBuffer);
+                mTargets.erase(mTargets.begin() + i);
+            } else {
+                i++;
+            }
+        }
+        mLastRequestedCount = mRequestedCount;
+        mLastRequestedBytes = mRequestedBytes;
+        mRequestedCount = 0;
+        mRequestedBytes = 0;
+    }
+
+    void RenderTargetPool::Destroy(){
+        for (const std::unique_ptr<RenderTarget>& target : mTargets){
+            glDeleteFramebuffers(1, &target->mFramebuffer);
+            glDeleteTextures(1, &target->mTexture);
+            glDeleteRenderbuffers(1, &target->mDepthBuffer);
+        }
+        mTargets.clear();
+    }
+
+    size_t RenderTargetPool::GetAllocatedBytes() const{
+        size_t bytes = 0;
+        for (const std::unique_ptr<RenderTarget>& target : mTargets){
+            bytes += GetByteSize(*target);
+        }
+        return bytes;
+    }
+
+    size_t RenderTargetPool::GetByteSize(const RenderTarget& target){
+        FrameGraphResourceDesc desc;
+        desc.mWidth = target.mWidth;
+        desc.mHeight = target.mHeight;
+        desc.mFormat = target.mFormat;
+        desc.mDepthFormat = target.mDepthFormat;
+        return FrameGraph::GetByteSize(desc);
+    }
+
+    RenderTargetGraphBackend::RenderTargetGraphBackend(RenderTargetPool* pool){
+        mPool = pool;
+    }
+
+    void RenderTargetGraphBackend::Reset(GLuint boundFramebuffer){
+        mSlots.clear();
+        mImported.clear();
+        mBoundFramebuffer = boundFramebuffer;
+        mFramebufferBinds = 0;
+    }
+
+    void RenderTargetGraphBackend::AcquireSlot(int slot, const FrameGraphResourceDesc& desc){
+        if (slot >= (int)mSlots.size()){
+            mSlots.resize(slot + 1, nullptr);
+        }
+        if (desc.mImported){
+            mImported.push_back(std::unique_ptr<RenderTarget>(new RenderTarget()));
+            RenderTarget* target = mImported.back().get();
+            target->mWidth = desc.mWidth;
+            target->mHeight = desc.mHeight;
+            target->mFormat = desc.mFormat;
+            target->mFramebuffer = desc.mExternal;
+            target->mInUse = true;
+            mSlots[slot] = target;
+        } else if (desc.mWidth > 0){
+            mSlots[slot] = mPool->Acquire(desc.mWidth, desc.mHeight, desc.mFormat, desc.mDepthFormat);
+        }
+        // The chain has no buffers; their slots stay empty.
+    }
+
+    void RenderTargetGraphBackend::ReleaseSlot(int slot){
+        RenderTarget* target = mSlots[slot];
+        if (target != nullptr && target->mTexture != 0){
+            mPool->Release(target);
+        }
+    }
+
+    void RenderTargetGraphBackend::Barrier(int /*slot*/, Access /*before*/, Access /*after*/){
+        // GL orders a draw into a texture before later draws sampling it, and
+        // an aliased target is simply overwritten; nothing to do.
+    }
+
+    void RenderTargetGraphBackend::BeginPass(const std::string& /*name*/, const std::vector<int>& targets){
+        if (targets.empty()){
+            return;
+        }
+        RenderTarget* target = mSlots[targets[0]];
+        if (target->mFramebuffer != mBoundFramebuffer){
+            glBindFramebuffer(GL_FRAMEBUFFER, target->mFramebuffer);
+            mBoundFramebuffer = target->mFramebuffer;
+            mFramebufferBinds++;
+        }
+        glViewport(0, 0, target->mWidth, target->mHeight);
+    }
+
+    PostProcessChain::PostProcessChain(const PostProcessSettings& settings, const PostProcessPrograms& programs) : mBackend(&mPool){
+        mSettings = settings;
+        mPrograms = programs;
+        mVertexArray = 0;
+    }
+
+    void PostProcessChain::Create(){
+        // The full-screen triangle comes from gl_VertexID, but core profile
+        // draws need a vertex array bound.
+        glGenVertexArrays(1, &mVertexArray);
+    }
+
+    void PostProcessChain::Destroy(){
+        mPool.Destroy();
+        glDeleteVertexArrays(1, &mVertexArray);
+        mVertexArray = 0;
+    }
+
+    RenderTarget* PostProcessChain::GetTarget(int resource) const{
+        return mBackend.GetTarget(mGraph.GetSlot(resource));
+    }
+
+    void PostProcessChain::DrawFullscreen(){
+        glDisable(GL_DEPTH_TEST);
+        glDisable(GL_CULL_FACE);
+        glBindVertexArray(mVertexArray);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
+
+    void PostProcessChain::BuildGraph(GLuint output, int width, int height, const std::function<void()>& drawScene){
+        mGraph.Reset();
+        FrameGraphResourceDesc outputDesc;
+        outputDesc.mWidth = width;
+        outputDesc.mHeight = height;
+        outputDesc.mFormat = GL_RGBA8;
+        outputDesc.mExternal = output;
+        int target = mGraph.Import("Output", outputDesc);
+        int scene = mGraph.CreateTexture("Scene", width, height, GL_RGBA16F, GL_DEPTH_COMPONENT32F);
+        int pass = mGraph.AddPass("Scene", drawScene);
+        mGraph.Write(pass, scene);
+
+        int bloom = -1;
+        int bloomLevels = std::max(1, std::min(mSettings.mBloomLevels, 8));
+        if (mSettings.mBloom){
+            std::vector<int> levels;
+            int source = scene;
+            for (int i = 0; i < bloomLevels; i++){
+                int level = mGraph.CreateTexture("Bloom" + std::to_string(i), std::max(1, width >> (i + 1)), std::max(1, height >> (i + 1)), GL_R11F_G11F_B10F);
+                pass = mGraph.AddPass("BloomDown" + std::to_string(i), [this, source, i](){
+                    GLuint program = mPrograms.mDownsample;
+                    RenderTarget* from = GetTarget(source);
+                    glUseProgram(program);
+                    glUniform1i(glGetUniformLocation(program, "u_Source"), 0);
+                    glUniform1f(glGetUniformLocation(program, "u_Threshold"), mSettings.mBloomThreshold);
+                    glUniform2f(glGetUniformLocation(program, "u_SourceTexel"), 1.0f / from->mWidth, 1.0f / from->mHeight);
+                    // Only the first level picks out the bright parts.
+                    glUniform1i(glGetUniformLocation(program, "u_Prefilter"), i == 0);
+                    glActiveTexture(GL_TEXTURE0);
+                    glBindTexture(GL_TEXTURE_2D, from->mTexture);
+                    DrawFullscreen();
+                });
+                mGraph.Read(pass, source);
+                mGraph.Write(pass, level);
+                levels.push_back(level);
+                source = level;
+            }
+            // Back up the chain, each level added onto the next larger one in place.
+            for (int i = bloomLevels - 1; i > 0; i--){
+                int from = levels[i];
+                pass = mGraph.AddPass("BloomUp" + std::to_string(i), [this, from](){
+                    GLuint program = mPrograms.mUpsample;
+                    RenderTarget* source = GetTarget(from);
+                    glUseProgram(program);
+                    glUniform1i(glGetUniformLocation(program, "u_Source"), 0);
+                    glUniform2f(glGetUniformLocation(program, "u_SourceTexel"), 1.0f / source->mWidth, 1.0f / source->mHeight);
+                    glActiveTexture(GL_TEXTURE0);
+                    glBindTexture(GL_TEXTURE_2D, source->mTexture);
+                    glEnable(GL_BLEND);
+                    glBlendFunc(GL_ONE, GL_ONE);
+                    DrawFullscreen();
+                    glDisable(GL_BLEND);
+                });
+                mGraph.Read(pass, levels[i]);
+                mGraph.Read(pass, levels[i - 1]);
+                mGraph.Write(pass, levels[i - 1]);
+            }
+            bloom = levels[0];
+        }
+
+        int resolved = mSettings.mFxaa ? mGraph.CreateTexture("Resolved", width, height, GL_RGBA8) : target;
+        pass = mGraph.AddPass("Resolve", [this, scene, bloom, bloomLevels](){
+            GLuint program = mPrograms.mResolve;
+            glUseProgram(program);
+            glUniform1i(glGetUniformLocation(program, "u_Scene"), 0);
+            glUniform1i(glGetUniformLocation(program, "u_Bloom"), 1);
+            glUniform1i(glGetUniformLocation(program, "u_UseBloom"), bloom >= 0);
+            // Every level adds its share of the bright parts again; divided out so the
+            // strength does not depend on the level count.
+            glUniform1f(glGetUniformLocation(program, "u_BloomStrength"), mSettings.mBloomStrength / bloomLevels);
+            glUniform1f(glGetUniformLocation(program, "u_Exposure"), mSettings.mExposure);
+            glUniform1i(glGetUniformLocation(program, "u_Tonemap"), mSettings.mTonemap);
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D, bloom >= 0 ? GetTarget(bloom)->mTexture : 0);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, GetTarget(scene)->mTexture);
+            DrawFullscreen();
+        });
+        mGraph.Read(pass, scene);
+        if (bloom >= 0){
+            mGraph.Read(pass, bloom);
+        }
+        mGraph.Write(pass, resolved);
+
+        if (mSettings.mFxaa){
+            pass = mGraph.AddPass("FXAA", [this, resolved](){
+                GLuint program = mPrograms.mFxaa;
+                RenderTarget* source = GetTarget(resolved);
+                glUseProgram(program);
+                glUniform1i(glGetUniformLocation(program, "u_Source"), 0);
+                glUniform2f(glGetUniformLocation(program, "u_SourceTexel"), 1.0f / source->mWidth, 1.0f / source->mHeight);
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, source->mTexture);
+                DrawFullscreen();
+            });
+            mGraph.Read(pass, resolved);
+            mGraph.Write(pass, target);
+        }
+    }
+
+    void PostProcessChain::Render(GLuint output, int width, int height, const std::function<void()>& drawScene){
+        TRACE_SCOPE("PostProcessChain::Render");
+        BuildGraph(output, width, height, drawScene);
+        mGraph.Compile();
+        mBackend.Reset(output);
+        mGraph.Execute(mBackend);
+        glDisable(GL_BLEND);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glBindVertexArray(0);
+        glUseProgram(0);
+        mPool.EndFrame();
+    }
+
+    void PostProcessChain::PrintReport() const{
+        std::cout << "Post-process:" << (mSettings.mBloom ? " bloom" : "") << (mSettings.mTonemap ? " tonemap" : "")
+                  << (mSettings.mFxaa ? " fxaa" : "") << "; " << mGraph.GetOrder().size() << " passes, "
+                  << mBackend.GetFramebufferBinds() << " framebuffer binds, " << mGraph.GetSlotCount() << " graph slots; "
+                  << mPool.GetRequestedCount() << " targets requested per frame (" << mPool.GetRequestedBytes() / 1024
+                  << " KB), pool holds " << mPool.GetTargetCount() << " (" << mPool.GetAllocatedBytes() / 1024 << " KB)" << std::endl;
+    }
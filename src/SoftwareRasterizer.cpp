@@ -0,0 +1,367 @@
+#include "SoftwareRasterizer.hpp"
+#include "JobSystem.hpp"
+#include "Simd.hpp"
+#include "Trace.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+    static uint32_t PackColor(float r, float g, float b, float a){
+        // Same float -> unorm8 conversion GL applies when writing to an RGBA8 target.
+        uint32_t R = (uint32_t)(std::min(std::max(r, 0.0f), 1.0f) * 255.0f + 0.5f);
+        uint32_t G = (uint32_t)(std::min(std::max(g, 0.0f), 1.0f) * 255.0f + 0.5f);
+        uint32_t B = (uint32_t)(std::min(std::max(b, 0.0f), 1.0f) * 255.0f + 0.5f);
+        uint32_t A = (uint32_t)(std::min(std::max(a, 0.0f), 1.0f) * 255.0f + 0.5f);
+        return R | (G << 8) | (B << 16) | (A << 24);
+    }
+
+    SoftwareRasterizer::SoftwareRasterizer(JobSystem* jobs){
+        mJobs = jobs != nullptr ? jobs : &JobSystem::Shared();
+        mWidth = 0;
+        mHeight = 0;
+        mStride = 0;
+        mPaddedHeight = 0;
+        mTilesX = 0;
+        mTilesY = 0;
+        mBlocksX = 0;
+        mDepthTest = true;
+        mCullBackFaces = false;
+    }
+    void SoftwareRasterizer::Resize(int width, int height){
+        mWidth = width;
+        mHeight = height;
+        mStride = (width + kBlockSize - 1) / kBlockSize * kBlockSize;
+        mPaddedHeight = (height + kBlockSize - 1) / kBlockSize * kBlockSize;
+        mTilesX = (width + kTileSize - 1) / kTileSize;
+        mTilesY = (height + kTileSize - 1) / kTileSize;
+        mBlocksX = mStride / kBlockSize;
+        mColor.assign((size_t)mStride * mPaddedHeight, 0);
+        mDepth.assign((size_t)mStride * mPaddedHeight, 0.0f);
+        mBlockFarDepth.assign((size_t)mBlocksX * (mPaddedHeight / kBlockSize), 0.0f);
+        mTileFarDepth.assign((size_t)mTilesX * mTilesY, 0.0f);
+    }
+    void SoftwareRasterizer::SetDepthTest(bool enabled){
+        mDepthTest = enabled;
+    }
+    void SoftwareRasterizer::SetCullBackFaces(bool enabled){
+        mCullBackFaces = enabled;
+    }
+    void SoftwareRasterizer::Clear(const glm::vec4& color, float depth){
+        std::fill(mColor.begin(), mColor.end(), PackColor(color.r, color.g, color.b, color.a));
+        std::fill(mDepth.begin(), mDepth.end(), depth);
+        std::fill(mBlockFarDepth.begin(), mBlockFarDepth.end(), depth);
+        std::fill(mTileFarDepth.begin(), mTileFarDepth.end(), depth);
+    }
+    const unsigned char* SoftwareRasterizer::GetColorBuffer(){
+        mResolved.resize((size_t)mWidth * mHeight * 4);
+        for (int y = 0; y < mHeight; y++){
+            memcpy(&mResolved[(size_t)y * mWidth * 4], &mColor[(size_t)y * mStride], (size_t)mWidth * 4);
+        }
+        return mResolved.data();
+    }
+
+    void SoftwareRasterizer::DrawIndexed(const float* vertexData, size_t stride, size_t vertexCount,
+                                         const unsigned int* indices, size_t indexCount,
+                                         const glm::mat4& modelViewProjection){
+        if (mWidth == 0 || vertexCount == 0 || indexCount < 3){
+            return;
+        }
+        TRACE_SCOPE("SoftwareRasterizer::DrawIndexed");
+        // Vertex stage: gl_Position = u_Projection * u_ViewMatrix * u_ModelMatrix * position,
+        // one column-vector FMA chain per vertex.
+        mTransformed.resize(vertexCount);
+        const Float4 column0 = Float4Load(&modelViewProjection[0][0]);
+        const Float4 column1 = Float4Load(&modelViewProjection[1][0]);
+        const Float4 column2 = Float4Load(&modelViewProjection[2][0]);
+        const Float4 column3 = Float4Load(&modelViewProjection[3][0]);
+        mJobs->ParallelFor(vertexCount, 4096, [&](size_t begin, size_t end){
+            TRACE_SCOPE("TransformVertices");
+            for (size_t i = begin; i < end; i++){
+                const float* v = vertexData + i * stride;
+                Float4 clip = column0 * Float4Splat(v[0]) + column1 * Float4Splat(v[1])
+                            + column2 * Float4Splat(v[2]) + column3;
+                float position[4];
+                Float4Store(position, clip);
+                mTransformed[i].position = glm::vec4(position[0], position[1], position[2], position[3]);
+                mTransformed[i].color = glm::vec3(v[3], v[4], v[5]);
+            }
+        });
+
+        // Triangle setup and binning, in contiguous chunks so every tile still sees
+        // triangles in submission order (the GL path draws without a depth test).
+        const size_t kTrianglesPerChunk = 2048;
+        size_t triangleCount = indexCount / 3;
+        size_t chunkCount = (triangleCount + kTrianglesPerChunk - 1) / kTrianglesPerChunk;
+        size_t tileCount = (size_t)mTilesX * mTilesY;
+        mChunkTriangles.resize(chunkCount);
+        mChunkBins.resize(chunkCount);
+        mJobs->ParallelFor(triangleCount, kTrianglesPerChunk, [&](size_t begin, size_t end){
+            TRACE_SCOPE("SetupAndBin");
+            size_t chunk = begin / kTrianglesPerChunk;
+            std::vector<RasterTriangle>& triangles = mChunkTriangles[chunk];
+            triangles.clear();
+            for (size_t t = begin; t < end; t++){
+                unsigned int i0 = indices[t * 3 + 0];
+                unsigned int i1 = indices[t * 3 + 1];
+                unsigned int i2 = indices[t * 3 + 2];
+                if (i0 >= vertexCount || i1 >= vertexCount || i2 >= vertexCount){
+                    continue;
+                }
+                const ClipVertex triangle[3] = { mTransformed[i0], mTransformed[i1], mTransformed[i2] };
+                SetupClipped(triangle, triangles);
+            }
+            std::vector<std::vector<uint32_t>>& bins = mChunkBins[chunk];
+            bins.resize(tileCount);
+            for (std::vector<uint32_t>& bin : bins){
+                bin.clear();
+            }
+            BinTriangles(chunk);
+        });
+
+        mJobs->ParallelFor(tileCount, 1, [&](size_t begin, size_t end){
+            for (size_t tile = begin; tile < end; tile++){
+                RasterizeTile((int)tile);
+            }
+        });
+    }
+
+    void SoftwareRasterizer::SetupClipped(const ClipVertex* triangle, std::vector<RasterTriangle>& out) const{
+        // Trivial reject against each clip plane: -w <= x, y <= w and 0 <= z <= w.
+        for (int axis = 0; axis < 3; axis++){
+            bool allBelow = true;
+            bool allAbove = true;
+            for (int i = 0; i < 3; i++){
+                const glm::vec4& p = triangle[i].position;
+                allBelow = allBelow && p[axis] < (axis == 2 ? 0.0f : -p.w);
+                allAbove = allAbove && p[axis] > p.w;
+            }
+            if (allBelow || allAbove){
+                return;
+            }
+        }
+        float distance[3];
+        int insideCount = 0;
+        for (int i = 0; i < 3; i++){
+            distance[i] = triangle[i].position.w - triangle[i].position.z;
+            insideCount += distance[i] >= 0.0f ? 1 : 0;
+        }
+        if (insideCount == 3){
+            SetupTriangle(triangle[0], triangle[1], triangle[2], out);
+            return;
+        }
+        // Clip against the near plane (z = w); the other planes are handled by
+        // the screen-space bounding box and the per-pixel depth range test.
+        ClipVertex polygon[4];
+        int polygonSize = 0;
+        for (int i = 0; i < 3; i++){
+            int j = (i + 1) % 3;
+            if (distance[i] >= 0.0f){
+                polygon[polygonSize++] = triangle[i];
+            }
+            if ((distance[i] >= 0.0f) != (distance[j] >= 0.0f)){
+                float t = distance[i] / (distance[i] - distance[j]);
+                ClipVertex& v = polygon[polygonSize++];
+                v.position = triangle[i].position + (triangle[j].position - triangle[i].position) * t;
+                v.color = triangle[i].color + (triangle[j].color - triangle[i].color) * t;
+            }
+        }
+        for (int i = 1; i + 1 < polygonSize; i++){
+            SetupTriangle(polygon[0], polygon[i], polygon[i + 1], out);
+        }
+    }
+
+    void SoftwareRasterizer::SetupTriangle(const ClipVertex& a, const ClipVertex& b, const ClipVertex& c,
+                                           std::vector<RasterTriangle>& out) const{
+        const ClipVertex* v[3] = { &a, &b, &c };
+        float x[3], y[3], z[3], invW[3];
+        for (int i = 0; i < 3; i++){
+            invW[i] = 1.0f / v[i]->position.w;
+            x[i] = (v[i]->position.x * invW[i] * 0.5f + 0.5f) * mWidth;
+            y[i] = (v[i]->position.y * invW[i] * 0.5f + 0.5f) * mHeight;
+            z[i] = v[i]->position.z * invW[i];
+        }
+        float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+        if (!(std::fabs(area) > 0.0f) || !std::isfinite(area) || (mCullBackFaces && area < 0.0f)){
+            return;
+        }
+        RasterTriangle triangle;
+        // Without face culling clockwise triangles are drawn too: flip them to
+        // make "inside" positive for both windings.
+        float orientation = area > 0.0f ? 1.0f : -1.0f;
+        for (int i = 0; i < 3; i++){
+            int j = (i + 1) % 3;
+            int k = (i + 2) % 3;
+            triangle.edgeA[i] = (y[j] - y[k]) * orientation;
+            triangle.edgeB[i] = (x[k] - x[j]) * orientation;
+            triangle.edgeC[i] = (x[j] * y[k] - y[j] * x[k]) * orientation;
+            // Top-left fill rule: pixels exactly on a shared edge belong to one triangle only.
+            triangle.topLeft[i] = triangle.edgeA[i] > 0.0f || (triangle.edgeA[i] == 0.0f && triangle.edgeB[i] < 0.0f);
+        }
+        triangle.invArea = 1.0f / (area * orientation);
+        triangle.z0 = z[0];
+        triangle.dz1 = z[1] - z[0];
+        triangle.dz2 = z[2] - z[0];
+        triangle.invW0 = invW[0];
+        triangle.dInvW1 = invW[1] - invW[0];
+        triangle.dInvW2 = invW[2] - invW[0];
+        triangle.colorOverW0 = a.color * invW[0];
+        triangle.dColorOverW1 = b.color * invW[1] - triangle.colorOverW0;
+        triangle.dColorOverW2 = c.color * invW[2] - triangle.colorOverW0;
+        triangle.nearZ = std::max(z[0], std::max(z[1], z[2]));
+        // Pixel (px,py) is sampled at its centre (px+0.5, py+0.5).
+        float minX = std::min(x[0], std::min(x[1], x[2]));
+        float maxX = std::max(x[0], std::max(x[1], x[2]));
+        float minY = std::min(y[0], std::min(y[1], y[2]));
+        float maxY = std::max(y[0], std::max(y[1], y[2]));
+        triangle.minX = (int)std::max(0.0f, std::ceil(minX - 0.5f));
+        triangle.maxX = (int)std::min((float)mWidth - 1.0f, std::floor(maxX - 0.5f));
+        triangle.minY = (int)std::max(0.0f, std::ceil(minY - 0.5f));
+        triangle.maxY = (int)std::min((float)mHeight - 1.0f, std::floor(maxY - 0.5f));
+        if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY){
+            return;
+        }
+        out.push_back(triangle);
+    }
+
+    void SoftwareRasterizer::BinTriangles(size_t chunk){
+        const std::vector<RasterTriangle>& triangles = mChunkTriangles[chunk];
+        std::vector<std::vector<uint32_t>>& bins = mChunkBins[chunk];
+        for (size_t t = 0; t < triangles.size(); t++){
+            const RasterTriangle& triangle = triangles[t];
+            for (int ty = triangle.minY / kTileSize; ty <= triangle.maxY / kTileSize; ty++){
+                for (int tx = triangle.minX / kTileSize; tx <= triangle.maxX / kTileSize; tx++){
+                    bins[ty * mTilesX + tx].push_back((uint32_t)t);
+                }
+            }
+        }
+    }
+
+    void SoftwareRasterizer::RasterizeTile(int tileIndex){
+        TRACE_SCOPE("RasterizeTile");
+        int tileX = (tileIndex % mTilesX) * kTileSize;
+        int tileY = (tileIndex / mTilesX) * kTileSize;
+        int tileMaxX = std::min(tileX + kTileSize, mWidth) - 1;
+        int tileMaxY = std::min(tileY + kTileSize, mHeight) - 1;
+        float& tileFarDepth = mTileFarDepth[tileIndex];
+        for (size_t chunk = 0; chunk < mChunkBins.size(); chunk++){
+            const std::vector<RasterTriangle>& triangles = mChunkTriangles[chunk];
+            for (uint32_t t : mChunkBins[chunk][tileIndex]){
+                const RasterTriangle& triangle = triangles[t];
+                // Coarsest level of the depth hierarchy: nothing in this tile is farther than tileFarDepth.
+                if (mDepthTest && triangle.nearZ <= tileFarDepth){
+                    continue;
+                }
+                int minX = std::max(triangle.minX, tileX);
+                int minY = std::max(triangle.minY, tileY);
+                int maxX = std::min(triangle.maxX, tileMaxX);
+                int maxY = std::min(triangle.maxY, tileMaxY);
+                bool wrote = false;
+                for (int blockY = minY / kBlockSize; blockY <= maxY / kBlockSize; blockY++){
+                    for (int blockX = minX / kBlockSize; blockX <= maxX / kBlockSize; blockX++){
+                        if (mDepthTest && triangle.nearZ <= mBlockFarDepth[blockY * mBlocksX + blockX]){
+                            continue;
+                        }
+                        wrote |= RasterizeBlock(triangle, blockX, blockY, minX, minY, maxX, maxY);
+                    }
+                }
+                if (wrote && mDepthTest){
+                    float farDepth = 1.0f;
+                    for (int blockY = tileY / kBlockSize; blockY <= tileMaxY / kBlockSize; blockY++){
+                        for (int blockX = tileX / kBlockSize; blockX <= tileMaxX / kBlockSize; blockX++){
+                            farDepth = std::min(farDepth, mBlockFarDepth[blockY * mBlocksX + blockX]);
+                        }
+                    }
+                    tileFarDepth = farDepth;
+                }
+            }
+        }
+    }
+
+    bool SoftwareRasterizer::RasterizeBlock(const RasterTriangle& triangle, int blockX, int blockY,
+                                            int minX, int minY, int maxX, int maxY){
+        int x0 = blockX * kBlockSize;
+        int y0 = blockY * kBlockSize;
+        // An edge function is linear, so if it is negative at all four block
+        // corners the whole block lies outside that edge.
+        for (int i = 0; i < 3; i++){
+            float left = triangle.edgeA[i] * (x0 + 0.5f);
+            float right = triangle.edgeA[i] * (x0 + kBlockSize - 0.5f);
+            float bottom = triangle.edgeB[i] * (y0 + 0.5f) + triangle.edgeC[i];
+            float top = triangle.edgeB[i] * (y0 + kBlockSize - 0.5f) + triangle.edgeC[i];
+            if (std::max(std::max(left, right) + bottom, std::max(left, right) + top) < 0.0f){
+                return false;
+            }
+        }
+        const Float4 zero = Float4Splat(0.0f);
+        const Float4 one = Float4Splat(1.0f);
+        const Float4 laneOffset = Float4Set(0.5f, 1.5f, 2.5f, 3.5f);
+        const Float4 invArea = Float4Splat(triangle.invArea);
+        const Float4 laneMin = Float4Splat((float)minX);
+        const Float4 laneMax = Float4Splat((float)maxX + 1.0f);
+        Float4 edgeA[3], edgeB[3], edgeC[3];
+        for (int i = 0; i < 3; i++){
+            edgeA[i] = Float4Splat(triangle.edgeA[i]);
+            edgeB[i] = Float4Splat(triangle.edgeB[i]);
+            edgeC[i] = Float4Splat(triangle.edgeC[i]);
+        }
+        bool wrote = false;
+        int rowBegin = std::max(y0, minY);
+        int rowEnd = std::min(y0 + kBlockSize - 1, maxY);
+        for (int y = rowBegin; y <= rowEnd; y++){
+            Float4 py = Float4Splat(y + 0.5f);
+            for (int x = x0; x < x0 + kBlockSize; x += 4){
+                if (x + 3 < minX || x > maxX){
+                    continue;
+                }
+                Float4 px = Float4Splat((float)x) + laneOffset;
+                Float4 mask = Float4And(Float4CmpGt(px, laneMin), Float4CmpLt(px, laneMax));
+                Float4 edge[3];
+                for (int i = 0; i < 3; i++){
+                    edge[i] = edgeA[i] * px + edgeB[i] * py + edgeC[i];
+                    mask = Float4And(mask, triangle.topLeft[i] ? Float4CmpGe(edge[i], zero) : Float4CmpGt(edge[i], zero));
+                }
+                if (Float4MoveMask(mask) == 0){
+                    continue;
+                }
+                Float4 l1 = edge[1] * invArea;
+                Float4 l2 = edge[2] * invArea;
+                Float4 z = Float4Splat(triangle.z0) + l1 * Float4Splat(triangle.dz1) + l2 * Float4Splat(triangle.dz2);
+                // Depth range clipping (near is already clipped geometrically).
+                mask = Float4And(mask, Float4And(Float4CmpGe(z, zero), Float4CmpLe(z, one)));
+                float* depthRow = &mDepth[(size_t)y * mStride + x];
+                Float4 depth = Float4Load(depthRow);
+                if (mDepthTest){
+                    mask = Float4And(mask, Float4CmpGt(z, depth));
+                }
+                int bits = Float4MoveMask(mask);
+                if (bits == 0){
+                    continue;
+                }
+                if (mDepthTest){
+                    Float4Store(depthRow, Float4Select(mask, z, depth));
+                }
+                // frag.glsl: color = vec4(v_vertexColors, 1.0), perspective-correct.
+                Float4 w = one / (Float4Splat(triangle.invW0) + l1 * Float4Splat(triangle.dInvW1) + l2 * Float4Splat(triangle.dInvW2));
+                float r[4], g[4], b[4];
+                Float4Store(r, (Float4Splat(triangle.colorOverW0.r) + l1 * Float4Splat(triangle.dColorOverW1.r) + l2 * Float4Splat(triangle.dColorOverW2.r)) * w);
+                Float4Store(g, (Float4Splat(triangle.colorOverW0.g) + l1 * Float4Splat(triangle.dColorOverW1.g) + l2 * Float4Splat(triangle.dColorOverW2.g)) * w);
+                Float4Store(b, (Float4Splat(triangle.colorOverW0.b) + l1 * Float4Splat(triangle.dColorOverW1.b) + l2 * Float4Splat(triangle.dColorOverW2.b)) * w);
+                uint32_t* colorRow = &mColor[(size_t)y * mStride + x];
+                for (int lane = 0; lane < 4; lane++){
+                    if (bits & (1 << lane)){
+                        colorRow[lane] = PackColor(r[lane], g[lane], b[lane], 1.0f);
+                    }
+                }
+                wrote = true;
+            }
+        }
+        if (wrote && mDepthTest){
+            Float4 farDepth = one;
+            for (int y = y0; y < y0 + kBlockSize; y++){
+                const float* depthRow = &mDepth[(size_t)y * mStride + x0];
+                farDepth = Float4Min(farDepth, Float4Min(Float4Load(depthRow), Float4Load(depthRow + 4)));
+            }
+            mBlockFarDepth[blockY * mBlocksX + blockX] = Float4HorizontalMin(farDepth);
+        }
+        return wrote;
+    }
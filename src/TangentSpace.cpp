@@ -0,0 +1,423 @@
+#include "TangentSpace.hpp"
+#include "JobSystem.hpp"
+#include "Simd.hpp"
+#include "Trace.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <unordered_map>
+
+    static const size_t kTrianglesPerJob = 4096;
+    static const size_t kCornersPerJob = 8192;
+
+    // Numbers the distinct vertex positions, compared bit-exactly; used when the
+    // mesh did not come from LoadOBJ and has no positionIds.
+    static std::vector<unsigned int> WeldPositions(const std::vector<Vertex>& vertices){
+        struct PositionHash{
+            size_t operator()(const glm::vec3& position) const{
+                unsigned int words[3];
+                memcpy(words, &position, sizeof(words));
+                return (size_t)(((unsigned long long)words[0] * 73856093u) ^ ((unsigned long long)words[1] * 19349663u)
+                                ^ ((unsigned long long)words[2] * 83492791u));
+            }
+        };
+        std::unordered_map<glm::vec3, unsigned int, PositionHash> ids;
+        ids.reserve(vertices.size());
+        std::vector<unsigned int> keys(vertices.size());
+        for (size_t i = 0; i < vertices.size(); i++){
+            keys[i] = ids.emplace(vertices[i].position, (unsigned int)ids.size()).first->second;
+        }
+        return keys;
+    }
+
+    // Buckets triangle corners by position: corners[start[k], start[k + 1])
+    // all sit on position k.
+    static void BuildCornerLists(const Mesh& mesh, size_t cornerCount, std::vector<unsigned int>& cornerKeys,
+                                 std::vector<unsigned int>& start, std::vector<unsigned int>& corners){
+        const std::vector<unsigned int>* positionKeys = &mesh.positionIds;
+        std::vector<unsigned int> welded;
+        if (mesh.positionIds.size() != mesh.vertices.size()){
+            welded = WeldPositions(mesh.vertices);
+            positionKeys = &welded;
+        }
+        cornerKeys.resize(cornerCount);
+        for (size_t c = 0; c < cornerCount; c++){
+            cornerKeys[c] = (*positionKeys)[mesh.indices[c]];
+        }
+        unsigned int keyCount = 0;
+        for (unsigned int key : cornerKeys){
+            keyCount = std::max(keyCount, key + 1);
+        }
+        start.assign((size_t)keyCount + 1, 0);
+        for (unsigned int key : cornerKeys){
+            start[key + 1]++;
+        }
+        for (size_t k = 0; k < keyCount; k++){
+            start[k + 1] += start[k];
+        }
+        corners.resize(cornerKeys.size());
+        std::vector<unsigned int> cursor(start.begin(), start.end() - 1);
+        for (size_t c = 0; c < cornerKeys.size(); c++){
+            corners[cursor[cornerKeys[c]]++] = (unsigned int)c;
+        }
+    }
+
+    // Writes a per-corner result into the vertices, copying a vertex when two of
+    // its corners disagree. matches(vertex, corner) and apply(vertex, corner).
+    template <typename Matches, typename Apply>
+    static void AssignCorners(Mesh& mesh, Matches matches, Apply apply){
+        const unsigned int kNone = ~0u;
+        size_t originalCount = mesh.vertices.size();
+        std::vector<unsigned char> assigned(originalCount, 0);
+        std::vector<unsigned int> nextCopy(originalCount, kNone);
+        bool trackPositions = mesh.positionIds.size() == originalCount;
+        for (size_t c = 0; c < mesh.indices.size(); c++){
+            unsigned int vertex = mesh.indices[c];
+            if (!assigned[vertex]){
+                apply(mesh.vertices[vertex], c);
+                assigned[vertex] = 1;
+                continue;
+            }
+            unsigned int candidate = vertex;
+            while (!matches(mesh.vertices[candidate], c) && nextCopy[candidate] != kNone){
+                candidate = nextCopy[candidate];
+            }
+            if (!matches(mesh.vertices[candidate], c)){
+                Vertex copy = mesh.vertices[vertex];
+                apply(copy, c);
+                unsigned int copyIndex = (unsigned int)mesh.vertices.size();
+                mesh.vertices.push_back(copy);
+                nextCopy.push_back(kNone);
+                nextCopy[candidate] = copyIndex;
+                if (trackPositions){
+                    mesh.positionIds.push_back(mesh.positionIds[vertex]);
+                }
+                candidate = copyIndex;
+            }
+            mesh.indices[c] = candidate;
+        }
+    }
+
+    static bool NearlyEqual(const glm::vec3& a, const glm::vec3& b){
+        glm::vec3 d = a - b;
+        return glm::dot(d, d) < 1e-10f;
+    }
+
+    void TangentSpace::GenerateNormals(Mesh& mesh, float smoothingAngle, NormalWeighting weighting){
+        TRACE_SCOPE("GenerateNormals");
+        size_t cornerCount = mesh.indices.size() - mesh.indices.size() % 3;
+        size_t triangleCount = cornerCount / 3;
+        if (triangleCount == 0){
+            return;
+        }
+        const std::vector<Vertex>& vertices = mesh.vertices;
+        const unsigned int* indices = mesh.indices.data();
+        // Unit face normals and the weighted normal every corner contributes,
+        // four floats each so they load straight into a Float4.
+        std::vector<float> faceNormals(triangleCount * 4);
+        std::vector<float> cornerNormals(cornerCount * 4);
+        size_t blockCount = (triangleCount + 3) / 4;
+        JobSystem::Shared().ParallelFor(blockCount, kTrianglesPerJob / 4, [&](size_t begin, size_t end){
+            for (size_t block = begin; block < end; block++){
+                // Four triangles side by side, one per lane; the tail repeats the last one.
+                float position[3][3][4];
+                for (int lane = 0; lane < 4; lane++){
+                    size_t t = std::min(block * 4 + lane, triangleCount - 1);
+                    for (int corner = 0; corner < 3; corner++){
+                        const glm::vec3& p = vertices[indices[t * 3 + corner]].position;
+                        position[corner][0][lane] = p.x;
+                        position[corner][1][lane] = p.y;
+                        position[corner][2][lane] = p.z;
+                    }
+                }
+                Float4 p[3][3];
+                for (int corner = 0; corner < 3; corner++){
+                    for (int axis = 0; axis < 3; axis++){
+                        p[corner][axis] = Float4Load(position[corner][axis]);
+                    }
+                }
+                Float4 e01[3] = { p[1][0] - p[0][0], p[1][1] - p[0][1], p[1][2] - p[0][2] };
+                Float4 e02[3] = { p[2][0] - p[0][0], p[2][1] - p[0][1], p[2][2] - p[0][2] };
+                Float4 e12[3] = { p[2][0] - p[1][0], p[2][1] - p[1][1], p[2][2] - p[1][2] };
+                Float4 normal[3] = { e01[1] * e02[2] - e01[2] * e02[1],
+                                     e01[2] * e02[0] - e01[0] * e02[2],
+                                     e01[0] * e02[1] - e01[1] * e02[0] };
+                Float4 tiny = Float4Splat(1e-30f);
+                Float4 zero = Float4Splat(0.0f);
+                Float4 one = Float4Splat(1.0f);
+                Float4 length = Float4Sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+                Float4 inverseLength = Float4Select(Float4CmpGt(length, tiny), one / Float4Max(length, tiny), zero);
+                Float4 length01 = Float4Sqrt(e01[0] * e01[0] + e01[1] * e01[1] + e01[2] * e01[2]);
+                Float4 length02 = Float4Sqrt(e02[0] * e02[0] + e02[1] * e02[1] + e02[2] * e02[2]);
+                Float4 length12 = Float4Sqrt(e12[0] * e12[0] + e12[1] * e12[1] + e12[2] * e12[2]);
+                Float4 cosine[3] = {
+                    (e01[0] * e02[0] + e01[1] * e02[1] + e01[2] * e02[2]) / Float4Max(length01 * length02, tiny),
+                    zero - (e01[0] * e12[0] + e01[1] * e12[1] + e01[2] * e12[2]) / Float4Max(length01 * length12, tiny),
+                    (e02[0] * e12[0] + e02[1] * e12[1] + e02[2] * e12[2]) / Float4Max(length02 * length12, tiny)
+                };
+                float unit[3][4];
+                float area[4];
+                float cosines[3][4];
+                for (int axis = 0; axis < 3; axis++){
+                    Float4Store(unit[axis], normal[axis] * inverseLength);
+                    Float4Store(cosines[axis], Float4Min(Float4Max(cosine[axis], Float4Splat(-1.0f)), one));
+                }
+                Float4Store(area, length);
+                for (int lane = 0; lane < 4 && block * 4 + lane < triangleCount; lane++){
+                    size_t t = block * 4 + lane;
+                    Float4 faceNormal = Float4Set(unit[0][lane], unit[1][lane], unit[2][lane], 0.0f);
+                    Float4Store(&faceNormals[t * 4], faceNormal);
+                    for (int corner = 0; corner < 3; corner++){
+                        float weight = weighting == kWeightArea ? area[lane] : std::acos(cosines[corner][lane]);
+                        Float4Store(&cornerNormals[(t * 3 + corner) * 4], faceNormal * Float4Splat(weight));
+                    }
+                }
+            }
+        });
+
+        std::vector<unsigned int> cornerKeys;
+        std::vector<unsigned int> start;
+        std::vector<unsigned int> corners;
+        BuildCornerLists(mesh, cornerCount, cornerKeys, start, corners);
+
+        bool hasGroups = mesh.smoothingGroups.size() >= triangleCount;
+        float cosineThreshold = std::cos(glm::radians(std::min(std::max(smoothingAngle, 0.0f), 180.0f)));
+        std::vector<glm::vec3> result(cornerCount);
+        JobSystem::Shared().ParallelFor(cornerCount, kCornersPerJob, [&](size_t begin, size_t end){
+            for (size_t c = begin; c < end; c++){
+                size_t face = c / 3;
+                unsigned int group = hasGroups ? mesh.smoothingGroups[face] : 1;
+                const float* faceNormal = &faceNormals[face * 4];
+                Float4 sum = Float4Load(&cornerNormals[c * 4]);
+                if (group != 0){
+                    unsigned int key = cornerKeys[c];
+                    for (unsigned int i = start[key]; i < start[key + 1]; i++){
+                        size_t other = corners[i];
+                        size_t otherFace = other / 3;
+                        if (otherFace == face || (hasGroups && mesh.smoothingGroups[otherFace] != group)){
+                            continue;
+                        }
+                        const float* otherNormal = &faceNormals[otherFace * 4];
+                        float cosine = faceNormal[0] * otherNormal[0] + faceNormal[1] * otherNormal[1] + faceNormal[2] * otherNormal[2];
+                        if (cosine >= cosineThreshold){
+                            sum = sum + Float4Load(&cornerNormals[other * 4]);
+                        }
+                    }
+                }
+                float n[4];
+                Float4Store(n, sum);
+                glm::vec3 normal(n[0], n[1], n[2]);
+                float length = glm::length(normal);
+                result[c] = length > 0.0f ? normal / length : glm::vec3(faceNormal[0], faceNormal[1], faceNormal[2]);
+            }
+        });
+        AssignCorners(mesh,
+                      [&](const Vertex& vertex, size_t c){ return NearlyEqual(vertex.normal, result[c]); },
+                      [&](Vertex& vertex, size_t c){ vertex.normal = result[c]; });
+    }
+
+    void TangentSpace::GenerateTangents(Mesh& mesh){
+        TRACE_SCOPE("GenerateTangents");
+        size_t cornerCount = mesh.indices.size() - mesh.indices.size() % 3;
+        size_t triangleCount = cornerCount / 3;
+        if (triangleCount == 0){
+            return;
+        }
+        const std::vector<Vertex>& vertices = mesh.vertices;
+        const unsigned int* indices = mesh.indices.data();
+        // Angle-weighted tangent each corner contributes, and whether its face
+        // keeps the UV winding (the bitangent sign).
+        std::vector<float> cornerTangents(cornerCount * 4);
+        std::vector<unsigned char> preservesOrientation(triangleCount);
+        size_t blockCount = (triangleCount + 3) / 4;
+        JobSystem::Shared().ParallelFor(blockCount, kTrianglesPerJob / 4, [&](size_t begin, size_t end){
+            for (size_t block = begin; block < end; block++){
+                // Four triangles per lane set, as in GenerateNormals.
+                float gathered[3][8][4];
+                for (int lane = 0; lane < 4; lane++){
+                    size_t t = std::min(block * 4 + lane, triangleCount - 1);
+                    for (int corner = 0; corner < 3; corner++){
+                        const Vertex& vertex = vertices[indices[t * 3 + corner]];
+                        const float values[8] = { vertex.position.x, vertex.position.y, vertex.position.z,
+                                                  vertex.normal.x, vertex.normal.y, vertex.normal.z,
+                                                  vertex.texCoord.x, vertex.texCoord.y };
+                        for (int i = 0; i < 8; i++){
+                            gathered[corner][i][lane] = values[i];
+                        }
+                    }
+                }
+                Float4 p[3][3];
+                Float4 n[3][3];
+                Float4 uv[3][2];
+                for (int corner = 0; corner < 3; corner++){
+                    for (int axis = 0; axis < 3; axis++){
+                        p[corner][axis] = Float4Load(gathered[corner][axis]);
+                        n[corner][axis] = Float4Load(gathered[corner][3 + axis]);
+                    }
+                    uv[corner][0] = Float4Load(gathered[corner][6]);
+                    uv[corner][1] = Float4Load(gathered[corner][7]);
+                }
+                Float4 zero = Float4Splat(0.0f);
+                Float4 one = Float4Splat(1.0f);
+                Float4 tiny = Float4Splat(1e-30f);
+                Float4 du1 = uv[1][0] - uv[0][0];
+                Float4 dv1 = uv[1][1] - uv[0][1];
+                Float4 du2 = uv[2][0] - uv[0][0];
+                Float4 dv2 = uv[2][1] - uv[0][1];
+                Float4 signedArea = du1 * dv2 - dv1 * du2;
+                Float4 sign = Float4Select(Float4CmpLt(signedArea, zero), Float4Splat(-1.0f), one);
+                Float4 degenerate = Float4And(Float4CmpGe(signedArea, zero), Float4CmpLe(signedArea, zero));
+                Float4 faceTangent[3];
+                for (int axis = 0; axis < 3; axis++){
+                    faceTangent[axis] = (dv2 * (p[1][axis] - p[0][axis]) - dv1 * (p[2][axis] - p[0][axis])) * sign;
+                }
+                float tangents[3][3][4];
+                float inverseLengths[3][4];
+                float cosines[3][4];
+                float valid[3][4];
+                for (int k = 0; k < 3; k++){
+                    const Float4* normal = n[k];
+                    // Project the tangent and both adjacent edges into the normal's plane.
+                    Float4 toNext[3];
+                    Float4 toPrevious[3];
+                    Float4 tangent[3];
+                    for (int axis = 0; axis < 3; axis++){
+                        toNext[axis] = p[(k + 1) % 3][axis] - p[k][axis];
+                        toPrevious[axis] = p[(k + 2) % 3][axis] - p[k][axis];
+                    }
+                    Float4 tangentDot = normal[0] * faceTangent[0] + normal[1] * faceTangent[1] + normal[2] * faceTangent[2];
+                    Float4 nextDot = normal[0] * toNext[0] + normal[1] * toNext[1] + normal[2] * toNext[2];
+                    Float4 previousDot = normal[0] * toPrevious[0] + normal[1] * toPrevious[1] + normal[2] * toPrevious[2];
+                    for (int axis = 0; axis < 3; axis++){
+                        tangent[axis] = faceTangent[axis] - normal[axis] * tangentDot;
+                        toNext[axis] = toNext[axis] - normal[axis] * nextDot;
+                        toPrevious[axis] = toPrevious[axis] - normal[axis] * previousDot;
+                        Float4Store(tangents[k][axis], tangent[axis]);
+                    }
+                    Float4 tangentLength = Float4Sqrt(tangent[0] * tangent[0] + tangent[1] * tangent[1] + tangent[2] * tangent[2]);
+                    Float4 nextLength = Float4Sqrt(toNext[0] * toNext[0] + toNext[1] * toNext[1] + toNext[2] * toNext[2]);
+                    Float4 previousLength = Float4Sqrt(toPrevious[0] * toPrevious[0] + toPrevious[1] * toPrevious[1] + toPrevious[2] * toPrevious[2]);
+                    Float4 cosine = (toNext[0] * toPrevious[0] + toNext[1] * toPrevious[1] + toNext[2] * toPrevious[2])
+                                  / Float4Max(nextLength * previousLength, tiny);
+                    Float4 usable = Float4And(Float4And(Float4CmpGt(tangentLength, tiny), Float4CmpGt(nextLength, tiny)),
+                                              Float4CmpGt(previousLength, tiny));
+                    Float4Store(inverseLengths[k], one / Float4Max(tangentLength, tiny));
+                    Float4Store(cosines[k], Float4Min(Float4Max(cosine, Float4Splat(-1.0f)), one));
+                    Float4Store(valid[k], Float4Select(degenerate, zero, Float4Select(usable, one, zero)));
+                }
+                float area[4];
+                Float4Store(area, signedArea);
+                for (int lane = 0; lane < 4 && block * 4 + lane < triangleCount; lane++){
+                    size_t t = block * 4 + lane;
+                    preservesOrientation[t] = area[lane] > 0.0f;
+                    for (int k = 0; k < 3; k++){
+                        // Angle-weighted unit tangent.
+                        float weight = valid[k][lane] != 0.0f ? std::acos(cosines[k][lane]) * inverseLengths[k][lane] : 0.0f;
+                        Float4Store(&cornerTangents[(t * 3 + k) * 4],
+                                    Float4Set(tangents[k][0][lane], tangents[k][1][lane], tangents[k][2][lane], 0.0f) * Float4Splat(weight));
+                    }
+                }
+            }
+        });
+
+        std::vector<unsigned int> cornerKeys;
+        std::vector<unsigned int> start;
+        std::vector<unsigned int> corners;
+        BuildCornerLists(mesh, cornerCount, cornerKeys, start, corners);
+
+        std::vector<glm::vec4> result(cornerCount);
+        JobSystem::Shared().ParallelFor(cornerCount, kCornersPerJob, [&](size_t begin, size_t end){
+            for (size_t c = begin; c < end; c++){
+                bool orientation = preservesOrientation[c / 3] != 0;
+                const Vertex& vertex = vertices[indices[c]];
+                Float4 sum = Float4Splat(0.0f);
+                unsigned int key = cornerKeys[c];
+                for (unsigned int i = start[key]; i < start[key + 1]; i++){
+                    unsigned int other = corners[i];
+                    const Vertex& otherVertex = vertices[indices[other]];
+                    if ((preservesOrientation[other / 3] != 0) == orientation &&
+                        otherVertex.normal == vertex.normal && otherVertex.texCoord == vertex.texCoord){
+                        sum = sum + Float4Load(&cornerTangents[(size_t)other * 4]);
+                    }
+                }
+                float s[4];
+                Float4Store(s, sum);
+                glm::vec3 tangent(s[0], s[1], s[2]);
+                float length = glm::length(tangent);
+                const glm::vec3& normal = vertex.normal;
+                if (length > 0.0f){
+                    tangent = tangent / length;
+                } else {
+                    // No usable UV gradient: any direction perpendicular to the normal.
+                    glm::vec3 axis = std::fabs(normal.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+                    tangent = glm::cross(normal, axis);
+                    float axisLength = glm::length(tangent);
+                    tangent = axisLength > 0.0f ? tangent / axisLength : glm::vec3(1.0f, 0.0f, 0.0f);
+                }
+                result[c] = glm::vec4(tangent, orientation ? 1.0f : -1.0f);
+            }
+        });
+        AssignCorners(mesh,
+                      [&](const Vertex& vertex, size_t c){
+                          return vertex.tangent.w == result[c].w && NearlyEqual(glm::vec3(vertex.tangent), glm::vec3(result[c]));
+                      },
+                      [&](Vertex& vertex, size_t c){ vertex.tangent = result[c]; });
+    }
+
+    // A rippled grid written the way LoadOBJ produces meshes: three vertices per
+    // triangle, positionIds into the shared grid points, and two smoothing
+    // groups meeting along the middle column.
+    static Mesh MakeRippledGrid(int triangleCount){
+        int size = std::max(2, (int)std::sqrt(triangleCount / 2.0));
+        Mesh mesh;
+        mesh.vertices.reserve((size_t)size * size * 6);
+        for (int y = 0; y < size; y++){
+            for (int x = 0; x < size; x++){
+                const int corners[6][2] = { { 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 0 }, { 1, 1 }, { 0, 1 } };
+                for (const int* offset : corners){
+                    int gx = x + offset[0];
+                    int gy = y + offset[1];
+                    float u = (float)gx / size;
+                    float v = (float)gy / size;
+                    Vertex vertex;
+                    vertex.position = glm::vec3(u, 0.05f * std::sin(u * 40.0f) * std::cos(v * 30.0f), v);
+                    vertex.texCoord = glm::vec2(u * 4.0f, v * 4.0f);
+                    mesh.indices.push_back((unsigned int)mesh.vertices.size());
+                    mesh.vertices.push_back(vertex);
+                    mesh.positionIds.push_back((unsigned int)(gy * (size + 1) + gx));
+                }
+                unsigned int group = x < size / 2 ? 1 : 2;
+                mesh.smoothingGroups.push_back(group);
+                mesh.smoothingGroups.push_back(group);
+            }
+        }
+        return mesh;
+    }
+
+    void TangentSpace::RunMicrobenchmark(int triangleCount){
+        Mesh mesh = MakeRippledGrid(triangleCount);
+        size_t triangles = mesh.indices.size() / 3;
+        size_t sourceVertices = mesh.vertices.size();
+        std::cout << "Tangent space for " << triangles << " triangles (" << sourceVertices << " unwelded vertices) on "
+                  << JobSystem::Shared().GetThreadCount() << " threads" << std::endl;
+        const NormalWeighting weightings[2] = { kWeightArea, kWeightAngle };
+        const char* names[2] = { "area", "angle" };
+        for (int i = 0; i < 2; i++){
+            Mesh copy = mesh;
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            GenerateNormals(copy, 60.0f, weightings[i]);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::cout << "\tnormals (" << names[i] << "-weighted): " << seconds * 1000.0 << " ms ("
+                      << triangles / seconds / 1e6 << " M tris/sec)" << std::endl;
+            if (i == 1){
+                mesh = std::move(copy);
+            }
+        }
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        GenerateTangents(mesh);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "\ttangents: " << seconds * 1000.0 << " ms (" << triangles / seconds / 1e6 << " M tris/sec), "
+                  << mesh.vertices.size() - sourceVertices << " vertices split" << std::endl;
+    }
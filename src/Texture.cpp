@@ -0,0 +1,834 @@
+#include "Texture.hpp"
+#include "DiskCache.hpp"
+#include "JobSystem.hpp"
+#include "Simd.hpp"
+#include "Trace.hpp"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <thread>
+
+    static const size_t kRowsPerJob = 16;
+    // Kaiser kernel: 8 taps at half-texel offsets, window half-width 4 source texels.
+    static const int kKaiserTaps = 8;
+    static const float kKaiserBeta = 4.0f;
+
+    static void FlipRows(Image& image){
+        size_t rowBytes = (size_t)image.mWidth * 4;
+        std::vector<uint8_t> row(rowBytes);
+        for (int y = 0; y < image.mHeight / 2; y++){
+            uint8_t* top = &image.mPixels[(size_t)y * rowBytes];
+            uint8_t* bottom = &image.mPixels[(size_t)(image.mHeight - 1 - y) * rowBytes];
+            memcpy(row.data(), top, rowBytes);
+            memcpy(top, bottom, rowBytes);
+            memcpy(bottom, row.data(), rowBytes);
+        }
+    }
+
+    // Next whitespace-separated header token, skipping # comments.
+    static bool ReadPPMToken(const uint8_t* data, size_t size, size_t& offset, int& value){
+        while (offset < size){
+            if (data[offset] == '#'){
+                while (offset < size && data[offset] != '\n'){
+                    offset++;
+                }
+            } else if (isspace(data[offset])){
+                offset++;
+            } else {
+                break;
+            }
+        }
+        if (offset >= size || !isdigit(data[offset])){
+            return false;
+        }
+        value = 0;
+        while (offset < size && isdigit(data[offset])){
+            value = value * 10 + (data[offset++] - '0');
+        }
+        return true;
+    }
+
+    static bool DecodePPM(const uint8_t* data, size_t size, Image& image){
+        bool binary = data[1] == '6';
+        size_t offset = 2;
+        int width = 0;
+        int height = 0;
+        int maxValue = 0;
+        if (!ReadPPMToken(data, size, offset, width) || !ReadPPMToken(data, size, offset, height)
+            || !ReadPPMToken(data, size, offset, maxValue) || width <= 0 || height <= 0 || maxValue <= 0 || maxValue > 65535){
+            return false;
+        }
+        size_t pixelCount = (size_t)width * height;
+        int sampleBytes = maxValue > 255 ? 2 : 1;
+        if (binary){
+            offset++; // the single whitespace byte ending the header
+            if (size < offset || size - offset < pixelCount * 3 * sampleBytes){
+                return false;
+            }
+        }
+        image.mWidth = width;
+        image.mHeight = height;
+        image.mPixels.resize(pixelCount * 4);
+        for (size_t i = 0; i < pixelCount; i++){
+            for (int c = 0; c < 3; c++){
+                int sample = 0;
+                if (!binary){
+                    if (!ReadPPMToken(data, size, offset, sample)){
+                        return false;
+                    }
+                } else if (sampleBytes == 2){
+                    sample = (data[offset] << 8) | data[offset + 1];
+                    offset += 2;
+                } else {
+                    sample = data[offset++];
+                }
+                image.mPixels[i * 4 + c] = (uint8_t)((std::min(sample, maxValue) * 255 + maxValue / 2) / maxValue);
+            }
+            image.mPixels[i * 4 + 3] = 255;
+        }
+        FlipRows(image);
+        return true;
+    }
+
+    static void ReadTGAPixel(const uint8_t* source, int bytesPerPixel, uint8_t* rgba){
+        if (bytesPerPixel == 1){
+            rgba[0] = rgba[1] = rgba[2] = source[0];
+            rgba[3] = 255;
+            return;
+        }
+        rgba[0] = source[2];
+        rgba[1] = source[1];
+        rgba[2] = source[0];
+        rgba[3] = bytesPerPixel == 4 ? source[3] : 255;
+    }
+
+    static bool DecodeTGA(const uint8_t* data, size_t size, Image& image){
+        if (size < 18){
+            return false;
+        }
+        int idLength = data[0];
+        int colorMapType = data[1];
+        int imageType = data[2];
+        int colorMapLength = data[5] | (data[6] << 8);
+        int colorMapBits = data[7];
+        int width = data[12] | (data[13] << 8);
+        int height = data[14] | (data[15] << 8);
+        int bitsPerPixel = data[16];
+        bool topOrigin = (data[17] & 0x20) != 0;
+        bool rle = imageType == 10 || imageType == 11;
+        bool grey = imageType == 3 || imageType == 11;
+        if ((imageType != 2 && imageType != 3 && !rle) || width <= 0 || height <= 0){
+            std::cout << "TGA: only true-colour and greyscale images are supported" << std::endl;
+            return false;
+        }
+        int bytesPerPixel = bitsPerPixel / 8;
+        if ((grey && bytesPerPixel != 1) || (!grey && bytesPerPixel != 3 && bytesPerPixel != 4)){
+            std::cout << "TGA: unsupported pixel depth " << bitsPerPixel << std::endl;
+            return false;
+        }
+        size_t offset = 18 + idLength + (colorMapType == 1 ? (size_t)colorMapLength * ((colorMapBits + 7) / 8) : 0);
+        size_t pixelCount = (size_t)width * height;
+        image.mWidth = width;
+        image.mHeight = height;
+        image.mPixels.resize(pixelCount * 4);
+        size_t pixel = 0;
+        while (pixel < pixelCount){
+            size_t count = 1;
+            bool run = false;
+            if (rle){
+                if (offset >= size){
+                    return false;
+                }
+                uint8_t header = data[offset++];
+                run = (header & 0x80) != 0;
+                count = std::min<size_t>((header & 0x7F) + 1, pixelCount - pixel);
+            } else {
+                count = pixelCount;
+            }
+            size_t sourceBytes = run ? bytesPerPixel : count * bytesPerPixel;
+            if (offset > size || size - offset < sourceBytes){
+                return false;
+            }
+            for (size_t i = 0; i < count; i++){
+                ReadTGAPixel(data + offset + (run ? 0 : i * bytesPerPixel), bytesPerPixel, &image.mPixels[(pixel + i) * 4]);
+            }
+            offset += sourceBytes;
+            pixel += count;
+        }
+        if (topOrigin){
+            FlipRows(image);
+        }
+        return true;
+    }
+
+    bool ImageCodec::ReadFile(const std::string& path, std::vector<uint8_t>& data){
+        std::ifstream file(path, std::ios::binary);
+        if (!file){
+            std::cout << "Could not open image: " << path << std::endl;
+            return false;
+        }
+        data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        return true;
+    }
+
+    bool ImageCodec::Decode(const std::string& path, Image& image){
+        std::vector<uint8_t> data;
+        if (!ReadFile(path, data)){
+            return false;
+        }
+        if (!Decode(data.data(), data.size(), image)){
+            std::cout << "Could not decode image: " << path << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool ImageCodec::Decode(const uint8_t* data, size_t size, Image& image){
+        TRACE_SCOPE("ImageCodec::Decode");
+        if (size >= 2 && data[0] == 'P' && (data[1] == '3' || data[1] == '6')){
+            return DecodePPM(data, size, image);
+        }
+        return DecodeTGA(data, size, image);
+    }
+
+    // sRGB <-> linear through lookup tables: exact going in, 4096 steps coming out.
+    struct SrgbTables{
+        float mToLinear[256];
+        uint8_t mFromLinear[4097];
+        SrgbTables(){
+            for (int i = 0; i < 256; i++){
+                float c = i / 255.0f;
+                mToLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+            }
+            for (int i = 0; i <= 4096; i++){
+                float l = i / 4096.0f;
+                float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+                mFromLinear[i] = (uint8_t)std::min(255.0f, c * 255.0f + 0.5f);
+            }
+        }
+    };
+    static const SrgbTables& GetSrgbTables(){
+        static const SrgbTables tables;
+        return tables;
+    }
+
+    // Linear RGBA, four floats per pixel, rows bottom first like Image. Level 0
+    // is read straight from the sRGB image a row at a time (mImage), so the
+    // largest level never exists as floats.
+    struct LinearLevel{
+        int mWidth = 0;
+        int mHeight = 0;
+        std::vector<float> mPixels;
+        const Image* mImage = nullptr;
+    };
+
+    static const float* ReadRow(const LinearLevel& level, int y, std::vector<float>& buffer){
+        if (level.mImage == nullptr){
+            return &level.mPixels[(size_t)y * level.mWidth * 4];
+        }
+        const SrgbTables& tables = GetSrgbTables();
+        const uint8_t* row = &level.mImage->mPixels[(size_t)y * level.mWidth * 4];
+        buffer.resize((size_t)level.mWidth * 4);
+        for (size_t i = 0; i < buffer.size(); i += 4){
+            buffer[i + 0] = tables.mToLinear[row[i + 0]];
+            buffer[i + 1] = tables.mToLinear[row[i + 1]];
+            buffer[i + 2] = tables.mToLinear[row[i + 2]];
+            buffer[i + 3] = row[i + 3] * (1.0f / 255.0f);
+        }
+        return buffer.data();
+    }
+
+    static void FromLinear(const LinearLevel& level, Image& image){
+        const SrgbTables& tables = GetSrgbTables();
+        image.mWidth = level.mWidth;
+        image.mHeight = level.mHeight;
+        image.mPixels.resize((size_t)level.mWidth * level.mHeight * 4);
+        const Float4 zero = Float4Splat(0.0f);
+        const Float4 one = Float4Splat(1.0f);
+        const Float4 scale = Float4Set(4096.0f, 4096.0f, 4096.0f, 255.0f);
+        for (size_t i = 0; i < image.mPixels.size(); i += 4){
+            // The Kaiser kernel has negative lobes, so clamp before the lookup.
+            float scaled[4];
+            Float4Store(scaled, Float4Min(Float4Max(Float4Load(&level.mPixels[i]), zero), one) * scale + Float4Splat(0.5f));
+            image.mPixels[i + 0] = tables.mFromLinear[(int)scaled[0]];
+            image.mPixels[i + 1] = tables.mFromLinear[(int)scaled[1]];
+            image.mPixels[i + 2] = tables.mFromLinear[(int)scaled[2]];
+            image.mPixels[i + 3] = (uint8_t)scaled[3];
+        }
+    }
+
+    static void DownsampleBox(const LinearLevel& source, LinearLevel& target){
+        target.mWidth = std::max(1, source.mWidth / 2);
+        target.mHeight = std::max(1, source.mHeight / 2);
+        target.mPixels.resize((size_t)target.mWidth * target.mHeight * 4);
+        target.mImage = nullptr;
+        const Float4 quarter = Float4Splat(0.25f);
+        JobSystem::Shared().ParallelFor(target.mHeight, kRowsPerJob, [&](size_t begin, size_t end){
+            std::vector<float> buffer0;
+            std::vector<float> buffer1;
+            for (size_t y = begin; y < end; y++){
+                // A source side of 1 texel is read twice rather than past its end.
+                const float* row0 = ReadRow(source, std::min<int>((int)y * 2, source.mHeight - 1), buffer0);
+                const float* row1 = ReadRow(source, std::min<int>((int)y * 2 + 1, source.mHeight - 1), buffer1);
+                float* out = &target.mPixels[y * target.mWidth * 4];
+                for (int x = 0; x < target.mWidth; x++){
+                    size_t x0 = (size_t)std::min(x * 2, source.mWidth - 1) * 4;
+                    size_t x1 = (size_t)std::min(x * 2 + 1, source.mWidth - 1) * 4;
+                    Float4 sum = Float4Load(row0 + x0) + Float4Load(row0 + x1) + Float4Load(row1 + x0) + Float4Load(row1 + x1);
+                    Float4Store(out + x * 4, sum * quarter);
+                }
+            }
+        });
+    }
+
+    static float BesselI0(float x){
+        float sum = 1.0f;
+        float term = 1.0f;
+        for (int k = 1; k < 16; k++){
+            term *= (x * 0.5f / k) * (x * 0.5f / k);
+            sum += term;
+        }
+        return sum;
+    }
+
+    // Weights for output texel i of a 2:1 reduction over source texels
+    // 2i - 3 .. 2i + 4, whose centres lie -3.5 .. 3.5 source texels away.
+    struct KaiserKernel{
+        float mWeights[kKaiserTaps];
+        KaiserKernel(){
+            const float pi = 3.14159265f;
+            float total = 0.0f;
+            for (int t = 0; t < kKaiserTaps; t++){
+                float distance = t - kKaiserTaps / 2 + 0.5f;
+                float x = distance * 0.5f;  // in target texels
+                float sinc = std::sin(pi * x) / (pi * x);
+                float window = distance / (kKaiserTaps / 2);
+                mWeights[t] = sinc * BesselI0(kKaiserBeta * std::sqrt(std::max(0.0f, 1.0f - window * window))) / BesselI0(kKaiserBeta);
+                total += mWeights[t];
+            }
+            for (int t = 0; t < kKaiserTaps; t++){
+                mWeights[t] /= total;
+            }
+        }
+    };
+
+    // Separable: horizontal into a (w/2 x h) scratch level, then vertical.
+    static void DownsampleKaiser(const LinearLevel& source, LinearLevel& scratch, LinearLevel& target){
+        static const KaiserKernel kernel;
+        Float4 weight[kKaiserTaps];
+        for (int t = 0; t < kKaiserTaps; t++){
+            weight[t] = Float4Splat(kernel.mWeights[t]);
+        }
+        const int half = kKaiserTaps / 2 - 1;
+        // A side already at 1 texel is copied through; the filter only narrows the other.
+        int width = std::max(1, source.mWidth / 2);
+        int height = std::max(1, source.mHeight / 2);
+        scratch.mWidth = width;
+        scratch.mHeight = source.mHeight;
+        scratch.mPixels.resize((size_t)width * source.mHeight * 4);
+        scratch.mImage = nullptr;
+        JobSystem::Shared().ParallelFor(source.mHeight, kRowsPerJob, [&](size_t begin, size_t end){
+            std::vector<float> buffer;
+            for (size_t y = begin; y < end; y++){
+                const float* row = ReadRow(source, (int)y, buffer);
+                float* out = &scratch.mPixels[y * width * 4];
+                for (int x = 0; x < width; x++){
+                    if (source.mWidth == 1){
+                        Float4Store(out, Float4Load(row));
+                        continue;
+                    }
+                    Float4 sum = Float4Splat(0.0f);
+                    for (int t = 0; t < kKaiserTaps; t++){
+                        int sx = std::min(std::max(x * 2 - half + t, 0), source.mWidth - 1);
+                        sum = sum + Float4Load(row + (size_t)sx * 4) * weight[t];
+                    }
+                    Float4Store(out + x * 4, sum);
+                }
+            }
+        });
+        target.mWidth = width;
+        target.mHeight = height;
+        target.mPixels.resize((size_t)width * height * 4);
+        target.mImage = nullptr;
+        JobSystem::Shared().ParallelFor(height, kRowsPerJob, [&](size_t begin, size_t end){
+            for (size_t y = begin; y < end; y++){
+                float* out = &target.mPixels[y * width * 4];
+                if (scratch.mHeight == 1){
+                    memcpy(out, scratch.mPixels.data(), (size_t)width * 4 * sizeof(float));
+                    continue;
+                }
+                const float* rows[kKaiserTaps];
+                for (int t = 0; t < kKaiserTaps; t++){
+                    int sy = std::min(std::max((int)y * 2 - half + t, 0), scratch.mHeight - 1);
+                    rows[t] = &scratch.mPixels[(size_t)sy * width * 4];
+                }
+                for (int x = 0; x < width; x++){
+                    Float4 sum = Float4Splat(0.0f);
+                    for (int t = 0; t < kKaiserTaps; t++){
+                        sum = sum + Float4Load(rows[t] + x * 4) * weight[t];
+                    }
+                    Float4Store(out + x * 4, sum);
+                }
+            }
+        });
+    }
+
+    void ImageCodec::GenerateMips(const Image& base, MipFilter filter, std::vector<Image>& levels){
+        TRACE_SCOPE("ImageCodec::GenerateMips");
+        levels.clear();
+        levels.push_back(base);
+        // Each level is filtered from the previous one while still linear, so
+        // quantization does not accumulate down the chain.
+        LinearLevel current;
+        LinearLevel next;
+        LinearLevel scratch;
+        current.mWidth = base.mWidth;
+        current.mHeight = base.mHeight;
+        current.mImage = &base;
+        while (current.mWidth > 1 || current.mHeight > 1){
+            if (filter == kMipKaiser){
+                DownsampleKaiser(current, scratch, next);
+            } else {
+                DownsampleBox(current, next);
+            }
+            levels.emplace_back();
+            FromLinear(next, levels.back());
+            std::swap(current, next);
+        }
+    }
+
+    TextureStreamer::TextureStreamer(size_t budgetBytes, size_t uploadBytesPerFrame){
+        mDecoding = 0;
+        mFormat = kUncompressed;
+        mUploadBuffer = 0;
+        mBudgetBytes = budgetBytes;
+        mUploadBytesPerFrame = uploadBytesPerFrame;
+        mResidentBytes = 0;
+    }
+    TextureStreamer::~TextureStreamer(){
+        // Decode jobs write into the textures, so they must finish first.
+        WaitForDecodes();
+    }
+
+    void TextureStreamer::SetCompression(BlockFormat format, const std::string& cacheDirectory){
+        if (format == kBC7 && !BlockCompressor::IsSupported(kBC7)){
+            std::cout << "BC7 textures are not supported here; using BC3" << std::endl;
+            format = kBC3;
+        }
+        if (format != kUncompressed && !BlockCompressor::IsSupported(format)){
+            std::cout << BlockCompressor::GetName(format) << " textures are not supported here; using RGBA8" << std::endl;
+            format = kUncompressed;
+        }
+        mFormat = format;
+        mCacheDirectory = cacheDirectory;
+    }
+
+    static const char kCacheMagic[4] = { 'B', 'C', 'T', 'X' };
+    static const uint32_t kCacheVersion = 1;
+
+    // Keyed on the source file, the filter and the format, kCacheVersion
+    // standing for the encoder.
+    static uint64_t HashSource(const std::vector<uint8_t>& data, MipFilter filter, BlockFormat format){
+        const uint32_t salt[3] = { (uint32_t)filter, (uint32_t)format, kCacheVersion };
+        return DiskCache::Hash(salt, sizeof(salt), DiskCache::Hash(data.data(), data.size()));
+    }
+
+    // Cache file: magic, version, format and level count, then width, height,
+    // byte count and data of every level. Everything in the header has to match
+    // what the source image would produce, so a stale or truncated file is a miss.
+    bool TextureStreamer::ReadCache(const std::string& cachePath, BlockFormat format, int width, int height,
+                                    std::vector<Level>& levels){
+        std::ifstream cache(cachePath, std::ios::binary);
+        char magic[4];
+        uint32_t header[3];
+        if (!cache.read(magic, 4) || !cache.read((char*)header, sizeof(header)) || memcmp(magic, kCacheMagic, 4) != 0
+            || header[0] != kCacheVersion || header[1] != (uint32_t)format){
+            return false;
+        }
+        uint32_t levelCount = 1;
+        for (int w = width, h = height; w > 1 || h > 1; w = std::max(1, w / 2), h = std::max(1, h / 2)){
+            levelCount++;
+        }
+        if (header[2] != levelCount){
+            return false;
+        }
+        levels.resize(levelCount);
+        for (Level& level : levels){
+            uint32_t size[3];
+            if (!cache.read((char*)size, sizeof(size)) || size[0] != (uint32_t)width || size[1] != (uint32_t)height
+                || size[2] != BlockCompressor::GetEncodedSize(width, height, format)){
+                return false;
+            }
+            level.mWidth = width;
+            level.mHeight = height;
+            level.mData.resize(size[2]);
+            if (!cache.read((char*)level.mData.data(), size[2])){
+                return false;
+            }
+            width = std::max(1, width / 2);
+            height = std::max(1, height / 2);
+        }
+        return true;
+    }
+
+    bool TextureStreamer::BuildLevels(Texture& texture, const std::string& path, MipFilter filter,
+                                      const std::string& cacheDirectory){
+        std::vector<uint8_t> source;
+        if (!ImageCodec::ReadFile(path, source)){
+            return false;
+        }
+        // Decoded even on a cache hit: the cache is checked against its size.
+        Image image;
+        if (!ImageCodec::Decode(source.data(), source.size(), image)){
+            std::cout << "Could not decode image: " << path << std::endl;
+            return false;
+        }
+        std::string cachePath;
+        if (!cacheDirectory.empty() && texture.mFormat != kUncompressed){
+            cachePath = DiskCache::GetPath(cacheDirectory, HashSource(source, filter, texture.mFormat), "bctx");
+            if (ReadCache(cachePath, texture.mFormat, image.mWidth, image.mHeight, texture.mLevels)){
+                std::cout << "Loaded " << path << " from " << cachePath << std::endl;
+                return true;
+            }
+            texture.mLevels.clear();
+        }
+
+        std::vector<Image> mips;
+        ImageCodec::GenerateMips(image, filter, mips);
+        texture.mLevels.resize(mips.size());
+        for (size_t i = 0; i < mips.size(); i++){
+            Level& level = texture.mLevels[i];
+            level.mWidth = mips[i].mWidth;
+            level.mHeight = mips[i].mHeight;
+            if (texture.mFormat == kUncompressed){
+                level.mData = std::move(mips[i].mPixels);
+            } else {
+                BlockCompressor::Encode(mips[i], texture.mFormat, level.mData);
+            }
+        }
+        if (texture.mFormat == kUncompressed){
+            return true;
+        }
+        Image decoded;
+        BlockCompressor::Decode(texture.mLevels[0].mData.data(), image.mWidth, image.mHeight, texture.mFormat, decoded);
+        std::cout << "Compressed " << path << " to " << BlockCompressor::GetName(texture.mFormat) << ": PSNR "
+                  << BlockCompressor::ComputePSNR(image, decoded, texture.mFormat != kBC1) << " dB, "
+                  << image.mPixels.size() / 1024 << " KB -> " << texture.mLevels[0].mData.size() / 1024 << " KB" << std::endl;
+        if (!cachePath.empty()){
+            DiskCache::Write(cachePath, [&texture](std::ofstream& cache){
+                uint32_t header[3] = { kCacheVersion, (uint32_t)texture.mFormat, (uint32_t)texture.mLevels.size() };
+                cache.write(kCacheMagic, 4);
+                cache.write((const char*)header, sizeof(header));
+                for (const Level& level : texture.mLevels){
+                    uint32_t size[3] = { (uint32_t)level.mWidth, (uint32_t)level.mHeight, (uint32_t)level.mData.size() };
+                    cache.write((const char*)size, sizeof(size));
+                    cache.write((const char*)level.mData.data(), level.mData.size());
+                }
+            });
+        }
+        return true;
+    }
+
+    int TextureStreamer::Load(const std::string& path, MipFilter filter){
+        mTextures.push_back(std::unique_ptr<Texture>(new Texture()));
+        Texture* texture = mTextures.back().get();
+        texture->mFormat = mFormat;
+        std::string cacheDirectory = mCacheDirectory;
+        mDecoding++;
+        JobSystem::Shared().SubmitBackground([this, texture, path, filter, cacheDirectory](){
+            TRACE_SCOPE("TextureStreamer::Decode");
+            if (!BuildLevels(*texture, path, filter, cacheDirectory)){
+                texture->mState = kFailed;
+            } else {
+                int tail = 0;
+                while (std::max(texture->mLevels[tail].mWidth, texture->mLevels[tail].mHeight) > kMipTailSize){
+                    tail++;
+                }
+                texture->mTailTop = tail;
+                texture->mState = kDecoded;
+            }
+            mDecoding--;
+        });
+        return (int)mTextures.size() - 1;
+    }
+
+    void TextureStreamer::WaitForDecodes(){
+        while (mDecoding.load() > 0){
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    void TextureStreamer::RequestPixels(int handle, float pixels){
+        Texture& texture = *mTextures[handle];
+        texture.mRequestedPixels = std::max(texture.mRequestedPixels, pixels);
+    }
+
+    GLuint TextureStreamer::GetTexture(int handle) const{
+        return mTextures[handle]->mTexture;
+    }
+
+    int TextureStreamer::GetResidentLevel(int handle) const{
+        return mTextures[handle]->mResidentTop;
+    }
+
+    size_t TextureStreamer::GetLevelBytes(const Texture& texture, int top) const{
+        size_t bytes = 0;
+        for (size_t i = top; i < texture.mLevels.size(); i++){
+            bytes += texture.mLevels[i].mData.size();
+        }
+        return bytes;
+    }
+
+    void TextureStreamer::Update(){
+        TRACE_SCOPE("TextureStreamer::Update");
+        // The finest level the screen can use: its larger side is the first one
+        // at or above the requested pixels.
+        size_t wantedBytes = 0;
+        std::vector<Texture*> decoded;
+        for (const std::unique_ptr<Texture>& pointer : mTextures){
+            Texture& texture = *pointer;
+            if (texture.mState.load() != kDecoded){
+                continue;
+            }
+            int size = std::max(texture.mLevels[0].mWidth, texture.mLevels[0].mHeight);
+            int top = texture.mTailTop;
+            if (texture.mRequestedPixels > 0.0f){
+                top = (int)std::floor(std::log2(std::max(1.0f, size / texture.mRequestedPixels)));
+                top = std::min(std::max(top, 0), texture.mTailTop);
+            }
+            texture.mWantedTop = top;
+            wantedBytes += GetLevelBytes(texture, top);
+            decoded.push_back(&texture);
+        }
+        // Over budget: drop the top level of whichever texture is most oversampled
+        // (fewest screen pixels per texel) until everything fits or only tails remain.
+        while (wantedBytes > mBudgetBytes){
+            Texture* victim = nullptr;
+            float victimDensity = 0.0f;
+            for (Texture* texture : decoded){
+                if (texture->mWantedTop >= texture->mTailTop){
+                    continue;
+                }
+                const Level& level = texture->mLevels[texture->mWantedTop];
+                float density = texture->mRequestedPixels / std::max(level.mWidth, level.mHeight);
+                if (victim == nullptr || density < victimDensity){
+                    victim = texture;
+                    victimDensity = density;
+                }
+            }
+            if (victim == nullptr){
+                break;
+            }
+            wantedBytes -= victim->mLevels[victim->mWantedTop].mData.size();
+            victim->mWantedTop++;
+        }
+        // Evictions first: they free memory and only re-upload the smaller chain.
+        size_t uploaded = 0;
+        for (int pass = 0; pass < 2; pass++){
+            for (Texture* texture : decoded){
+                bool evict = texture->mResidentTop >= 0 && texture->mWantedTop > texture->mResidentTop;
+                bool load = texture->mResidentTop < 0 || texture->mWantedTop < texture->mResidentTop;
+                if ((pass == 0 && !evict) || (pass == 1 && !load)){
+                    continue;
+                }
+                size_t bytes = GetLevelBytes(*texture, texture->mWantedTop);
+                if (uploaded > 0 && uploaded + bytes > mUploadBytesPerFrame){
+                    continue;
+                }
+                Upload(*texture, texture->mWantedTop);
+                uploaded += bytes;
+            }
+        }
+        for (const std::unique_ptr<Texture>& texture : mTextures){
+            texture->mRequestedPixels = 0.0f;
+        }
+    }
+
+    // GL 4.1 has no sparse or immutable storage to shrink a texture in place, so
+    // every residency change builds a new texture holding levels top..1x1 and
+    // swaps it in. The pixels go through one unpack buffer, orphaned on every
+    // upload so the driver can hand out fresh storage while earlier copies are
+    // still in flight.
+    void TextureStreamer::Upload(Texture& texture, int top){
+        TRACE_SCOPE("TextureStreamer::Upload");
+        size_t bytes = GetLevelBytes(texture, top);
+        if (mUploadBuffer == 0){
+            glGenBuffers(1, &mUploadBuffer);
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, mUploadBuffer);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+        uint8_t* mapped = (uint8_t*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes,
+                                                     GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if (mapped == nullptr){
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            return;
+        }
+        size_t offset = 0;
+        for (size_t i = top; i < texture.mLevels.size(); i++){
+            memcpy(mapped + offset, texture.mLevels[i].mData.data(), texture.mLevels[i].mData.size());
+            offset += texture.mLevels[i].mData.size();
+        }
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+        GLuint handle = 0;
+        glGenTextures(1, &handle);
+        glBindTexture(GL_TEXTURE_2D, handle);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        offset = 0;
+        for (size_t i = top; i < texture.mLevels.size(); i++){
+            const Level& level = texture.mLevels[i];
+            if (texture.mFormat == kUncompressed){
+                glTexImage2D(GL_TEXTURE_2D, (GLint)(i - top), GL_RGBA8, level.mWidth, level.mHeight, 0, GL_RGBA,
+                             GL_UNSIGNED_BYTE, (const void*)offset);
+            } else {
+                glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)(i - top), BlockCompressor::GetGLFormat(texture.mFormat),
+                                       level.mWidth, level.mHeight, 0, (GLsizei)level.mData.size(), (const void*)offset);
+            }
+            offset += level.mData.size();
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)(texture.mLevels.size() - 1 - top));
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+        if (texture.mTexture != 0){
+            glDeleteTextures(1, &texture.mTexture);
+            mResidentBytes -= GetLevelBytes(texture, texture.mResidentTop);
+        }
+        texture.mTexture = handle;
+        texture.mResidentTop = top;
+        mResidentBytes += bytes;
+    }
+
+    void TextureStreamer::Destroy(){
+        WaitForDecodes();
+        for (const std::unique_ptr<Texture>& texture : mTextures){
+            if (texture->mTexture != 0){
+                glDeleteTextures(1, &texture->mTexture);
+                texture->mTexture = 0;
+                texture->mResidentTop = -1;
+            }
+        }
+        if (mUploadBuffer != 0){
+            glDeleteBuffers(1, &mUploadBuffer);
+            mUploadBuffer = 0;
+        }
+        mResidentBytes = 0;
+    }
+
+    // Smooth gradients under a fine checkerboard: the mips have both flat areas
+    // and detail that aliases when filtered badly.
+    static Image MakeTestImage(int size, int seed){
+        Image image;
+        image.mWidth = size;
+        image.mHeight = size;
+        image.mPixels.resize((size_t)size * size * 4);
+        for (int y = 0; y < size; y++){
+            for (int x = 0; x < size; x++){
+                uint8_t* p = &image.mPixels[((size_t)y * size + x) * 4];
+                int checker = ((x >> 2) ^ (y >> 2)) & 1;
+                p[0] = (uint8_t)((x * 255 / size + seed * 37) & 255);
+                p[1] = (uint8_t)((y * 255 / size) ^ (checker * 64));
+                p[2] = (uint8_t)(checker ? 220 : 30);
+                p[3] = 255;
+            }
+        }
+        return image;
+    }
+
+    static std::vector<uint8_t> EncodePPM(const Image& image){
+        std::string header = "P6\n" + std::to_string(image.mWidth) + " " + std::to_string(image.mHeight) + "\n255\n";
+        std::vector<uint8_t> data(header.begin(), header.end());
+        for (int y = image.mHeight - 1; y >= 0; y--){
+            for (int x = 0; x < image.mWidth; x++){
+                const uint8_t* p = &image.mPixels[((size_t)y * image.mWidth + x) * 4];
+                data.insert(data.end(), p, p + 3);
+            }
+        }
+        return data;
+    }
+
+    // RLE true-colour with alpha, bottom origin.
+    static std::vector<uint8_t> EncodeTGA(const Image& image){
+        std::vector<uint8_t> data(18, 0);
+        data[2] = 10;
+        data[12] = (uint8_t)(image.mWidth & 255);
+        data[13] = (uint8_t)(image.mWidth >> 8);
+        data[14] = (uint8_t)(image.mHeight & 255);
+        data[15] = (uint8_t)(image.mHeight >> 8);
+        data[16] = 32;
+        data[17] = 8;
+        size_t pixelCount = (size_t)image.mWidth * image.mHeight;
+        const uint32_t* pixels = (const uint32_t*)image.mPixels.data();
+        for (size_t i = 0; i < pixelCount;){
+            size_t run = 1;
+            while (i + run < pixelCount && run < 128 && pixels[i + run] == pixels[i]){
+                run++;
+            }
+            size_t count = run;
+            if (run > 1){
+                data.push_back((uint8_t)(0x80 | (run - 1)));
+            } else {
+                while (i + count < pixelCount && count < 128 && pixels[i + count] != pixels[i + count - 1]){
+                    count++;
+                }
+                data.push_back((uint8_t)(count - 1));
+            }
+            for (size_t k = 0; k < (run > 1 ? 1 : count); k++){
+                const uint8_t* p = &image.mPixels[(i + k) * 4];
+                data.insert(data.end(), { p[2], p[1], p[0], p[3] });
+            }
+            i += count;
+        }
+        return data;
+    }
+
+    void TextureStreamer::RunMicrobenchmark(int imageSize, int imageCount){
+        std::vector<std::vector<uint8_t>> files;
+        size_t fileBytes = 0;
+        for (int i = 0; i < imageCount; i++){
+            Image image = MakeTestImage(imageSize, i);
+            files.push_back(i % 2 == 0 ? EncodePPM(image) : EncodeTGA(image));
+            fileBytes += files.back().size();
+        }
+        double megapixels = (double)imageSize * imageSize * imageCount / 1e6;
+        std::cout << "Texture decode + mips: " << imageCount << " images of " << imageSize << "x" << imageSize
+                  << " (PPM and RLE TGA, " << fileBytes / (1024.0 * 1024.0) << " MB) on "
+                  << JobSystem::Shared().GetThreadCount() << " threads" << std::endl;
+
+        // One image per job, as TextureStreamer::Load does.
+        std::vector<Image> images(imageCount);
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        JobSystem::Shared().ParallelFor(imageCount, 1, [&](size_t begin, size_t end){
+            for (size_t i = begin; i < end; i++){
+                ImageCodec::Decode(files[i].data(), files[i].size(), images[i]);
+            }
+        });
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "\tdecode: " << seconds * 1000.0 << " ms (" << fileBytes / seconds / (1024.0 * 1024.0) << " MB/sec, "
+                  << megapixels / seconds << " Mpixels/sec)" << std::endl;
+
+        const MipFilter filters[2] = { kMipBox, kMipKaiser };
+        const char* names[2] = { "box", "kaiser" };
+        for (int f = 0; f < 2; f++){
+            std::vector<std::vector<Image>> chains(imageCount);
+            start = std::chrono::steady_clock::now();
+            JobSystem::Shared().ParallelFor(imageCount, 1, [&](size_t begin, size_t end){
+                for (size_t i = begin; i < end; i++){
+                    ImageCodec::GenerateMips(images[i], filters[f], chains[i]);
+                }
+            });
+            seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::cout << "\tmips (" << names[f] << "): " << seconds * 1000.0 << " ms (" << megapixels / seconds
+                      << " Mpixels/sec of level 0, " << chains[0].size() << " levels)" << std::endl;
+        }
+    }
@@ -0,0 +1,198 @@
+#include "Trace.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+    std::atomic<bool> TraceCollector::sActive(false);
+
+    static std::mutex sRegistryMutex;
+    static std::vector<std::unique_ptr<TraceBuffer>> sBuffers;
+    static std::vector<std::vector<TraceEvent>> sCollected;
+    static std::thread sDrainThread;
+    static std::atomic<bool> sDraining(false);
+    static uint64_t sStartTicks = 0;
+    static uint64_t sStartNanoseconds = 0;
+    static double sNanosecondsPerTick = 1.0;
+
+    TraceBuffer::TraceBuffer(uint32_t threadId)
+        : mThreadId(threadId), mHead(0), mTail(0), mDropped(0), mEvents(kCapacity){
+    }
+    void TraceBuffer::Drain(std::vector<TraceEvent>* out){
+        uint32_t tail = mTail.load(std::memory_order_relaxed);
+        uint32_t head = mHead.load(std::memory_order_acquire);
+        for (uint32_t i = tail; i != head; i++){
+            out->push_back(mEvents[i & (kCapacity - 1)]);
+        }
+        mTail.store(head, std::memory_order_release);
+    }
+
+    uint64_t TraceCollector::SteadyNanoseconds(){
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    TraceBuffer* TraceCollector::RegisterThread(){
+        std::lock_guard<std::mutex> lock(sRegistryMutex);
+        sBuffers.emplace_back(new TraceBuffer((uint32_t)sBuffers.size() + 1));
+        sCollected.emplace_back();
+        return sBuffers.back().get();
+    }
+    void TraceCollector::SetThreadName(const char* name){
+        TraceBuffer* buffer = GetThreadBuffer();
+        std::lock_guard<std::mutex> lock(sRegistryMutex);
+        buffer->mThreadName = name;
+    }
+    void TraceCollector::DrainAll(){
+        std::lock_guard<std::mutex> lock(sRegistryMutex);
+        for (size_t i = 0; i < sBuffers.size(); i++){
+            sBuffers[i]->Drain(&sCollected[i]);
+        }
+    }
+    void TraceCollector::Start(){
+        if (IsActive()){
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(sRegistryMutex);
+            for (size_t i = 0; i < sBuffers.size(); i++){
+                std::vector<TraceEvent> stale;
+                sBuffers[i]->Drain(&stale);
+                sCollected[i].clear();
+            }
+        }
+        sStartTicks = Now();
+        sStartNanoseconds = SteadyNanoseconds();
+        sDraining.store(true);
+        sDrainThread = std::thread([](){
+            while (sDraining.load(std::memory_order_relaxed)){
+                std::this_thread::sleep_for(std::chrono::milliseconds(2));
+                DrainAll();
+            }
+        });
+        sActive.store(true, std::memory_order_release);
+    }
+    void TraceCollector::Stop(){
+        if (!IsActive()){
+            return;
+        }
+        sActive.store(false, std::memory_order_release);
+        sDraining.store(false);
+        sDrainThread.join();
+        DrainAll();
+        // Calibrate the raw counter over the whole session.
+        uint64_t ticks = Now() - sStartTicks;
+        uint64_t nanoseconds = SteadyNanoseconds() - sStartNanoseconds;
+        sNanosecondsPerTick = ticks > 0 ? (double)nanoseconds / ticks : 1.0;
+    }
+    bool TraceCollector::WriteChromeTrace(const std::string& filepath){
+        std::ofstream file(filepath);
+        if (!file.is_open()){
+            std::cerr << "Failed to write trace: " << filepath << std::endl;
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(sRegistryMutex);
+        file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        const char* separator = "\n";
+        for (size_t i = 0; i < sBuffers.size(); i++){
+            const TraceBuffer& buffer = *sBuffers[i];
+            std::string name = buffer.mThreadName.empty() ? "Thread " + std::to_string(buffer.GetThreadId()) : buffer.mThreadName;
+            file << separator << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer.GetThreadId()
+                 << ",\"args\":{\"name\":\"" << name << "\",\"dropped_events\":" << buffer.GetDropped() << "}}";
+            separator = ",\n";
+        }
+        file.setf(std::ios::fixed);
+        file.precision(3);
+        for (size_t i = 0; i < sBuffers.size(); i++){
+            uint32_t threadId = sBuffers[i]->GetThreadId();
+            for (const TraceEvent& event : sCollected[i]){
+                double begin = (double)(int64_t)(event.mBegin - sStartTicks) * sNanosecondsPerTick / 1000.0;
+                double duration = (double)(event.mEnd - event.mBegin) * sNanosecondsPerTick / 1000.0;
+                file << separator << "{\"name\":\"" << event.mName << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << threadId
+                     << ",\"ts\":" << begin << ",\"dur\":" << duration << "}";
+                separator = ",\n";
+            }
+        }
+        file << "\n]}\n";
+        return true;
+    }
+    // Nanoseconds for count iterations of an empty loop, or of one holding a
+    // TRACE_SCOPE.
+    template <bool kScope>
+    static double TimeLoop(int count){
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (int i = 0; i < count; i++){
+            if (kScope){
+                TraceScope scope("microbenchmark");
+                asm volatile("" ::: "memory");
+            } else {
+                asm volatile("" ::: "memory");
+            }
+        }
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    size_t TraceCollector::CountEvents(const char* name, const char* threadName){
+        std::lock_guard<std::mutex> lock(sRegistryMutex);
+        size_t count = 0;
+        for (size_t i = 0; i < sBuffers.size(); i++){
+            if (sBuffers[i]->mThreadName != threadName){
+                continue;
+            }
+            for (const TraceEvent& event : sCollected[i]){
+                count += strcmp(event.mName, name) == 0;
+            }
+        }
+        return count;
+    }
+
+    double TraceCollector::RunMicrobenchmark(int iterations){
+        if (IsActive()){
+            std::cout << "Trace microbenchmark needs tracing to be stopped" << std::endl;
+            return -1.0;
+        }
+        TraceBuffer* buffer = GetThreadBuffer();
+        // Tracing compiled in but not started: one relaxed load and a branch.
+        // Both loops run interleaved and the fastest of each counts, so clock
+        // ramp-up and interruptions do not land on one side only. The branch is
+        // predicted and hides in the loop overhead, so what remains is noise
+        // around zero, reported as zero when it comes out below.
+        double inactiveBaseline = 0.0;
+        double inactive = 0.0;
+        for (int round = 0; round < 5; round++){
+            double empty = TimeLoop<false>(iterations);
+            double scoped = TimeLoop<true>(iterations);
+            inactiveBaseline = round == 0 ? empty : std::min(inactiveBaseline, empty);
+            inactive = round == 0 ? scoped : std::min(inactive, scoped);
+        }
+
+        // Recording runs in bursts of half a ring, each started once the collector
+        // has drained the last, so no event is dropped and every one pays for its store.
+        const int burst = (int)(TraceBuffer::kCapacity / 2);
+        Start();
+        uint64_t droppedBefore = buffer->GetDropped();
+        double baseline = 0.0;
+        double active = 0.0;
+        for (int done = 0; done < iterations; done += burst){
+            int count = std::min(burst, iterations - done);
+            while (buffer->GetPending() != 0){
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            baseline += TimeLoop<false>(count);
+            active += TimeLoop<true>(count);
+        }
+        uint64_t dropped = buffer->GetDropped() - droppedBefore;
+        Stop();
+        if (dropped != 0){
+            std::cout << "TRACE_SCOPE overhead: run failed, " << dropped << " of " << iterations << " events dropped" << std::endl;
+            return -1.0;
+        }
+        double perEvent = (active - baseline) / iterations;
+        std::cout << "TRACE_SCOPE overhead: " << perEvent << " ns/event recording, "
+                  << std::max(0.0, inactive - inactiveBaseline) / iterations << " ns/event when not started ("
+                  << iterations << " iterations in bursts of " << burst << ", none dropped)" << std::endl;
+        return perEvent;
+    }